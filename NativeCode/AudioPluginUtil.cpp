@@ -4,6 +4,7 @@
 
 #include "AudioPluginUtil.h"
 #include <stdarg.h>
+#include <atomic>
 
 #define ENABLE_TESTS ((PLATFORM_WIN || PLATFORM_OSX) && 1)
 
@@ -36,8 +37,9 @@ static void FFTProcess(UnityComplexNumber* data, int numsamples, bool forward)
         ++numbits;
     }
 
-    static unsigned int* reversetable[32] = { NULL };
-    unsigned int* tbl = reversetable[numbits];
+    // several threads can build a table at the same time, the first one published is kept.
+    static std::atomic<unsigned int*> reversetable[32] = {};
+    unsigned int* tbl = reversetable[numbits].load(std::memory_order_acquire);
     if (tbl == NULL)
     {
         tbl = new unsigned int[numsamples];
@@ -59,7 +61,12 @@ static void FFTProcess(UnityComplexNumber* data, int numsamples, bool forward)
             assert(tbl[tbl[n]] == n);
         }
 #endif
-        reversetable[numbits] = tbl;
+        unsigned int* published = NULL;
+        if (!reversetable[numbits].compare_exchange_strong(published, tbl, std::memory_order_acq_rel))
+        {
+            delete[] tbl;
+            tbl = published;
+        }
     }
 
     for (unsigned int i = 0; i < numsamples; i++)
@@ -386,47 +393,6 @@ void DeclareEffect(
     registereffectdefcallback(definition);
 }
 
-#define DECLARE_EFFECT(namestr, ns) \
-    namespace ns \
-    { \
-    UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK CreateCallback            (UnityAudioEffectState* state); \
-    UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK ReleaseCallback           (UnityAudioEffectState* state); \
-    UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK ProcessCallback           (UnityAudioEffectState* state, float* inbuffer, float* outbuffer, unsigned int length, int inchannels, int outchannels); \
-    UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK SetFloatParameterCallback (UnityAudioEffectState* state, int index, float value); \
-    UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK GetFloatParameterCallback (UnityAudioEffectState* state, int index, float* value, char *valuestr); \
-    UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK GetFloatBufferCallback    (UnityAudioEffectState* state, const char* name, float* buffer, int numsamples); \
-    int InternalRegisterEffectDefinition(UnityAudioEffectDefinition& definition); \
-    }
-#include "PluginList.h"
-#undef DECLARE_EFFECT
-
-#define DECLARE_EFFECT(namestr, ns) \
-DeclareEffect( \
-definition[numeffects++], \
-namestr, \
-ns::CreateCallback, \
-ns::ReleaseCallback, \
-ns::ProcessCallback, \
-ns::SetFloatParameterCallback, \
-ns::GetFloatParameterCallback, \
-ns::GetFloatBufferCallback, \
-ns::InternalRegisterEffectDefinition);
-
-extern "C" UNITY_AUDIODSP_EXPORT_API int AUDIO_CALLING_CONVENTION UnityGetAudioEffectDefinitions(UnityAudioEffectDefinition*** definitionptr)
-{
-    static UnityAudioEffectDefinition definition[256];
-    static UnityAudioEffectDefinition* definitionp[256];
-    static int numeffects = 0;
-    if (numeffects == 0)
-    {
-        #include "PluginList.h"
-    }
-    for (int n = 0; n < numeffects; n++)
-        definitionp[n] = &definition[n];
-    *definitionptr = definitionp;
-    return numeffects;
-}
-
 // Simplistic unit-test framework
 #if ENABLE_TESTS
     #define NAP_TESTSUITE(name) \
@@ -0,0 +1,170 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+// Compares the library binaural decoder with the PartitionedConvolver at orders 1 to 7,
+// with and without the use of the left/right symmetry of the filters.
+// usage: BenchmarkDecoder [vectorsize] [partition_size]
+//
+// The convolver is built from the responses of the library decoder when the order is
+// supported by the HRIR set, and from random filters of the same length and symmetry
+// otherwise.
+
+#include "HoaLibraryApi.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+
+using namespace HoaLibraryUnity;
+using matrix_t = PartitionedConvolver::matrix_t;
+using clock_type = std::chrono::steady_clock;
+
+namespace
+{
+    const size_t k_max_order = 7;
+    const double k_duration = 0.5; // seconds of processing per measure
+    
+    template<class Process>
+    double measure(Process&& process)
+    {
+        size_t blocks = 0;
+        const auto start = clock_type::now();
+        double elapsed = 0.;
+        
+        while(elapsed < k_duration)
+        {
+            process();
+            ++blocks;
+            elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+        }
+        
+        return elapsed * 1e6 / blocks;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const size_t vectorsize = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 512;
+    size_t partition_size = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 0;
+    
+    if(vectorsize == 0 || partition_size > vectorsize
+       || (partition_size > 0 && (vectorsize % partition_size != 0
+                                  || (partition_size & (partition_size - 1)) != 0)))
+    {
+        std::fprintf(stderr, "the partition size must be a power of two that divides the vectorsize\n");
+        return 1;
+    }
+    
+    if(partition_size == 0)
+    {
+        partition_size = get_max_partition_size(vectorsize);
+    }
+    
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float_t> distribution(-1.f, 1.f);
+    auto noise = [&](float_t) { return distribution(generator); };
+    
+    std::printf("vectorsize %zu, partition size %zu, HRIR order %zu\n\n",
+                vectorsize, partition_size, k_order);
+    std::printf("order  harmonics  length  partitions  symmetric  library (us)  "
+                "partitioned (us)  asymmetric (us)  speedup  error (dB)\n");
+    
+    size_t filter_length = 0;
+    
+    for(size_t order = 1; order <= k_max_order; ++order)
+    {
+        const size_t num_harmonics = get_num_harmonics_for_order(order);
+        
+        harmonics_matrix_t inputs = harmonics_matrix_t::Zero(num_harmonics, vectorsize).unaryExpr(noise);
+        stereo_matrix_t expected = stereo_matrix_t::Zero(2, vectorsize);
+        stereo_matrix_t outputs = stereo_matrix_t::Zero(2, vectorsize);
+        auto expected_map = stereo_matrix_t::Map(expected.data(), 2, vectorsize);
+        
+        matrix_t left, right;
+        std::unique_ptr<decoder_t> decoder = nullptr;
+        
+        if(order <= k_order)
+        {
+            decoder = std::make_unique<decoder_t>(order);
+            decoder->prepare(vectorsize);
+            
+            if(!probeDecoder(*decoder, num_harmonics, vectorsize, left, right))
+            {
+                std::fprintf(stderr, "order %zu: the decoder responses are too long\n", order);
+                return 1;
+            }
+            
+            filter_length = static_cast<size_t>(left.cols());
+        }
+        else
+        {
+            // right filters of the sin harmonics (m < 0) are the opposite of the left ones.
+            left = matrix_t::Zero(num_harmonics, filter_length).unaryExpr(noise);
+            right = left;
+            
+            for(size_t degree = 0; degree <= order; ++degree)
+            {
+                for(size_t i = 0; i < degree; ++i)
+                {
+                    right.row(degree * degree + i) *= -1.f;
+                }
+            }
+        }
+        
+        PartitionedConvolver convolver(partition_size, left, right);
+        PartitionedConvolver asymmetric_convolver(partition_size, left, right, false);
+        
+        double library_time = 0., error_db = 0.;
+        if(decoder)
+        {
+            library_time = measure([&]() { decoder->processBlock(inputs, expected_map); });
+            
+            // same input history for both
+            decoder = std::make_unique<decoder_t>(order);
+            decoder->prepare(vectorsize);
+            
+            double error = 0., energy = 0.;
+            for(size_t i = 0; i < filter_length / vectorsize + 2; ++i)
+            {
+                inputs = inputs.unaryExpr(noise);
+                decoder->processBlock(inputs, expected_map);
+                convolver.process(inputs, outputs);
+                error += (expected - outputs).cwiseAbs2().sum();
+                energy += expected.cwiseAbs2().sum();
+            }
+            
+            error_db = 10. * std::log10(error / energy);
+        }
+        
+        const double partitioned_time = measure([&]() { convolver.process(inputs, outputs); });
+        const double asymmetric_time = measure([&]() { asymmetric_convolver.process(inputs, outputs); });
+        const char* symmetric = convolver.isSymmetric() ? "yes" : "no";
+        
+        if(decoder)
+        {
+            std::printf("%5zu  %9zu  %6zu  %10zu  %9s  %12.1f  %16.1f  %15.1f  %7.1f  %10.1f\n",
+                        order, num_harmonics, filter_length, convolver.getNumberOfPartitions(), symmetric,
+                        library_time, partitioned_time, asymmetric_time,
+                        library_time / partitioned_time, error_db);
+        }
+        else
+        {
+            std::printf("%5zu  %9zu  %6zu  %10zu  %9s  %12s  %16.1f  %15.1f  %7s  %10s\n",
+                        order, num_harmonics, filter_length, convolver.getNumberOfPartitions(), symmetric,
+                        "-", partitioned_time, asymmetric_time, "-", "-");
+        }
+    }
+    
+    return 0;
+}
@@ -0,0 +1,470 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+// Measures the hot paths of the renderer and writes the results in JSON.
+// usage: BenchmarkSuite [--quick] [--output results.json] [--baseline baseline.json] [--threshold 10]
+//
+// - source_process: Source::process of a moving source, per order, block size,
+//   optimization and encoding mode.
+// - source_input: Source::setInterleavedBuffer (downmix and handoff), per block size.
+// - decoder: the binaural decoder processBlock, per order and block size.
+// - render: HoaLibraryApi::fillInterleavedOutputBuffer with moving sources, their input
+//   blocks included, per number of sources, block size and encoding mode.
+//
+// Each case reports the time per block, the time per sample and per source, and the
+// real-time factor (duration of a block over its processing time) at 48 kHz.
+// With --baseline, each case is compared to the case with the same key in a previous
+// output: the cases slower by more than the threshold (in percent) are reported, and
+// the exit code is 2 if there is any.
+
+#include "HoaLibraryApi.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace HoaLibraryUnity;
+using clock_type = std::chrono::steady_clock;
+
+namespace
+{
+    const float_t k_sample_rate = 48000.f;
+    
+    struct Result
+    {
+        std::string key;        // unique name of the case
+        std::string benchmark;
+        size_t order = 0;
+        size_t blocksize = 0;
+        size_t sources = 1;
+        std::string variant;
+        double block_us = 0.;
+        
+        double getNsPerSampleSource() const { return block_us * 1e3 / (blocksize * sources); }
+        double getRealTimeFactor() const { return (blocksize / k_sample_rate) * 1e6 / block_us; }
+    };
+    
+    class Suite
+    {
+    public:
+        
+        explicit Suite(double duration) : m_duration(duration) {}
+        
+        //! @brief Measures the mean time of a block, in microseconds.
+        template<class Process>
+        void measure(Result result, Process&& process)
+        {
+            // one block to warm up the caches and the allocations.
+            process();
+            
+            size_t blocks = 0;
+            const auto start = clock_type::now();
+            double elapsed = 0.;
+            
+            while(elapsed < m_duration || blocks < 3)
+            {
+                process();
+                ++blocks;
+                elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+            }
+            
+            result.block_us = elapsed * 1e6 / blocks;
+            
+            std::printf("%-48s %12.2f us/block %10.3f ns/sample/source %10.1f x real-time\n",
+                        result.key.c_str(), result.block_us,
+                        result.getNsPerSampleSource(), result.getRealTimeFactor());
+            std::fflush(stdout);
+            
+            m_results.push_back(result);
+        }
+        
+        std::vector<Result> const& getResults() const { return m_results; }
+    
+    private:
+        
+        const double m_duration;
+        std::vector<Result> m_results {};
+    };
+    
+    std::string make_key(std::string const& benchmark, size_t order, size_t blocksize,
+                         size_t sources, std::string const& variant)
+    {
+        std::ostringstream key;
+        key << benchmark << "/o" << order << "/b" << blocksize << "/s" << sources;
+        if(!variant.empty())
+        {
+            key << "/" << variant;
+        }
+        
+        return key.str();
+    }
+    
+    Result make_result(std::string const& benchmark, size_t order, size_t blocksize,
+                       size_t sources, std::string const& variant)
+    {
+        Result result;
+        result.key = make_key(benchmark, order, blocksize, sources, variant);
+        result.benchmark = benchmark;
+        result.order = order;
+        result.blocksize = blocksize;
+        result.sources = sources;
+        result.variant = variant;
+        return result;
+    }
+    
+    std::vector<float_t> make_noise(size_t size)
+    {
+        std::mt19937 generator(1);
+        std::uniform_real_distribution<float_t> distribution(-0.5f, 0.5f);
+        
+        std::vector<float_t> noise(size);
+        for(auto& sample : noise)
+        {
+            sample = distribution(generator);
+        }
+        
+        return noise;
+    }
+    
+    const char* get_mode_name(EncodingMode mode)
+    {
+        switch(mode)
+        {
+            case EncodingMode::PerSample: return "persample";
+            case EncodingMode::BlockRate: return "blockrate";
+            case EncodingMode::Matrix: return "matrix";
+            case EncodingMode::Spatializer: return "spatializer";
+        }
+        
+        return "";
+    }
+    
+    const char* get_optim_name(int optim)
+    {
+        static const char* const names[] = { "basic", "maxre", "inphase" };
+        return names[optim];
+    }
+    
+    // ==================================================================================== //
+    // Benchmarks
+    // ==================================================================================== //
+    
+    void run_source_process(Suite& suite, std::vector<size_t> const& orders,
+                            std::vector<size_t> const& blocksizes)
+    {
+        const EncodingMode modes[] = { EncodingMode::PerSample, EncodingMode::BlockRate };
+        
+        for(const size_t order : orders)
+        {
+            for(const size_t blocksize : blocksizes)
+            {
+                const auto input = make_noise(blocksize * 2);
+                harmonics_matrix_t harmonics = harmonics_matrix_t::Zero(get_num_harmonics_for_order(order), blocksize);
+                
+                for(int optim = 0; optim < 3; ++optim)
+                {
+                    for(const auto mode : modes)
+                    {
+                        Source source(order, blocksize, k_sample_rate);
+                        source.setOptim(optim);
+                        source.setEncodingMode(mode, k_default_encoding_subblock_size);
+                        source.updateEncodingOrder();
+                        
+                        InputStatistics statistics;
+                        source.setInterleavedBuffer(input.data(), blocksize, 0);
+                        source.acquireInput(0, statistics);
+                        
+                        // a source turning around the listener, so that the coefficients always change.
+                        float_t angle = 0.f;
+                        std::string variant = std::string(get_optim_name(optim)) + "/" + get_mode_name(mode);
+                        
+                        suite.measure(make_result("source_process", order, blocksize, 1, variant), [&]() {
+                            angle += 0.01f;
+                            source.setPosition(std::cos(angle) * 2.f, 0.5f, std::sin(angle) * 2.f);
+                            harmonics.setZero();
+                            source.process(harmonics);
+                        });
+                    }
+                }
+            }
+        }
+    }
+    
+    void run_source_input(Suite& suite, std::vector<size_t> const& blocksizes)
+    {
+        for(const size_t blocksize : blocksizes)
+        {
+            const auto input = make_noise(blocksize * 2);
+            Source source(1, blocksize, k_sample_rate);
+            dsptick_t dsptick = 0;
+            
+            suite.measure(make_result("source_input", 0, blocksize, 1, ""), [&]() {
+                source.setInterleavedBuffer(input.data(), blocksize, dsptick);
+                dsptick += blocksize;
+            });
+        }
+    }
+    
+    void run_decoder(Suite& suite, std::vector<size_t> const& blocksizes)
+    {
+        for(size_t order = 1; order <= k_order; ++order)
+        {
+            for(const size_t blocksize : blocksizes)
+            {
+                const size_t num_harmonics = get_num_harmonics_for_order(order);
+                const auto noise = make_noise(num_harmonics * blocksize);
+                harmonics_matrix_t inputs = harmonics_matrix_t::Map(noise.data(), num_harmonics, blocksize);
+                stereo_matrix_t outputs = stereo_matrix_t::Zero(2, blocksize);
+                auto outputs_map = stereo_matrix_t::Map(outputs.data(), 2, blocksize);
+                
+                decoder_t decoder(order);
+                decoder.prepare(blocksize);
+                
+                suite.measure(make_result("decoder", order, blocksize, 1, ""), [&]() {
+                    decoder.processBlock(inputs, outputs_map);
+                });
+            }
+        }
+    }
+    
+    void run_render(Suite& suite, std::vector<size_t> const& counts, std::vector<size_t> const& blocksizes)
+    {
+        const EncodingMode modes[] = { EncodingMode::PerSample, EncodingMode::BlockRate, EncodingMode::Matrix };
+        
+        for(const size_t count : counts)
+        {
+            for(const size_t blocksize : blocksizes)
+            {
+                const auto input = make_noise(blocksize * 2);
+                std::vector<float_t> outputs(blocksize * 2);
+                
+                for(const auto mode : modes)
+                {
+                    // the near-field filters on top of each encoding mode, the sources get closer
+                    // and farther than the reproduction radius.
+                    for(const bool near_field : {false, true})
+                    {
+                        ApiSettings settings;
+                        settings.vectorsize = blocksize;
+                        settings.sample_rate = k_sample_rate;
+                        settings.max_sources = count;
+                        settings.near_field.enabled = near_field;
+                        
+                        std::unique_ptr<HoaLibraryApi> api(CreateHoaLibraryApi(settings));
+                        api->setEncodingMode(mode);
+                        
+                        std::vector<HoaLibraryApi::source_id_t> sources;
+                        for(size_t i = 0; i < count; ++i)
+                        {
+                            sources.push_back(api->createSource());
+                        }
+                        
+                        dsptick_t dsptick = 0;
+                        float_t angle = 0.f;
+                        
+                        const std::string variant = std::string(get_mode_name(mode)) + (near_field ? "/nearfield" : "");
+                        suite.measure(make_result("render", api->getOrder(), blocksize, count, variant), [&]() {
+                            angle += 0.01f;
+                            for(size_t i = 0; i < count; ++i)
+                            {
+                                const float_t source_angle = angle + i * 0.1f;
+                                const float_t distance = near_field ? 2.f + 1.5f * std::sin(source_angle * 0.5f) : 3.f;
+                                api->setSourcePosition(sources[i], std::cos(source_angle) * distance, 0.f,
+                                                       std::sin(source_angle) * distance);
+                                api->setInterleavedSourceBuffer(sources[i], input.data(), blocksize, dsptick);
+                            }
+                            
+                            api->fillInterleavedOutputBuffer(blocksize, outputs.data(), dsptick);
+                            dsptick += blocksize;
+                        });
+                    }
+                }
+            }
+        }
+    }
+    
+    // ==================================================================================== //
+    // JSON
+    // ==================================================================================== //
+    
+    //! @brief Writes the results, one case per line so that the baselines are easy to diff.
+    bool write_json(std::string const& path, std::vector<Result> const& results)
+    {
+        std::ofstream file(path);
+        if(!file)
+            return false;
+        
+        file << "{\n  \"sample_rate\": " << k_sample_rate << ",\n  \"hrir_order\": " << k_order
+        << ",\n  \"results\": [\n";
+        
+        for(size_t i = 0; i < results.size(); ++i)
+        {
+            auto const& result = results[i];
+            char line[512];
+            std::snprintf(line, sizeof(line),
+                          "    {\"key\": \"%s\", \"benchmark\": \"%s\", \"order\": %zu, \"blocksize\": %zu, "
+                          "\"sources\": %zu, \"variant\": \"%s\", \"us_per_block\": %.4f, "
+                          "\"ns_per_sample_source\": %.5f, \"realtime_factor\": %.3f}%s\n",
+                          result.key.c_str(), result.benchmark.c_str(), result.order, result.blocksize,
+                          result.sources, result.variant.c_str(), result.block_us,
+                          result.getNsPerSampleSource(), result.getRealTimeFactor(),
+                          (i + 1 < results.size()) ? "," : "");
+            file << line;
+        }
+        
+        file << "  ]\n}\n";
+        return static_cast<bool>(file);
+    }
+    
+    //! @brief Reads the time per sample and per source of each key of a file written by write_json.
+    bool read_baseline(std::string const& path, std::map<std::string, double>& baseline)
+    {
+        std::ifstream file(path);
+        if(!file)
+            return false;
+        
+        const std::string key_field = "\"key\": \"";
+        const std::string time_field = "\"ns_per_sample_source\": ";
+        
+        std::string line;
+        while(std::getline(file, line))
+        {
+            const auto key_position = line.find(key_field);
+            const auto time_position = line.find(time_field);
+            if(key_position == std::string::npos || time_position == std::string::npos)
+                continue;
+            
+            const auto key_start = key_position + key_field.size();
+            const auto key_end = line.find('"', key_start);
+            if(key_end == std::string::npos)
+                continue;
+            
+            baseline[line.substr(key_start, key_end - key_start)]
+            = std::strtod(line.c_str() + time_position + time_field.size(), nullptr);
+        }
+        
+        return true;
+    }
+    
+    //! @brief Prints the comparison with a baseline.
+    //! @return The number of regressions.
+    size_t compare(std::vector<Result> const& results, std::map<std::string, double> const& baseline,
+                   double threshold)
+    {
+        std::printf("\n%-48s %14s %14s %9s\n", "case", "baseline (ns)", "current (ns)", "change");
+        
+        size_t regressions = 0, compared = 0;
+        for(auto const& result : results)
+        {
+            auto it = baseline.find(result.key);
+            if(it == baseline.end() || !(it->second > 0.))
+                continue;
+            
+            ++compared;
+            const double current = result.getNsPerSampleSource();
+            const double change = (current / it->second - 1.) * 100.;
+            const bool regression = change > threshold;
+            regressions += regression ? 1 : 0;
+            
+            std::printf("%-48s %14.3f %14.3f %+8.1f%%%s\n", result.key.c_str(), it->second, current, change,
+                        regression ? "  REGRESSION" : (change < -threshold ? "  improvement" : ""));
+        }
+        
+        std::printf("\n%zu cases compared, %zu slower by more than %.1f%%\n", compared, regressions, threshold);
+        return regressions;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool quick = false;
+    std::string output = "benchmark.json";
+    std::string baseline_path;
+    double threshold = 10.;
+    
+    for(int i = 1; i < argc; ++i)
+    {
+        const bool has_value = (i + 1 < argc);
+        
+        if(std::strcmp(argv[i], "--quick") == 0)
+        {
+            quick = true;
+        }
+        else if(std::strcmp(argv[i], "--output") == 0 && has_value)
+        {
+            output = argv[++i];
+        }
+        else if(std::strcmp(argv[i], "--baseline") == 0 && has_value)
+        {
+            baseline_path = argv[++i];
+        }
+        else if(std::strcmp(argv[i], "--threshold") == 0 && has_value)
+        {
+            threshold = std::strtod(argv[++i], nullptr);
+        }
+        else
+        {
+            std::fprintf(stderr, "usage: BenchmarkSuite [--quick] [--output results.json] "
+                         "[--baseline baseline.json] [--threshold percent]\n");
+            return 1;
+        }
+    }
+    
+    std::map<std::string, double> baseline;
+    if(!baseline_path.empty() && !read_baseline(baseline_path, baseline))
+    {
+        std::fprintf(stderr, "can't read the baseline %s\n", baseline_path.c_str());
+        return 1;
+    }
+    
+    // the quick sweep is meant for continuous integration, the full one before a release.
+    Suite suite(quick ? 0.02 : 0.2);
+    
+    const std::vector<size_t> orders = quick ? std::vector<size_t> { 1, 3 } : std::vector<size_t> { 1, 3, 5, 7 };
+    const std::vector<size_t> blocksizes = quick
+    ? std::vector<size_t> { 256, 1024 }
+    : std::vector<size_t> { 64, 256, 1024, 4096 };
+    const std::vector<size_t> counts = quick
+    ? std::vector<size_t> { 1, 100 }
+    : std::vector<size_t> { 1, 10, 100, 500, 2000 };
+    const std::vector<size_t> render_blocksizes = quick
+    ? std::vector<size_t> { 512 }
+    : std::vector<size_t> { 64, 512, 4096 };
+    
+    run_source_process(suite, orders, blocksizes);
+    run_source_input(suite, blocksizes);
+    run_decoder(suite, blocksizes);
+    run_render(suite, counts, render_blocksizes);
+    
+    if(!write_json(output, suite.getResults()))
+    {
+        std::fprintf(stderr, "can't write %s\n", output.c_str());
+        return 1;
+    }
+    
+    std::printf("\nresults written to %s\n", output.c_str());
+    
+    if(!baseline.empty() || !baseline_path.empty())
+    {
+        return compare(suite.getResults(), baseline, threshold) > 0 ? 2 : 0;
+    }
+    
+    return 0;
+}
@@ -11,11 +11,17 @@
 
 #include "HoaLibraryApi.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <random>
+
 namespace HoaLibraryUnity
 {
-    HOA_EXPORT HoaLibraryApi* CreateHoaLibraryApi(size_t vectorsize)
+    HOA_EXPORT HoaLibraryApi* CreateHoaLibraryApi(ApiSettings const& settings)
     {
-        return new HoaLibraryApi(vectorsize);
+        return new HoaLibraryApi(settings);
     }
     
     SphericalCoordinate cartopol(CartesianCoordinate car)
@@ -60,21 +66,70 @@ namespace HoaLibraryUnity
         return {m_x.process(), m_y.process(), m_z.process()};
     }
     
+    CartesianCoordinate SmoothedCartesianCoordinate::process(size_t frames)
+    {
+        for(size_t i = 1; i < frames; ++i)
+        {
+            m_x.process();
+            m_y.process();
+            m_z.process();
+        }
+        
+        return process();
+    }
+    
     // ==================================================================================== //
     // Source
     // ==================================================================================== //
     
-    Source::Source(size_t order, size_t vectorsize)
-    : m_encoder(order)
+    Source::Source(size_t order, size_t vectorsize, float_t sample_rate,
+                   NearFieldFilters const* near_field, bool encoded_inputs)
+    : m_max_order(order)
+    , m_encoder(order)
     , m_optim(order)
+    , m_encoded_inputs(encoded_inputs)
+    , m_input_blocks(InputBlock {
+        vector_t::Zero(vectorsize),
+        encoded_inputs ? harmonics_matrix_t::Zero(get_num_harmonics_for_order(order), vectorsize) : harmonics_matrix_t(),
+        0, 0, false, true, 0.f
+    })
+    , m_encoded_gains(vectorsize)
     , m_mono_input_buffer(vectorsize)
     , m_temp_harmonics(m_encoder.getNumberOfHarmonics())
+    , m_coeffs(m_encoder.getNumberOfHarmonics())
+    , m_target_coeffs(m_encoder.getNumberOfHarmonics())
+    , m_ramped_input(vectorsize)
+    , m_requested_order(order)
+    , m_order(order)
+    , m_order_harmonics(get_num_harmonics_for_order(order))
+    , m_coeffs_harmonics(m_order_harmonics)
+    , m_target_harmonics(m_order_harmonics)
+    , m_order_weights(m_encoder.getNumberOfHarmonics())
     {
-        m_smoothed_position.setRamp(1100); // in samps (± 25ms at 44.1kHz)
+        const auto smoothing_ramp = std::lround(k_position_smoothing_time * 0.001f * sample_rate);
+        m_smoothed_position.setRamp(static_cast<size_t>(std::max(smoothing_ramp, 1l)));
         m_optim.setMode(optim_mode_t::Basic);
         
         m_mono_input_buffer.setZero();
+        m_encoded_gains.setOnes();
         m_temp_harmonics.setZero();
+        m_coeffs.setZero();
+        m_target_coeffs.setZero();
+        m_ramped_input.setZero();
+        m_order_weights.setOnes();
+        
+        if(near_field != nullptr && near_field->getOrder() == order)
+        {
+            m_near_field_filters = near_field;
+            m_next_near_field_filters.store(near_field, std::memory_order_relaxed);
+            m_used_near_field_filters.store(near_field, std::memory_order_relaxed);
+            m_near_field = std::make_unique<NearFieldBatch>(order, near_field->getNumberOfSections(),
+                                                            1, vectorsize);
+            m_near_field_signals = signal_matrix_t::Zero(order + 1, vectorsize);
+            m_near_field_ramped = signal_matrix_t::Zero(order + 1, vectorsize);
+            m_near_field_coeffs = harmonics_matrix_t::Zero(m_coeffs.size(), order + 1);
+            m_near_field_deltas = harmonics_matrix_t::Zero(m_coeffs.size(), order + 1);
+        }
     }
     
     Source::~Source()
@@ -87,174 +142,2534 @@ namespace HoaLibraryUnity
     
     void Source::setOptim(int optim_int)
     {
-        auto optim = static_cast<optim_mode_t>(optim_int);
-        if(optim != m_optim.getMode())
+        m_requested_optim.store(optim_int, std::memory_order_relaxed);
+    }
+    
+    void Source::setOptimBypassed(bool bypassed)
+    {
+        m_optim_bypassed.store(bypassed, std::memory_order_relaxed);
+    }
+    
+    bool Source::isOptimApplied() const
+    {
+        return m_optim.getMode() != optim_mode_t::Basic && !m_optim_bypass_applied;
+    }
+    
+    void Source::setGain(float_t gain)
+    {
+        m_gain = std::max<float_t>(0.f, gain);
+    }
+    
+    void Source::setPriority(float_t priority)
+    {
+        m_priority.store(priority, std::memory_order_relaxed);
+    }
+    
+    float_t Source::getPriority() const
+    {
+        return m_priority.load(std::memory_order_relaxed);
+    }
+    
+    float_t Source::getDistance() const
+    {
+        return m_distance.load(std::memory_order_relaxed);
+    }
+    
+    void Source::updateDistance(CartesianCoordinate const& position)
+    {
+        m_distance.store(std::sqrt(position.x * position.x + position.y * position.y + position.z * position.z),
+                         std::memory_order_relaxed);
+    }
+    
+    void Source::setEncodingOrder(size_t order)
+    {
+        m_requested_order.store(std::min(order, m_max_order), std::memory_order_relaxed);
+    }
+    
+    void Source::updateEncodingOrder()
+    {
+        const size_t order = m_requested_order.load(std::memory_order_relaxed);
+        if(order != m_order)
+        {
+            m_order = order;
+            m_order_harmonics = get_num_harmonics_for_order(order);
+            computeOrderWeights();
+            m_coeffs_dirty = true;
+        }
+        
+        const auto optim = static_cast<optim_mode_t>(m_requested_optim.load(std::memory_order_relaxed));
+        const bool bypassed = m_optim_bypassed.load(std::memory_order_relaxed);
+        if(optim != m_optim.getMode() || bypassed != m_optim_bypass_applied)
         {
             m_optim.setMode(optim);
+            m_optim_bypass_applied = bypassed;
+            m_coeffs_dirty = true;
         }
     }
     
-    void Source::setGain(float_t gain)
+    size_t Source::getEncodingOrder() const
     {
-        m_gain = std::max<float_t>(0.f, gain);
+        return m_requested_order.load(std::memory_order_relaxed);
     }
     
-    void Source::setInterleavedBuffer(float_t const* inputs, size_t frames)
+    size_t Source::getEncodingHarmonics() const
     {
-        assert(frames == m_mono_input_buffer.size() && "");
+        return m_coeffs_initialized ? std::max(m_coeffs_harmonics, m_order_harmonics) : m_order_harmonics;
+    }
+    
+    void Source::computeOrderWeights()
+    {
+        m_order_weights.setZero();
         
-        const float_t left_gain = (1.f - m_pan) * 0.5;
-        const float_t right_gain = (1.f + m_pan) * 0.5;
+        // max-rE: g(l) = P_l(cos(137.9° / (N + 1.51))) (Zotter & Frank approximation),
+        // the Legendre polynomials are evaluated with the Bonnet recursion.
+        const double x = std::cos(2.4068 / (m_order + 1.51));
+        double previous = 0., weight = 1.;
+        double energy = 0., weighted_energy = 0.;
         
-        auto const& stereo_input = stereo_matrix_t::Map(inputs, 2, frames);
+        for(size_t degree = 0; degree <= m_order; ++degree)
+        {
+            if(degree > 0)
+            {
+                const double next = ((2. * degree - 1.) * x * weight - (degree - 1.) * previous) / degree;
+                previous = weight;
+                weight = next;
+            }
+            
+            m_order_weights.segment(degree * degree, 2 * degree + 1).setConstant(static_cast<float_t>(weight));
+            energy += 2. * degree + 1.;
+            weighted_energy += (2. * degree + 1.) * weight * weight;
+        }
         
-        m_mono_input_buffer.noalias() = ((stereo_input.row(0) * left_gain)
-                                         + (stereo_input.row(1) * right_gain)) * m_gain;
+        // preserves the energy of the unweighted harmonics.
+        m_order_weights *= static_cast<float_t>(std::sqrt(energy / weighted_energy));
     }
     
-    void Source::setPosition(float_t x, float_t y, float_t z)
+    bool Source::setInterleavedBuffer(float_t const* inputs, size_t frames, dsptick_t dsptick,
+                                      size_t encoding_subblock_size)
     {
-        m_smoothed_position.setValues({x, y, z});
+        assert(frames == m_mono_input_buffer.size() && "");
+        
+        const float_t left_gain = (1.f - m_pan) * 0.5;
+        const float_t right_gain = (1.f + m_pan) * 0.5;
+        
+        auto& block = m_input_blocks.getWriteBuffer();
+        
+        // downmix, peak and energy in one pass, with one accumulator per lane
+        // so that the reductions vectorize without reassociation.
+        float_t peaks[k_simd_lanes] = {};
+        float_t energies[k_simd_lanes] = {};
+        
+        if(m_gain > 0.f)
+        {
+            auto* samples = block.samples.data();
+            const size_t vectorized_frames = frames - frames % k_simd_lanes;
+            
+            auto downmix = [&](size_t frame, size_t lane) {
+                const float_t sample = (inputs[2 * frame] * left_gain + inputs[2 * frame + 1] * right_gain) * m_gain;
+                samples[frame] = sample;
+                peaks[lane] = std::max(peaks[lane], std::abs(sample));
+                energies[lane] += sample * sample;
+            };
+            
+            for(size_t frame = 0; frame < vectorized_frames; frame += k_simd_lanes)
+            {
+                for(size_t lane = 0; lane < k_simd_lanes; ++lane)
+                {
+                    downmix(frame + lane, lane);
+                }
+            }
+            
+            for(size_t frame = vectorized_frames; frame < frames; ++frame)
+            {
+                downmix(frame, 0);
+            }
+        }
+        else
+        {
+            block.samples.setZero();
+        }
+        
+        float_t peak = 0.f, energy = 0.f;
+        for(size_t lane = 0; lane < k_simd_lanes; ++lane)
+        {
+            peak = std::max(peak, peaks[lane]);
+            energy += energies[lane];
+        }
+        
+        block.dsptick = dsptick;
+        block.silent = (peak <= k_silence_threshold);
+        block.level = std::sqrt(energy / frames);
+        block.encoded = false;
+        
+        // the block is encoded here only if the audio thread handed the encoding state over.
+        if(m_spatializer_encoding.load(std::memory_order_acquire))
+        {
+            if(encoding_subblock_size > 0)
+            {
+                block.encoded = true;
+                if(m_near_field)
+                {
+                    applyNearFieldFilters(m_next_near_field_filters.load(std::memory_order_acquire));
+                }
+            }
+            else
+            {
+                // the mode changed: the state is handed back with this block, not touched anymore.
+                m_spatializer_encoding.store(false, std::memory_order_release);
+            }
+        }
+        
+        if(block.encoded && block.silent)
+        {
+            // nothing to encode, the renderer skips the block.
+            skipBlock();
+        }
+        else if(block.encoded)
+        {
+            // the renderer does not touch the encoding state of the source while
+            // it receives encoded blocks.
+            updateEncodingOrder();
+            block.num_harmonics = getEncodingHarmonics();
+            block.harmonics.topRows(block.num_harmonics).setZero();
+            
+            if(m_near_field)
+            {
+                filterNearField(block.samples, frames);
+            }
+            
+            encodeBlockRate(block.samples, encoding_subblock_size, block.harmonics);
+        }
+        
+        m_input_blocks.publish();
+        
+        const bool duplicated = (m_has_published && m_last_published_tick == dsptick);
+        m_last_published_tick = dsptick;
+        m_has_published = true;
+        return !duplicated;
     }
     
-    void Source::process(harmonics_matrix_t& harmonics_matrix)
+    void Source::acquireInput(dsptick_t dsptick, InputStatistics& statistics)
     {
-        assert(harmonics_matrix.cols() == m_mono_input_buffer.size());
+        const auto frames = static_cast<dsptick_t>(m_mono_input_buffer.size());
         
-        const bool process_optim = m_optim.getMode() != optim_mode_t::Basic;
+        m_encoded_faded = false;
         
-        auto* input = m_mono_input_buffer.data();
-        for(auto harmonic_vector : harmonics_matrix.colwise())
+        bool acquired = false;
+        if(m_input_blocks.update())
         {
-            auto polar_coords = cartopol(m_smoothed_position.process());
+            // the harmonics of the previous block are gone.
+            m_encoded_available = false;
+            
+            auto const& block = m_input_blocks.getReadBuffer();
             
-            if(m_encoder.getRadius() != polar_coords.radius)
+            // published again for the tick already acquired: it is not a gap, the last
+            // block is kept (the duplicate was counted when it was published).
+            const bool republished = (m_has_acquired && block.dsptick == m_last_acquired_tick);
+            
+            if(block.dsptick == dsptick || block.dsptick + frames == dsptick)
             {
-                // We let unity provide gain attenuation when the source is farther than 1 meter.
-                // @todo Set it to "minimum distance" instead of the arbitrary 1 meter value.
+                if(!republished && m_has_acquired && block.dsptick > m_last_acquired_tick + frames)
+                {
+                    statistics.dropped_blocks += (block.dsptick - m_last_acquired_tick) / frames - 1;
+                }
+                
+                if(block.encoded)
+                {
+                    m_encoded_available = true;
+                }
+                else
+                {
+                    m_mono_input_buffer = block.samples;
+                }
                 
-                m_encoder.setRadius(std::min<float_t>(polar_coords.radius, 1.0f));
+                m_input_encoded = block.encoded;
+                m_last_acquired_tick = block.dsptick;
+                m_has_acquired = true;
+                acquired = true;
             }
-            
-            if(m_encoder.getAzimuth() != polar_coords.azimuth)
+            else if(!republished)
             {
-                m_encoder.setAzimuth(polar_coords.azimuth);
+                // stale block, rendering it would misalign the source.
+                ++statistics.dropped_blocks;
             }
+        }
+        
+        if(acquired)
+        {
+            m_input_state = InputState::Playing;
             
-            if(m_encoder.getElevation() != polar_coords.elevation)
+            auto const& block = m_input_blocks.getReadBuffer();
+            m_input_level = block.level;
+            m_input_silent = block.silent;
+        }
+        else if(m_input_state == InputState::Playing)
+        {
+            // fade out the previous block rather than stopping abruptly.
+            fadeInput(false);
+            
+            m_input_state = InputState::Concealed;
+            m_input_level *= 0.5f;
+            ++statistics.concealed_blocks;
+        }
+        else if(m_input_state == InputState::Concealed)
+        {
+            m_mono_input_buffer.setZero();
+            m_encoded_available = false;
+            m_input_state = InputState::Idle;
+            m_input_level = 0.f;
+            m_input_silent = true;
+        }
+        
+        // a block published before the spatializer took the encoding state over
+        // can not be encoded here anymore, it is dropped.
+        if(!m_renderer_encoding && !m_input_encoded && m_input_state != InputState::Idle)
+        {
+            if(acquired)
             {
-                m_encoder.setElevation(polar_coords.elevation);
+                ++statistics.dropped_blocks;
             }
             
-            auto* harmonics = m_temp_harmonics.data();
-            m_encoder.process(input++, harmonics);
+            m_mono_input_buffer.setZero();
+            m_encoded_available = false;
+            m_input_state = InputState::Idle;
+            m_input_level = 0.f;
+            m_input_silent = true;
+        }
+    }
+    
+    void Source::fadeInput(bool fade_in)
+    {
+        const auto size = m_mono_input_buffer.size();
+        const auto ramp = fade_in
+        ? vector_t::LinSpaced(size, 1.f / size, 1.f)
+        : vector_t::LinSpaced(size, 1.f - 1.f / size, 0.f);
+        
+        if(m_input_encoded)
+        {
+            // applied by addEncodedInput.
+            if(!m_encoded_faded)
+            {
+                m_encoded_gains.setOnes();
+                m_encoded_faded = true;
+            }
             
-            if(process_optim)
+            m_encoded_gains.array() *= ramp.array();
+        }
+        else
+        {
+            m_mono_input_buffer.array() *= ramp.array();
+        }
+    }
+    
+    void Source::skipBlock()
+    {
+        updateDistance(m_smoothed_position.process(m_mono_input_buffer.size()));
+        m_coeffs_initialized = false;
+        
+        if(m_near_field)
+        {
+            // the filters restart from silence with the next encoded block.
+            m_near_field->states().setZero();
+        }
+    }
+    
+    bool Source::setCulled(bool culled)
+    {
+        if(culled && m_culled)
+        {
+            // silent until the source fades back in.
+            if(!m_input_encoded)
             {
-                m_optim.process(harmonics, harmonics);
+                skipBlock();
             }
             
-            harmonic_vector += m_temp_harmonics;
+            return false;
+        }
+        
+        if(culled != m_culled)
+        {
+            fadeInput(!culled);
+            m_culled = culled;
         }
+        
+        return true;
     }
     
-    // ==================================================================================== //
-    // API
-    // ==================================================================================== //
+    void Source::addEncodedInput(harmonics_matrix_t& harmonics_matrix) const
+    {
+        if(!m_encoded_available)
+            return;
+        
+        auto const& block = m_input_blocks.getReadBuffer();
+        auto const harmonics = block.harmonics.topRows(block.num_harmonics);
+        auto target = harmonics_matrix.topRows(block.num_harmonics);
+        assert(harmonics.cols() == harmonics_matrix.cols());
+        
+        if(m_encoded_faded)
+        {
+            target.noalias() += harmonics * m_encoded_gains.asDiagonal();
+        }
+        else
+        {
+            target += harmonics;
+        }
+    }
     
-    HoaLibraryApi::HoaLibraryApi(size_t vectorsize)
-    : m_vectorsize(vectorsize)
-    , m_source_id_counter(0)
-    , m_master_gain(1.f)
-    , m_decoder(k_order)
+    void Source::setPosition(float_t x, float_t y, float_t z)
     {
-        m_decoder.prepare(m_vectorsize);        
-        m_soundfield_matrix.resize(k_num_harmonics, m_vectorsize);
+        m_smoothed_position.setValues({x, y, z});
     }
     
-    HoaLibraryApi::~HoaLibraryApi()
-    {}
+    void Source::setMinDistance(float_t distance)
+    {
+        m_min_distance.store(std::max(distance, k_min_near_field_distance), std::memory_order_relaxed);
+    }
     
-    bool HoaLibraryApi::fillInterleavedOutputBuffer(size_t frames, float_t* outputs)
+    float_t Source::getMinDistance() const
     {
-        m_soundfield_matrix.setZero();
+        return m_min_distance.load(std::memory_order_relaxed);
+    }
+    
+    float_t Source::getEncoderDistance() const
+    {
+        return hasNearField() ? getMinDistance() : 1.f;
+    }
+    
+    void Source::setEncodingMode(EncodingMode mode, size_t subblock_size)
+    {
+        m_encoding_mode = mode;
+        m_subblock_size = subblock_size > 0 ? subblock_size : m_mono_input_buffer.size();
+        
+        // read once per block, the spatializer may hand the state back at any time.
+        m_renderer_encoding = !m_spatializer_encoding.load(std::memory_order_acquire);
+    }
+    
+    void Source::handOverEncodingState()
+    {
+        if(m_renderer_encoding && m_encoded_inputs)
+        {
+            m_renderer_encoding = false;
+            m_spatializer_encoding.store(true, std::memory_order_release);
+        }
+    }
+    
+    void Source::updateEncoder(CartesianCoordinate const& position)
+    {
+        auto polar_coords = cartopol(position);
         
-        for(auto& source : m_sources)
+        // We let unity provide gain attenuation when the source is farther than its
+        // minimum distance, the encoder widens the source inside it.
+        const float_t radius = std::min<float_t>(polar_coords.radius / getEncoderDistance(), 1.0f);
+        if(m_encoder.getRadius() != radius)
         {
-            source.second->process(m_soundfield_matrix);
+            m_encoder.setRadius(radius);
         }
         
-        auto outs = stereo_matrix_t::Map(outputs, 2, frames);
-        m_decoder.processBlock(m_soundfield_matrix, outs);
-        outs *= m_master_gain;
+        if(m_encoder.getAzimuth() != polar_coords.azimuth)
+        {
+            m_encoder.setAzimuth(polar_coords.azimuth);
+        }
         
-        return true;
+        if(m_encoder.getElevation() != polar_coords.elevation)
+        {
+            m_encoder.setElevation(polar_coords.elevation);
+        }
     }
     
-    void HoaLibraryApi::setMasterGain(float_t gain)
+    void Source::computeTargetCoefficients(CartesianCoordinate const& position)
     {
-        m_master_gain = gain;
+        updateEncoder(position);
+        
+        // The encoder is linear, encoding a unit sample gives the gain of each harmonic.
+        const float_t unit = 1.f;
+        m_encoder.process(&unit, m_temp_harmonics.data());
+        setTargetCoefficients(m_temp_harmonics.data());
     }
     
-    auto HoaLibraryApi::createSource() -> source_id_t
+    bool Source::prepareSubBlock(size_t frames, CartesianCoordinate& position)
     {
-        const auto source_id = m_source_id_counter.fetch_add(1);
-        assert(m_sources.find(source_id) == m_sources.end());
-        const auto order = k_order; // (silent symbol not found issue on osx)
-        m_sources[source_id] = std::make_unique<Source>(order, m_vectorsize);
-        return source_id;
+        position = m_smoothed_position.process(frames);
+        updateDistance(position);
+        
+        const float_t dx = position.x - m_coeffs_position.x;
+        const float_t dy = position.y - m_coeffs_position.y;
+        const float_t dz = position.z - m_coeffs_position.z;
+        const float_t radius2 = std::max(1.f, position.x * position.x + position.y * position.y + position.z * position.z);
+        
+        if(m_coeffs_dirty || !m_coeffs_initialized
+           || dx * dx + dy * dy + dz * dz > k_position_tolerance * k_position_tolerance * radius2)
+        {
+            m_coeffs_position = position;
+            return true;
+        }
+        
+        return false;
     }
     
-    void HoaLibraryApi::destroySource(source_id_t source_id)
+    void Source::setTargetCoefficients(float_t const* coeffs)
     {
-        assert(m_sources.find(source_id) != m_sources.end());
-        m_sources.erase(source_id);
+        auto* target = m_target_coeffs.data();
+        std::copy(coeffs, coeffs + m_target_coeffs.size(), target);
+        
+        if(isOptimApplied())
+        {
+            m_optim.process(target, target);
+        }
+        else if(m_order < m_max_order)
+        {
+            // without optimization, the reduced order is weighted with the max-rE weights of its order.
+            m_target_coeffs.array() *= m_order_weights.array();
+        }
+        
+        m_target_harmonics = m_order_harmonics;
+        m_coeffs_dirty = false;
+        m_target_changed = true;
     }
     
-    void HoaLibraryApi::setInterleavedSourceBuffer(source_id_t source_id,
-                                                   float_t const* audio_buffer_ptr, size_t num_frames)
+    void Source::process(harmonics_matrix_t& harmonics_matrix)
     {
-        auto source = m_sources.find(source_id);
-        if(source != m_sources.end())
+        assert(harmonics_matrix.cols() == m_mono_input_buffer.size());
+        
+        if(m_encoding_mode != EncodingMode::PerSample)
+        {
+            processBlockRate(harmonics_matrix);
+        }
+        else
         {
-            source->second->setInterleavedBuffer(audio_buffer_ptr, num_frames);
+            processPerSample(harmonics_matrix);
         }
     }
     
-    void HoaLibraryApi::setSourcePosition(source_id_t source_id,
-                                          float_t x, float_t y, float_t z)
+    void Source::processPerSample(harmonics_matrix_t& harmonics_matrix)
+    {
+        if(m_near_field)
+        {
+            processNearFieldPerSample(harmonics_matrix);
+            return;
+        }
+        
+        const bool process_optim = isOptimApplied();
+        
+        auto* input = m_mono_input_buffer.data();
+        for(auto harmonic_vector : harmonics_matrix.colwise())
+        {
+            updateEncoder(m_smoothed_position.process());
+            
+            auto* harmonics = m_temp_harmonics.data();
+            m_encoder.process(input++, harmonics);
+            
+            if(process_optim)
+            {
+                m_optim.process(harmonics, harmonics);
+            }
+            
+            harmonic_vector += m_temp_harmonics;
+        }
+        
+        updateDistance(m_smoothed_position.getValues());
+        
+        // block rate coefficients are out of date now.
+        m_coeffs_initialized = false;
+    }
+    
+    void Source::processBlockRate(harmonics_matrix_t& harmonics_matrix)
+    {
+        encodeBlockRate(m_mono_input_buffer, m_subblock_size, harmonics_matrix);
+    }
+    
+    void Source::encodeBlockRate(vector_t const& input, size_t subblock_size,
+                                 harmonics_matrix_t& harmonics_matrix)
     {
-        auto source = m_sources.find(source_id);
-        if(source != m_sources.end())
+        const auto frames = static_cast<size_t>(harmonics_matrix.cols());
+        
+        for(size_t start = 0; start < frames; start += subblock_size)
         {
-            source->second->setPosition(x, y, z);
+            const size_t size = std::min(subblock_size, frames - start);
+            
+            CartesianCoordinate position;
+            if(prepareSubBlock(size, position))
+            {
+                computeTargetCoefficients(position);
+            }
+            
+            encodeSubBlock(input, start, size, harmonics_matrix);
         }
     }
     
-    void HoaLibraryApi::setSourcePan(source_id_t source_id, float_t pan)
+    void Source::initializeCoefficients()
     {
-        auto source = m_sources.find(source_id);
-        if(source != m_sources.end())
+        if(!m_coeffs_initialized)
         {
-            source->second->setPan(pan);
+            // (re)start without interpolation.
+            m_coeffs = m_target_coeffs;
+            m_coeffs_harmonics = m_target_harmonics;
+            m_coeffs_initialized = true;
+            m_target_changed = false;
         }
     }
     
-    void HoaLibraryApi::setSourceGain(source_id_t source_id, float_t volume)
+    bool Source::advanceCoefficients(float_t* coeffs, float_t* deltas)
     {
-        auto source = m_sources.find(source_id);
-        if(source != m_sources.end())
+        initializeCoefficients();
+        
+        const auto size = m_coeffs.size();
+        vector_t::Map(coeffs, size) = m_coeffs;
+        
+        if(!m_target_changed)
         {
-            source->second->setGain(volume);
+            return false;
         }
+        
+        vector_t::Map(deltas, size) = m_target_coeffs - m_coeffs;
+        m_coeffs = m_target_coeffs;
+        m_coeffs_harmonics = m_target_harmonics;
+        m_target_changed = false;
+        return true;
     }
     
-    void HoaLibraryApi::setSourceOptim(source_id_t source_id, int optim)
+    void Source::processSubBlock(size_t start, size_t frames, harmonics_matrix_t& harmonics_matrix)
+    {
+        encodeSubBlock(m_mono_input_buffer, start, frames, harmonics_matrix);
+    }
+    
+    void Source::encodeSubBlock(vector_t const& input_buffer, size_t start, size_t frames,
+                                harmonics_matrix_t& harmonics_matrix)
+    {
+        if(m_near_field)
+        {
+            // the input was copied with the filtered signals.
+            encodeNearFieldSubBlock(start, frames, harmonics_matrix);
+            return;
+        }
+        
+        auto input = input_buffer.segment(start, frames);
+        
+        initializeCoefficients();
+        
+        if(!m_target_changed)
+        {
+            // static source: constant coefficients.
+            auto subblock = harmonics_matrix.block(0, start, m_coeffs_harmonics, frames);
+            subblock.noalias() += m_coeffs.head(m_coeffs_harmonics) * input.transpose();
+            return;
+        }
+        
+        // the harmonics of the previous order fade out, the ones of the new order fade in.
+        const size_t harmonics = std::max(m_coeffs_harmonics, m_target_harmonics);
+        auto subblock = harmonics_matrix.block(0, start, harmonics, frames);
+        
+        // Linear interpolation of the coefficients from c0 to c1 over the sub-block:
+        // c(n) = c0 + (c1 - c0) * (n + 1) / frames
+        auto ramped_input = m_ramped_input.head(frames);
+        ramped_input.setLinSpaced(frames, 1.f / frames, 1.f);
+        ramped_input.array() *= input.array();
+        
+        auto deltas = m_temp_harmonics.head(harmonics);
+        deltas = m_target_coeffs.head(harmonics) - m_coeffs.head(harmonics);
+        subblock.noalias() += m_coeffs.head(harmonics) * input.transpose();
+        subblock.noalias() += deltas * ramped_input.transpose();
+        
+        m_coeffs = m_target_coeffs;
+        m_coeffs_harmonics = m_target_harmonics;
+        m_target_changed = false;
+    }
+    
+    size_t Source::getNearFieldOrder(EncodingMode mode) const
+    {
+        // the per sample encoding always encodes all the harmonics.
+        if(mode == EncodingMode::PerSample)
+            return m_max_order;
+        
+        return static_cast<size_t>(std::lround(std::sqrt(getEncodingHarmonics()))) - 1;
+    }
+    
+    void Source::updateNearFieldNumerators()
+    {
+        // the distance at the start of the block.
+        const float_t distance = std::max(cartopol(m_smoothed_position.getValues()).radius, k_min_near_field_distance);
+        if(distance != m_near_field_distance)
+        {
+            m_near_field_filters->computeNumerators(distance, m_near_field->numerators().data(), 1);
+            m_near_field_distance = distance;
+        }
+    }
+    
+    size_t Source::gatherNearField(NearFieldBatch& batch, size_t lane, size_t frames)
+    {
+        updateNearFieldNumerators();
+        m_near_field_order = getNearFieldOrder(m_encoding_mode);
+        
+        batch.inputs().row(lane).head(frames) = m_mono_input_buffer.head(frames).transpose();
+        batch.numerators().row(lane) = m_near_field->numerators().row(0);
+        batch.states().row(lane) = m_near_field->states().row(0);
+        return m_near_field_order;
+    }
+    
+    void Source::scatterNearField(NearFieldBatch const& batch, size_t lane, size_t frames, bool outputs)
+    {
+        m_near_field->states().row(0) = batch.states().row(lane);
+        
+        // the orders not filtered in this block restart from silence.
+        m_near_field_filters->clearStates(*m_near_field, 0, m_near_field_order);
+        
+        if(outputs)
+        {
+            const size_t lanes = batch.getLanes();
+            m_near_field_signals.row(0).head(frames) = m_mono_input_buffer.head(frames).transpose();
+            for(size_t order = 1; order <= m_near_field_order; ++order)
+            {
+                m_near_field_signals.row(order).head(frames) = batch.outputs().row((order - 1) * lanes + lane).head(frames);
+            }
+        }
+    }
+    
+    void Source::setNearFieldFilters(NearFieldFilters const* near_field)
+    {
+        m_next_near_field_filters.store(near_field, std::memory_order_release);
+        if(m_renderer_encoding)
+        {
+            applyNearFieldFilters(near_field);
+        }
+    }
+    
+    bool Source::usesNearFieldFilters(NearFieldFilters const* near_field) const
+    {
+        return m_used_near_field_filters.load(std::memory_order_acquire) == near_field;
+    }
+    
+    void Source::applyNearFieldFilters(NearFieldFilters const* near_field)
+    {
+        if(near_field != m_near_field_filters && near_field != nullptr)
+        {
+            // the numerators are computed again for the new radius.
+            m_near_field_filters = near_field;
+            m_near_field_distance = -1.f;
+            m_used_near_field_filters.store(near_field, std::memory_order_release);
+        }
+    }
+    
+    void Source::filterNearField(vector_t const& input, size_t frames)
+    {
+        // only called to encode in the spatializer.
+        updateNearFieldNumerators();
+        m_near_field_order = getNearFieldOrder(EncodingMode::Spatializer);
+        
+        auto& batch = *m_near_field;
+        batch.inputs().row(0).head(frames) = input.head(frames).transpose();
+        for(size_t order = 1; order <= batch.order_lanes.size(); ++order)
+        {
+            batch.order_lanes[order - 1] = (order <= m_near_field_order) ? 1 : 0;
+        }
+        
+        m_near_field_filters->process(batch, frames);
+        m_near_field_filters->clearStates(batch, 0, m_near_field_order);
+        
+        m_near_field_signals.row(0).head(frames) = input.head(frames).transpose();
+        m_near_field_signals.block(1, 0, m_near_field_order, frames) = batch.outputs().topLeftCorner(m_near_field_order, frames);
+    }
+    
+    void Source::encodeNearFieldSubBlock(size_t start, size_t frames, harmonics_matrix_t& harmonics_matrix)
+    {
+        initializeCoefficients();
+        
+        // the harmonics of the previous order fade out, the ones of the new order fade in.
+        const bool interpolate = m_target_changed;
+        const size_t harmonics = interpolate ? std::max(m_coeffs_harmonics, m_target_harmonics) : m_coeffs_harmonics;
+        const size_t orders = std::min<size_t>(static_cast<size_t>(std::lround(std::sqrt(harmonics))),
+                                               m_near_field_order + 1);
+        
+        // the harmonics of an order only see its signal.
+        for(size_t order = 0; order < orders; ++order)
+        {
+            const size_t first = order * order;
+            const size_t size = 2 * order + 1;
+            m_near_field_coeffs.col(order).segment(first, size) = m_coeffs.segment(first, size);
+            
+            if(interpolate)
+            {
+                m_near_field_deltas.col(order).segment(first, size) = (m_target_coeffs.segment(first, size)
+                                                                       - m_coeffs.segment(first, size));
+            }
+        }
+        
+        auto signals = m_near_field_signals.block(0, start, orders, frames);
+        auto subblock = harmonics_matrix.block(0, start, harmonics, frames);
+        subblock.noalias() += m_near_field_coeffs.topLeftCorner(harmonics, orders) * signals;
+        
+        if(!interpolate)
+            return;
+        
+        // c(n) = c0 + (c1 - c0) * (n + 1) / frames
+        auto ramp = m_ramped_input.head(frames);
+        ramp.setLinSpaced(frames, 1.f / frames, 1.f);
+        
+        auto ramped_signals = m_near_field_ramped.topLeftCorner(orders, frames);
+        ramped_signals = signals.array().rowwise() * ramp.transpose().array();
+        subblock.noalias() += m_near_field_deltas.topLeftCorner(harmonics, orders) * ramped_signals;
+        
+        m_coeffs = m_target_coeffs;
+        m_coeffs_harmonics = m_target_harmonics;
+        m_target_changed = false;
+    }
+    
+    void Source::processNearFieldPerSample(harmonics_matrix_t& harmonics_matrix)
+    {
+        const bool process_optim = isOptimApplied();
+        
+        const float_t unit = 1.f;
+        const auto frames = static_cast<size_t>(harmonics_matrix.cols());
+        
+        for(size_t frame = 0; frame < frames; ++frame)
+        {
+            updateEncoder(m_smoothed_position.process());
+            
+            auto* harmonics = m_temp_harmonics.data();
+            m_encoder.process(&unit, harmonics);
+            
+            if(process_optim)
+            {
+                m_optim.process(harmonics, harmonics);
+            }
+            
+            // the coefficients of each order times its filtered input.
+            for(size_t order = 0; order <= m_near_field_order; ++order)
+            {
+                m_temp_harmonics.segment(order * order, 2 * order + 1) *= m_near_field_signals(order, frame);
+            }
+            
+            harmonics_matrix.col(frame) += m_temp_harmonics;
+        }
+        
+        updateDistance(m_smoothed_position.getValues());
+        
+        // block rate coefficients are out of date now.
+        m_coeffs_initialized = false;
+    }
+    
+    // ==================================================================================== //
+    // Bed
+    // ==================================================================================== //
+    
+    Bed::Bed(AmbixConversion const& conversion, size_t vectorsize)
+    : m_conversion(conversion)
+    , m_input_blocks(InputBlock {harmonics_matrix_t::Zero(conversion.channels.size(), vectorsize), 0, 0})
+    , m_fade_out(vector_t::LinSpaced(vectorsize, 1.f - 1.f / vectorsize, 0.f))
+    {}
+    
+    void Bed::setGain(float_t gain)
+    {
+        m_gain = gain;
+    }
+    
+    bool Bed::setInterleavedBuffer(float_t const* inputs, size_t channels, size_t frames,
+                                   dsptick_t dsptick)
+    {
+        auto& block = m_input_blocks.getWriteBuffer();
+        assert(frames == static_cast<size_t>(block.harmonics.cols()) && "");
+        
+        // the harmonics of the complete degrees of the stream.
+        size_t degrees = 0;
+        while((degrees + 1) * (degrees + 1) <= channels)
+        {
+            ++degrees;
+        }
+        
+        const size_t num_harmonics = std::min(degrees * degrees, m_conversion.channels.size());
+        auto const* channel = m_conversion.channels.data();
+        auto const* scale = m_conversion.scales.data();
+        const float_t gain = m_gain;
+        
+        // the conversion is a permutation and a scale of the channels,
+        // done here while the block is copied for the audio thread.
+        for(size_t frame = 0; frame < frames; ++frame)
+        {
+            float_t const* input = inputs + frame * channels;
+            float_t* output = block.harmonics.col(frame).data();
+            for(size_t h = 0; h < num_harmonics; ++h)
+            {
+                output[h] = scale[h] * gain * input[channel[h]];
+            }
+        }
+        
+        block.num_harmonics = num_harmonics;
+        block.dsptick = dsptick;
+        m_input_blocks.publish();
+        
+        const bool duplicated = (m_has_published && m_last_published_tick == dsptick);
+        m_last_published_tick = dsptick;
+        m_has_published = true;
+        return !duplicated;
+    }
+    
+    void Bed::acquireInput(dsptick_t dsptick, InputStatistics& statistics)
+    {
+        bool acquired = false;
+        if(m_input_blocks.update())
+        {
+            auto const& block = m_input_blocks.getReadBuffer();
+            const auto frames = static_cast<dsptick_t>(block.harmonics.cols());
+            
+            // published again for the tick already acquired: it is not a gap, the last
+            // block is kept (the duplicate was counted when it was published).
+            const bool republished = (m_has_acquired && block.dsptick == m_last_acquired_tick);
+            
+            if(block.dsptick == dsptick || block.dsptick + frames == dsptick)
+            {
+                if(!republished && m_has_acquired && block.dsptick > m_last_acquired_tick + frames)
+                {
+                    statistics.dropped_blocks += (block.dsptick - m_last_acquired_tick) / frames - 1;
+                }
+                
+                m_last_acquired_tick = block.dsptick;
+                m_has_acquired = true;
+                acquired = true;
+            }
+            else if(!republished)
+            {
+                // stale block, rendering it would misalign the bed.
+                ++statistics.dropped_blocks;
+            }
+        }
+        
+        if(acquired)
+        {
+            m_input_state = InputState::Playing;
+        }
+        else if(m_input_state == InputState::Playing)
+        {
+            // the previous block is faded out rather than stopping abruptly.
+            m_input_state = InputState::Concealed;
+            ++statistics.concealed_blocks;
+        }
+        else
+        {
+            m_input_state = InputState::Idle;
+        }
+    }
+    
+    void Bed::addInput(harmonics_matrix_t& harmonics_matrix) const
+    {
+        if(m_input_state == InputState::Idle)
+            return;
+        
+        auto const& block = m_input_blocks.getReadBuffer();
+        const auto cols = std::min(block.harmonics.cols(), harmonics_matrix.cols());
+        auto const harmonics = block.harmonics.topLeftCorner(block.num_harmonics, cols);
+        auto target = harmonics_matrix.topLeftCorner(block.num_harmonics, cols);
+        
+        if(m_input_state == InputState::Concealed)
+        {
+            target.noalias() += harmonics * m_fade_out.head(cols).asDiagonal();
+        }
+        else
+        {
+            target += harmonics;
+        }
+    }
+    
+    // ==================================================================================== //
+    // SourcesEncoder
+    // ==================================================================================== //
+    
+    SourcesEncoder::SourcesEncoder(size_t max_sources, size_t vectorsize, size_t order,
+                                   BatchedEncoder const& batched_encoder,
+                                   NearFieldFilters const* near_field)
+    : m_order(order)
+    , m_num_harmonics(get_num_harmonics_for_order(order))
+    , m_batched_encoder(batched_encoder)
+    {
+        // buffers for the maximum number of sources, not to allocate while processing.
+        m_encoding_sources.resize(max_sources);
+        m_sorted_sources.resize(max_sources);
+        m_order_counts.resize(order + 2);
+        m_source_harmonics.resize(max_sources);
+        m_moving_harmonics.resize(max_sources);
+        m_batch_sources.resize(max_sources);
+        m_batch_x.resize(max_sources);
+        m_batch_y.resize(max_sources);
+        m_batch_z.resize(max_sources);
+        m_batch_coeffs.resize(m_num_harmonics, max_sources);
+        m_encoding_coeffs.resize(m_num_harmonics, max_sources);
+        m_encoding_deltas.resize(m_num_harmonics, max_sources);
+        m_signal_matrix.resize(max_sources, vectorsize);
+        m_ramped_signal_matrix.resize(max_sources, vectorsize);
+        m_ramp.resize(vectorsize);
+        
+        if(near_field != nullptr && near_field->getOrder() == order)
+        {
+            m_near_field_filters = near_field;
+            m_near_field = std::make_unique<NearFieldBatch>(order, near_field->getNumberOfSections(),
+                                                            max_sources, vectorsize);
+            m_near_field_products.resize(2 * order + 1, vectorsize);
+        }
+    }
+    
+    void SourcesEncoder::process(Source* const* sources, size_t count,
+                                 EncodingMode mode, size_t subblock_size,
+                                 harmonics_matrix_t& soundfield)
+    {
+        assert(count <= m_batch_sources.size());
+        
+        // the sources encoded by the spatializer are only summed.
+        size_t num_encoding = 0;
+        for(size_t i = 0; i < count; ++i)
+        {
+            if(sources[i]->hasEncodedInput())
+            {
+                sources[i]->addEncodedInput(soundfield);
+            }
+            else
+            {
+                sources[i]->updateEncodingOrder();
+                m_encoding_sources[num_encoding++] = sources[i];
+            }
+        }
+        
+        sources = m_encoding_sources.data();
+        count = num_encoding;
+        
+        // the near-field filters run on the sources sorted by order, the orders above the
+        // order of a source are not filtered.
+        if(mode == EncodingMode::Matrix || m_near_field)
+        {
+            sortEncodingSources(count);
+        }
+        
+        if(m_near_field && count > 0)
+        {
+            // the matrix encoding reads the filtered signals from the batch.
+            filterNearField(sources, count, static_cast<size_t>(soundfield.cols()), mode != EncodingMode::Matrix);
+        }
+        
+        if(mode == EncodingMode::Matrix)
+        {
+            processMatrix(sources, count, subblock_size, soundfield);
+        }
+        else if(mode == EncodingMode::BlockRate || mode == EncodingMode::Spatializer)
+        {
+            // in EncodingMode::Spatializer, only the blocks published before the mode changed.
+            processBlockRate(sources, count, subblock_size, soundfield);
+        }
+        else
+        {
+            for(size_t i = 0; i < count; ++i)
+            {
+                sources[i]->process(soundfield);
+            }
+        }
+    }
+    
+    void SourcesEncoder::updateTargetCoefficients(Source* const* sources, size_t count, size_t frames)
+    {
+        const bool batched = m_batched_encoder.isValid();
+        
+        // gather the moving sources
+        size_t num_moving = 0;
+        for(size_t i = 0; i < count; ++i)
+        {
+            auto* source = sources[i];
+            
+            CartesianCoordinate position;
+            if(source->prepareSubBlock(frames, position))
+            {
+                if(!batched)
+                {
+                    source->computeTargetCoefficients(position);
+                    continue;
+                }
+                
+                // the encoder radius is relative to the minimum distance of the source.
+                const float_t scale = 1.f / source->getEncoderDistance();
+                m_batch_sources[num_moving] = source;
+                m_batch_x[num_moving] = position.x * scale;
+                m_batch_y[num_moving] = position.y * scale;
+                m_batch_z[num_moving] = position.z * scale;
+                ++num_moving;
+            }
+        }
+        
+        if(num_moving > 0)
+        {
+            m_batched_encoder.processCartesian(num_moving,
+                                               m_batch_x.data(), m_batch_y.data(), m_batch_z.data(),
+                                               m_batch_coeffs.data(), m_num_harmonics);
+            
+            for(size_t i = 0; i < num_moving; ++i)
+            {
+                m_batch_sources[i]->setTargetCoefficients(m_batch_coeffs.col(i).data());
+            }
+        }
+    }
+    
+    void SourcesEncoder::processBlockRate(Source* const* sources, size_t count,
+                                          size_t subblock_size, harmonics_matrix_t& soundfield)
+    {
+        const auto frames = static_cast<size_t>(soundfield.cols());
+        subblock_size = subblock_size > 0 ? subblock_size : frames;
+        
+        for(size_t start = 0; start < frames; start += subblock_size)
+        {
+            const size_t size = std::min(subblock_size, frames - start);
+            
+            updateTargetCoefficients(sources, count, size);
+            
+            for(size_t i = 0; i < count; ++i)
+            {
+                sources[i]->processSubBlock(start, size, soundfield);
+            }
+        }
+    }
+    
+    void SourcesEncoder::sortEncodingSources(size_t count)
+    {
+        // orders from the highest to the lowest, the order of the sources is kept
+        // within an order so that the result does not depend on a sort implementation.
+        std::fill(m_order_counts.begin(), m_order_counts.end(), 0);
+        for(size_t i = 0; i < count; ++i)
+        {
+            const size_t harmonics = m_encoding_sources[i]->getEncodingHarmonics();
+            const auto order = static_cast<size_t>(std::lround(std::sqrt(harmonics))) - 1;
+            ++m_order_counts[m_order - order + 1];
+        }
+        
+        for(size_t i = 1; i < m_order_counts.size(); ++i)
+        {
+            m_order_counts[i] += m_order_counts[i - 1];
+        }
+        
+        for(size_t i = 0; i < count; ++i)
+        {
+            auto* source = m_encoding_sources[i];
+            const auto order = static_cast<size_t>(std::lround(std::sqrt(source->getEncodingHarmonics()))) - 1;
+            m_sorted_sources[m_order_counts[m_order - order]++] = source;
+        }
+        
+        std::copy(m_sorted_sources.begin(), m_sorted_sources.begin() + count, m_encoding_sources.begin());
+    }
+    
+    template<class Signals, class SubBlock>
+    void SourcesEncoder::addProduct(harmonics_matrix_t const& coeffs, Signals const& signals,
+                                    size_t const* harmonics, size_t count, SubBlock& subblock)
+    {
+        // one product per group of consecutive sources touching the same harmonics.
+        for(size_t begin = 0; begin < count;)
+        {
+            const size_t rows = harmonics[begin];
+            size_t end = begin + 1;
+            while(end < count && harmonics[end] == rows)
+            {
+                ++end;
+            }
+            
+            subblock.topRows(rows).noalias() += (coeffs.block(0, begin, rows, end - begin)
+                                                 * signals.middleRows(begin, end - begin));
+            begin = end;
+        }
+    }
+    
+    void SourcesEncoder::processMatrix(Source* const* sources, size_t num_sources,
+                                       size_t subblock_size, harmonics_matrix_t& soundfield)
+    {
+        if(num_sources == 0)
+            return;
+        
+        const auto frames = static_cast<size_t>(soundfield.cols());
+        
+        // (sources x frames) mono signals
+        for(size_t index = 0; index < num_sources; ++index)
+        {
+            m_signal_matrix.row(index).head(frames) = sources[index]->getInputBuffer().head(frames).transpose();
+            m_source_harmonics[index] = sources[index]->getEncodingHarmonics();
+        }
+        
+        subblock_size = subblock_size > 0 ? subblock_size : frames;
+        
+        for(size_t start = 0; start < frames; start += subblock_size)
+        {
+            const size_t size = std::min(subblock_size, frames - start);
+            
+            updateTargetCoefficients(sources, num_sources, size);
+            
+            // (harmonics x sources) coefficients at the start of the sub-block,
+            // the interpolated sources are packed in the first columns of the deltas.
+            size_t moving = 0;
+            for(size_t index = 0; index < num_sources; ++index)
+            {
+                if(m_near_field)
+                {
+                    // the filtered signals are not moved, the deltas are not packed either.
+                    if(sources[index]->advanceCoefficients(m_encoding_coeffs.col(index).data(),
+                                                           m_encoding_deltas.col(index).data()))
+                    {
+                        ++moving;
+                    }
+                    else
+                    {
+                        m_encoding_deltas.col(index).setZero();
+                    }
+                }
+                else if(sources[index]->advanceCoefficients(m_encoding_coeffs.col(index).data(),
+                                                            m_encoding_deltas.col(moving).data()))
+                {
+                    m_ramped_signal_matrix.row(moving).head(size) = m_signal_matrix.row(index).segment(start, size);
+                    m_moving_harmonics[moving] = m_source_harmonics[index];
+                    ++moving;
+                }
+            }
+            
+            auto subblock = soundfield.middleCols(start, size);
+            
+            if(m_near_field)
+            {
+                addNearFieldProducts(num_sources, moving > 0, start, size, subblock);
+                continue;
+            }
+            
+            addProduct(m_encoding_coeffs, m_signal_matrix.block(0, start, num_sources, size),
+                       m_source_harmonics.data(), num_sources, subblock);
+            
+            if(moving > 0)
+            {
+                // c(n) = c0 + (c1 - c0) * (n + 1) / size
+                auto ramp = m_ramp.head(size);
+                ramp.setLinSpaced(size, 1.f / size, 1.f);
+                
+                auto ramped_signals = m_ramped_signal_matrix.topLeftCorner(moving, size);
+                ramped_signals.array().rowwise() *= ramp.transpose().array();
+                
+                addProduct(m_encoding_deltas, ramped_signals, m_moving_harmonics.data(), moving, subblock);
+            }
+        }
+    }
+    
+    template<class SubBlock>
+    void SourcesEncoder::addNearFieldProducts(size_t num_sources, bool moving, size_t start, size_t size,
+                                              SubBlock& subblock)
+    {
+        const auto filtered = m_near_field->outputs();
+        
+        // c(n) = c0 + (c1 - c0) * (n + 1) / size, the ramp is the same for all the sources:
+        // it is applied to the product of the deltas by the signals.
+        auto ramp = m_ramp.head(size);
+        ramp.setLinSpaced(size, 1.f / size, 1.f);
+        
+        // the sources are sorted by decreasing order, the ones of an order and above are the first ones.
+        size_t count = num_sources;
+        
+        for(size_t degree = 0; degree <= m_order; ++degree)
+        {
+            const size_t first = degree * degree;
+            while(count > 0 && m_source_harmonics[count - 1] <= first)
+            {
+                --count;
+            }
+            
+            if(count == 0)
+                break;
+            
+            const size_t rows = 2 * degree + 1;
+            auto degree_subblock = subblock.middleRows(first, rows);
+            
+            auto add_product = [&](auto const& signals) {
+                degree_subblock.noalias() += m_encoding_coeffs.block(first, 0, rows, count) * signals;
+                
+                if(moving)
+                {
+                    auto products = m_near_field_products.topLeftCorner(rows, size);
+                    products.noalias() = m_encoding_deltas.block(first, 0, rows, count) * signals;
+                    degree_subblock.array() += products.array().rowwise() * ramp.transpose().array();
+                }
+            };
+            
+            if(degree == 0)
+            {
+                add_product(m_signal_matrix.block(0, start, count, size));
+            }
+            else
+            {
+                add_product(filtered.block((degree - 1) * num_sources, start, count, size));
+            }
+        }
+    }
+    
+    void SourcesEncoder::filterNearField(Source* const* sources, size_t count, size_t frames,
+                                         bool scatter_outputs)
+    {
+        auto& batch = *m_near_field;
+        batch.setLanes(count);
+        std::fill(batch.order_lanes.begin(), batch.order_lanes.end(), 0);
+        
+        for(size_t lane = 0; lane < count; ++lane)
+        {
+            assert(sources[lane]->hasNearField());
+            
+            const size_t order = sources[lane]->gatherNearField(batch, lane, frames);
+            for(size_t m = 1; m <= order; ++m)
+            {
+                ++batch.order_lanes[m - 1];
+            }
+        }
+        
+        m_near_field_filters->process(batch, frames);
+        
+        for(size_t lane = 0; lane < count; ++lane)
+        {
+            sources[lane]->scatterNearField(batch, lane, frames, scatter_outputs);
+        }
+    }
+    
+    void SourcesEncoder::setNearFieldFilters(NearFieldFilters const* near_field)
+    {
+        if(m_near_field && near_field != nullptr)
+        {
+            m_near_field_filters = near_field;
+        }
+    }
+    
+    // ==================================================================================== //
+    // ParallelEncoder
+    // ==================================================================================== //
+    
+    ParallelEncoder::ParallelEncoder(size_t max_sources, size_t vectorsize, size_t order,
+                                     BatchedEncoder const& batched_encoder,
+                                     NearFieldFilters const* near_field)
+    {
+        const size_t max_chunk_size = (max_sources + k_num_encoding_chunks - 1) / k_num_encoding_chunks;
+        
+        m_encoders.reserve(k_num_encoding_chunks);
+        m_partial_soundfields.reserve(k_num_encoding_chunks);
+        
+        for(size_t i = 0; i < k_num_encoding_chunks; ++i)
+        {
+            m_encoders.emplace_back(std::make_unique<SourcesEncoder>(max_chunk_size, vectorsize, order,
+                                                                     batched_encoder, near_field));
+            m_partial_soundfields.emplace_back(harmonics_matrix_t::Zero(get_num_harmonics_for_order(order), vectorsize));
+        }
+    }
+    
+    void ParallelEncoder::process(std::vector<Source*> const& sources,
+                                  EncodingMode mode, size_t subblock_size,
+                                  harmonics_matrix_t& soundfield, WorkerPool* pool)
+    {
+        const size_t num_sources = sources.size();
+        const auto frames = soundfield.cols();
+        
+        auto encode_chunk = [&](size_t chunk) {
+            const size_t begin = chunk * num_sources / k_num_encoding_chunks;
+            const size_t end = (chunk + 1) * num_sources / k_num_encoding_chunks;
+            
+            auto& partial = m_partial_soundfields[chunk];
+            partial.setZero();
+            
+            m_encoders[chunk]->process(sources.data() + begin, end - begin,
+                                       mode, subblock_size, partial);
+        };
+        
+        if(pool)
+        {
+            pool->run(k_num_encoding_chunks, encode_chunk);
+        }
+        else
+        {
+            for(size_t chunk = 0; chunk < k_num_encoding_chunks; ++chunk)
+            {
+                encode_chunk(chunk);
+            }
+        }
+        
+        // fixed order reduction
+        for(size_t chunk = 0; chunk < k_num_encoding_chunks; ++chunk)
+        {
+            if(chunk * num_sources / k_num_encoding_chunks != (chunk + 1) * num_sources / k_num_encoding_chunks)
+            {
+                soundfield += m_partial_soundfields[chunk].leftCols(frames);
+            }
+        }
+    }
+    
+    void ParallelEncoder::setNearFieldFilters(NearFieldFilters const* near_field)
+    {
+        for(auto& encoder : m_encoders)
+        {
+            encoder->setNearFieldFilters(near_field);
+        }
+    }
+    
+    // ==================================================================================== //
+    // API
+    // ==================================================================================== //
+    
+    namespace
+    {
+        //! @brief Returns the distance of the farthest speaker of a layout, 0 if it has none.
+        float_t get_speakers_radius(std::string const& description)
+        {
+            float_t radius = 0.f;
+            SpeakerLayout layout;
+            if(get_speaker_layout(description, layout))
+            {
+                for(auto const& speaker : layout)
+                {
+                    radius = std::max(radius, speaker.distance);
+                }
+            }
+            
+            return radius;
+        }
+        
+        //! @brief Returns the radius of the near-field filters (see NearFieldSettings::radius).
+        float_t get_near_field_radius(float_t radius, float_t speakers_radius)
+        {
+            // the soundfield is reproduced at the distance of the farthest speaker.
+            if(radius <= 0.f)
+            {
+                radius = speakers_radius;
+            }
+            
+            return radius > 0.f ? radius : k_default_near_field_radius;
+        }
+        
+        //! @brief Returns the near-field filters of an instance, nullptr if they are disabled.
+        std::unique_ptr<NearFieldFilters> create_near_field_filters(ApiSettings const& settings,
+                                                                    size_t order, float_t sample_rate)
+        {
+            auto const& near_field = settings.near_field;
+            if(!near_field.enabled || order == 0)
+                return nullptr;
+            
+            const float_t radius = get_near_field_radius(near_field.radius, get_speakers_radius(settings.speakers.layout));
+            return std::make_unique<NearFieldFilters>(order, radius, near_field.max_boost, sample_rate);
+        }
+        
+        //! @brief Responses of the library decoder resampled to a sample rate, (k_num_harmonics x length).
+        struct ResampledResponses
+        {
+            PartitionedConvolver::matrix_t left, right;
+        };
+        
+        // the built-in HRIR set is resampled once per sample rate for all the instances.
+        static std::mutex resampled_responses_mutex;
+        static std::map<float_t, ResampledResponses> resampled_responses;
+    }
+    
+    HoaLibraryApi::HoaLibraryApi(ApiSettings const& settings)
+    : m_vectorsize(settings.vectorsize)
+    , m_sample_rate(settings.sample_rate > 0.f ? settings.sample_rate : k_builtin_hrir_sample_rate)
+    , m_max_sources(settings.max_sources)
+    , m_order(settings.order > 0 ? std::min(settings.order, k_order) : k_order)
+    , m_num_harmonics(get_num_harmonics_for_order(m_order))
+    , m_sources(settings.max_sources)
+    , m_beds(std::max<size_t>(settings.max_beds, 1))
+    , m_master_gain(1.f)
+    , m_near_field_filters(create_near_field_filters(settings, m_order, m_sample_rate))
+    , m_batched_encoder(m_order)
+    , m_encoder(settings.max_sources, settings.vectorsize, m_order, m_batched_encoder, m_near_field_filters.get())
+    , m_world_frame(settings.world_frame)
+    , m_decoder(k_order)
+    {
+        m_decoder.prepare(m_vectorsize);        
+        
+        if(!m_batched_encoder.isValid())
+        {
+            HOA_LOG("HoaLibrary: the batched spherical harmonics kernel does not match the library encoder, the block rate coefficients are computed source by source\n");
+        }
+        
+        m_soundfield_matrix.resize(m_num_harmonics, m_vectorsize);
+        m_fade_outputs.resize(2, m_vectorsize);
+        m_lod_ranks.reserve(m_max_sources);
+        m_active_sources.reserve(m_max_sources);
+        m_voice_ranks.reserve(m_max_sources);
+        m_rendered_sources.reserve(m_max_sources);
+        setOrderLod(settings.order_lod);
+        setEncodingBudget(settings.encoding_budget);
+        setQualitySettings(settings.quality);
+        
+        if(m_num_harmonics < k_num_harmonics)
+        {
+            m_decoder_inputs = harmonics_matrix_t::Zero(k_num_harmonics, m_vectorsize);
+        }
+        
+        m_worker_threads = settings.worker_threads;
+        m_pin_worker_threads = settings.pin_worker_threads;
+        if(m_worker_threads > 0)
+        {
+            m_worker_pool = std::make_unique<WorkerPool>(m_worker_threads, m_pin_worker_threads);
+        }
+        
+        const size_t partition_size = settings.decoder_partition_size;
+        const bool valid_size = (partition_size > 0
+                                 && (partition_size & (partition_size - 1)) == 0
+                                 && m_vectorsize % partition_size == 0);
+        
+        m_decoder_partition_size = valid_size ? partition_size : get_max_partition_size(m_vectorsize);
+        
+        setHeadTrackingSubblockSize(settings.head_tracking_subblock_size);
+        
+        // also used without world frame for the head orientation, it costs nothing unrotated.
+        m_rotation = std::make_unique<SoundfieldRotation>(m_order, m_vectorsize, m_batched_encoder);
+        if(!m_rotation->isValid())
+        {
+            m_rotation = nullptr;
+        }
+        
+        // the beds need the rotation, and their own one by the listener out of world frame.
+        if(m_rotation)
+        {
+            if(!m_world_frame)
+            {
+                m_bed_rotation = std::make_unique<SoundfieldRotation>(m_order, m_vectorsize, m_batched_encoder);
+            }
+            
+            m_ambix_conversion.channels.resize(m_num_harmonics);
+            m_ambix_conversion.scales.resize(m_num_harmonics);
+            for(size_t h = 0; h < m_num_harmonics; ++h)
+            {
+                m_ambix_conversion.channels[h] = m_batched_encoder.getBasisIndex(h);
+                m_ambix_conversion.scales[h] = m_batched_encoder.getBasisScale(h);
+            }
+            
+            m_bed_matrix = harmonics_matrix_t::Zero(m_num_harmonics, m_vectorsize);
+        }
+        
+        // the speaker decoder is mapped to the library harmonics with the AmbiX conversion.
+        SpeakerLayout layout;
+        if(!m_ambix_conversion.channels.empty()
+           && get_speaker_layout(settings.speakers.layout, layout))
+        {
+            m_speaker_decoder = std::make_unique<SpeakerDecoder>(m_order, layout, settings.speakers,
+                                                                 m_ambix_conversion.channels,
+                                                                 m_ambix_conversion.scales,
+                                                                 m_vectorsize, m_sample_rate);
+            if(!m_speaker_decoder->isValid())
+            {
+                m_speaker_decoder = nullptr;
+            }
+        }
+        
+        m_speaker_crossover.store(settings.speakers.crossover, std::memory_order_relaxed);
+        m_applied_crossover = settings.speakers.crossover;
+        m_speakers_radius = get_speakers_radius(settings.speakers.layout);
+        m_near_field_max_boost = settings.near_field.max_boost;
+        
+        // the library decoder can only run at the sample rate of its HRIR set.
+        if(settings.partitioned_decoder || m_sample_rate != k_builtin_hrir_sample_rate)
+        {
+            preparePartitionedDecoder(m_decoder_partition_size);
+        }
+    }
+    
+    void HoaLibraryApi::preparePartitionedDecoder(size_t partition_size)
+    {
+        using matrix_t = PartitionedConvolver::matrix_t;
+        
+        const bool resample = (m_sample_rate != k_builtin_hrir_sample_rate);
+        std::unique_lock<std::mutex> lock(resampled_responses_mutex, std::defer_lock);
+        if(resample)
+        {
+            lock.lock();
+            auto it = resampled_responses.find(m_sample_rate);
+            if(it != resampled_responses.end())
+            {
+                m_partitioned_decoder = std::make_unique<PartitionedConvolver>(partition_size,
+                                                                               it->second.left.topRows(m_num_harmonics),
+                                                                               it->second.right.topRows(m_num_harmonics));
+                return;
+            }
+        }
+        
+        decoder_t decoder(k_order);
+        decoder.prepare(m_vectorsize);
+        
+        matrix_t left, right;
+        if(!probeDecoder(decoder, k_num_harmonics, m_vectorsize, left, right))
+        {
+            HOA_LOG("HoaLibrary: the responses of the library decoder are too long for the partitioned decoder\n");
+            return;
+        }
+        
+        // the harmonics above the order of the instance are always silent.
+        auto convolver = std::make_unique<PartitionedConvolver>(partition_size,
+                                                                left.topRows(m_num_harmonics),
+                                                                right.topRows(m_num_harmonics));
+        
+        // checks it against the library decoder on noise.
+        std::mt19937 generator(1);
+        std::uniform_real_distribution<float_t> distribution(-1.f, 1.f);
+        
+        harmonics_matrix_t inputs = harmonics_matrix_t::Zero(k_num_harmonics, m_vectorsize);
+        stereo_matrix_t expected(2, m_vectorsize);
+        stereo_matrix_t outputs(2, m_vectorsize);
+        auto expected_map = stereo_matrix_t::Map(expected.data(), 2, m_vectorsize);
+        
+        double error = 0., energy = 0.;
+        const size_t num_blocks = left.cols() / m_vectorsize + 2;
+        for(size_t block = 0; block < num_blocks; ++block)
+        {
+            inputs.topRows(m_num_harmonics) = inputs.topRows(m_num_harmonics).unaryExpr([&](float_t) {
+                return distribution(generator);
+            });
+            
+            decoder.processBlock(inputs, expected_map);
+            convolver->process(inputs.topRows(m_num_harmonics), outputs);
+            
+            error += (expected - outputs).cwiseAbs2().sum();
+            energy += expected.cwiseAbs2().sum();
+        }
+        
+        if(!(energy > 0. && error / energy < 1e-7))
+        {
+            HOA_LOG("HoaLibrary: the partitioned decoder does not match the library decoder\n");
+            return;
+        }
+        
+        if(!resample)
+        {
+            convolver->reset();
+            m_partitioned_decoder = std::move(convolver);
+            return;
+        }
+        
+        if(!resampleDecodingFilters(left, right, k_builtin_hrir_sample_rate, m_sample_rate))
+        {
+            HOA_LOG("HoaLibrary: the HRIR set can't be resampled to the sample rate of the instance\n");
+            return;
+        }
+        
+        m_partitioned_decoder = std::make_unique<PartitionedConvolver>(partition_size,
+                                                                       left.topRows(m_num_harmonics),
+                                                                       right.topRows(m_num_harmonics));
+        
+        auto& responses = resampled_responses[m_sample_rate];
+        responses.left = std::move(left);
+        responses.right = std::move(right);
+    }
+    
+    HoaLibraryApi::~HoaLibraryApi()
+    {
+        std::thread loader;
+        {
+            std::lock_guard<std::mutex> lock(m_hrir_mutex);
+            m_hrir_stopping = true;
+            loader = std::move(m_hrir_loader);
+        }
+        
+        if(loader.joinable())
+        {
+            loader.join();
+        }
+        
+        delete m_pending_swap.exchange(nullptr);
+        delete m_retired_swap.exchange(nullptr);
+        delete m_pending_decoder.exchange(nullptr);
+        delete m_retired_decoder.exchange(nullptr);
+        delete m_pending_near_field.exchange(nullptr);
+        delete m_retired_near_field.exchange(nullptr);
+    }
+    
+    bool HoaLibraryApi::fillInterleavedOutputBuffer(size_t frames, float_t* outputs, dsptick_t dsptick)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        renderSoundfield(frames, dsptick);
+        const auto decode_start = std::chrono::steady_clock::now();
+        
+        auto outs = stereo_matrix_t::Map(outputs, 2, frames);
+        if(!updateDecoder(outs))
+        {
+            decode(outs);
+        }
+        outs *= m_master_gain;
+        
+        recordMetrics(frames, start, decode_start);
+        return true;
+    }
+    
+    bool HoaLibraryApi::fillInterleavedAmbisonicBuffer(size_t frames, size_t channels,
+                                                       float_t* outputs, dsptick_t dsptick)
+    {
+        if(m_ambix_conversion.channels.empty())
+            return false;
+        
+        const auto start = std::chrono::steady_clock::now();
+        renderSoundfield(frames, dsptick);
+        const auto decode_start = std::chrono::steady_clock::now();
+        
+        std::fill(outputs, outputs + frames * channels, 0.f);
+        
+        // the inverse of the AmbiX conversion of the beds.
+        for(size_t h = 0; h < m_num_harmonics; ++h)
+        {
+            const size_t channel = m_ambix_conversion.channels[h];
+            if(channel >= channels)
+                continue;
+            
+            const float_t gain = m_master_gain / m_ambix_conversion.scales[h];
+            for(size_t frame = 0; frame < frames; ++frame)
+            {
+                outputs[frame * channels + channel] = m_soundfield_matrix(h, frame) * gain;
+            }
+        }
+        
+        recordMetrics(frames, start, decode_start);
+        return true;
+    }
+    
+    bool HoaLibraryApi::fillInterleavedSpeakerBuffer(size_t frames, size_t channels,
+                                                     float_t* outputs, dsptick_t dsptick)
+    {
+        if(!m_speaker_decoder)
+            return false;
+        
+        const auto start = std::chrono::steady_clock::now();
+        renderSoundfield(frames, dsptick);
+        const auto decode_start = std::chrono::steady_clock::now();
+        
+        const float_t crossover = m_speaker_crossover.load(std::memory_order_relaxed);
+        if(crossover != m_applied_crossover)
+        {
+            m_speaker_decoder->setCrossover(crossover);
+            m_applied_crossover = crossover;
+        }
+        
+        m_speaker_decoder->process(m_soundfield_matrix, frames, channels, outputs, m_master_gain);
+        
+        recordMetrics(frames, start, decode_start);
+        return true;
+    }
+    
+    void HoaLibraryApi::recordMetrics(size_t frames, std::chrono::steady_clock::time_point start,
+                                      std::chrono::steady_clock::time_point decode_start)
+    {
+        BlockTimings timings;
+        timings.block_us = get_elapsed_us(start);
+        timings.encode_us = m_encode_time;
+        timings.decode_us = get_elapsed_us(decode_start);
+        timings.sources = m_encoded_sources;
+        timings.period_us = frames * 1e6 / m_sample_rate;
+        
+        updateQuality(timings.block_us, timings.period_us);
+        timings.quality_level = m_quality.getLevel();
+        timings.quality_changes = m_quality.getChanges();
+        m_metrics.record(timings);
+    }
+    
+    void HoaLibraryApi::renderSoundfield(size_t frames, dsptick_t dsptick)
+    {
+        m_sources.applyCommands();
+        updateWorkerPool();
+        updateQualitySettings();
+        m_soundfield_matrix.setZero();
+        
+        auto const& sources = m_sources.getActive();
+        const auto encoding_mode = m_encoding_mode.load(std::memory_order_relaxed);
+        const auto encoding_subblock_size = m_encoding_subblock_size.load(std::memory_order_relaxed);
+        
+        InputStatistics statistics;
+        for(auto* source : sources)
+        {
+            source->setEncodingMode(encoding_mode, encoding_subblock_size);
+            source->acquireInput(dsptick, statistics);
+        }
+        
+        updateNearField(sources);
+        
+        m_beds_active = m_rotation && acquireBeds(dsptick, statistics);
+        
+        m_concealed_blocks.fetch_add(statistics.concealed_blocks, std::memory_order_relaxed);
+        m_dropped_blocks.fetch_add(statistics.dropped_blocks, std::memory_order_relaxed);
+        
+        // the silent sources are not encoded, only their position smoothing runs
+        // (on the spatializer thread for the blocks it encodes).
+        m_active_sources.clear();
+        for(auto* source : sources)
+        {
+            if(!source->isSilent())
+            {
+                m_active_sources.push_back(source);
+            }
+            else if(!source->hasEncodedInput() && source->ownsEncodingState())
+            {
+                source->skipBlock();
+            }
+        }
+        
+        m_silent_voices.store(sources.size() - m_active_sources.size(), std::memory_order_relaxed);
+        
+        const bool bypass_optim = m_quality.hasLevel(QualityLevel::NoLowPriorityOptim);
+        for(auto* source : m_active_sources)
+        {
+            source->setOptimBypassed(bypass_optim && isLowPriority(*source));
+        }
+        
+        updateEncodingOrders(m_active_sources);
+        auto const& rendered_sources = scheduleVoices(m_active_sources);
+        
+        const auto start = std::chrono::steady_clock::now();
+        
+        m_encoder.process(rendered_sources, encoding_mode, encoding_subblock_size,
+                          m_soundfield_matrix, m_worker_pool.get());
+        
+        const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        
+        if(encoding_mode == EncodingMode::Spatializer)
+        {
+            // the state is not touched anymore in this block.
+            for(auto* source : sources)
+            {
+                source->handOverEncodingState();
+            }
+        }
+        
+        updateHarmonicCost(rendered_sources, elapsed.count());
+        m_encode_time = elapsed.count();
+        m_encoded_sources = rendered_sources.size();
+        
+        if(m_rotation)
+        {
+            rotateSoundfield(frames);
+        }
+    }
+    
+    void HoaLibraryApi::setListenerOrientation(Quaternion const& orientation)
+    {
+        m_listener_orientation.store(orientation);
+    }
+    
+    void HoaLibraryApi::setHeadOrientation(Quaternion const& orientation)
+    {
+        m_head_orientation.store(orientation);
+    }
+    
+    void HoaLibraryApi::setHeadTrackingSubblockSize(size_t subblock_size)
+    {
+        m_head_subblock_size.store(subblock_size, std::memory_order_relaxed);
+    }
+    
+    void HoaLibraryApi::rotateSoundfield(size_t frames)
+    {
+        const size_t subblock_size = m_head_subblock_size.load(std::memory_order_relaxed);
+        const size_t step = (subblock_size > 0) ? std::min(subblock_size, frames) : frames;
+        
+        for(size_t start = 0; start < frames; start += step)
+        {
+            const size_t size = std::min(step, frames - start);
+            updateRotation();
+            
+            auto soundfield = m_soundfield_matrix.middleCols(start, size);
+            if(m_beds_active)
+            {
+                auto beds = m_bed_matrix.middleCols(start, size);
+                if(m_bed_rotation)
+                {
+                    m_bed_rotation->process(beds);
+                }
+                
+                soundfield += beds;
+            }
+            
+            m_rotation->process(soundfield);
+        }
+    }
+    
+    void HoaLibraryApi::updateRotation()
+    {
+        bool listener_changed = false, head_changed = false;
+        Quaternion orientation;
+        
+        const uint32_t listener_version = m_listener_orientation.getVersion();
+        if(listener_version != m_listener_version && m_listener_orientation.load(orientation))
+        {
+            m_listener_rotation = get_rotation_matrix(orientation);
+            m_listener_version = listener_version;
+            listener_changed = true;
+        }
+        
+        const uint32_t head_version = m_head_orientation.getVersion();
+        if(head_version != m_head_version && m_head_orientation.load(orientation))
+        {
+            m_head_rotation = get_rotation_matrix(orientation);
+            m_head_version = head_version;
+            head_changed = true;
+        }
+        
+        // out of world frame, only the beds are brought back from the world to the listener frame.
+        if(listener_changed && m_bed_rotation)
+        {
+            m_bed_rotation->setRotation(get_hoa_rotation(m_listener_rotation.transpose()));
+        }
+        
+        if(head_changed || (listener_changed && m_world_frame))
+        {
+            // the directions are brought back from the world (or listener) to the head frame.
+            const Eigen::Matrix3d head_to_world = m_world_frame
+            ? Eigen::Matrix3d(m_listener_rotation * m_head_rotation)
+            : m_head_rotation;
+            
+            m_rotation->setRotation(get_hoa_rotation(head_to_world.transpose()));
+        }
+    }
+    
+    bool HoaLibraryApi::acquireBeds(dsptick_t dsptick, InputStatistics& statistics)
+    {
+        m_beds.applyCommands();
+        
+        bool active = false;
+        for(auto* bed : m_beds.getActive())
+        {
+            bed->acquireInput(dsptick, statistics);
+            if(!bed->isActive())
+                continue;
+            
+            if(!active)
+            {
+                m_bed_matrix.setZero();
+                active = true;
+            }
+            
+            bed->addInput(m_bed_matrix);
+        }
+        
+        return active;
+    }
+    
+    void HoaLibraryApi::decode(Eigen::Map<stereo_matrix_t> outputs)
+    {
+        if(m_partitioned_decoder)
+        {
+            // the library decoder always decodes all the harmonics, only this one can drop some.
+            const bool reduced = m_order > 1 && m_quality.hasLevel(QualityLevel::DecoderOrder);
+            m_partitioned_decoder->setActiveInputs(reduced ? get_num_harmonics_for_order(m_order - 1)
+                                                   : m_num_harmonics);
+            m_partitioned_decoder->process(m_soundfield_matrix, outputs);
+        }
+        else if(m_sample_rate != k_builtin_hrir_sample_rate)
+        {
+            // the library decoder only runs at the sample rate of the built-in HRIR set,
+            // the output is silent until an HRIR set is loaded (see preparePartitionedDecoder).
+            outputs.setZero();
+        }
+        else if(m_num_harmonics < k_num_harmonics)
+        {
+            m_decoder_inputs.topRows(m_num_harmonics) = m_soundfield_matrix;
+            m_decoder.processBlock(m_decoder_inputs, outputs);
+        }
+        else
+        {
+            m_decoder.processBlock(m_soundfield_matrix, outputs);
+        }
+    }
+    
+    bool HoaLibraryApi::updateDecoder(Eigen::Map<stereo_matrix_t> outputs)
+    {
+        // the previous decoder must have been deleted before another one can be swapped.
+        if(m_retired_decoder.load(std::memory_order_acquire) != nullptr)
+            return false;
+        
+        auto* swap = m_pending_decoder.exchange(nullptr, std::memory_order_acq_rel);
+        if(swap == nullptr)
+            return false;
+        
+        const auto frames = outputs.cols();
+        auto previous_outputs = stereo_matrix_t::Map(m_fade_outputs.data(), 2, frames);
+        decode(previous_outputs);
+        
+        std::swap(swap->decoder, m_partitioned_decoder);
+        m_retired_decoder.store(swap, std::memory_order_release);
+        
+        // the new decoder starts with an empty history, it fades in over the block.
+        decode(outputs);
+        for(Eigen::Index i = 0; i < frames; ++i)
+        {
+            const float_t fade = static_cast<float_t>(i + 1) / static_cast<float_t>(frames);
+            outputs.col(i) = fade * outputs.col(i) + (1.f - fade) * previous_outputs.col(i);
+        }
+        
+        return true;
+    }
+    
+    void HoaLibraryApi::loadHrir(std::string const& path, std::string const& cache_directory)
+    {
+        std::thread finished_loader;
+        {
+            std::lock_guard<std::mutex> lock(m_hrir_mutex);
+            m_hrir_path = path;
+            m_hrir_cache_directory = cache_directory;
+            m_hrir_requested = true;
+            m_hrir_status.store(HrirStatus::Loading, std::memory_order_release);
+            
+            // the running loader picks the request up after its current set.
+            if(m_hrir_loading)
+                return;
+            
+            m_hrir_loading = true;
+            finished_loader = std::move(m_hrir_loader);
+            m_hrir_loader = std::thread(&HoaLibraryApi::runHrirLoader, this);
+        }
+        
+        // the previous loader has returned or is returning.
+        if(finished_loader.joinable())
+        {
+            finished_loader.join();
+        }
+    }
+    
+    bool HoaLibraryApi::isHrirLoaderInterrupted()
+    {
+        std::lock_guard<std::mutex> lock(m_hrir_mutex);
+        return m_hrir_requested || m_hrir_stopping;
+    }
+    
+    void HoaLibraryApi::runHrirLoader()
+    {
+        for(;;)
+        {
+            std::string path, cache_directory;
+            {
+                std::lock_guard<std::mutex> lock(m_hrir_mutex);
+                if(!m_hrir_requested || m_hrir_stopping)
+                {
+                    m_hrir_loading = false;
+                    return;
+                }
+                
+                path = m_hrir_path;
+                cache_directory = m_hrir_cache_directory;
+                m_hrir_requested = false;
+            }
+            
+            auto decoder = (m_decoder_partition_size > 0)
+            ? createHrirDecoder(path, cache_directory, m_order, m_decoder_partition_size, m_sample_rate)
+            : nullptr;
+            
+            const bool loaded = (decoder != nullptr);
+            if(loaded)
+            {
+                delete m_retired_decoder.exchange(nullptr, std::memory_order_acq_rel);
+                
+                auto* swap = new DecoderSwap();
+                swap->decoder = std::move(decoder);
+                delete m_pending_decoder.exchange(swap, std::memory_order_acq_rel);
+            }
+            
+            {
+                // the status of a newer request is kept.
+                std::lock_guard<std::mutex> lock(m_hrir_mutex);
+                if(!m_hrir_requested)
+                {
+                    m_hrir_status.store(loaded ? HrirStatus::Loaded : HrirStatus::Failed,
+                                        std::memory_order_release);
+                }
+            }
+            
+            // the replaced decoder is freed as soon as the audio thread retires it.
+            while(loaded && m_retired_decoder.load(std::memory_order_acquire) == nullptr
+                  && !isHrirLoaderInterrupted())
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            
+            delete m_retired_decoder.exchange(nullptr, std::memory_order_acq_rel);
+        }
+    }
+    
+    HrirStatus HoaLibraryApi::getHrirStatus() const
+    {
+        return m_hrir_status.load(std::memory_order_acquire);
+    }
+    
+    size_t HoaLibraryApi::getDistanceOrder(float_t distance, float_t lod_distance, size_t min_order) const
+    {
+        if(lod_distance <= 0.f || distance <= lod_distance)
+            return m_order;
+        
+        // one order less each time the distance doubles.
+        const auto drop = 1 + static_cast<size_t>(std::log2(distance / lod_distance));
+        return (m_order > min_order + drop) ? m_order - drop : min_order;
+    }
+    
+    void HoaLibraryApi::updateEncodingOrders(std::vector<Source*> const& sources)
+    {
+        const auto lod_distance = m_lod_distance.load(std::memory_order_relaxed);
+        const auto budget = m_lod_harmonics_budget.load(std::memory_order_relaxed);
+        const auto min_order = std::min(m_lod_min_order.load(std::memory_order_relaxed), m_order);
+        const bool reduce_order = m_quality.hasLevel(QualityLevel::LowPriorityOrder);
+        
+        // the per sample encoding always runs at the order of the instance.
+        if(m_encoding_mode.load(std::memory_order_relaxed) == EncodingMode::PerSample)
+        {
+            for(auto* source : sources)
+            {
+                source->setEncodingOrder(m_order);
+            }
+            
+            return;
+        }
+        
+        // the adaptive quality takes one more order off the low priority sources.
+        auto get_order = [&](Source const& source) {
+            const size_t order = getDistanceOrder(source.getDistance(), lod_distance, min_order);
+            return (reduce_order && order > min_order && isLowPriority(source)) ? order - 1 : order;
+        };
+        
+        if(budget == 0)
+        {
+            for(auto* source : sources)
+            {
+                source->setEncodingOrder(get_order(*source));
+            }
+            
+            return;
+        }
+        
+        // the sources with the highest priority, then the nearest, are served first.
+        m_lod_ranks.clear();
+        for(auto* source : sources)
+        {
+            m_lod_ranks.push_back({source->getPriority(), source->getDistance(), source});
+        }
+        
+        std::sort(m_lod_ranks.begin(), m_lod_ranks.end(), [](LodRank const& lhs, LodRank const& rhs) {
+            return (lhs.priority != rhs.priority) ? lhs.priority > rhs.priority : lhs.distance < rhs.distance;
+        });
+        
+        size_t used = 0;
+        for(auto const& rank : m_lod_ranks)
+        {
+            size_t order = get_order(*rank.source);
+            while(order > min_order && used + get_num_harmonics_for_order(order) > budget)
+            {
+                --order;
+            }
+            
+            used += get_num_harmonics_for_order(order);
+            rank.source->setEncodingOrder(order);
+        }
+    }
+    
+    auto HoaLibraryApi::scheduleVoices(std::vector<Source*> const& sources) -> std::vector<Source*> const&
+    {
+        double budget = m_encoding_budget.load(std::memory_order_relaxed);
+        if(m_quality_budget > 0.)
+        {
+            budget = (budget > 0.) ? std::min(budget, m_quality_budget) : m_quality_budget;
+        }
+        
+        // no budget or nothing measured yet: all the sources are rendered.
+        if(budget <= 0. || m_harmonic_cost <= 0.)
+        {
+            for(auto* source : sources)
+            {
+                source->setCulled(false);
+            }
+            
+            m_rendered_voices.store(sources.size(), std::memory_order_relaxed);
+            m_culled_voices.store(0, std::memory_order_relaxed);
+            return sources;
+        }
+        
+        // the loudest sources, weighted by their priority, are served first.
+        m_voice_ranks.clear();
+        for(auto* source : sources)
+        {
+            const auto harmonics = get_num_harmonics_for_order(source->getEncodingOrder());
+            m_voice_ranks.push_back({source->getInputLevel() * source->getPriority(), harmonics, source});
+        }
+        
+        std::sort(m_voice_ranks.begin(), m_voice_ranks.end(), [](VoiceRank const& lhs, VoiceRank const& rhs) {
+            return lhs.score > rhs.score;
+        });
+        
+        // the sources that fit in the budget in this order, a source that does not fit is
+        // skipped and the cheaper ones after it can still fill the budget. The first one is
+        // always rendered, even over the budget. The sources fading out are not counted.
+        m_rendered_sources.clear();
+        double cost = 0.;
+        size_t rendered_voices = 0;
+        
+        for(auto const& rank : m_voice_ranks)
+        {
+            const double source_cost = rank.harmonics * m_harmonic_cost;
+            const bool culled = (rendered_voices > 0 && cost + source_cost > budget);
+            
+            if(!culled)
+            {
+                cost += source_cost;
+                ++rendered_voices;
+            }
+            
+            if(rank.source->setCulled(culled))
+            {
+                m_rendered_sources.push_back(rank.source);
+            }
+        }
+        
+        m_rendered_voices.store(rendered_voices, std::memory_order_relaxed);
+        m_culled_voices.store(sources.size() - rendered_voices, std::memory_order_relaxed);
+        return m_rendered_sources;
+    }
+    
+    void HoaLibraryApi::updateHarmonicCost(std::vector<Source*> const& sources, double microseconds)
+    {
+        // the sources encoded by the spatializer are only summed.
+        size_t harmonics = 0;
+        for(auto const* source : sources)
+        {
+            if(!source->hasEncodedInput())
+            {
+                harmonics += source->getEncodingHarmonics();
+            }
+        }
+        
+        if(harmonics == 0)
+            return;
+        
+        // smoothed over a few blocks
+        const double cost = microseconds / harmonics;
+        m_harmonic_cost = (m_harmonic_cost > 0.) ? (0.9 * m_harmonic_cost + 0.1 * cost) : cost;
+        m_measured_harmonic_cost.store(static_cast<float_t>(m_harmonic_cost), std::memory_order_relaxed);
+    }
+    
+    void HoaLibraryApi::updateQualitySettings()
+    {
+        QualitySettings settings;
+        const uint32_t version = m_quality_settings.getVersion();
+        if(version != m_quality_version && m_quality_settings.load(settings))
+        {
+            m_quality.setSettings(settings);
+            m_quality_version = version;
+            
+            if(m_quality.getLevel() < static_cast<int>(QualityLevel::Culling))
+            {
+                m_quality_budget = 0.;
+            }
+        }
+    }
+    
+    void HoaLibraryApi::updateQuality(double block_us, double period_us)
+    {
+        const int previous_level = m_quality.getLevel();
+        if(!m_quality.update(block_us, period_us))
+            return;
+        
+        const int culling = static_cast<int>(QualityLevel::Culling);
+        const int level = m_quality.getLevel();
+        if(level < culling)
+        {
+            m_quality_budget = 0.;
+            return;
+        }
+        
+        // the first culling level keeps a part of the measured encoding time, the next ones
+        // cut the budget again, recovering gives the cuts back one by one.
+        if(previous_level < culling)
+        {
+            m_quality_budget = std::max(m_encode_time * k_quality_culling_ratio, 1.);
+        }
+        else if(level > previous_level)
+        {
+            m_quality_budget *= k_quality_culling_ratio;
+        }
+        else
+        {
+            m_quality_budget /= k_quality_culling_ratio;
+        }
+    }
+    
+    bool HoaLibraryApi::isLowPriority(Source const& source) const
+    {
+        return source.getPriority() < m_quality.getSettings().low_priority;
+    }
+    
+    void HoaLibraryApi::updateWorkerPool()
+    {
+        // the previous pool must have been deleted before another one can be swapped.
+        if(m_retired_swap.load(std::memory_order_acquire) != nullptr)
+            return;
+        
+        if(auto* swap = m_pending_swap.exchange(nullptr, std::memory_order_acq_rel))
+        {
+            std::swap(swap->pool, m_worker_pool);
+            m_retired_swap.store(swap, std::memory_order_release);
+        }
+    }
+    
+    void HoaLibraryApi::setWorkerThreads(size_t num_threads, bool pin_threads)
+    {
+        std::lock_guard<std::mutex> lock(m_swap_mutex);
+        
+        delete m_retired_swap.exchange(nullptr, std::memory_order_acq_rel);
+        
+        // pinning does not matter without threads.
+        if(num_threads == m_worker_threads && (num_threads == 0 || pin_threads == m_pin_worker_threads))
+            return;
+        
+        m_worker_threads = num_threads;
+        m_pin_worker_threads = pin_threads;
+        
+        auto* swap = new WorkerPoolSwap();
+        if(num_threads > 0)
+        {
+            swap->pool = std::make_unique<WorkerPool>(num_threads, pin_threads);
+        }
+        
+        delete m_pending_swap.exchange(swap, std::memory_order_acq_rel);
+    }
+    
+    void HoaLibraryApi::updateNearField(std::vector<Source*> const& sources)
+    {
+        if(!m_near_field_filters)
+            return;
+        
+        // the previous filters are retired once no source can use them anymore, they must
+        // have been deleted before they can be retired again.
+        if(m_previous_near_field && m_retired_near_field.load(std::memory_order_acquire) == nullptr)
+        {
+            auto const* previous = m_previous_near_field.get();
+            const bool used = std::any_of(sources.begin(), sources.end(), [previous](Source const* source) {
+                return source->usesNearFieldFilters(previous);
+            });
+            
+            if(!used)
+            {
+                m_retired_near_field.store(m_previous_near_field.release(), std::memory_order_release);
+            }
+        }
+        
+        if(!m_previous_near_field)
+        {
+            if(auto* filters = m_pending_near_field.exchange(nullptr, std::memory_order_acq_rel))
+            {
+                m_previous_near_field = std::move(m_swapped_near_field);
+                m_swapped_near_field.reset(filters);
+            }
+        }
+        
+        auto const* current = m_swapped_near_field ? m_swapped_near_field.get() : m_near_field_filters.get();
+        m_encoder.setNearFieldFilters(current);
+        for(auto* source : sources)
+        {
+            source->setNearFieldFilters(current);
+        }
+    }
+    
+    void HoaLibraryApi::setNearFieldRadius(float_t radius)
+    {
+        if(!m_near_field_filters)
+            return;
+        
+        std::lock_guard<std::mutex> lock(m_near_field_mutex);
+        
+        delete m_retired_near_field.exchange(nullptr, std::memory_order_acq_rel);
+        
+        auto filters = std::make_unique<NearFieldFilters>(m_order, get_near_field_radius(radius, m_speakers_radius),
+                                                          m_near_field_max_boost, m_sample_rate);
+        delete m_pending_near_field.exchange(filters.release(), std::memory_order_acq_rel);
+    }
+    
+    void HoaLibraryApi::setSpeakerCrossover(float_t frequency)
+    {
+        m_speaker_crossover.store(frequency, std::memory_order_relaxed);
+    }
+    
+    void HoaLibraryApi::setMasterGain(float_t gain)
+    {
+        m_master_gain = gain;
+    }
+    
+    void HoaLibraryApi::setEncodingMode(EncodingMode mode, size_t subblock_size)
+    {
+        m_encoding_mode = mode;
+        m_encoding_subblock_size = subblock_size;
+    }
+    
+    void HoaLibraryApi::setOrderLod(OrderLodSettings const& settings)
+    {
+        m_lod_distance.store(std::max(settings.distance, 0.f), std::memory_order_relaxed);
+        m_lod_harmonics_budget.store(settings.harmonics_budget, std::memory_order_relaxed);
+        m_lod_min_order.store(settings.min_order, std::memory_order_relaxed);
+    }
+    
+    void HoaLibraryApi::setEncodingBudget(float_t microseconds)
+    {
+        m_encoding_budget.store(std::max(microseconds, 0.f), std::memory_order_relaxed);
+    }
+    
+    DspMetrics HoaLibraryApi::getDspMetrics() const
+    {
+        auto metrics = m_metrics.getMetrics();
+        
+        const auto inputs = getInputStatistics();
+        metrics.concealed_blocks = inputs.concealed_blocks;
+        metrics.duplicated_blocks = inputs.duplicated_blocks;
+        metrics.dropped_blocks = inputs.dropped_blocks;
+        
+        const auto voices = getVoiceStatistics();
+        metrics.rendered_voices = static_cast<uint32_t>(voices.rendered_voices);
+        metrics.culled_voices = static_cast<uint32_t>(voices.culled_voices);
+        metrics.silent_voices = static_cast<uint32_t>(voices.silent_voices);
+        
+        return metrics;
+    }
+    
+    void HoaLibraryApi::setQualitySettings(QualitySettings const& settings)
+    {
+        m_quality_settings.store(settings);
+    }
+    
+    QualityLog HoaLibraryApi::getQualityLog() const
+    {
+        return m_quality.getLog();
+    }
+    
+    VoiceStatistics HoaLibraryApi::getVoiceStatistics() const
+    {
+        VoiceStatistics statistics;
+        statistics.rendered_voices = m_rendered_voices.load(std::memory_order_relaxed);
+        statistics.culled_voices = m_culled_voices.load(std::memory_order_relaxed);
+        statistics.silent_voices = m_silent_voices.load(std::memory_order_relaxed);
+        statistics.harmonic_cost = m_measured_harmonic_cost.load(std::memory_order_relaxed);
+        return statistics;
+    }
+    
+    InputStatistics HoaLibraryApi::getInputStatistics() const
+    {
+        InputStatistics statistics;
+        statistics.concealed_blocks = m_concealed_blocks.load(std::memory_order_relaxed);
+        statistics.duplicated_blocks = m_duplicated_blocks.load(std::memory_order_relaxed);
+        statistics.dropped_blocks = m_dropped_blocks.load(std::memory_order_relaxed);
+        return statistics;
+    }
+    
+    auto HoaLibraryApi::createSource() -> source_id_t
+    {
+        const auto order = m_order;
+        const auto vectorsize = m_vectorsize;
+        const auto sample_rate = m_sample_rate;
+        const auto* near_field = m_near_field_filters.get();
+        const bool encoded_inputs = (m_encoding_mode.load(std::memory_order_relaxed) == EncodingMode::Spatializer);
+        return m_sources.create([order, vectorsize, sample_rate, near_field, encoded_inputs]() {
+            return std::make_unique<Source>(order, vectorsize, sample_rate, near_field, encoded_inputs);
+        });
+    }
+    
+    auto HoaLibraryApi::createBed() -> bed_id_t
+    {
+        if(m_ambix_conversion.channels.empty())
+            return invalid_bed_id;
+        
+        auto const& conversion = m_ambix_conversion;
+        const auto vectorsize = m_vectorsize;
+        return m_beds.create([&conversion, vectorsize]() {
+            return std::make_unique<Bed>(conversion, vectorsize);
+        });
+    }
+    
+    void HoaLibraryApi::destroyBed(bed_id_t bed_id)
+    {
+        m_beds.destroy(bed_id);
+    }
+    
+    bool HoaLibraryApi::isBedValid(bed_id_t bed_id) const
+    {
+        return m_beds.get(bed_id) != nullptr;
+    }
+    
+    void HoaLibraryApi::setInterleavedBedBuffer(bed_id_t bed_id, float_t const* inputs, size_t channels,
+                                                size_t num_frames, dsptick_t dsptick)
+    {
+        if(auto* bed = m_beds.get(bed_id))
+        {
+            if(!bed->setInterleavedBuffer(inputs, channels, num_frames, dsptick))
+            {
+                m_duplicated_blocks.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    void HoaLibraryApi::setBedGain(bed_id_t bed_id, float_t gain)
+    {
+        if(auto* bed = m_beds.get(bed_id))
+        {
+            bed->setGain(gain);
+        }
+    }
+    
+    void HoaLibraryApi::destroySource(source_id_t source_id)
+    {
+        m_sources.destroy(source_id);
+    }
+    
+    bool HoaLibraryApi::isSourceValid(source_id_t source_id) const
+    {
+        return m_sources.get(source_id) != nullptr;
+    }
+    
+    void HoaLibraryApi::setInterleavedSourceBuffer(source_id_t source_id,
+                                                   float_t const* audio_buffer_ptr, size_t num_frames,
+                                                   dsptick_t dsptick)
+    {
+        if(auto* source = m_sources.get(source_id))
+        {
+            size_t encoding_subblock_size = 0;
+            if(m_encoding_mode.load(std::memory_order_relaxed) == EncodingMode::Spatializer)
+            {
+                encoding_subblock_size = m_encoding_subblock_size.load(std::memory_order_relaxed);
+                encoding_subblock_size = encoding_subblock_size > 0 ? encoding_subblock_size : num_frames;
+            }
+            
+            if(!source->setInterleavedBuffer(audio_buffer_ptr, num_frames, dsptick, encoding_subblock_size))
+            {
+                m_duplicated_blocks.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    void HoaLibraryApi::setSourcePosition(source_id_t source_id,
+                                          float_t x, float_t y, float_t z)
+    {
+        if(auto* source = m_sources.get(source_id))
+        {
+            source->setPosition(x, y, z);
+        }
+    }
+    
+    void HoaLibraryApi::setSourcePan(source_id_t source_id, float_t pan)
+    {
+        if(auto* source = m_sources.get(source_id))
+        {
+            source->setPan(pan);
+        }
+    }
+    
+    void HoaLibraryApi::setSourceGain(source_id_t source_id, float_t volume)
+    {
+        if(auto* source = m_sources.get(source_id))
+        {
+            source->setGain(volume);
+        }
+    }
+    
+    void HoaLibraryApi::setSourceOptim(source_id_t source_id, int optim)
+    {
+        if(auto* source = m_sources.get(source_id))
+        {
+            source->setOptim(optim);
+        }
+    }
+    
+    void HoaLibraryApi::setSourcePriority(source_id_t source_id, float_t priority)
+    {
+        if(auto* source = m_sources.get(source_id))
+        {
+            source->setPriority(priority);
+        }
+    }
+    
+    void HoaLibraryApi::setSourceMinDistance(source_id_t source_id, float_t distance)
     {
-        auto source = m_sources.find(source_id);
-        if(source != m_sources.end())
+        if(auto* source = m_sources.get(source_id))
         {
-            source->second->setOptim(optim);
+            source->setMinDistance(distance);
         }
     }
 }
@@ -41,18 +41,37 @@
 #include <Hoa.hpp>
 #include <Hoa_Line.hpp>
 
+#include "HoaLibraryDecoder.h"
+#include "HoaLibraryHarmonics.h"
+#include "HoaLibraryHrir.h"
+#include "HoaLibraryMetrics.h"
+#include "HoaLibraryNearField.h"
+#include "HoaLibraryQuality.h"
+#include "HoaLibraryRegistry.h"
+#include "HoaLibraryRotation.h"
+#include "HoaLibrarySeqLock.h"
+#include "HoaLibrarySpeakers.h"
+#include "HoaLibraryTripleBuffer.h"
+#include "HoaLibraryWorkers.h"
+
 #include <assert.h>
 #include <atomic>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 #include <array>
-#include <unordered_map>
 
 namespace HoaLibraryUnity
 {
     using namespace hoa;
     using float_t = float;
     
+    //! @brief Sample counter marking the start of a block (UnityAudioEffectState::currdsptick).
+    using dsptick_t = uint64_t;
+    
     class HoaLibraryApi;
     
     //! @brief Returns the number of harmonics depending on an ambisonic order.
@@ -61,25 +80,204 @@ namespace HoaLibraryUnity
         return (order + 1) * (order + 1);
     }
     
-    extern "C"
-    {
-        //! @brief Factory method to create a HoaLibrary API instance.
-        //! @details Caller must take ownership of returned instance and destroy it via operator delete.
-        //! @param vectorsize Number of frames per buffer.
-        //! @param samplerate System sample rate (Hz).
-        HOA_EXPORT HoaLibraryApi* CreateHoaLibraryApi(size_t vectorsize);
-    }
-    
     using decoder_t = DecoderBinaural<Hoa3d, float_t, hrir::Sadie_D2_3D>;
     using harmonics_matrix_t = decoder_t::input_matrix_t;
     using hrir_t = decoder_t::hrir_t;
     using stereo_matrix_t = Eigen::Matrix2X<float_t>;
     using vector_t = Eigen::VectorX<float_t>;
+    using signal_matrix_t = Eigen::Matrix<float_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
     
     static constexpr size_t k_output_channels = 2;
     static constexpr size_t k_order = hrir_t::getOrderOfDecomposition();
     static constexpr size_t k_num_harmonics = get_num_harmonics_for_order(k_order);
     
+    //! @brief Sample rate of the built-in HRIR set.
+    static constexpr float_t k_builtin_hrir_sample_rate = 44100.f;
+    
+    //! @brief Duration of the smoothing of the source positions in milliseconds.
+    static constexpr float_t k_position_smoothing_time = 25.f;
+    
+    //! @brief Move of a source, relative to its distance (at least one meter), under which
+    //! its block rate coefficients are kept.
+    //! @details Absorbs the rounding of the positions computed from the listener matrix,
+    //! they are not exactly the same from a block to another when the listener turns.
+    static constexpr float_t k_position_tolerance = 1e-5f;
+    
+    //! @brief Default maximum number of sources of an HoaLibraryApi instance.
+    static constexpr size_t k_default_max_sources = 1024;
+    
+    //! @brief Default maximum number of ambisonic beds alive at the same time.
+    static constexpr size_t k_default_max_beds = 16;
+    
+    //! @brief Default number of frames between two evaluations of the encoder coefficients
+    //! in EncodingMode::BlockRate and EncodingMode::Matrix.
+    static constexpr size_t k_default_encoding_subblock_size = 64;
+    
+    //! @brief Default number of frames between two readings of the head orientation.
+    static constexpr size_t k_default_head_tracking_subblock_size = 64;
+    
+    //! @brief Number of groups of sources encoded in parallel when worker threads are used.
+    //! @details It does not depend on the number of threads so that the partial soundfields
+    //! are always the same and summed in the same order.
+    static constexpr size_t k_num_encoding_chunks = 16;
+    
+    //! @brief Peak level under which an input block is silent and is not encoded (-120 dB).
+    static constexpr float_t k_silence_threshold = 1e-6f;
+    
+    //! @brief Level of detail of the order the sources are encoded at.
+    //! @details A source is encoded at the order of the instance up to a distance, then
+    //! loses an order each time its distance doubles. When the total number of encoded
+    //! harmonics exceeds the budget, the sources with the lowest priority (then the farthest)
+    //! lose orders first. The sources encoded below the order of the instance only touch the
+    //! first (n+1)^2 harmonics, they are weighted with energy preserving max-rE weights of
+    //! their order when their optimization is Basic (or bypassed), a chosen optimization is
+    //! kept. The level of detail does not apply to EncodingMode::PerSample, these sources
+    //! are always encoded at the order of the instance.
+    struct OrderLodSettings
+    {
+        //! Distance from which the order starts to decrease (0 to disable).
+        float_t distance = 0.f;
+        
+        //! Maximum number of harmonics encoded per block for all the sources (0 for no limit).
+        size_t harmonics_budget = 0;
+        
+        //! The lowest order a source can be encoded at.
+        size_t min_order = 1;
+    };
+    
+    //! @brief Settings of an HoaLibraryApi instance.
+    struct ApiSettings
+    {
+        //! Number of frames per buffer.
+        size_t vectorsize = 0;
+        
+        //! Sample rate of the audio engine, the HRIR sets are resampled to it
+        //! (0 for the sample rate of the built-in HRIR set).
+        float_t sample_rate = 0.f;
+        
+        //! Maximum ambisonic order, at most the order of the HRIR set (0 for the order of the HRIR set).
+        size_t order = 0;
+        
+        //! Level of detail of the order of the sources.
+        OrderLodSettings order_lod {};
+        
+        //! Time budget of the encoding of the sources per block in microseconds (0 for no limit).
+        float_t encoding_budget = 0.f;
+        
+        //! Steps the quality down when the blocks come close to their deadline.
+        QualitySettings quality {};
+        
+        //! Filters the harmonics of the sources closer or farther than the reproduction radius.
+        NearFieldSettings near_field {};
+        
+        //! Maximum number of sources alive at the same time.
+        size_t max_sources = k_default_max_sources;
+        
+        //! Maximum number of ambisonic beds alive at the same time.
+        size_t max_beds = k_default_max_beds;
+        
+        //! Number of threads helping the audio thread to encode the sources
+        //! (0 to encode them on the audio thread only).
+        size_t worker_threads = 0;
+        
+        //! Pins each worker thread to its own core (linux only).
+        bool pin_worker_threads = false;
+        
+        //! Decodes with a PartitionedConvolver built from the responses of the library decoder.
+        bool partitioned_decoder = true;
+        
+        //! Partition size of the partitioned decoder, a power of two that divides the vectorsize
+        //! (0 for the largest one).
+        size_t decoder_partition_size = 0;
+        
+        //! The sources positions are given in the world frame, the soundfield is rotated
+        //! by the listener orientation once per block instead of moving every source:
+        //! the positions only change with the translations of the listener, so a source at
+        //! rest keeps its block rate coefficients while the listener turns (up to the rounding
+        //! of the positions, see k_position_tolerance).
+        bool world_frame = false;
+        
+        //! Number of frames between two readings of the head orientation (0 for once per block).
+        size_t head_tracking_subblock_size = k_default_head_tracking_subblock_size;
+        
+        //! The loudspeaker layout and decoding of the speaker output (no speaker output without layout).
+        SpeakerSettings speakers {};
+    };
+    
+    extern "C"
+    {
+        //! @brief Factory method to create a HoaLibrary API instance.
+        //! @details Caller must take ownership of returned instance and destroy it via operator delete.
+        //! @param settings The settings of the instance.
+        HOA_EXPORT HoaLibraryApi* CreateHoaLibraryApi(ApiSettings const& settings);
+    }
+    
+    //! @brief The way sources compute their spherical harmonics coefficients.
+    enum class EncodingMode : int
+    {
+        //! Coefficients are recomputed for every sample (reference mode).
+        PerSample = 0,
+        
+        //! Coefficients are computed once per sub-block and linearly interpolated
+        //! across the samples, static sources reuse their coefficients.
+        BlockRate = 1,
+        
+        //! Same as BlockRate, but the soundfield of each sub-block is computed for all
+        //! sources at once as a (harmonics x sources) by (sources x frames) matrix product.
+        Matrix = 2,
+        
+        //! Same as BlockRate, but each source encodes its own block in the spatializer
+        //! callback, the renderer only sums the soundfields of the sources.
+        //! Only the sources created in this mode are encoded by the spatializer (their input
+        //! blocks are allocated with the harmonics), the other ones are encoded by the renderer.
+        Spatializer = 3,
+    };
+    
+    //! @brief Counters of the source input blocks handoff.
+    struct InputStatistics
+    {
+        //! Gaps in the input of a playing source, concealed by fading out its previous block.
+        uint64_t concealed_blocks = 0;
+        
+        //! Blocks passed twice for the same dsp tick, the last one is kept.
+        uint64_t duplicated_blocks = 0;
+        
+        //! Blocks never rendered (stale, replaced before being rendered or never passed).
+        uint64_t dropped_blocks = 0;
+    };
+    
+    //! @brief Counts of the voices scheduled in the last block.
+    struct VoiceStatistics
+    {
+        //! Sources encoded in the block.
+        size_t rendered_voices = 0;
+        
+        //! Sources culled to fit in the encoding budget (including the ones fading out).
+        size_t culled_voices = 0;
+        
+        //! Sources skipped because their input block is silent.
+        size_t silent_voices = 0;
+        
+        //! Measured encoding time of a harmonic of a source for a block, in microseconds.
+        float_t harmonic_cost = 0.f;
+    };
+    
+    //! @brief State of the HRIR set of an instance.
+    enum class HrirStatus : int
+    {
+        //! The built-in HRIR set is used.
+        Default = 0,
+        
+        //! An HRIR set is being loaded, the previous one is used in the meantime.
+        Loading = 1,
+        
+        //! The last HRIR set passed to loadHrir is used.
+        Loaded = 2,
+        
+        //! The last HRIR set passed to loadHrir could not be loaded, the previous one is used.
+        Failed = 3,
+    };
+    
     // ==================================================================================== //
     // Source
     // ==================================================================================== //
@@ -108,6 +306,9 @@ namespace HoaLibraryUnity
         
         CartesianCoordinate process();
         
+        //! @brief Advances the smoothing by a number of frames and returns the last value.
+        CartesianCoordinate process(size_t frames);
+    
     private:
         
         Line<float_t> m_x = {};
@@ -115,11 +316,26 @@ namespace HoaLibraryUnity
         Line<float_t> m_z = {};
     };
     
+    //! @brief A source encoded into the soundfield of an instance.
+    //! @details The encoding state (position smoothing, coefficients, order, optimization and
+    //! near-field filters) is owned by one thread at a time: the audio thread, or the spatializer
+    //! thread in EncodingMode::Spatializer. The audio thread hands it over at the end of a block
+    //! and the spatializer hands it back with the first block it does not encode, the other
+    //! thread only reads the atomic settings and the distance of the source.
     class Source
     {
     public:
         
-        Source(size_t order, size_t vectorsize);
+        //! @brief Constructor
+        //! @param order The maximum order of the source.
+        //! @param vectorsize The maximum number of frames of a block.
+        //! @param sample_rate The sample rate the time constants are computed at.
+        //! @param near_field The near-field filters of the instance (nullptr for none),
+        //! they must outlive the source.
+        //! @param encoded_inputs Allocates the harmonics of the input blocks,
+        //! so that the spatializer can encode them (EncodingMode::Spatializer).
+        Source(size_t order, size_t vectorsize, float_t sample_rate,
+               NearFieldFilters const* near_field = nullptr, bool encoded_inputs = false);
         ~Source();
         
         void setGain(float_t gain);
@@ -128,18 +344,213 @@ namespace HoaLibraryUnity
         
         void setOptim(int optim);
         
-        void setInterleavedBuffer(float_t const* inputs, size_t frames);
+        //! @brief Sets the priority of the source when the harmonics budget is exceeded.
+        void setPriority(float_t priority);
+        
+        //! @brief Returns the priority of the source.
+        float_t getPriority() const;
+        
+        //! @brief Encodes the source without its optimization (audio thread, adaptive quality).
+        //! @details It is applied by the thread that encodes the source with updateEncodingOrder.
+        void setOptimBypassed(bool bypassed);
+        
+        //! @brief Returns the distance of the source to the listener (any thread).
+        //! @details The smoothed distance at the end of the last block encoded or skipped.
+        float_t getDistance() const;
+        
+        //! @brief Sets the order the source is encoded at in block rate (any thread).
+        //! @details It is applied by the thread that encodes the source with updateEncodingOrder.
+        void setEncodingOrder(size_t order);
+        
+        //! @brief Applies the order passed to setEncodingOrder and the optimization passed
+        //! to setOptim and setOptimBypassed (thread that encodes the source).
+        void updateEncodingOrder();
+        
+        //! @brief Returns the number of harmonics the source touches during the current block
+        //! (the harmonics of its order and the ones of its previous order while it fades out).
+        size_t getEncodingHarmonics() const;
+        
+        //! @brief Returns the order passed to setEncodingOrder.
+        size_t getEncodingOrder() const;
+        
+        //! @brief Returns the RMS level of the current input block.
+        float_t getInputLevel() const noexcept { return m_input_level; }
+        
+        //! @brief Returns true if the peak of the current input block is under k_silence_threshold.
+        bool isSilent() const noexcept { return m_input_silent; }
+        
+        //! @brief Advances the position smoothing by a block without encoding (audio thread).
+        //! @details The coefficients restart without interpolation at the next encoded block.
+        void skipBlock();
+        
+        //! @brief Includes the source in the current block or culls it (audio thread, after acquireInput).
+        //! @details A culled source fades out during the first block it is culled, then it is not
+        //! encoded anymore but its position smoothing keeps running so that it fades back in
+        //! at the right place.
+        //! @return true if the source must be encoded in this block.
+        bool setCulled(bool culled);
+        
+        //! @brief Publishes the input block of a dsp tick (spatializer thread).
+        //! @param encoding_subblock_size If not 0, the block is also encoded here in block rate
+        //! with this sub-block size (EncodingMode::Spatializer).
+        //! @return false if a block was already published for this dsp tick.
+        bool setInterleavedBuffer(float_t const* inputs, size_t frames, dsptick_t dsptick,
+                                  size_t encoding_subblock_size = 0);
+        
+        //! @brief Picks up the input block of a dsp tick (audio thread).
+        //! @details The published block is used only if it is stamped with this tick,
+        //! or with the previous one when the spatializer runs after the renderer, a block
+        //! published again for the tick already acquired is used as well (it is not a gap).
+        //! Otherwise the previous block is faded out once, then the input is silent.
+        void acquireInput(dsptick_t dsptick, InputStatistics& statistics);
         
         void setPosition(float_t x, float_t y, float_t z);
         
+        //! @brief Sets the distance under which the source is widened (any thread).
+        //! @details Unity attenuates the sources farther than this distance, the encoder
+        //! widens the nearer ones. Only used with the near-field filters, without them
+        //! the sources are widened inside 1 meter.
+        void setMinDistance(float_t distance);
+        
+        //! @brief Returns the distance passed to setMinDistance.
+        float_t getMinDistance() const;
+        
+        //! @brief Returns the distance the encoder radius is relative to, the minimum
+        //! distance with the near-field filters, 1 meter without them.
+        float_t getEncoderDistance() const;
+        
+        //! @brief Returns true if the harmonics are filtered by near-field filters.
+        bool hasNearField() const noexcept { return m_near_field != nullptr; }
+        
+        //! @brief Copies the input block, the near-field filter coefficients for the current
+        //! distance and the filter states to a lane of a batch (audio thread).
+        //! @return The order the lane must be filtered at.
+        size_t gatherNearField(NearFieldBatch& batch, size_t lane, size_t frames);
+        
+        //! @brief Copies back the filter states of a lane once the batch was filtered.
+        //! @param outputs Copies the filtered signals too (the source encodes them itself).
+        void scatterNearField(NearFieldBatch const& batch, size_t lane, size_t frames, bool outputs);
+        
+        //! @brief Sets the near-field filters of the next blocks (audio thread, at the start of each block).
+        //! @details Applied here if the audio thread owns the encoding state, by the spatializer
+        //! at its next block otherwise. The filters must have the sections of the current ones,
+        //! the filter states are kept.
+        void setNearFieldFilters(NearFieldFilters const* near_field);
+        
+        //! @brief Returns true if the owner of the encoding state may still use these filters.
+        bool usesNearFieldFilters(NearFieldFilters const* near_field) const;
+        
+        //! @brief Sets the encoding mode (audio thread, at the start of each block).
+        //! @details Also takes the encoding state back if the spatializer returned it.
+        //! @param subblock_size Number of frames between two coefficients evaluations
+        //! (not used in EncodingMode::PerSample).
+        void setEncodingMode(EncodingMode mode, size_t subblock_size);
+        
+        //! @brief Returns true if the audio thread owns the encoding state in the current block.
+        //! @details Otherwise the source must not be encoded nor skipped by the audio thread,
+        //! its input is silent or encoded by the spatializer.
+        bool ownsEncodingState() const noexcept { return m_renderer_encoding; }
+        
+        //! @brief Hands the encoding state over to the spatializer (audio thread, end of a
+        //! block in EncodingMode::Spatializer), it encodes the next blocks.
+        void handOverEncodingState();
+        
         void process(harmonics_matrix_t& harmonics_matrix);
         
+        //! @brief Advances the position smoothing by a sub-block (block rate encoding).
+        //! @param frames Number of frames of the sub-block.
+        //! @param position Receives the position at the end of the sub-block.
+        //! @return true if the target coefficients must be updated for this position.
+        bool prepareSubBlock(size_t frames, CartesianCoordinate& position);
+        
+        //! @brief Sets the target coefficients of the sub-block.
+        //! @param coeffs The harmonics of a unit sample encoded at the sub-block position.
+        void setTargetCoefficients(float_t const* coeffs);
+        
+        //! @brief Computes the target coefficients for a position with the source encoder.
+        void computeTargetCoefficients(CartesianCoordinate const& position);
+        
+        //! @brief Encodes a sub-block, coefficients are interpolated toward the target.
+        void processSubBlock(size_t start, size_t frames, harmonics_matrix_t& harmonics_matrix);
+        
+        //! @brief Moves to the target coefficients without encoding (EncodingMode::Matrix).
+        //! @param coeffs Receives the coefficients at the start of the sub-block.
+        //! @param deltas Receives the target minus the start coefficients if they differ.
+        //! @return true if the coefficients must be interpolated (deltas was written).
+        bool advanceCoefficients(float_t* coeffs, float_t* deltas);
+        
+        //! @brief Returns the mono input buffer of the current block.
+        vector_t const& getInputBuffer() const { return m_mono_input_buffer; }
+        
+        //! @brief Returns true if the current block was encoded by the spatializer,
+        //! the source must then be added with addEncodedInput instead of being encoded.
+        bool hasEncodedInput() const noexcept { return m_input_encoded; }
+        
+        //! @brief Adds the soundfield of the current block encoded by the spatializer.
+        void addEncodedInput(harmonics_matrix_t& harmonics_matrix) const;
+    
+    private:
+        
+        void processPerSample(harmonics_matrix_t& harmonics_matrix);
+        
+        void processBlockRate(harmonics_matrix_t& harmonics_matrix);
+        
+        //! @brief Encodes an input block in block rate.
+        void encodeBlockRate(vector_t const& input, size_t subblock_size,
+                             harmonics_matrix_t& harmonics_matrix);
+        
+        //! @brief Encodes a sub-block of an input block.
+        void encodeSubBlock(vector_t const& input, size_t start, size_t frames,
+                            harmonics_matrix_t& harmonics_matrix);
+        
+        //! @brief Encodes a sub-block, each order from its near-field filtered input.
+        //! @details The coefficients are laid out block diagonally, (harmonics x orders),
+        //! so that all the orders are encoded by a single product.
+        void encodeNearFieldSubBlock(size_t start, size_t frames, harmonics_matrix_t& harmonics_matrix);
+        
+        //! @brief Encodes per sample, each order from its near-field filtered input.
+        void processNearFieldPerSample(harmonics_matrix_t& harmonics_matrix);
+        
+        //! @brief Returns the order of the near-field filters of the current block.
+        //! @param mode The mode the block is encoded in.
+        size_t getNearFieldOrder(EncodingMode mode) const;
+        
+        //! @brief Computes the near-field filter coefficients if the distance changed.
+        void updateNearFieldNumerators();
+        
+        //! @brief Switches to the filters passed by setNearFieldFilters (owner of the encoding state).
+        void applyNearFieldFilters(NearFieldFilters const* near_field);
+        
+        //! @brief Filters an input block with the near-field filters of the source alone.
+        void filterNearField(vector_t const& input, size_t frames);
+        
+        //! @brief Updates the encoder with a new cartesian position.
+        void updateEncoder(CartesianCoordinate const& position);
+        
+        //! @brief Publishes the distance of the smoothed position.
+        void updateDistance(CartesianCoordinate const& position);
+        
+        //! @brief Returns true if the optimization is applied to the coefficients.
+        bool isOptimApplied() const;
+        
+        //! @brief Starts from the target coefficients if they were never set.
+        void initializeCoefficients();
+        
+        //! @brief Computes the energy preserving max-rE weights of the encoding order.
+        void computeOrderWeights();
+        
+        //! @brief Applies a fade to the current block (in: 0 to 1, out: 1 to 0).
+        void fadeInput(bool fade_in);
+    
     private:
         
+        const size_t m_max_order;
         float_t m_gain = 1.f;
         float_t m_pan = 0.f;
+        std::atomic<float_t> m_priority {1.f};
         
         SmoothedCartesianCoordinate m_smoothed_position {};
+        std::atomic<float_t> m_distance {0.f};
         
         using encoder_t = hoa::Encoder<hoa::Hoa3d, float_t>;
         using optim_t = hoa::Optim<hoa::Hoa3d, float_t>;
@@ -147,9 +558,306 @@ namespace HoaLibraryUnity
         
         encoder_t m_encoder;
         optim_t m_optim;
+        std::atomic<int> m_requested_optim {static_cast<int>(optim_mode_t::Basic)};
+        std::atomic<bool> m_optim_bypassed {false};
+        bool m_optim_bypass_applied = false;
+        
+        // owner of the encoding state, true for the spatializer thread.
+        const bool m_encoded_inputs;
+        std::atomic<bool> m_spatializer_encoding {false};
+        bool m_renderer_encoding = true;    // the audio thread owns it in the current block
+        
+        // input blocks handoff
+        struct InputBlock
+        {
+            vector_t samples {};
+            harmonics_matrix_t harmonics {};    // allocated with the source if its inputs can be encoded
+            size_t num_harmonics = 0;           // encoded rows of harmonics
+            dsptick_t dsptick = 0;
+            bool encoded = false;
+            bool silent = true;
+            float_t level = 0.f;                // RMS
+        };
+        
+        enum class InputState
+        {
+            Idle,
+            Playing,
+            Concealed,
+        };
+        
+        TripleBuffer<InputBlock> m_input_blocks;
+        dsptick_t m_last_published_tick = 0;
+        bool m_has_published = false;
+        dsptick_t m_last_acquired_tick = 0;
+        bool m_has_acquired = false;
+        InputState m_input_state = InputState::Idle;
+        bool m_input_encoded = false;
+        bool m_encoded_available = false;   // the read block holds the harmonics to add
+        float_t m_input_level = 0.f;
+        bool m_input_silent = true;
+        
+        // fades of the encoded harmonics (concealment and culling)
+        vector_t m_encoded_gains {};
+        bool m_encoded_faded = false;
+        
+        // culling
+        bool m_culled = false;
         
         vector_t m_mono_input_buffer {};
         vector_t m_temp_harmonics {};
+        
+        // block rate encoding
+        EncodingMode m_encoding_mode = EncodingMode::PerSample;
+        size_t m_subblock_size = k_default_encoding_subblock_size;
+        vector_t m_coeffs {};
+        vector_t m_target_coeffs {};
+        vector_t m_ramped_input {};
+        CartesianCoordinate m_coeffs_position {};
+        bool m_coeffs_dirty = true;
+        bool m_coeffs_initialized = false;
+        bool m_target_changed = false;
+        
+        // order level of detail
+        std::atomic<size_t> m_requested_order {0};
+        size_t m_order = 0;
+        size_t m_order_harmonics = 0;       // harmonics of m_order
+        size_t m_coeffs_harmonics = 0;      // non-zero rows of m_coeffs
+        size_t m_target_harmonics = 0;      // non-zero rows of m_target_coeffs
+        vector_t m_order_weights {};
+        
+        // near field
+        std::atomic<float_t> m_min_distance {1.f};
+        NearFieldFilters const* m_near_field_filters = nullptr;
+        std::atomic<NearFieldFilters const*> m_next_near_field_filters {nullptr};
+        std::atomic<NearFieldFilters const*> m_used_near_field_filters {nullptr};
+        std::unique_ptr<NearFieldBatch> m_near_field = nullptr;
+        signal_matrix_t m_near_field_signals {};    // (orders x frames) the input, then filtered by each order
+        signal_matrix_t m_near_field_ramped {};
+        harmonics_matrix_t m_near_field_coeffs {};  // (harmonics x orders) block diagonal
+        harmonics_matrix_t m_near_field_deltas {};
+        float_t m_near_field_distance = -1.f;
+        size_t m_near_field_order = 0;
+    };
+    
+    // ==================================================================================== //
+    // Bed
+    // ==================================================================================== //
+    
+    //! @brief Converts AmbiX channels (ACN ordering, SN3D normalization) to the harmonics
+    //! of the library: a harmonic is a scaled AmbiX channel of the same degree.
+    struct AmbixConversion
+    {
+        std::vector<size_t> channels {};    // per harmonic, its AmbiX channel
+        std::vector<float_t> scales {};     // per harmonic, its scale
+    };
+    
+    //! @brief A pre-encoded ambisonic stream added as is to the soundfield of the instance.
+    //! @details The stream is converted to the library harmonics while it is handed over
+    //! to the audio thread, the renderer then adds it to the soundfield with one matrix add.
+    class Bed
+    {
+    public:
+        
+        //! @brief Constructor
+        //! @param conversion The conversion of the AmbiX channels, for the order of the instance.
+        //! @param vectorsize The maximum number of frames of a block.
+        Bed(AmbixConversion const& conversion, size_t vectorsize);
+        
+        ~Bed() = default;
+        
+        void setGain(float_t gain);
+        
+        //! @brief Publishes the input block of a dsp tick (decoder thread).
+        //! @details The channels above the order of the instance are ignored,
+        //! the harmonics above the order of the stream are silent.
+        //! @param inputs Interleaved AmbiX channels.
+        //! @param channels The number of channels of the stream.
+        //! @return false if a block was already published for this dsp tick.
+        bool setInterleavedBuffer(float_t const* inputs, size_t channels, size_t frames,
+                                  dsptick_t dsptick);
+        
+        //! @brief Picks up the input block of a dsp tick (audio thread).
+        //! @details Same rules as Source::acquireInput, a missing block fades out the previous one.
+        void acquireInput(dsptick_t dsptick, InputStatistics& statistics);
+        
+        //! @brief Returns true if the bed has something to add in the current block.
+        bool isActive() const noexcept { return m_input_state != InputState::Idle; }
+        
+        //! @brief Adds the current block to a soundfield (audio thread).
+        void addInput(harmonics_matrix_t& harmonics_matrix) const;
+    
+    private:
+        
+        AmbixConversion const m_conversion;
+        float_t m_gain = 1.f;
+        
+        // input blocks handoff
+        struct InputBlock
+        {
+            harmonics_matrix_t harmonics {};
+            size_t num_harmonics = 0;           // non-zero rows of harmonics
+            dsptick_t dsptick = 0;
+        };
+        
+        enum class InputState
+        {
+            Idle,
+            Playing,
+            Concealed,
+        };
+        
+        TripleBuffer<InputBlock> m_input_blocks;
+        dsptick_t m_last_published_tick = 0;
+        bool m_has_published = false;
+        dsptick_t m_last_acquired_tick = 0;
+        bool m_has_acquired = false;
+        InputState m_input_state = InputState::Idle;
+        vector_t m_fade_out {};
+    };
+    
+    // ==================================================================================== //
+    // SourcesEncoder
+    // ==================================================================================== //
+    
+    //! @brief Encodes a group of sources into a soundfield.
+    //! @details Owns all the buffers needed to encode at most max_sources sources,
+    //! so that several groups can be encoded at the same time.
+    //! The sources already encoded by the spatializer are only summed.
+    class SourcesEncoder
+    {
+    public:
+        
+        //! @brief Constructor
+        //! @param batched_encoder A BatchedEncoder of the order, copied with its calibration.
+        //! @param near_field The near-field filters of the sources, nullptr if not used.
+        SourcesEncoder(size_t max_sources, size_t vectorsize, size_t order,
+                       BatchedEncoder const& batched_encoder,
+                       NearFieldFilters const* near_field = nullptr);
+        ~SourcesEncoder() = default;
+        
+        //! @brief Adds the encoded sources to a soundfield.
+        //! @param sources Array of count sources.
+        //! @param mode The encoding mode.
+        //! @param subblock_size Number of frames between two coefficients evaluations.
+        //! @param soundfield (harmonics x frames) soundfield.
+        void process(Source* const* sources, size_t count,
+                     EncodingMode mode, size_t subblock_size,
+                     harmonics_matrix_t& soundfield);
+        
+        //! @brief Returns true if the coefficients are evaluated by the BatchedEncoder,
+        //! false if its calibration failed and each source evaluates its own.
+        bool isBatched() const noexcept { return m_batched_encoder.isValid(); }
+        
+        //! @brief Replaces the near-field filters by filters with the same sections.
+        void setNearFieldFilters(NearFieldFilters const* near_field);
+    
+    private:
+        
+        //! @brief Advances the sources by a sub-block and updates the target
+        //! coefficients of the moving ones, evaluated together by the BatchedEncoder.
+        void updateTargetCoefficients(Source* const* sources, size_t count, size_t frames);
+        
+        //! @brief Encodes the sources in EncodingMode::BlockRate.
+        void processBlockRate(Source* const* sources, size_t count,
+                              size_t subblock_size, harmonics_matrix_t& soundfield);
+        
+        //! @brief Encodes the sources in EncodingMode::Matrix.
+        //! @details The sources must be sorted by decreasing number of encoding harmonics.
+        void processMatrix(Source* const* sources, size_t count,
+                           size_t subblock_size, harmonics_matrix_t& soundfield);
+        
+        //! @brief Adds the near-field filtered signals of the sources to a sub-block
+        //! in EncodingMode::Matrix, one product per order.
+        //! @details The deltas are not packed: the column of a static source is zero.
+        template<class SubBlock>
+        void addNearFieldProducts(size_t num_sources, bool moving, size_t start, size_t size,
+                                  SubBlock& subblock);
+        
+        //! @brief Filters the inputs of the sources by their near-field filters, all together.
+        //! @details The sources must be sorted by decreasing number of encoding harmonics.
+        //! @param scatter_outputs Copies the filtered signals back to the sources.
+        void filterNearField(Source* const* sources, size_t count, size_t frames, bool scatter_outputs);
+        
+        //! @brief Sorts the sources to encode by decreasing order (stable counting sort).
+        void sortEncodingSources(size_t count);
+        
+        //! @brief Adds the product of (harmonics x count) coefficients by (count x frames) signals
+        //! to a sub-block, each column only touching the harmonics of its source.
+        template<class Signals, class SubBlock>
+        void addProduct(harmonics_matrix_t const& coeffs, Signals const& signals,
+                        size_t const* harmonics, size_t count, SubBlock& subblock);
+    
+    private:
+        
+        const size_t m_order;
+        const size_t m_num_harmonics;
+        
+        // sources left to encode
+        std::vector<Source*> m_encoding_sources {};
+        std::vector<Source*> m_sorted_sources {};
+        std::vector<size_t> m_order_counts {};
+        std::vector<size_t> m_source_harmonics {};
+        std::vector<size_t> m_moving_harmonics {};
+        
+        // batched coefficients evaluation (structure of arrays)
+        BatchedEncoder m_batched_encoder;
+        std::vector<Source*> m_batch_sources {};
+        std::vector<float_t> m_batch_x {};
+        std::vector<float_t> m_batch_y {};
+        std::vector<float_t> m_batch_z {};
+        harmonics_matrix_t m_batch_coeffs;
+        
+        // matrix encoding
+        harmonics_matrix_t m_encoding_coeffs;
+        harmonics_matrix_t m_encoding_deltas;
+        signal_matrix_t m_signal_matrix;
+        signal_matrix_t m_ramped_signal_matrix;
+        vector_t m_ramp;
+        
+        // near-field filters of all the sources
+        NearFieldFilters const* m_near_field_filters = nullptr;
+        std::unique_ptr<NearFieldBatch> m_near_field {};
+        harmonics_matrix_t m_near_field_products;
+    };
+    
+    // ==================================================================================== //
+    // ParallelEncoder
+    // ==================================================================================== //
+    
+    //! @brief Encodes the sources, with the help of a WorkerPool or not.
+    //! @details The sources are split in k_num_encoding_chunks contiguous chunks, each one
+    //! encoded by its own SourcesEncoder into its own partial soundfield. The partial
+    //! soundfields are then summed in chunk order, with or without workers, the result is
+    //! bit-identical whatever the number of threads and whichever thread encoded a chunk.
+    class ParallelEncoder
+    {
+    public:
+        
+        //! @brief Constructor
+        //! @param batched_encoder A BatchedEncoder of the order, copied by each chunk.
+        //! @param near_field The near-field filters of the sources, nullptr if not used.
+        ParallelEncoder(size_t max_sources, size_t vectorsize, size_t order,
+                        BatchedEncoder const& batched_encoder,
+                        NearFieldFilters const* near_field = nullptr);
+        ~ParallelEncoder() = default;
+        
+        //! @brief Adds the encoded sources to a soundfield.
+        //! @param pool The workers sharing the chunks, nullptr to encode them on the calling thread.
+        void process(std::vector<Source*> const& sources,
+                     EncodingMode mode, size_t subblock_size,
+                     harmonics_matrix_t& soundfield, WorkerPool* pool);
+        
+        //! @brief Returns true if the coefficients are evaluated by the BatchedEncoder.
+        bool isBatched() const noexcept { return m_encoders.front()->isBatched(); }
+        
+        //! @brief Replaces the near-field filters of all the chunks (not while encoding).
+        void setNearFieldFilters(NearFieldFilters const* near_field);
+    
+    private:
+        
+        std::vector<std::unique_ptr<SourcesEncoder>> m_encoders {};
+        std::vector<harmonics_matrix_t> m_partial_soundfields {};
     };
     
     // ==================================================================================== //
@@ -161,18 +869,24 @@ namespace HoaLibraryUnity
     {
     public:
         
-        using source_id_t = int;
+        using source_registry_t = SlotRegistry<Source>;
+        using source_id_t = source_registry_t::handle_t;
+        using bed_registry_t = SlotRegistry<Bed>;
+        using bed_id_t = bed_registry_t::handle_t;
         
         //! @brief Constructor
         //! @details Use the CreateHoaLibraryApi instead.
-        HoaLibraryApi(size_t vectorsize);
+        HoaLibraryApi(ApiSettings const& settings);
         
         // Destructor
         ~HoaLibraryApi();
         
         // Invalid source id that can be used to initialize handler variables during
         // class construction.
-        static const source_id_t invalid_source_id = -1;
+        static const source_id_t invalid_source_id = source_registry_t::invalid_handle;
+        
+        // Invalid bed id.
+        static const bed_id_t invalid_bed_id = bed_registry_t::invalid_handle;
         
         //! @brief Sets the master gain of the main audio output.
         //! @param volume Master volume (linear) in amplitude in range [0, 1] for
@@ -181,27 +895,76 @@ namespace HoaLibraryUnity
         
         //! @brief Renders and outputs an interleaved output buffer in float format.
         //! @param num_frames Size of output buffer in frames.
-        //! @param num_channels Number of channels in output buffer.
         //! @param buffer_ptr Raw float pointer to audio buffer.
+        //! @param dsptick Sample counter marking the start of the block.
         //! @return True if a valid output was successfully rendered, false otherwise.
-        bool fillInterleavedOutputBuffer(size_t num_frames, float_t* buffer_ptr);
+        bool fillInterleavedOutputBuffer(size_t num_frames, float_t* buffer_ptr, dsptick_t dsptick);
+        
+        //! @brief Renders the soundfield without decoding it, in AmbiX format.
+        //! @details The harmonics are output in ACN ordering with SN3D normalization,
+        //! the channels above the harmonics of the order are silent and the harmonics
+        //! above the number of channels are dropped.
+        //! @param num_frames Size of output buffer in frames.
+        //! @param num_channels Number of interleaved channels of the output buffer.
+        //! @param buffer_ptr Raw float pointer to audio buffer.
+        //! @param dsptick Sample counter marking the start of the block.
+        //! @return false if the harmonics can't be converted to AmbiX (nothing is rendered).
+        bool fillInterleavedAmbisonicBuffer(size_t num_frames, size_t num_channels,
+                                            float_t* buffer_ptr, dsptick_t dsptick);
+        
+        //! @brief Renders the soundfield decoded to the loudspeaker layout of the settings.
+        //! @details The speakers are output in the order of the layout, the channels above
+        //! the speakers are silent and the speakers above the number of channels are dropped.
+        //! @param num_frames Size of output buffer in frames.
+        //! @param num_channels Number of interleaved channels of the output buffer.
+        //! @param buffer_ptr Raw float pointer to audio buffer.
+        //! @param dsptick Sample counter marking the start of the block.
+        //! @return false if the instance has no speaker decoder (nothing is rendered).
+        bool fillInterleavedSpeakerBuffer(size_t num_frames, size_t num_channels,
+                                          float_t* buffer_ptr, dsptick_t dsptick);
+        
+        //! @brief Returns the number of speakers of the speaker output (0 if it has none).
+        size_t getNumberOfSpeakers() const noexcept
+        {
+            return m_speaker_decoder ? m_speaker_decoder->getNumberOfSpeakers() : 0;
+        }
+        
+        //! @brief Sets the crossover frequency of the dual-band speaker decoder (any thread).
+        //! @details Applied at the start of the next block, the decoder is kept (see
+        //! SpeakerDecoder::setCrossover). No effect without speaker output.
+        void setSpeakerCrossover(float_t frequency);
+        
+        //! @brief Sets the radius the soundfield is reproduced at (see NearFieldSettings::radius).
+        //! @details Must not be called from the audio thread. Only the near-field filters are
+        //! built again, they are handed over to the audio thread at the start of the next block
+        //! and the sources keep their filter states. The replaced filters are freed by a later
+        //! call or with the instance, once no source uses them. No effect without near-field
+        //! compensation.
+        void setNearFieldRadius(float_t radius);
         
         //! @brief Creates a sound object source instance.
-        //! @param rendering_mode Rendering mode which governs quality and performance.
-        //! @return Id of new source.
+        //! @details Can be called from any thread, the source is rendered from the next block.
+        //! @return Id of new source, or invalid_source_id if there are too many sources.
         source_id_t createSource();
         
         //! @brief Destroys source instance.
+        //! @details Can be called from any thread, the id is invalid as soon as this returns.
         //! @param source_id Id of source to be destroyed.
         void destroySource(source_id_t source_id);
         
+        //! @brief Returns true if the source exists.
+        bool isSourceValid(source_id_t source_id) const;
+        
         //! @brief Sets the next audio buffer in interleaved float format to a sound source.
+        //! @details In EncodingMode::Spatializer, the buffer is also encoded here.
         //! @param source_id Id of sound source.
         //! @param audio_buffer_ptr Pointer to interleaved float audio buffer.
         //! @param num_frames Number of frames per channel (assumed stereo) in interleaved audio buffer.
+        //! @param dsptick Sample counter marking the start of the block.
         void setInterleavedSourceBuffer(source_id_t source_id,
                                         float_t const* audio_buffer_ptr,
-                                        size_t num_frames);
+                                        size_t num_frames,
+                                        dsptick_t dsptick);
         
         //! @brief Sets the given source's position.
         //! @param source_id Id of source.
@@ -222,18 +985,343 @@ namespace HoaLibraryUnity
         //! @brief Sets the source optimization.
         void setSourceOptim(source_id_t source_id, int optim);
         
+        //! @brief Sets the source priority, the sources with the highest priority keep
+        //! their order when the harmonics budget is exceeded.
+        void setSourcePriority(source_id_t source_id, float_t priority);
+        
+        //! @brief Sets the source minimum distance (Unity's minDistance), the source
+        //! is widened inside it and attenuated by Unity outside of it.
+        void setSourceMinDistance(source_id_t source_id, float_t distance);
+        
+        //! @brief Creates an ambisonic bed (any thread, see Bed).
+        //! @details The beds are rotated by the listener orientation (setListenerOrientation).
+        //! @return Id of the new bed, or invalid_bed_id if there are too many beds
+        //! or if the harmonics of the instance can't be converted from AmbiX.
+        bed_id_t createBed();
+        
+        //! @brief Destroys an ambisonic bed (any thread).
+        void destroyBed(bed_id_t bed_id);
+        
+        //! @brief Returns true if the bed exists.
+        bool isBedValid(bed_id_t bed_id) const;
+        
+        //! @brief Sets the next block of a bed.
+        //! @param bed_id Id of the bed.
+        //! @param inputs Interleaved AmbiX channels (ACN ordering, SN3D normalization).
+        //! @param channels Number of channels of the stream, (order + 1)^2 for any order.
+        //! @param num_frames Number of frames.
+        //! @param dsptick Sample counter marking the start of the block.
+        void setInterleavedBedBuffer(bed_id_t bed_id, float_t const* inputs, size_t channels,
+                                     size_t num_frames, dsptick_t dsptick);
+        
+        //! @brief Sets the linear gain of a bed.
+        void setBedGain(bed_id_t bed_id, float_t gain);
+        
+        //! @brief Sets the level of detail of the order of the sources.
+        void setOrderLod(OrderLodSettings const& settings);
+        
+        //! @brief Returns the ambisonic order of the instance.
+        size_t getOrder() const noexcept { return m_order; }
+        
+        //! @brief Returns the sample rate of the instance.
+        float_t getSampleRate() const noexcept { return m_sample_rate; }
+        
+        //! @brief Sets the encoding mode of all sources.
+        //! @param mode The encoding mode.
+        //! @param subblock_size Number of frames between two coefficients evaluations
+        //! in EncodingMode::BlockRate and EncodingMode::Matrix
+        //! (a value of 0 means once per block).
+        void setEncodingMode(EncodingMode mode,
+                             size_t subblock_size = k_default_encoding_subblock_size);
+        
+        //! @brief Sets the number of threads helping the audio thread to encode the sources.
+        //! @details Must not be called from the audio thread, the threads are created here
+        //! and handed over to the audio thread at the start of the next block. The encoders
+        //! are kept, only the WorkerPool is replaced and only if the settings changed.
+        //! @param num_threads Number of worker threads (0 to encode on the audio thread only).
+        //! @param pin_threads Pins each worker thread to its own core (linux only).
+        void setWorkerThreads(size_t num_threads, bool pin_threads);
+        
+        //! @brief Returns the input blocks counters since the creation of the instance.
+        InputStatistics getInputStatistics() const;
+        
+        //! @brief Sets the time budget of the encoding of the sources per block.
+        //! @details The sources are ranked by input level times priority, the first one is always
+        //! encoded, each of the next ones only if it still fits in the budget. The cost of a source is predicted from the
+        //! measured encoding time of a harmonic and the number of harmonics of its order.
+        //! @param microseconds The budget (0 for no limit).
+        void setEncodingBudget(float_t microseconds);
+        
+        //! @brief Returns the counts of the voices scheduled in the last block.
+        VoiceStatistics getVoiceStatistics() const;
+        
+        //! @brief Returns the DSP load metrics of the rendered blocks (any thread but the audio thread).
+        //! @details Published by the audio thread every few blocks, see MetricsRecorder, with the
+        //! current input blocks counters and voices counts (see getInputStatistics and
+        //! getVoiceStatistics).
+        DspMetrics getDspMetrics() const;
+        
+        //! @brief Sets the adaptive quality (any thread).
+        //! @details The load of each block is measured against its period by a QualityController.
+        //! Under pressure the quality steps down through the QualityLevel steps: the low priority
+        //! sources lose their optimization then one order, the binaural decoder drops the highest
+        //! order over a crossfade of one block, then the encoding budget is cut below the measured
+        //! encoding time. It steps back up once the load stays low. Applied at the start of the
+        //! next block. Disabled by default.
+        void setQualitySettings(QualitySettings const& settings);
+        
+        //! @brief Returns the last adaptive quality decisions (any thread but the audio thread).
+        QualityLog getQualityLog() const;
+        
+        //! @brief Decodes with an HRIR set instead of the built-in one.
+        //! @details Must not be called from the audio thread. The decoding filters are read
+        //! from the cache, or computed and cached, on a background thread, then the audio
+        //! thread crossfades to the new decoder over one block. Does not wait: a set requested
+        //! while another one is loading is loaded next, it replaces the previous requests.
+        //! @param path The HRIR set file (see HrirSet).
+        //! @param cache_directory The directory of the decoding filters cache (empty for no cache).
+        void loadHrir(std::string const& path, std::string const& cache_directory);
+        
+        //! @brief Returns the state of the HRIR set.
+        HrirStatus getHrirStatus() const;
+        
+        //! @brief Returns true if the sources positions are given in the world frame.
+        //! @details False if world_frame was not set or the rotation is not available.
+        bool isWorldFrame() const noexcept { return m_world_frame && m_rotation != nullptr; }
+        
+        //! @brief Sets the orientation of the listener in the world frame (any thread).
+        //! @details Only used in world frame, the rotation is interpolated over the next block.
+        void setListenerOrientation(Quaternion const& orientation);
+        
+        //! @brief Sets the orientation of the head relative to the listener (any thread, wait-free).
+        //! @details Meant for a tracker thread publishing at its own rate, the latest orientation
+        //! is read at each head tracking sub-block and the rotation is interpolated over it,
+        //! so that the head motion reaches the output within a sub-block.
+        //! It is composed with the listener orientation in world frame.
+        void setHeadOrientation(Quaternion const& orientation);
+        
+        //! @brief Sets the number of frames between two readings of the head orientation.
+        //! @param subblock_size The number of frames (0 for once per block).
+        void setHeadTrackingSubblockSize(size_t subblock_size);
+    
+    private:
+        
+        //! @brief Encodes, sums and rotates the soundfield of a block (audio thread).
+        void renderSoundfield(size_t frames, dsptick_t dsptick);
+        
+        //! @brief Records the timings of a rendered block (audio thread).
+        //! @param start The start of the block.
+        //! @param decode_start The end of renderSoundfield.
+        void recordMetrics(size_t frames, std::chrono::steady_clock::time_point start,
+                           std::chrono::steady_clock::time_point decode_start);
+        
+        //! @brief Picks up the WorkerPool passed by setWorkerThreads (audio thread).
+        void updateWorkerPool();
+        
+        //! @brief Picks up the filters passed by setNearFieldRadius, retires the previous
+        //! ones once no source uses them (audio thread).
+        void updateNearField(std::vector<Source*> const& sources);
+        
+        //! @brief Chooses the order of each source from its distance, its priority
+        //! and the harmonics budget (audio thread).
+        void updateEncodingOrders(std::vector<Source*> const& sources);
+        
+        //! @brief Returns the order of a source at a distance.
+        size_t getDistanceOrder(float_t distance, float_t lod_distance, size_t min_order) const;
+        
+        //! @brief Chooses the sources encoded in the block to fit in the encoding budget (audio thread).
+        //! @return The sources to encode.
+        std::vector<Source*> const& scheduleVoices(std::vector<Source*> const& sources);
+        
+        //! @brief Updates the measured cost of a harmonic (audio thread).
+        void updateHarmonicCost(std::vector<Source*> const& sources, double microseconds);
+        
+        //! @brief Picks up the settings passed by setQualitySettings (audio thread).
+        void updateQualitySettings();
+        
+        //! @brief Updates the quality level with the load of a block (audio thread).
+        void updateQuality(double block_us, double period_us);
+        
+        //! @brief Returns true if a source is degraded first by the adaptive quality.
+        bool isLowPriority(Source const& source) const;
+        
+        //! @brief Builds the partitioned decoder from the responses of the library decoder.
+        //! @details It is kept only if it gives the same output as the library decoder,
+        //! then its filters are resampled to the sample rate of the instance if needed, once
+        //! per sample rate for all the instances. The failures are logged: the library decoder
+        //! is used at the sample rate of the built-in HRIR set, the binaural output is silent
+        //! at the other ones.
+        void preparePartitionedDecoder(size_t partition_size);
+        
+        //! @brief Rotates the soundfield by the listener and head orientations (audio thread).
+        //! @details The orientations are read again at each head tracking sub-block.
+        void rotateSoundfield(size_t frames);
+        
+        //! @brief Picks up the orientations published since the last call (audio thread).
+        void updateRotation();
+        
+        //! @brief Picks up the blocks of the beds and sums them in m_bed_matrix (audio thread).
+        //! @return true if a bed was added to m_bed_matrix.
+        bool acquireBeds(dsptick_t dsptick, InputStatistics& statistics);
+        
+        //! @brief Decodes the soundfield of the block.
+        void decode(Eigen::Map<stereo_matrix_t> outputs);
+        
+        //! @brief Loads the HRIR sets requested by loadHrir until there is no request left,
+        //! frees the replaced decoders (HRIR loader thread).
+        void runHrirLoader();
+        
+        //! @brief Returns true if another HRIR set was requested or the instance is destroyed.
+        bool isHrirLoaderInterrupted();
+        
+        //! @brief Picks up the decoder passed by loadHrir and crossfades to it (audio thread).
+        //! @return true if the outputs were decoded.
+        bool updateDecoder(Eigen::Map<stereo_matrix_t> outputs);
+    
     private:
         
+        // a WorkerPool handed over to the audio thread (nullptr to stop using workers).
+        struct WorkerPoolSwap
+        {
+            std::unique_ptr<WorkerPool> pool = nullptr;
+        };
+        
+        // a decoder handed over to the audio thread.
+        struct DecoderSwap
+        {
+            std::unique_ptr<PartitionedConvolver> decoder = nullptr;
+        };
+        
         const size_t m_vectorsize;
+        const float_t m_sample_rate;
+        const size_t m_max_sources;
+        const size_t m_order;
+        const size_t m_num_harmonics;
         
-        // Incremental source id counter.
-        std::atomic<source_id_t> m_source_id_counter {0};
-        std::unordered_map<source_id_t, std::unique_ptr<Source>> m_sources;
+        // Sources, created and destroyed through lock-free commands applied on the audio thread.
+        source_registry_t m_sources;
+        
+        // Ambisonic beds, created and destroyed like the sources.
+        bed_registry_t m_beds;
+        AmbixConversion m_ambix_conversion {};
+        harmonics_matrix_t m_bed_matrix;
+        bool m_beds_active = false;
         
         float_t m_master_gain = 1.f;
         
+        // input blocks counters
+        std::atomic<uint64_t> m_concealed_blocks {0};
+        std::atomic<uint64_t> m_duplicated_blocks {0};
+        std::atomic<uint64_t> m_dropped_blocks {0};
+        
+        // also read by the spatializer threads
+        std::atomic<EncodingMode> m_encoding_mode {EncodingMode::PerSample};
+        std::atomic<size_t> m_encoding_subblock_size {k_default_encoding_subblock_size};
+        
+        // order level of detail
+        struct LodRank
+        {
+            float_t priority;
+            float_t distance;
+            Source* source;
+        };
+        
+        std::atomic<float_t> m_lod_distance {0.f};
+        std::atomic<size_t> m_lod_harmonics_budget {0};
+        std::atomic<size_t> m_lod_min_order {1};
+        std::vector<LodRank> m_lod_ranks {};
+        
+        // sources with a non-silent input
+        std::vector<Source*> m_active_sources {};
+        std::atomic<size_t> m_silent_voices {0};
+        
+        // voices scheduling
+        struct VoiceRank
+        {
+            float_t score;
+            size_t harmonics;
+            Source* source;
+        };
+        
+        std::atomic<float_t> m_encoding_budget {0.f};
+        std::vector<VoiceRank> m_voice_ranks {};
+        std::vector<Source*> m_rendered_sources {};
+        double m_harmonic_cost = 0.;
+        std::atomic<size_t> m_rendered_voices {0};
+        std::atomic<size_t> m_culled_voices {0};
+        std::atomic<float_t> m_measured_harmonic_cost {0.f};
+        
+        // DSP load metrics
+        MetricsRecorder m_metrics {};
+        double m_encode_time = 0.;  // microseconds encoding the sources of the block
+        size_t m_encoded_sources = 0;
+        
+        // adaptive quality, the settings are published by any thread.
+        QualityController m_quality {};
+        SeqLock<QualitySettings> m_quality_settings {};
+        uint32_t m_quality_version = 0;
+        double m_quality_budget = 0.;   // microseconds of encoding kept by the culling levels (0 for none)
+        
+        // shared by the sources and the encoders, nullptr without near-field compensation.
+        // The filters built at construction are kept, the new sources use them until their
+        // first block, the others are created and deleted outside of the audio thread.
+        std::unique_ptr<NearFieldFilters> m_near_field_filters = nullptr;
+        std::unique_ptr<NearFieldFilters> m_swapped_near_field = nullptr;   // current if not the first ones
+        std::unique_ptr<NearFieldFilters> m_previous_near_field = nullptr;  // still used by a source
+        std::atomic<NearFieldFilters*> m_pending_near_field {nullptr};
+        std::atomic<NearFieldFilters*> m_retired_near_field {nullptr};
+        std::mutex m_near_field_mutex {};
+        float_t m_speakers_radius = 0.f;    // the farthest speaker of the layout (0 for none)
+        float_t m_near_field_max_boost = 0.f;
+        
+        // calibrated once, copied by the encoders.
+        BatchedEncoder m_batched_encoder;
+        ParallelEncoder m_encoder;
+        
+        // parallel encoding, the swaps are created and deleted outside of the audio thread.
+        std::unique_ptr<WorkerPool> m_worker_pool = nullptr;
+        std::atomic<WorkerPoolSwap*> m_pending_swap {nullptr};
+        std::atomic<WorkerPoolSwap*> m_retired_swap {nullptr};
+        std::mutex m_swap_mutex {};
+        size_t m_worker_threads = 0;    // last settings passed, guarded by m_swap_mutex
+        bool m_pin_worker_threads = false;
+        
         harmonics_matrix_t m_soundfield_matrix;
+        
+        // world frame and head tracking, the orientations are published by any thread.
+        const bool m_world_frame;
+        std::unique_ptr<SoundfieldRotation> m_rotation = nullptr;
+        std::unique_ptr<SoundfieldRotation> m_bed_rotation = nullptr;    // beds, out of world frame
+        SeqLock<Quaternion> m_listener_orientation {};
+        SeqLock<Quaternion> m_head_orientation {};
+        uint32_t m_listener_version = 0;
+        uint32_t m_head_version = 0;
+        Eigen::Matrix3d m_listener_rotation = Eigen::Matrix3d::Identity();
+        Eigen::Matrix3d m_head_rotation = Eigen::Matrix3d::Identity();
+        std::atomic<size_t> m_head_subblock_size {k_default_head_tracking_subblock_size};
+        
+        // loudspeaker output, built at construction.
+        std::unique_ptr<SpeakerDecoder> m_speaker_decoder = nullptr;
+        std::atomic<float_t> m_speaker_crossover {0.f};
+        float_t m_applied_crossover = 0.f;
+        
+        harmonics_matrix_t m_decoder_inputs;    // soundfield padded to the HRIR order
         decoder_t m_decoder;
+        std::unique_ptr<PartitionedConvolver> m_partitioned_decoder = nullptr;
+        size_t m_decoder_partition_size = 0;
+        
+        // HRIR sets, the swaps are created and deleted outside of the audio thread.
+        std::atomic<DecoderSwap*> m_pending_decoder {nullptr};
+        std::atomic<DecoderSwap*> m_retired_decoder {nullptr};
+        std::atomic<HrirStatus> m_hrir_status {HrirStatus::Default};
+        std::mutex m_hrir_mutex {};             // guards the request and the loader state
+        std::string m_hrir_path {};
+        std::string m_hrir_cache_directory {};
+        bool m_hrir_requested = false;          // a set waits for the loader
+        bool m_hrir_loading = false;            // the loader thread runs
+        bool m_hrir_stopping = false;           // the instance is destroyed
+        std::thread m_hrir_loader {};
+        stereo_matrix_t m_fade_outputs;         // outputs of the previous decoder
     };
 }
 
@@ -0,0 +1,432 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#include "HoaLibraryDecoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace HoaLibraryUnity
+{
+    namespace
+    {
+        //! @brief Multiplies two sizes.
+        //! @return false if the product overflows.
+        bool multiply_sizes(size_t a, size_t b, size_t& product)
+        {
+            if(a != 0 && b > std::numeric_limits<size_t>::max() / a)
+                return false;
+            
+            product = a * b;
+            return true;
+        }
+    }
+    
+    // ==================================================================================== //
+    // PartitionedConvolver
+    // ==================================================================================== //
+    
+    PartitionedConvolver::PartitionedConvolver(size_t partition_size,
+                                               matrix_t const& left, matrix_t const& right,
+                                               bool detect_symmetry)
+    : m_partition_size(partition_size)
+    , m_fft_size(2 * partition_size)
+    , m_num_bins(partition_size + 1)
+    , m_num_inputs(static_cast<size_t>(left.rows()))
+    , m_active_inputs(m_num_inputs)
+    , m_target_inputs(m_num_inputs)
+    {
+        assert(partition_size > 0 && (partition_size & (partition_size - 1)) == 0);
+        assert(left.rows() == right.rows() && left.cols() == right.cols());
+        
+        const auto length = static_cast<size_t>(left.cols());
+        m_num_partitions = std::max<size_t>(1, (length + partition_size - 1) / partition_size);
+        
+        m_symmetric = detect_symmetry && findSymmetry(left, right, m_antisymmetric);
+        
+        const auto columns = m_num_partitions * m_num_inputs;
+        m_left_spectra.resize(m_num_bins, columns);
+        m_right_spectra.resize(m_num_bins, m_symmetric ? 0 : columns);
+        allocate();
+        
+        // filters spectra: each partition is zero-padded to the FFT size,
+        // the left and right filters are transformed together.
+        for(size_t partition = 0; partition < m_num_partitions; ++partition)
+        {
+            const size_t start = partition * m_partition_size;
+            const size_t size = std::min(m_partition_size, length - std::min(start, length));
+            
+            for(size_t input = 0; input < m_num_inputs; ++input)
+            {
+                for(size_t i = 0; i < m_fft_size; ++i)
+                {
+                    m_fft_buffer[i].Set(0.f, 0.f);
+                }
+                
+                for(size_t i = 0; i < size; ++i)
+                {
+                    m_fft_buffer[i].Set(left(input, start + i), right(input, start + i));
+                }
+                
+                const auto column = partition * m_num_inputs + input;
+                auto* right_spectrum = m_symmetric ? m_left_accumulator.data() : &m_right_spectra(0, column);
+                forward(m_num_bins, &m_left_spectra(0, column), right_spectrum, true);
+            }
+        }
+        
+        reset();
+    }
+    
+    PartitionedConvolver::PartitionedConvolver(size_t partition_size, size_t num_inputs)
+    : m_partition_size(partition_size)
+    , m_fft_size(2 * partition_size)
+    , m_num_bins(partition_size + 1)
+    , m_num_inputs(num_inputs)
+    , m_active_inputs(num_inputs)
+    , m_target_inputs(num_inputs)
+    {}
+    
+    void PartitionedConvolver::allocate()
+    {
+        m_delay_line.resize(m_num_bins, m_num_partitions * m_num_inputs);
+        m_previous_inputs.resize(m_partition_size, m_num_inputs);
+        m_fft_buffer.resize(m_fft_size);
+        m_left_accumulator.resize(m_num_bins);
+        m_right_accumulator.resize(m_num_bins);
+    }
+    
+    // filters data: partition size, inputs, partitions and symmetry (uint64_t), the antisymmetric
+    // flags (one byte per input) if symmetric, then the left and right spectra (complex floats).
+    
+    bool PartitionedConvolver::writeFilters(std::FILE* file) const
+    {
+        const uint64_t header[4] = {
+            m_partition_size, m_num_inputs, m_num_partitions, m_symmetric ? 1u : 0u
+        };
+        
+        if(std::fwrite(header, sizeof(header), 1, file) != 1)
+            return false;
+        
+        if(m_symmetric)
+        {
+            const std::vector<uint8_t> flags(m_antisymmetric.begin(), m_antisymmetric.end());
+            if(std::fwrite(flags.data(), 1, flags.size(), file) != flags.size())
+                return false;
+        }
+        
+        for(auto const* spectra : {&m_left_spectra, &m_right_spectra})
+        {
+            const auto size = static_cast<size_t>(spectra->size());
+            if(size > 0 && std::fwrite(spectra->data(), sizeof(complex_t), size, file) != size)
+                return false;
+        }
+        
+        return true;
+    }
+    
+    std::unique_ptr<PartitionedConvolver> PartitionedConvolver::readFilters(char const* data, size_t size,
+                                                                          size_t partition_size,
+                                                                          size_t num_inputs)
+    {
+        uint64_t header[4];
+        if(size < sizeof(header))
+            return nullptr;
+        
+        // the header is checked against the expected filters before anything is sized from it.
+        std::memcpy(header, data, sizeof(header));
+        const size_t max_partitions = (k_max_decoder_response_length + partition_size - 1) / std::max<size_t>(partition_size, 1);
+        
+        if(partition_size == 0 || (partition_size & (partition_size - 1)) != 0 || num_inputs == 0
+           || header[0] != partition_size || header[1] != num_inputs
+           || header[2] == 0 || header[2] > max_partitions || header[3] > 1)
+            return nullptr;
+        
+        const auto num_partitions = static_cast<size_t>(header[2]);
+        const bool symmetric = (header[3] != 0);
+        
+        size_t columns = 0, spectra_size = 0, filters_size = 0;
+        if(!multiply_sizes(num_partitions, num_inputs, columns)
+           || !multiply_sizes(partition_size + 1, columns, spectra_size)
+           || !multiply_sizes(spectra_size, sizeof(complex_t), spectra_size)
+           || !multiply_sizes(spectra_size, symmetric ? 1 : 2, filters_size))
+            return nullptr;
+        
+        const size_t flags_size = symmetric ? num_inputs : 0;
+        if(size < sizeof(header) + flags_size || size - sizeof(header) - flags_size != filters_size)
+            return nullptr;
+        
+        // a flag is 1 for an antisymmetric input, 0 for a symmetric one.
+        auto const* flags = reinterpret_cast<uint8_t const*>(data + sizeof(header));
+        if(std::any_of(flags, flags + flags_size, [](uint8_t flag) { return flag > 1; }))
+            return nullptr;
+        
+        std::unique_ptr<PartitionedConvolver> convolver(new PartitionedConvolver(partition_size, num_inputs));
+        convolver->m_num_partitions = num_partitions;
+        convolver->m_symmetric = symmetric;
+        
+        data += sizeof(header);
+        convolver->m_antisymmetric.assign(flags, flags + flags_size);
+        data += flags_size;
+        
+        convolver->m_left_spectra.resize(partition_size + 1, columns);
+        std::memcpy(convolver->m_left_spectra.data(), data, spectra_size);
+        data += spectra_size;
+        
+        convolver->m_right_spectra.resize(partition_size + 1, symmetric ? 0 : columns);
+        if(!symmetric)
+        {
+            std::memcpy(convolver->m_right_spectra.data(), data, spectra_size);
+        }
+        
+        convolver->allocate();
+        convolver->reset();
+        return convolver;
+    }
+    
+    bool PartitionedConvolver::findSymmetry(matrix_t const& left, matrix_t const& right,
+                                            std::vector<bool>& antisymmetric)
+    {
+        const float_t tolerance = 1e-6f * std::max(left.cwiseAbs().maxCoeff(), float_t(1e-30));
+        
+        antisymmetric.assign(static_cast<size_t>(left.rows()), false);
+        
+        for(Eigen::Index input = 0; input < left.rows(); ++input)
+        {
+            if((right.row(input) - left.row(input)).cwiseAbs().maxCoeff() <= tolerance)
+                continue;
+            
+            if((right.row(input) + left.row(input)).cwiseAbs().maxCoeff() <= tolerance)
+            {
+                antisymmetric[static_cast<size_t>(input)] = true;
+                continue;
+            }
+            
+            return false;
+        }
+        
+        return true;
+    }
+    
+    void PartitionedConvolver::reset()
+    {
+        m_delay_line.setZero();
+        m_delay_line_position = 0;
+        m_previous_inputs.setZero();
+        
+        // nothing left to flush.
+        m_active_inputs = m_target_inputs;
+    }
+    
+    void PartitionedConvolver::setActiveInputs(size_t num_inputs)
+    {
+        num_inputs = std::min(num_inputs, m_num_inputs);
+        if(num_inputs == m_target_inputs)
+            return;
+        
+        m_target_inputs = num_inputs;
+        m_fade_position = 0;
+        m_flushed_partitions = 0;
+        
+        // the dropped inputs fade out in process.
+        if(num_inputs < m_active_inputs)
+            return;
+        
+        for(size_t input = m_active_inputs; input < num_inputs; ++input)
+        {
+            for(size_t slot = 0; slot < m_num_partitions; ++slot)
+            {
+                m_delay_line.col(slot * m_num_inputs + input).setZero();
+            }
+            
+            m_previous_inputs.col(input).setZero();
+        }
+        
+        m_active_inputs = num_inputs;
+    }
+    
+    auto PartitionedConvolver::getFadeGain(size_t frame) const noexcept -> float_t
+    {
+        const size_t position = m_fade_position + frame + 1;
+        return (position < m_fade_frames)
+        ? 1.f - static_cast<float_t>(position) / static_cast<float_t>(m_fade_frames)
+        : 0.f;
+    }
+    
+    void PartitionedConvolver::advanceFade()
+    {
+        if(m_fade_position < m_fade_frames)
+        {
+            m_fade_position += m_partition_size;
+        }
+        else if(++m_flushed_partitions >= m_num_partitions)
+        {
+            // the delay line only holds silence for them now.
+            m_active_inputs = m_target_inputs;
+        }
+    }
+    
+    void PartitionedConvolver::forward(size_t bins, complex_t* first, complex_t* second, bool highprecision)
+    {
+        // z = x1 + j.x2  =>  X1[k] = (Z[k] + Z*[N-k]) / 2,  X2[k] = (Z[k] - Z*[N-k]) / 2j
+        auto* buffer = m_fft_buffer.data();
+        FFT::Forward(buffer, static_cast<int>(m_fft_size), highprecision);
+        
+        for(size_t k = 0; k < bins; ++k)
+        {
+            auto const& z = buffer[k];
+            auto const& zn = buffer[(m_fft_size - k) & (m_fft_size - 1)];
+            
+            first[k] = complex_t(0.5f * (z.re + zn.re), 0.5f * (z.im - zn.im));
+            second[k] = complex_t(0.5f * (z.im + zn.im), 0.5f * (zn.re - z.re));
+        }
+    }
+    
+    void PartitionedConvolver::process(matrix_t const& inputs, Eigen::Ref<stereo_t> outputs)
+    {
+        assert(static_cast<size_t>(inputs.rows()) == m_num_inputs);
+        assert(inputs.cols() % m_partition_size == 0);
+        
+        // a fade out lasts one block.
+        if(m_target_inputs < m_active_inputs && m_fade_position == 0)
+        {
+            m_fade_frames = static_cast<size_t>(inputs.cols());
+        }
+        
+        for(size_t offset = 0; offset < static_cast<size_t>(inputs.cols()); offset += m_partition_size)
+        {
+            processPartition(inputs, offset, outputs);
+            
+            if(m_target_inputs < m_active_inputs)
+            {
+                advanceFade();
+            }
+        }
+    }
+    
+    void PartitionedConvolver::processPartition(matrix_t const& inputs, size_t offset,
+                                                Eigen::Ref<stereo_t> outputs)
+    {
+        const size_t size = m_partition_size;
+        auto* buffer = m_fft_buffer.data();
+        
+        // spectra of the current partition of each input, two inputs per FFT.
+        m_delay_line_position = (m_delay_line_position + 1) % m_num_partitions;
+        const auto first_column = m_delay_line_position * m_num_inputs;
+        
+        for(size_t input = 0; input < m_active_inputs; input += 2)
+        {
+            const bool pair = (input + 1 < m_active_inputs);
+            
+            for(size_t i = 0; i < size; ++i)
+            {
+                buffer[i].Set(m_previous_inputs(i, input), pair ? m_previous_inputs(i, input + 1) : 0.f);
+            }
+            
+            // the inputs dropped by setActiveInputs fade out.
+            const bool fading = (m_target_inputs < m_active_inputs);
+            const bool fade_first = fading && (input >= m_target_inputs);
+            const bool fade_second = fading && (input + 1 >= m_target_inputs);
+            
+            for(size_t i = 0; i < size; ++i)
+            {
+                auto first = inputs(input, offset + i);
+                auto second = pair ? inputs(input + 1, offset + i) : 0.f;
+                
+                if(fade_second)
+                {
+                    const float_t gain = getFadeGain(i);
+                    first *= fade_first ? gain : 1.f;
+                    second *= gain;
+                }
+                
+                buffer[size + i].Set(first, second);
+                m_previous_inputs(i, input) = first;
+                
+                if(pair)
+                {
+                    m_previous_inputs(i, input + 1) = second;
+                }
+            }
+            
+            auto* first = &m_delay_line(0, first_column + input);
+            auto* second = pair ? &m_delay_line(0, first_column + input + 1) : first;
+            
+            if(pair)
+            {
+                forward(m_num_bins, first, second, false);
+            }
+            else
+            {
+                // the accumulator is cleared below, use it for the spectrum of the silent input.
+                forward(m_num_bins, first, m_right_accumulator.data(), false);
+            }
+        }
+        
+        // sum of the products of the delayed input spectra with the filter partitions.
+        m_left_accumulator.setZero();
+        m_right_accumulator.setZero();
+        
+        for(size_t partition = 0; partition < m_num_partitions; ++partition)
+        {
+            const auto slot = (m_delay_line_position + m_num_partitions - partition) % m_num_partitions;
+            
+            for(size_t input = 0; input < m_active_inputs; ++input)
+            {
+                auto const& spectrum = m_delay_line.col(slot * m_num_inputs + input);
+                const auto filter = partition * m_num_inputs + input;
+                
+                if(m_symmetric)
+                {
+                    // symmetric inputs in the left accumulator, antisymmetric ones in the right.
+                    auto& accumulator = m_antisymmetric[input] ? m_right_accumulator : m_left_accumulator;
+                    accumulator += spectrum * m_left_spectra.col(filter);
+                }
+                else
+                {
+                    m_left_accumulator += spectrum * m_left_spectra.col(filter);
+                    m_right_accumulator += spectrum * m_right_spectra.col(filter);
+                }
+            }
+        }
+        
+        if(m_symmetric)
+        {
+            // left = symmetric + antisymmetric, right = symmetric - antisymmetric
+            m_left_accumulator += m_right_accumulator;
+            m_right_accumulator = m_left_accumulator - 2.f * m_right_accumulator;
+        }
+        
+        // one inverse FFT for both outputs: w = yl + j.yr
+        for(size_t k = 0; k < m_num_bins; ++k)
+        {
+            auto const& l = m_left_accumulator[k];
+            auto const& r = m_right_accumulator[k];
+            buffer[k].Set(l.real() - r.imag(), l.imag() + r.real());
+        }
+        
+        for(size_t k = m_num_bins; k < m_fft_size; ++k)
+        {
+            auto const& l = m_left_accumulator[m_fft_size - k];
+            auto const& r = m_right_accumulator[m_fft_size - k];
+            buffer[k].Set(l.real() + r.imag(), r.real() - l.imag());
+        }
+        
+        FFT::Backward(buffer, static_cast<int>(m_fft_size), false);
+        
+        // overlap-save: the last half is the linear convolution.
+        for(size_t i = 0; i < size; ++i)
+        {
+            outputs(0, offset + i) = buffer[size + i].re;
+            outputs(1, offset + i) = buffer[size + i].im;
+        }
+    }
+}
@@ -0,0 +1,241 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#pragma once
+
+#include "AudioPluginUtil.h"
+
+#include <Eigen/Dense>
+
+#include <complex>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+namespace HoaLibraryUnity
+{
+    //! @brief Maximum length of the impulse responses measured by probeDecoder.
+    static constexpr size_t k_max_decoder_response_length = 16384;
+    
+    //! @brief Returns the largest power of two that divides a number of frames.
+    static inline size_t get_max_partition_size(size_t vectorsize)
+    {
+        return vectorsize & (~vectorsize + 1);
+    }
+    
+    // ==================================================================================== //
+    // PartitionedConvolver
+    // ==================================================================================== //
+    
+    //! @brief Convolves many inputs with their own pair of filters and sums them into two outputs.
+    //! @details Uniformly partitioned overlap-save convolution: the filters are cut in
+    //! partitions of partition_size samples whose spectra are computed once, the spectra of
+    //! the last inputs are kept in a frequency-domain delay line, and the products are summed
+    //! in the frequency domain so that there is only one inverse FFT per partition for both
+    //! outputs. Real signals are transformed two at a time with a single complex FFT.
+    //! There is no latency as long as the blocks are a multiple of the partition size.
+    //! When the right filter of each input equals its left filter or its opposite
+    //! (spherical harmonics decoding of a left/right symmetric HRIR set), the inputs are
+    //! split in a symmetric and an antisymmetric group convolved with the left filters only,
+    //! and the outputs are their sum and difference.
+    class PartitionedConvolver
+    {
+    public:
+        
+        using float_t = float;
+        using complex_t = std::complex<float_t>;
+        using matrix_t = Eigen::Matrix<float_t, Eigen::Dynamic, Eigen::Dynamic>;
+        using stereo_t = Eigen::Matrix<float_t, 2, Eigen::Dynamic>;
+        
+        //! @brief Constructor
+        //! @param partition_size Number of frames of a partition, a power of two.
+        //! @param left (inputs x length) filters of the left output.
+        //! @param right (inputs x length) filters of the right output.
+        //! @param detect_symmetry Uses the left/right symmetry of the filters if there is one.
+        PartitionedConvolver(size_t partition_size, matrix_t const& left, matrix_t const& right,
+                             bool detect_symmetry = true);
+        
+        ~PartitionedConvolver() = default;
+        
+        //! @brief Returns the number of frames of a partition.
+        size_t getPartitionSize() const noexcept { return m_partition_size; }
+        
+        //! @brief Returns the number of partitions of the filters.
+        size_t getNumberOfPartitions() const noexcept { return m_num_partitions; }
+        
+        //! @brief Returns the number of inputs.
+        size_t getNumberOfInputs() const noexcept { return m_num_inputs; }
+        
+        //! @brief Returns true if the left/right symmetry of the filters is used.
+        bool isSymmetric() const noexcept { return m_symmetric; }
+        
+        //! @brief Clears the inputs history, the inputs fading out are dropped at once.
+        void reset();
+        
+        //! @brief Convolves only the first inputs, the others are ignored.
+        //! @details The inputs dropped fade out over the next block, then their history is
+        //! flushed with silence for the length of the filters before they are ignored, so that
+        //! their tails are not cut. The inputs enabled again are added at once, a fade in
+        //! progress is cancelled, and their history is cleared so that they start from silence
+        //! instead of replaying their old spectra.
+        //! @param num_inputs The number of inputs, at most getNumberOfInputs().
+        void setActiveInputs(size_t num_inputs);
+        
+        //! @brief Returns the number of inputs convolved, including the ones fading out.
+        size_t getActiveInputs() const noexcept { return m_active_inputs; }
+        
+        //! @brief Convolves a block of inputs.
+        //! @param inputs (inputs x frames) signals, frames must be a multiple of the partition size.
+        //! @param outputs (2 x frames) output signals, overwritten.
+        void process(matrix_t const& inputs, Eigen::Ref<stereo_t> outputs);
+        
+        //! @brief Writes the filters spectra so that they can be read back by readFilters.
+        //! @return false if the file could not be written.
+        bool writeFilters(std::FILE* file) const;
+        
+        //! @brief Creates a convolver from the filters spectra written by writeFilters.
+        //! @details The data may come from a corrupted file: it must hold the expected
+        //! partition size and inputs, at most k_max_decoder_response_length samples of
+        //! filters, and exactly the size they need.
+        //! @param data The written bytes (for instance a memory-mapped file).
+        //! @param partition_size The expected partition size.
+        //! @param num_inputs The expected number of inputs.
+        //! @return nullptr if the data is not valid.
+        static std::unique_ptr<PartitionedConvolver> readFilters(char const* data, size_t size,
+                                                                 size_t partition_size, size_t num_inputs);
+        
+    private:
+        
+        using spectra_t = Eigen::Array<complex_t, Eigen::Dynamic, Eigen::Dynamic>;
+        
+        //! @brief Constructor of readFilters.
+        PartitionedConvolver(size_t partition_size, size_t num_inputs);
+        
+        //! @brief Allocates the buffers once the filters are known.
+        void allocate();
+        
+        //! @brief Convolves the partition of inputs starting at a frame.
+        void processPartition(matrix_t const& inputs, size_t offset, Eigen::Ref<stereo_t> outputs);
+        
+        //! @brief Returns the gain of a frame of the partition for an input fading out.
+        float_t getFadeGain(size_t frame) const noexcept;
+        
+        //! @brief Moves the fade out of the dropped inputs by a partition.
+        void advanceFade();
+        
+        //! @brief Computes the spectra of two real signals of 2 * partition_size frames.
+        void forward(size_t bins, complex_t* first, complex_t* second, bool highprecision);
+        
+        //! @brief Finds the sign of the right filters relative to the left filters.
+        //! @return false if a right filter is neither the left filter nor its opposite.
+        static bool findSymmetry(matrix_t const& left, matrix_t const& right, std::vector<bool>& antisymmetric);
+        
+    private:
+        
+        const size_t m_partition_size;
+        const size_t m_fft_size;
+        const size_t m_num_bins;
+        const size_t m_num_inputs;
+        size_t m_active_inputs;
+        size_t m_num_partitions = 0;
+        
+        // the inputs from m_target_inputs to m_active_inputs fade out, then are flushed.
+        size_t m_target_inputs;
+        size_t m_fade_frames = 0;
+        size_t m_fade_position = 0;
+        size_t m_flushed_partitions = 0;
+        
+        // left/right symmetry, the right spectra are not used.
+        bool m_symmetric = false;
+        std::vector<bool> m_antisymmetric {};
+        
+        // (bins x (partitions * inputs)) filters spectra
+        spectra_t m_left_spectra {};
+        spectra_t m_right_spectra {};
+        
+        // (bins x (partitions * inputs)) frequency-domain delay line
+        spectra_t m_delay_line {};
+        size_t m_delay_line_position = 0;
+        
+        // (partition_size x inputs) previous partition of each input (overlap-save)
+        matrix_t m_previous_inputs {};
+        
+        std::vector<UnityComplexNumber> m_fft_buffer {};
+        Eigen::Array<complex_t, Eigen::Dynamic, 1> m_left_accumulator {};
+        Eigen::Array<complex_t, Eigen::Dynamic, 1> m_right_accumulator {};
+    };
+    
+    // ==================================================================================== //
+    // Decoder probing
+    // ==================================================================================== //
+    
+    //! @brief Measures the impulse responses of a linear (harmonics -> stereo) decoder.
+    //! @details An impulse is sent to each input in turn, the decoder is run until its
+    //! outputs are silent for two blocks, the responses are then trimmed to the last
+    //! non-zero sample of all inputs.
+    //! @param decoder A fresh decoder prepared for vectorsize frames.
+    //! @param left Receives the (inputs x length) responses of the left output.
+    //! @param right Receives the (inputs x length) responses of the right output.
+    //! @return false if a response is longer than k_max_decoder_response_length.
+    template<class Decoder>
+    bool probeDecoder(Decoder& decoder, size_t num_inputs, size_t vectorsize,
+                      PartitionedConvolver::matrix_t& left, PartitionedConvolver::matrix_t& right)
+    {
+        using input_matrix_t = typename Decoder::input_matrix_t;
+        using stereo_t = Eigen::Matrix<typename input_matrix_t::Scalar, 2, Eigen::Dynamic>;
+        
+        const size_t max_blocks = (k_max_decoder_response_length + vectorsize - 1) / vectorsize;
+        
+        input_matrix_t inputs = input_matrix_t::Zero(num_inputs, vectorsize);
+        stereo_t buffer = stereo_t::Zero(2, vectorsize);
+        Eigen::Map<stereo_t> outputs(buffer.data(), 2, vectorsize);
+        
+        left.setZero(num_inputs, max_blocks * vectorsize);
+        right.setZero(num_inputs, max_blocks * vectorsize);
+        
+        size_t length = 0;
+        for(size_t input = 0; input < num_inputs; ++input)
+        {
+            size_t silent_blocks = 0;
+            size_t block = 0;
+            
+            inputs(input, 0) = 1;
+            
+            for(; block < max_blocks && silent_blocks < 2; ++block)
+            {
+                decoder.processBlock(inputs, outputs);
+                inputs.setZero();
+                
+                left.row(input).segment(block * vectorsize, vectorsize) = outputs.row(0);
+                right.row(input).segment(block * vectorsize, vectorsize) = outputs.row(1);
+                
+                silent_blocks = outputs.isZero(0) ? silent_blocks + 1 : 0;
+            }
+            
+            if(silent_blocks < 2)
+                return false;
+            
+            for(size_t i = block * vectorsize; i > length; --i)
+            {
+                if(left(input, i - 1) != 0 || right(input, i - 1) != 0)
+                {
+                    length = i;
+                    break;
+                }
+            }
+        }
+        
+        length = std::max<size_t>(length, 1);
+        left.conservativeResize(Eigen::NoChange, length);
+        right.conservativeResize(Eigen::NoChange, length);
+        return true;
+    }
+}
@@ -0,0 +1,439 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#include "HoaLibraryHarmonics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace HoaLibraryUnity
+{
+    namespace
+    {
+        // Number of radius values sampled in [0, 1] for each degree.
+        static constexpr size_t k_radius_lut_size = 1025;
+
+        size_t get_legendre_index(size_t degree, size_t order)
+        {
+            return degree * (degree + 1) / 2 + order;
+        }
+
+        double factorial(size_t n)
+        {
+            double result = 1.;
+            for(size_t i = 2; i <= n; ++i)
+            {
+                result *= static_cast<double>(i);
+            }
+            return result;
+        }
+    }
+
+    BatchedEncoder::BatchedEncoder(size_t order)
+    : m_order(order)
+    , m_num_harmonics((order + 1) * (order + 1))
+    , m_basis_norm(m_num_harmonics)
+    , m_cos_m(order + 1)
+    , m_sin_m(order + 1)
+    , m_legendre(get_legendre_index(order, order) + 1)
+    , m_basis(m_num_harmonics)
+    , m_radius_weights(order + 1)
+    , m_basis_index(m_num_harmonics)
+    , m_degree(m_num_harmonics)
+    , m_scale(m_num_harmonics)
+    , m_radius_lut((order + 1) * k_radius_lut_size)
+    {
+        for(size_t l = 0; l <= m_order; ++l)
+        {
+            for(size_t m = 0; m <= l; ++m)
+            {
+                const double norm = std::sqrt((m == 0 ? 1. : 2.) * factorial(l - m) / factorial(l + m));
+                m_basis_norm[l * l + l + m] = static_cast<float_t>(norm);
+                m_basis_norm[l * l + l - m] = static_cast<float_t>(norm);
+            }
+        }
+
+        m_valid = calibrate() && verify();
+    }
+
+    void BatchedEncoder::computeBasis(lanes_t const& cos_az, lanes_t const& sin_az,
+                                      lanes_t const& cos_el, lanes_t const& sin_el)
+    {
+        const size_t lanes = k_simd_lanes;
+
+        // cos(m.az) and sin(m.az) by angle addition.
+        for(size_t i = 0; i < lanes; ++i)
+        {
+            m_cos_m[0].v[i] = 1.f;
+            m_sin_m[0].v[i] = 0.f;
+        }
+
+        for(size_t m = 1; m <= m_order; ++m)
+        {
+            auto const& pc = m_cos_m[m-1];
+            auto const& ps = m_sin_m[m-1];
+            auto& c = m_cos_m[m];
+            auto& s = m_sin_m[m];
+            for(size_t i = 0; i < lanes; ++i)
+            {
+                c.v[i] = pc.v[i] * cos_az.v[i] - ps.v[i] * sin_az.v[i];
+                s.v[i] = ps.v[i] * cos_az.v[i] + pc.v[i] * sin_az.v[i];
+            }
+        }
+
+        // associated Legendre functions of sin(el), without Condon-Shortley phase.
+        for(size_t i = 0; i < lanes; ++i)
+        {
+            m_legendre[0].v[i] = 1.f;
+        }
+
+        for(size_t m = 1; m <= m_order; ++m)
+        {
+            auto const& prev = m_legendre[get_legendre_index(m-1, m-1)];
+            auto& p = m_legendre[get_legendre_index(m, m)];
+            const float_t factor = static_cast<float_t>(2 * m - 1);
+            for(size_t i = 0; i < lanes; ++i)
+            {
+                p.v[i] = prev.v[i] * factor * cos_el.v[i];
+            }
+        }
+
+        for(size_t m = 0; m < m_order; ++m)
+        {
+            auto const& prev = m_legendre[get_legendre_index(m, m)];
+            auto& p = m_legendre[get_legendre_index(m+1, m)];
+            const float_t factor = static_cast<float_t>(2 * m + 1);
+            for(size_t i = 0; i < lanes; ++i)
+            {
+                p.v[i] = prev.v[i] * factor * sin_el.v[i];
+            }
+        }
+
+        for(size_t m = 0; m <= m_order; ++m)
+        {
+            for(size_t l = m + 2; l <= m_order; ++l)
+            {
+                auto const& p1 = m_legendre[get_legendre_index(l-1, m)];
+                auto const& p2 = m_legendre[get_legendre_index(l-2, m)];
+                auto& p = m_legendre[get_legendre_index(l, m)];
+                const float_t a = static_cast<float_t>(2 * l - 1) / static_cast<float_t>(l - m);
+                const float_t b = static_cast<float_t>(l + m - 1) / static_cast<float_t>(l - m);
+                for(size_t i = 0; i < lanes; ++i)
+                {
+                    p.v[i] = a * sin_el.v[i] * p1.v[i] - b * p2.v[i];
+                }
+            }
+        }
+
+        // real harmonics in ACN ordering.
+        for(size_t l = 0; l <= m_order; ++l)
+        {
+            for(size_t m = 0; m <= l; ++m)
+            {
+                auto const& p = m_legendre[get_legendre_index(l, m)];
+                const size_t cos_index = l * l + l + m;
+                const size_t sin_index = l * l + l - m;
+                const float_t norm = m_basis_norm[cos_index];
+                auto& yc = m_basis[cos_index];
+                auto& ys = m_basis[sin_index];
+                auto const& c = m_cos_m[m];
+                auto const& s = m_sin_m[m];
+
+                for(size_t i = 0; i < lanes; ++i)
+                {
+                    yc.v[i] = norm * p.v[i] * c.v[i];
+                }
+
+                if(m > 0)
+                {
+                    for(size_t i = 0; i < lanes; ++i)
+                    {
+                        ys.v[i] = norm * p.v[i] * s.v[i];
+                    }
+                }
+            }
+        }
+    }
+
+    void BatchedEncoder::writeCoefficients(lanes_t const& radius, size_t count,
+                                           float_t* coeffs, size_t stride)
+    {
+        const size_t lanes = k_simd_lanes;
+        const float_t scale = static_cast<float_t>(k_radius_lut_size - 1);
+
+        for(size_t l = 0; l <= m_order; ++l)
+        {
+            auto const* lut = m_radius_lut.data() + l * k_radius_lut_size;
+            auto& w = m_radius_weights[l];
+            for(size_t i = 0; i < lanes; ++i)
+            {
+                const float_t pos = std::min(std::max(radius.v[i], 0.f), 1.f) * scale;
+                const size_t index = std::min(static_cast<size_t>(pos), k_radius_lut_size - 2);
+                const float_t frac = pos - static_cast<float_t>(index);
+                w.v[i] = lut[index] + (lut[index + 1] - lut[index]) * frac;
+            }
+        }
+
+        for(size_t h = 0; h < m_num_harmonics; ++h)
+        {
+            auto const& y = m_basis[m_basis_index[h]];
+            auto const& w = m_radius_weights[m_degree[h]];
+            const float_t s = m_scale[h];
+            for(size_t i = 0; i < count; ++i)
+            {
+                coeffs[i * stride + h] = s * w.v[i] * y.v[i];
+            }
+        }
+    }
+
+    void BatchedEncoder::processCartesian(size_t count,
+                                          float_t const* x, float_t const* y, float_t const* z,
+                                          float_t* coeffs, size_t stride)
+    {
+        lanes_t cos_az, sin_az, cos_el, sin_el, radius;
+
+        for(size_t start = 0; start < count; start += k_simd_lanes)
+        {
+            const size_t size = std::min(k_simd_lanes, count - start);
+
+            // same conventions as cartopol() without trigonometry:
+            // azimuth = atan2(z, x) - pi/2 and elevation = asin(y / radius).
+            for(size_t i = 0; i < k_simd_lanes; ++i)
+            {
+                const size_t j = start + std::min(i, size - 1);
+                const float_t px = x[j], py = y[j], pz = z[j];
+                const float_t rho = std::sqrt(px * px + pz * pz);
+                const float_t r = std::sqrt(px * px + py * py + pz * pz);
+                const float_t inv_rho = rho > 0.f ? 1.f / rho : 0.f;
+                const float_t inv_r = r > 0.f ? 1.f / r : 0.f;
+
+                cos_az.v[i] = rho > 0.f ? pz * inv_rho : 0.f;
+                sin_az.v[i] = rho > 0.f ? -px * inv_rho : -1.f;
+                cos_el.v[i] = r > 0.f ? rho * inv_r : 1.f;
+                sin_el.v[i] = py * inv_r;
+                radius.v[i] = r;
+            }
+
+            computeBasis(cos_az, sin_az, cos_el, sin_el);
+            writeCoefficients(radius, size, coeffs + start * stride, stride);
+        }
+    }
+
+    void BatchedEncoder::processSpherical(size_t count,
+                                          float_t const* azimuth, float_t const* elevation,
+                                          float_t const* radius,
+                                          float_t* coeffs, size_t stride)
+    {
+        lanes_t cos_az, sin_az, cos_el, sin_el, r;
+
+        for(size_t start = 0; start < count; start += k_simd_lanes)
+        {
+            const size_t size = std::min(k_simd_lanes, count - start);
+
+            for(size_t i = 0; i < k_simd_lanes; ++i)
+            {
+                const size_t j = start + std::min(i, size - 1);
+                cos_az.v[i] = std::cos(azimuth[j]);
+                sin_az.v[i] = std::sin(azimuth[j]);
+                cos_el.v[i] = std::cos(elevation[j]);
+                sin_el.v[i] = std::sin(elevation[j]);
+                r.v[i] = radius[j];
+            }
+
+            computeBasis(cos_az, sin_az, cos_el, sin_el);
+            writeCoefficients(r, size, coeffs + start * stride, stride);
+        }
+    }
+
+    bool BatchedEncoder::calibrate()
+    {
+        using encoder_t = hoa::Encoder<hoa::Hoa3d, float_t>;
+        using matrix_t = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic>;
+
+        encoder_t encoder(m_order);
+        if(encoder.getNumberOfHarmonics() != m_num_harmonics)
+            return false;
+
+        const float_t unit = 1.f;
+        std::vector<float_t> harmonics(m_num_harmonics);
+
+        // Fibonacci sphere
+        const size_t num_points = std::max<size_t>(m_num_harmonics * 4, 64);
+        const size_t num_batches = (num_points + k_simd_lanes - 1) / k_simd_lanes;
+        const double golden_angle = hoa::math<double>::pi() * (3. - std::sqrt(5.));
+
+        matrix_t library(m_num_harmonics, num_batches * k_simd_lanes);
+        matrix_t basis(m_num_harmonics, num_batches * k_simd_lanes);
+
+        encoder.setRadius(1.f);
+
+        for(size_t batch = 0; batch < num_batches; ++batch)
+        {
+            lanes_t cos_az, sin_az, cos_el, sin_el;
+
+            for(size_t i = 0; i < k_simd_lanes; ++i)
+            {
+                const size_t n = batch * k_simd_lanes + i;
+                const double height = 1. - (2. * n + 1.) / (num_batches * k_simd_lanes);
+                const float_t az = static_cast<float_t>(std::remainder(golden_angle * n, 2. * hoa::math<double>::pi()));
+                const float_t el = static_cast<float_t>(std::asin(height));
+
+                encoder.setAzimuth(az);
+                encoder.setElevation(el);
+                encoder.process(&unit, harmonics.data());
+
+                for(size_t h = 0; h < m_num_harmonics; ++h)
+                {
+                    library(h, n) = harmonics[h];
+                }
+
+                cos_az.v[i] = std::cos(az);
+                sin_az.v[i] = std::sin(az);
+                cos_el.v[i] = std::cos(el);
+                sin_el.v[i] = std::sin(el);
+            }
+
+            computeBasis(cos_az, sin_az, cos_el, sin_el);
+
+            for(size_t j = 0; j < m_num_harmonics; ++j)
+            {
+                for(size_t i = 0; i < k_simd_lanes; ++i)
+                {
+                    basis(j, batch * k_simd_lanes + i) = m_basis[j].v[i];
+                }
+            }
+        }
+
+        // Each library harmonic must be one of the basis functions up to a scale factor.
+        std::vector<bool> used(m_num_harmonics, false);
+
+        for(size_t h = 0; h < m_num_harmonics; ++h)
+        {
+            const double energy = library.row(h).squaredNorm();
+            if(energy <= 0.)
+                return false;
+
+            size_t best_index = m_num_harmonics;
+            double best_residual = 1e-8 * energy;
+            double best_scale = 0.;
+
+            for(size_t j = 0; j < m_num_harmonics; ++j)
+            {
+                const double scale = library.row(h).dot(basis.row(j)) / basis.row(j).squaredNorm();
+                const double residual = (library.row(h) - scale * basis.row(j)).squaredNorm();
+                if(residual <= best_residual)
+                {
+                    best_index = j;
+                    best_residual = residual;
+                    best_scale = scale;
+                }
+            }
+
+            if(best_index == m_num_harmonics || used[best_index])
+                return false;
+
+            used[best_index] = true;
+            m_basis_index[h] = best_index;
+            m_degree[h] = static_cast<size_t>(std::sqrt(static_cast<double>(best_index)));
+            m_scale[h] = static_cast<float_t>(best_scale);
+        }
+
+        // Radius weighting, measured on the largest harmonic of each degree
+        // for a direction where no degree vanishes.
+        encoder.setAzimuth(0.3f);
+        encoder.setElevation(0.2f);
+        encoder.process(&unit, harmonics.data());
+
+        const std::vector<float_t> reference = harmonics;
+        std::vector<size_t> degree_harmonic(m_order + 1, m_num_harmonics);
+
+        for(size_t h = 0; h < m_num_harmonics; ++h)
+        {
+            auto& index = degree_harmonic[m_degree[h]];
+            if(index == m_num_harmonics || std::abs(reference[h]) > std::abs(reference[index]))
+            {
+                index = h;
+            }
+        }
+
+        for(size_t l = 0; l <= m_order; ++l)
+        {
+            if(std::abs(reference[degree_harmonic[l]]) < 1e-3f)
+                return false;
+        }
+
+        for(size_t k = 0; k < k_radius_lut_size; ++k)
+        {
+            encoder.setRadius(static_cast<float_t>(k) / static_cast<float_t>(k_radius_lut_size - 1));
+            encoder.process(&unit, harmonics.data());
+
+            for(size_t l = 0; l <= m_order; ++l)
+            {
+                const size_t h = degree_harmonic[l];
+                m_radius_lut[l * k_radius_lut_size + k] = harmonics[h] / reference[h];
+            }
+        }
+
+        return true;
+    }
+
+    bool BatchedEncoder::verify()
+    {
+        using encoder_t = hoa::Encoder<hoa::Hoa3d, float_t>;
+
+        encoder_t encoder(m_order);
+
+        const size_t num_directions = 16 * k_simd_lanes;
+        std::vector<float_t> azimuth(num_directions), elevation(num_directions), radius(num_directions);
+        std::vector<float_t> coeffs(num_directions * m_num_harmonics);
+        std::vector<float_t> harmonics(m_num_harmonics);
+
+        uint32_t seed = 1;
+        auto random = [&seed]() {
+            seed = seed * 1664525u + 1013904223u;
+            return static_cast<float_t>(seed >> 8) / static_cast<float_t>(1u << 24);
+        };
+
+        for(size_t n = 0; n < num_directions; ++n)
+        {
+            azimuth[n] = (random() * 2.f - 1.f) * hoa::math<float_t>::pi();
+            elevation[n] = (random() * 2.f - 1.f) * hoa::math<float_t>::pi_over_two();
+            radius[n] = n % 2 ? 1.f : random();
+        }
+
+        processSpherical(num_directions, azimuth.data(), elevation.data(), radius.data(),
+                         coeffs.data(), m_num_harmonics);
+
+        const float_t unit = 1.f;
+        for(size_t n = 0; n < num_directions; ++n)
+        {
+            encoder.setRadius(radius[n]);
+            encoder.setAzimuth(azimuth[n]);
+            encoder.setElevation(elevation[n]);
+            encoder.process(&unit, harmonics.data());
+
+            float_t peak = 1.f;
+            for(auto value : harmonics)
+            {
+                peak = std::max(peak, std::abs(value));
+            }
+
+            for(size_t h = 0; h < m_num_harmonics; ++h)
+            {
+                if(std::abs(coeffs[n * m_num_harmonics + h] - harmonics[h]) > 1e-3f * peak)
+                    return false;
+            }
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,124 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#pragma once
+
+#include <Hoa.hpp>
+
+#include <vector>
+
+namespace HoaLibraryUnity
+{
+    //! @brief Number of directions evaluated at once by the BatchedEncoder,
+    //! one direction per SIMD lane.
+#if defined(__AVX512F__)
+    static constexpr size_t k_simd_lanes = 16;
+#else
+    static constexpr size_t k_simd_lanes = 8;
+#endif
+
+    // ==================================================================================== //
+    // BatchedEncoder
+    // ==================================================================================== //
+
+    //! @brief Evaluates the spherical harmonics coefficients of many directions at once.
+    //! @details The directions are given as structure-of-arrays and processed
+    //! k_simd_lanes at a time with branch-free recurrences (no trigonometry for
+    //! cartesian inputs) so that the compiler can map one direction per SIMD lane.
+    //! At construction the kernel is calibrated against hoa::Encoder<Hoa3d>
+    //! (harmonics ordering, normalization and radius weighting) so that it returns
+    //! exactly what a unit sample encoded by the library would give. If the
+    //! calibration fails, isValid() returns false and the kernel must not be used.
+    class BatchedEncoder
+    {
+    public:
+
+        using float_t = float;
+
+        BatchedEncoder(size_t order);
+        ~BatchedEncoder() = default;
+
+        //! @brief Returns true if the kernel matches the library encoder.
+        bool isValid() const noexcept { return m_valid; }
+
+        //! @brief Returns the number of harmonics.
+        size_t getNumberOfHarmonics() const noexcept { return m_num_harmonics; }
+
+        //! @brief Returns the index of the basis function of a library harmonic
+        //! (ACN ordering, SN3D without Condon-Shortley phase, x front, y left, z up).
+        size_t getBasisIndex(size_t harmonic) const { return m_basis_index[harmonic]; }
+
+        //! @brief Returns the factor from the basis function to a library harmonic.
+        float_t getBasisScale(size_t harmonic) const { return m_scale[harmonic]; }
+
+        //! @brief Computes the harmonics coefficients of positions given in unity
+        //! listener coordinates (same conventions as the Source positions).
+        //! @param count Number of positions.
+        //! @param x, y, z Arrays of count coordinates.
+        //! @param coeffs Output, one column of getNumberOfHarmonics() values per position.
+        //! @param stride Distance between two columns in coeffs.
+        void processCartesian(size_t count,
+                              float_t const* x, float_t const* y, float_t const* z,
+                              float_t* coeffs, size_t stride);
+
+        //! @brief Computes the harmonics coefficients of spherical coordinates.
+        //! @param count Number of directions.
+        //! @param azimuth, elevation, radius Arrays of count hoa coordinates.
+        //! @param coeffs Output, one column of getNumberOfHarmonics() values per direction.
+        //! @param stride Distance between two columns in coeffs.
+        void processSpherical(size_t count,
+                              float_t const* azimuth, float_t const* elevation, float_t const* radius,
+                              float_t* coeffs, size_t stride);
+
+    private:
+
+        struct lanes_t
+        {
+            float_t v[k_simd_lanes];
+        };
+
+        //! @brief Computes the unscaled basis of k_simd_lanes directions in m_basis.
+        void computeBasis(lanes_t const& cos_az, lanes_t const& sin_az,
+                          lanes_t const& cos_el, lanes_t const& sin_el);
+
+        //! @brief Maps the basis to the library harmonics and writes count columns.
+        void writeCoefficients(lanes_t const& radius, size_t count,
+                               float_t* coeffs, size_t stride);
+
+        //! @brief Matches the basis against hoa::Encoder.
+        bool calibrate();
+
+        //! @brief Checks the kernel against hoa::Encoder on random directions.
+        bool verify();
+
+    private:
+
+        const size_t m_order;
+        const size_t m_num_harmonics;
+        bool m_valid = false;
+
+        // per basis function (ACN ordering, SN3D without Condon-Shortley phase)
+        std::vector<float_t> m_basis_norm {};
+        std::vector<lanes_t> m_cos_m {};
+        std::vector<lanes_t> m_sin_m {};
+        std::vector<lanes_t> m_legendre {};
+        std::vector<lanes_t> m_basis {};
+        std::vector<lanes_t> m_radius_weights {};
+
+        // per library harmonic
+        std::vector<size_t> m_basis_index {};
+        std::vector<size_t> m_degree {};
+        std::vector<float_t> m_scale {};
+
+        // per degree radius weighting, sampled on [0, 1]
+        std::vector<float_t> m_radius_lut {};
+    };
+}
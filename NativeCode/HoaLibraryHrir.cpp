@@ -0,0 +1,417 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#include "HoaLibraryHrir.h"
+#include "HoaLibraryResampler.h"
+
+#include <Hoa.hpp>
+
+#include <assert.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if defined(_WIN32)
+#   ifndef NOMINMAX
+#       define NOMINMAX
+#   endif
+#   ifndef WIN32_LEAN_AND_MEAN
+#       define WIN32_LEAN_AND_MEAN
+#   endif
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+namespace HoaLibraryUnity
+{
+    namespace
+    {
+        struct hrir_header_t
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t num_measurements;
+            uint32_t length;
+            float sample_rate;
+        };
+
+        struct cache_header_t
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t order;
+            uint64_t hrir_hash;
+            uint32_t sample_rate;
+            uint32_t partition_size;
+        };
+
+        static const char k_hrir_magic[8] = {'H', 'O', 'A', 'H', 'R', 'I', 'R', '\0'};
+        static const char k_cache_magic[8] = {'H', 'O', 'A', 'D', 'E', 'C', '\0', '\0'};
+
+        // FNV-1a
+        uint64_t hashBytes(char const* data, size_t size)
+        {
+            uint64_t hash = 14695981039346656037ull;
+            for(size_t i = 0; i < size; ++i)
+            {
+                hash ^= static_cast<unsigned char>(data[i]);
+                hash *= 1099511628211ull;
+            }
+
+            return hash;
+        }
+    }
+
+    // ==================================================================================== //
+    // MappedFile
+    // ==================================================================================== //
+
+#if defined(_WIN32)
+
+    MappedFile::MappedFile(std::string const& path)
+    {
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(file == INVALID_HANDLE_VALUE)
+            return;
+
+        m_file = file;
+
+        LARGE_INTEGER size;
+        if(!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+            return;
+
+        m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(m_mapping == nullptr)
+            return;
+
+        if(void* data = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0))
+        {
+            m_data = static_cast<char const*>(data);
+            m_size = static_cast<size_t>(size.QuadPart);
+        }
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if(m_data != nullptr)
+        {
+            UnmapViewOfFile(m_data);
+        }
+
+        if(m_mapping != nullptr)
+        {
+            CloseHandle(m_mapping);
+        }
+
+        if(m_file != nullptr)
+        {
+            CloseHandle(m_file);
+        }
+    }
+
+#else
+
+    MappedFile::MappedFile(std::string const& path)
+    {
+        const int file = ::open(path.c_str(), O_RDONLY);
+        if(file < 0)
+            return;
+
+        struct stat status;
+        if(::fstat(file, &status) == 0 && status.st_size > 0)
+        {
+            const auto size = static_cast<size_t>(status.st_size);
+            void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+            if(data != MAP_FAILED)
+            {
+                m_data = static_cast<char const*>(data);
+                m_size = size;
+            }
+        }
+
+        // the mapping stays valid once the file is closed.
+        ::close(file);
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if(m_data != nullptr)
+        {
+            ::munmap(const_cast<char*>(m_data), m_size);
+        }
+    }
+
+#endif
+
+    // ==================================================================================== //
+    // HrirSet
+    // ==================================================================================== //
+
+    HrirSet::HrirSet(std::string const& path)
+    : m_file(path)
+    {
+        hrir_header_t header;
+        if(!m_file.isValid() || m_file.getSize() < sizeof(header))
+            return;
+
+        std::memcpy(&header, m_file.getData(), sizeof(header));
+
+        if(std::memcmp(header.magic, k_hrir_magic, sizeof(k_hrir_magic)) != 0
+           || header.version != k_version
+           || header.num_measurements == 0 || header.length == 0
+           || !(header.sample_rate > 0.f) || !std::isfinite(header.sample_rate))
+            return;
+
+        const size_t num_measurements = header.num_measurements;
+        const size_t length = header.length;
+        const size_t positions_size = num_measurements * 2 * sizeof(float);
+        const size_t responses_size = num_measurements * 2 * length * sizeof(float);
+
+        if(m_file.getSize() != sizeof(header) + positions_size + responses_size)
+            return;
+
+        m_num_measurements = num_measurements;
+        m_length = length;
+        m_sample_rate = header.sample_rate;
+        m_hash = hashBytes(m_file.getData(), m_file.getSize());
+
+        // the header size is a multiple of the alignment of a float.
+        m_responses = reinterpret_cast<float const*>(m_file.getData() + sizeof(header) + positions_size);
+        m_positions = reinterpret_cast<float const*>(m_file.getData() + sizeof(header));
+    }
+
+    float HrirSet::getAzimuth(size_t measurement) const
+    {
+        assert(measurement < m_num_measurements);
+        return m_positions[measurement * 2] * hoa::math<float>::pi() / 180.f;
+    }
+
+    float HrirSet::getElevation(size_t measurement) const
+    {
+        assert(measurement < m_num_measurements);
+        return m_positions[measurement * 2 + 1] * hoa::math<float>::pi() / 180.f;
+    }
+
+    float const* HrirSet::getResponse(size_t measurement, size_t ear) const
+    {
+        assert(measurement < m_num_measurements && ear < 2);
+        return m_responses + (measurement * 2 + ear) * m_length;
+    }
+
+    bool computeDecodingFilters(HrirSet const& hrir, size_t order,
+                                PartitionedConvolver::matrix_t& left,
+                                PartitionedConvolver::matrix_t& right)
+    {
+        using encoder_t = hoa::Encoder<hoa::Hoa3d, float>;
+        using matrix_t = Eigen::MatrixXd;
+        using responses_t = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+        const size_t num_harmonics = (order + 1) * (order + 1);
+        const size_t num_measurements = hrir.getNumberOfMeasurements();
+        const size_t length = std::min(hrir.getLength(), k_max_decoder_response_length);
+
+        if(!hrir.isValid() || num_measurements < num_harmonics)
+            return false;
+
+        // harmonics of the measured directions, one row per measurement.
+        encoder_t encoder(order);
+        encoder.setRadius(1.f);
+
+        const float unit = 1.f;
+        std::vector<float> harmonics(num_harmonics);
+        matrix_t directions(num_measurements, num_harmonics);
+
+        for(size_t i = 0; i < num_measurements; ++i)
+        {
+            encoder.setAzimuth(hrir.getAzimuth(i));
+            encoder.setElevation(hrir.getElevation(i));
+            encoder.process(&unit, harmonics.data());
+
+            for(size_t h = 0; h < num_harmonics; ++h)
+            {
+                directions(i, h) = harmonics[h];
+            }
+        }
+
+        // normal equations, slightly regularized for the sets with a sparse coverage.
+        matrix_t gram = directions.transpose() * directions;
+        const double regularization = 1e-6 * gram.trace() / num_harmonics;
+        gram.diagonal().array() += regularization;
+
+        const Eigen::LDLT<matrix_t> solver(gram);
+        if(solver.info() != Eigen::Success)
+            return false;
+
+        const auto stride = Eigen::OuterStride<>(static_cast<Eigen::Index>(2 * hrir.getLength()));
+        PartitionedConvolver::matrix_t* filters[2] = {&left, &right};
+
+        for(size_t ear = 0; ear < 2; ++ear)
+        {
+            const Eigen::Map<const responses_t, 0, Eigen::OuterStride<>> responses(hrir.getResponse(0, ear),
+                                                                                  num_measurements, length,
+                                                                                  stride);
+
+            const matrix_t solution = solver.solve(directions.transpose() * responses.cast<double>());
+            if(!solution.allFinite())
+                return false;
+
+            *filters[ear] = solution.cast<float>();
+        }
+
+        return true;
+    }
+
+    bool resampleDecodingFilters(PartitionedConvolver::matrix_t& left,
+                                 PartitionedConvolver::matrix_t& right,
+                                 double source_rate, double target_rate)
+    {
+        const PolyphaseResampler resampler(source_rate, target_rate);
+        if(!resampler.isValid())
+            return false;
+
+        const auto length = std::min(resampler.getOutputLength(left.cols()), k_max_decoder_response_length);
+        left = resampler.processResponses(left).leftCols(length);
+        right = resampler.processResponses(right).leftCols(length);
+        return true;
+    }
+
+    // ==================================================================================== //
+    // Decoder cache
+    // ==================================================================================== //
+
+    std::string getDecoderCachePath(std::string const& directory, DecoderCacheKey const& key)
+    {
+        char name[128];
+        std::snprintf(name, sizeof(name), "hoa_decoder_%016llx_o%u_sr%u_p%u.bin",
+                      static_cast<unsigned long long>(key.hrir_hash),
+                      key.order, key.sample_rate, key.partition_size);
+
+        if(directory.empty() || directory.back() == '/' || directory.back() == '\\')
+            return directory + name;
+
+        return directory + '/' + name;
+    }
+
+    std::unique_ptr<PartitionedConvolver> loadDecoderCache(std::string const& directory,
+                                                           DecoderCacheKey const& key)
+    {
+        MappedFile file(getDecoderCachePath(directory, key));
+
+        cache_header_t header;
+        if(!file.isValid() || file.getSize() < sizeof(header))
+            return nullptr;
+
+        std::memcpy(&header, file.getData(), sizeof(header));
+
+        if(std::memcmp(header.magic, k_cache_magic, sizeof(k_cache_magic)) != 0
+           || header.version != k_decoder_cache_version
+           || header.hrir_hash != key.hrir_hash
+           || header.order != key.order
+           || header.sample_rate != key.sample_rate
+           || header.partition_size != key.partition_size)
+            return nullptr;
+
+        return PartitionedConvolver::readFilters(file.getData() + sizeof(header),
+                                                 file.getSize() - sizeof(header),
+                                                 key.partition_size,
+                                                 (key.order + 1) * (key.order + 1));
+    }
+
+    bool saveDecoderCache(std::string const& directory, DecoderCacheKey const& key,
+                          PartitionedConvolver const& decoder)
+    {
+        const auto path = getDecoderCachePath(directory, key);
+        const auto temporary_path = path + ".tmp";
+
+        std::FILE* file = std::fopen(temporary_path.c_str(), "wb");
+        if(file == nullptr)
+            return false;
+
+        cache_header_t header;
+        std::memcpy(header.magic, k_cache_magic, sizeof(k_cache_magic));
+        header.version = k_decoder_cache_version;
+        header.order = key.order;
+        header.hrir_hash = key.hrir_hash;
+        header.sample_rate = key.sample_rate;
+        header.partition_size = key.partition_size;
+
+        bool written = (std::fwrite(&header, sizeof(header), 1, file) == 1) && decoder.writeFilters(file);
+        written = (std::fclose(file) == 0) && written;
+
+#if defined(_WIN32)
+        // rename does not replace an existing file on windows.
+        if(written)
+        {
+            std::remove(path.c_str());
+        }
+#endif
+
+        if(!written || std::rename(temporary_path.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temporary_path.c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+    std::unique_ptr<PartitionedConvolver> createHrirDecoder(std::string const& path,
+                                                            std::string const& cache_directory,
+                                                            size_t order, size_t partition_size,
+                                                            double sample_rate)
+    {
+        HrirSet hrir(path);
+        if(!hrir.isValid())
+            return nullptr;
+
+        const double hrir_rate = hrir.getSampleRate();
+        if(sample_rate <= 0.)
+        {
+            sample_rate = hrir_rate;
+        }
+
+        DecoderCacheKey key;
+        key.hrir_hash = hrir.getHash();
+        key.order = static_cast<uint32_t>(order);
+        key.sample_rate = static_cast<uint32_t>(std::lround(sample_rate));
+        key.partition_size = static_cast<uint32_t>(partition_size);
+
+        if(!cache_directory.empty())
+        {
+            if(auto decoder = loadDecoderCache(cache_directory, key))
+                return decoder;
+        }
+
+        PartitionedConvolver::matrix_t left, right;
+        if(!computeDecodingFilters(hrir, order, left, right))
+            return nullptr;
+
+        if(key.sample_rate != static_cast<uint32_t>(std::lround(hrir_rate))
+           && !resampleDecodingFilters(left, right, hrir_rate, sample_rate))
+            return nullptr;
+
+        auto decoder = std::make_unique<PartitionedConvolver>(partition_size, left, right);
+
+        if(!cache_directory.empty())
+        {
+            saveDecoderCache(cache_directory, key, *decoder);
+        }
+
+        return decoder;
+    }
+}
@@ -0,0 +1,181 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#pragma once
+
+#include "HoaLibraryDecoder.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace HoaLibraryUnity
+{
+    // ==================================================================================== //
+    // MappedFile
+    // ==================================================================================== //
+
+    //! @brief A file mapped read-only in memory.
+    class MappedFile
+    {
+    public:
+
+        //! @brief Maps a file, check it with isValid.
+        MappedFile(std::string const& path);
+
+        //! @brief Unmaps the file.
+        ~MappedFile();
+
+        MappedFile(MappedFile const&) = delete;
+        MappedFile& operator=(MappedFile const&) = delete;
+
+        //! @brief Returns false if the file could not be mapped (or is empty).
+        bool isValid() const noexcept { return m_data != nullptr; }
+
+        //! @brief Returns the content of the file.
+        char const* getData() const noexcept { return m_data; }
+
+        //! @brief Returns the size of the file in bytes.
+        size_t getSize() const noexcept { return m_size; }
+
+    private:
+
+        char const* m_data = nullptr;
+        size_t m_size = 0;
+
+#if defined(_WIN32)
+        void* m_file = nullptr;
+        void* m_mapping = nullptr;
+#endif
+    };
+
+    // ==================================================================================== //
+    // HrirSet
+    // ==================================================================================== //
+
+    //! @brief A set of head-related impulse responses measured around the listener.
+    //! @details The file holds the variables of a SOFA SimpleFreeFieldHRIR set without
+    //! its HDF5 container (little endian):
+    //! - header: char[8] "HOAHRIR", uint32 version, uint32 measurements M, uint32 length N,
+    //!   float sample rate.
+    //! - float SourcePosition[M][2]: azimuth and elevation in degrees (SOFA spherical
+    //!   coordinates: azimuth counterclockwise from the front, elevation upward).
+    //! - float Data.IR[M][2][N]: the left and right responses.
+    //! The file stays mapped as long as the set is alive.
+    class HrirSet
+    {
+    public:
+
+        //! @brief Version of the file format.
+        static constexpr uint32_t k_version = 1;
+
+        //! @brief Maps a file, check it with isValid.
+        HrirSet(std::string const& path);
+
+        //! @brief Returns false if the file could not be read or is not a valid HRIR set.
+        bool isValid() const noexcept { return m_positions != nullptr; }
+
+        //! @brief Returns the number of measured directions.
+        size_t getNumberOfMeasurements() const noexcept { return m_num_measurements; }
+
+        //! @brief Returns the number of samples of the responses.
+        size_t getLength() const noexcept { return m_length; }
+
+        //! @brief Returns the sample rate of the responses.
+        float getSampleRate() const noexcept { return m_sample_rate; }
+
+        //! @brief Returns a hash of the content of the file.
+        uint64_t getHash() const noexcept { return m_hash; }
+
+        //! @brief Returns the azimuth of a measurement in radians (hoa coordinates).
+        float getAzimuth(size_t measurement) const;
+
+        //! @brief Returns the elevation of a measurement in radians (hoa coordinates).
+        float getElevation(size_t measurement) const;
+
+        //! @brief Returns the response of an ear (0 for left, 1 for right) of a measurement.
+        float const* getResponse(size_t measurement, size_t ear) const;
+
+    private:
+
+        MappedFile m_file;
+        size_t m_num_measurements = 0;
+        size_t m_length = 0;
+        float m_sample_rate = 0.f;
+        uint64_t m_hash = 0;
+        float const* m_positions = nullptr;
+        float const* m_responses = nullptr;
+    };
+
+    //! @brief Computes the decoding filters of the harmonics that best reproduce an HRIR set.
+    //! @details Least-squares fit (with a small regularization) of the responses by the
+    //! harmonics of the measured directions: a plane wave encoded at any of the measured
+    //! directions and decoded with the filters gives its measured responses.
+    //! The filters are truncated to k_max_decoder_response_length samples.
+    //! @param hrir The HRIR set, it must have more measurements than harmonics.
+    //! @param order The ambisonic order.
+    //! @param left, right Outputs (harmonics x length) filters of each ear.
+    //! @return false if the filters could not be computed.
+    bool computeDecodingFilters(HrirSet const& hrir, size_t order,
+                                PartitionedConvolver::matrix_t& left,
+                                PartitionedConvolver::matrix_t& right);
+
+    //! @brief Resamples decoding filters to another sample rate (see PolyphaseResampler).
+    //! @details The filters are truncated to k_max_decoder_response_length samples.
+    //! @return false if the ratio of the rates is not supported, the filters are then unchanged.
+    bool resampleDecodingFilters(PartitionedConvolver::matrix_t& left,
+                                 PartitionedConvolver::matrix_t& right,
+                                 double source_rate, double target_rate);
+
+    // ==================================================================================== //
+    // Decoder cache
+    // ==================================================================================== //
+
+    //! @brief Identifies the filters spectra of a decoder in the cache.
+    struct DecoderCacheKey
+    {
+        uint64_t hrir_hash = 0;
+        uint32_t order = 0;
+        uint32_t sample_rate = 0;
+        uint32_t partition_size = 0;
+    };
+
+    //! @brief Version of the cache files, files of other versions are recomputed.
+    static constexpr uint32_t k_decoder_cache_version = 1;
+
+    //! @brief Returns the path of the cache file of a decoder.
+    std::string getDecoderCachePath(std::string const& directory, DecoderCacheKey const& key);
+
+    //! @brief Reads a decoder from the cache.
+    //! @return nullptr if the decoder is not in the cache.
+    std::unique_ptr<PartitionedConvolver> loadDecoderCache(std::string const& directory,
+                                                           DecoderCacheKey const& key);
+
+    //! @brief Writes a decoder to the cache.
+    //! @details The file is written next to its final path then renamed, so that another
+    //! process never maps a partially written file.
+    bool saveDecoderCache(std::string const& directory, DecoderCacheKey const& key,
+                          PartitionedConvolver const& decoder);
+
+    //! @brief Creates the partitioned decoder of an HRIR set.
+    //! @details The decoder is read from the cache if it was already computed,
+    //! otherwise its filters are computed and resampled (which can take a while) and cached.
+    //! @param path The HRIR set file (see HrirSet).
+    //! @param cache_directory The directory of the cache (empty to disable the cache).
+    //! @param order The ambisonic order.
+    //! @param partition_size The partition size of the decoder.
+    //! @param sample_rate The sample rate of the decoder (0 for the one of the HRIR set).
+    //! @return nullptr if the HRIR set is not valid or can't be resampled.
+    std::unique_ptr<PartitionedConvolver> createHrirDecoder(std::string const& path,
+                                                            std::string const& cache_directory,
+                                                            size_t order, size_t partition_size,
+                                                            double sample_rate);
+}
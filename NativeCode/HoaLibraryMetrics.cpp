@@ -0,0 +1,175 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#include "HoaLibraryMetrics.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <thread>
+
+namespace HoaLibraryUnity
+{
+    MetricsRecorder::MetricsRecorder(size_t window)
+    : m_window(std::max<size_t>(window, 1))
+    {
+        for(auto& values : m_values)
+        {
+            values.assign(m_window, 0.f);
+        }
+
+        m_sorted.resize(m_window);
+    }
+
+    void MetricsRecorder::record(BlockTimings const& timings)
+    {
+        m_last[Block] = static_cast<float>(timings.block_us);
+        m_last[Encode] = static_cast<float>(timings.encode_us);
+        m_last[Decode] = static_cast<float>(timings.decode_us);
+        m_last[SourceCost] = timings.sources > 0 ? static_cast<float>(timings.encode_us / timings.sources) : 0.f;
+        m_last[Load] = timings.period_us > 0. ? static_cast<float>(timings.block_us * 100. / timings.period_us) : 0.f;
+
+        for(size_t measure = 0; measure < NumMeasures; ++measure)
+        {
+            m_values[measure][m_position] = m_last[measure];
+        }
+
+        m_position = (m_position + 1) % m_window;
+        m_count = std::min(m_count + 1, m_window);
+        m_sources = timings.sources;
+        m_quality_level = timings.quality_level;
+        m_quality_changes = timings.quality_changes;
+        ++m_blocks;
+
+        if(m_blocks % k_metrics_publish_interval == 0)
+        {
+            publish();
+        }
+    }
+
+    MetricStatistics MetricsRecorder::computeStatistics(Measure measure)
+    {
+        auto const& values = m_values[measure];
+
+        MetricStatistics statistics;
+        statistics.last = m_last[measure];
+
+        // the window starts filled with the first blocks only.
+        const auto begin = m_sorted.begin();
+        const auto end = begin + static_cast<std::ptrdiff_t>(m_count);
+        std::copy_n(values.begin(), m_count, begin);
+
+        double sum = 0.;
+        float max = 0.f;
+        for(auto it = begin; it != end; ++it)
+        {
+            sum += *it;
+            max = std::max(max, *it);
+        }
+
+        statistics.mean = static_cast<float>(sum / m_count);
+        statistics.max = max;
+
+        const size_t rank = (m_count * 99 + 99) / 100 - 1;
+        std::nth_element(begin, begin + static_cast<std::ptrdiff_t>(rank), end);
+        statistics.p99 = *(begin + static_cast<std::ptrdiff_t>(rank));
+
+        return statistics;
+    }
+
+    void MetricsRecorder::publish()
+    {
+        DspMetrics metrics;
+        metrics.block_time = computeStatistics(Block);
+        metrics.encode_time = computeStatistics(Encode);
+        metrics.decode_time = computeStatistics(Decode);
+        metrics.source_cost = computeStatistics(SourceCost);
+        metrics.dsp_load = computeStatistics(Load);
+        metrics.sources = static_cast<float>(m_sources);
+        metrics.blocks = m_blocks;
+        metrics.quality_level = m_quality_level;
+        metrics.quality_changes = m_quality_changes;
+
+        m_metrics.store(metrics);
+    }
+
+    DspMetrics MetricsRecorder::getMetrics() const
+    {
+        // the recording thread is never blocked, the reader retries while it writes.
+        DspMetrics metrics;
+        while(!m_metrics.load(metrics))
+        {
+            std::this_thread::yield();
+        }
+
+        return metrics;
+    }
+
+    bool get_metrics_buffer(DspMetrics const& metrics, const char* name, float* buffer, int numsamples)
+    {
+        if(name == nullptr || buffer == nullptr || numsamples <= 0)
+            return false;
+
+        MetricStatistics const* statistics = nullptr;
+        if(std::strcmp(name, "BlockTime") == 0)
+            statistics = &metrics.block_time;
+        else if(std::strcmp(name, "EncodeTime") == 0)
+            statistics = &metrics.encode_time;
+        else if(std::strcmp(name, "DecodeTime") == 0)
+            statistics = &metrics.decode_time;
+        else if(std::strcmp(name, "SourceCost") == 0)
+            statistics = &metrics.source_cost;
+        else if(std::strcmp(name, "DspLoad") == 0)
+            statistics = &metrics.dsp_load;
+
+        std::array<float, 4> values {};
+        size_t count = 0;
+        if(statistics)
+        {
+            values = {{ statistics->last, statistics->mean, statistics->max, statistics->p99 }};
+            count = 4;
+        }
+        else if(std::strcmp(name, "Sources") == 0)
+        {
+            values = {{ metrics.sources }};
+            count = 1;
+        }
+        else if(std::strcmp(name, "Quality") == 0)
+        {
+            values = {{ static_cast<float>(metrics.quality_level), static_cast<float>(metrics.quality_changes) }};
+            count = 2;
+        }
+        else if(std::strcmp(name, "Inputs") == 0)
+        {
+            values = {{
+                static_cast<float>(metrics.concealed_blocks), static_cast<float>(metrics.duplicated_blocks),
+                static_cast<float>(metrics.dropped_blocks)
+            }};
+            count = 3;
+        }
+        else if(std::strcmp(name, "Voices") == 0)
+        {
+            values = {{
+                static_cast<float>(metrics.rendered_voices), static_cast<float>(metrics.culled_voices),
+                static_cast<float>(metrics.silent_voices)
+            }};
+            count = 3;
+        }
+        else
+        {
+            return false;
+        }
+
+        std::fill(buffer, buffer + numsamples, 0.f);
+        std::copy_n(values.begin(), std::min(count, static_cast<size_t>(numsamples)), buffer);
+        return true;
+    }
+}
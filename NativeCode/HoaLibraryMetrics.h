@@ -0,0 +1,137 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#pragma once
+
+#include "HoaLibrarySeqLock.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace HoaLibraryUnity
+{
+    //! @brief Default number of blocks the statistics of the metrics are computed over.
+    static constexpr size_t k_default_metrics_window = 256;
+
+    //! @brief Number of blocks between two publications of the metrics.
+    static constexpr size_t k_metrics_publish_interval = 8;
+
+    //! @brief Statistics of a measure over the window of the last blocks.
+    struct MetricStatistics
+    {
+        float last = 0.f;
+        float mean = 0.f;
+        float max = 0.f;
+        float p99 = 0.f;
+    };
+
+    //! @brief DSP load metrics of a renderer or of a spatializer.
+    struct DspMetrics
+    {
+        MetricStatistics block_time {};     //!< microseconds of the whole block.
+        MetricStatistics encode_time {};    //!< microseconds encoding the sources.
+        MetricStatistics decode_time {};    //!< microseconds decoding the soundfield.
+        MetricStatistics source_cost {};    //!< microseconds of encoding per encoded source.
+        MetricStatistics dsp_load {};       //!< block time in percent of the block period.
+        float sources = 0.f;                //!< sources encoded in the last block.
+        uint32_t blocks = 0;                //!< blocks recorded since the creation.
+        int32_t quality_level = 0;          //!< adaptive quality level of the last block (see QualityLevel).
+        uint32_t quality_changes = 0;       //!< adaptive quality decisions since the creation.
+        uint64_t concealed_blocks = 0;      //!< source input gaps concealed since the creation.
+        uint64_t duplicated_blocks = 0;     //!< source input blocks passed twice for a dsp tick.
+        uint64_t dropped_blocks = 0;        //!< source input blocks never rendered.
+        uint32_t rendered_voices = 0;       //!< sources encoded in the last block.
+        uint32_t culled_voices = 0;         //!< sources culled by the encoding budget in the last block.
+        uint32_t silent_voices = 0;         //!< sources skipped in the last block, their input was silent.
+    };
+
+    //! @brief The timings of a block.
+    struct BlockTimings
+    {
+        double block_us = 0.;
+        double encode_us = 0.;
+        double decode_us = 0.;
+        size_t sources = 0;
+        double period_us = 0.;              //!< duration of the block.
+        int quality_level = 0;
+        uint32_t quality_changes = 0;
+    };
+
+    //! @brief Returns the microseconds elapsed since a time point.
+    inline double get_elapsed_us(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    //! @brief Records the timings of the blocks of the audio thread and publishes their statistics.
+    //! @details The timings are kept in a ring buffer of a window of blocks, allocated at construction.
+    //! Every few blocks the last, mean, max and 99th percentile of each measure are computed and
+    //! published through a SeqLock, so that any thread can poll them without blocking the audio thread.
+    class MetricsRecorder
+    {
+    public:
+
+        //! @brief Constructor
+        //! @param window Number of blocks of the statistics.
+        MetricsRecorder(size_t window = k_default_metrics_window);
+
+        ~MetricsRecorder() = default;
+
+        //! @brief Records the timings of a block (a single thread, usually the audio thread).
+        void record(BlockTimings const& timings);
+
+        //! @brief Returns the last published metrics (any thread but the recording one).
+        DspMetrics getMetrics() const;
+
+    private:
+
+        enum Measure
+        {
+            Block,
+            Encode,
+            Decode,
+            SourceCost,
+            Load,
+            NumMeasures
+        };
+
+        void publish();
+
+        MetricStatistics computeStatistics(Measure measure);
+
+    private:
+
+        const size_t m_window;
+        std::array<std::vector<float>, NumMeasures> m_values {};
+        std::array<float, NumMeasures> m_last {};
+        std::vector<float> m_sorted {};
+        size_t m_position = 0;
+        size_t m_count = 0;
+        size_t m_sources = 0;
+        uint32_t m_blocks = 0;
+        int m_quality_level = 0;
+        uint32_t m_quality_changes = 0;
+
+        SeqLock<DspMetrics> m_metrics {};
+    };
+
+    //! @brief Copies a named metric to a buffer, for the GetFloatBuffer callbacks of the plugins.
+    //! @details The names are "BlockTime", "EncodeTime", "DecodeTime", "SourceCost" (microseconds)
+    //! and "DspLoad" (percent), each one as { last, mean, max, p99 }, "Sources" as { count }
+    //! "Quality" as { level, changes }, "Inputs" as { concealed, duplicated, dropped }
+    //! (the source input blocks counted by the renderer since its creation, see InputStatistics)
+    //! and "Voices" as { rendered, culled, silent } (the last block, see VoiceStatistics).
+    //! The samples above the values are set to zero.
+    //! @return false if the name is unknown.
+    bool get_metrics_buffer(DspMetrics const& metrics, const char* name, float* buffer, int numsamples);
+}
@@ -0,0 +1,265 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#include "HoaLibraryNearField.h"
+#include "HoaLibrarySpeakers.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <complex>
+
+namespace HoaLibraryUnity
+{
+    namespace
+    {
+        //! @brief Returns the roots of the Bessel polynomial of a degree,
+        //! the complex ones once with their imaginary part positive.
+        std::vector<std::complex<double>> get_bessel_roots(size_t degree)
+        {
+            // y_n(x) = sum_k (n + k)! / ((n - k)! k! 2^k) x^k
+            std::vector<double> coefficients(degree + 1);
+            for(size_t k = 0; k <= degree; ++k)
+            {
+                double value = 1.;
+                for(size_t i = degree - k + 1; i <= degree + k; ++i)
+                {
+                    value *= static_cast<double>(i);
+                }
+
+                for(size_t i = 1; i <= k; ++i)
+                {
+                    value /= 2. * i;
+                }
+
+                coefficients[k] = value;
+            }
+
+            // the eigenvalues of the companion matrix of the monic polynomial.
+            Eigen::MatrixXd companion = Eigen::MatrixXd::Zero(degree, degree);
+            for(size_t i = 0; i < degree; ++i)
+            {
+                companion(0, i) = -coefficients[degree - 1 - i] / coefficients[degree];
+                if(i + 1 < degree)
+                {
+                    companion(i + 1, i) = 1.;
+                }
+            }
+
+            const Eigen::EigenSolver<Eigen::MatrixXd> solver(companion, false);
+            auto const& eigenvalues = solver.eigenvalues();
+
+            std::vector<std::complex<double>> roots;
+            for(Eigen::Index i = 0; i < eigenvalues.size(); ++i)
+            {
+                const auto root = eigenvalues[i];
+                if(root.imag() >= 0.)
+                {
+                    roots.push_back(std::abs(root.imag()) < 1e-9 ? std::complex<double>(root.real(), 0.) : root);
+                }
+            }
+
+            // the pairs first, the real root of the odd degrees last.
+            std::sort(roots.begin(), roots.end(), [](std::complex<double> const& lhs, std::complex<double> const& rhs) {
+                return lhs.imag() > rhs.imag();
+            });
+
+            return roots;
+        }
+    }
+
+    // ==================================================================================== //
+    // NearFieldBatch
+    // ==================================================================================== //
+
+    NearFieldBatch::NearFieldBatch(size_t order, size_t sections, size_t max_lanes, size_t vectorsize)
+    : order_lanes(order, 0)
+    , m_order(order)
+    , m_sections(sections)
+    , m_max_lanes(max_lanes)
+    , m_vectorsize(vectorsize)
+    , m_lanes(max_lanes)
+    , m_inputs(max_lanes * vectorsize, 0.f)
+    , m_numerators(max_lanes * 3 * sections, 0.f)
+    , m_states(max_lanes * 2 * sections, 0.f)
+    , m_outputs(order * max_lanes * vectorsize, 0.f)
+    {}
+
+    void NearFieldBatch::setLanes(size_t lanes)
+    {
+        assert(lanes <= m_max_lanes);
+        m_lanes = std::min(lanes, m_max_lanes);
+    }
+
+    // ==================================================================================== //
+    // NearFieldFilters
+    // ==================================================================================== //
+
+    NearFieldFilters::NearFieldFilters(size_t order, double radius, double max_boost, double sample_rate)
+    : m_order(order)
+    , m_radius(std::max<double>(radius, k_min_near_field_distance))
+    , m_sample_rate(sample_rate)
+    {
+        const double k = 2. * m_sample_rate;
+
+        m_min_distances.resize(order + 1, k_min_near_field_distance);
+        m_order_sections.resize(order + 2, 0);
+
+        for(size_t m = 1; m <= order; ++m)
+        {
+            // (R / r)^m <= max_boost
+            m_min_distances[m] = std::max<double>(m_radius * std::pow(10., -std::max(max_boost, 0.) / (20. * m)),
+                                                  k_min_near_field_distance);
+            m_order_sections[m] = m_sections.size();
+
+            for(auto const& root : get_bessel_roots(m))
+            {
+                Section section;
+                section.order = m;
+                section.root_real = root.real();
+                section.root_imag = root.imag();
+                section.first_order = (root.imag() == 0.);
+
+                double c1, c0;
+                getAnalogFactor(section, m_radius, c1, c0);
+
+                // bilinear transform of the poles: s = k (1 - z^-1) / (1 + z^-1)
+                if(section.first_order)
+                {
+                    const double a0 = k + c0;
+                    section.inverse_a0 = 1. / a0;
+                    section.a1 = static_cast<float_t>((c0 - k) / a0);
+                    section.a2 = 0.f;
+                }
+                else
+                {
+                    const double a0 = k * k + c1 * k + c0;
+                    section.inverse_a0 = 1. / a0;
+                    section.a1 = static_cast<float_t>(2. * (c0 - k * k) / a0);
+                    section.a2 = static_cast<float_t>((k * k - c1 * k + c0) / a0);
+                }
+
+                m_sections.push_back(section);
+            }
+        }
+
+        m_order_sections[order + 1] = m_sections.size();
+    }
+
+    void NearFieldFilters::getAnalogFactor(Section const& section, double distance, double& c1, double& c0) const
+    {
+        // a root x of the Bessel polynomial gives a zero or a pole at q = c / (distance x).
+        const std::complex<double> q = k_speed_of_sound / (distance * std::complex<double>(section.root_real,
+                                                                                            section.root_imag));
+        if(section.first_order)
+        {
+            c1 = 0.;
+            c0 = -q.real();
+        }
+        else
+        {
+            c1 = -2. * q.real();
+            c0 = std::norm(q);
+        }
+    }
+
+    void NearFieldFilters::computeNumerators(float_t distance, float_t* numerators, size_t stride) const
+    {
+        const double k = 2. * m_sample_rate;
+
+        for(size_t index = 0; index < m_sections.size(); ++index)
+        {
+            auto const& section = m_sections[index];
+            const double r = std::max<double>(distance, m_min_distances[section.order]);
+
+            double c1, c0;
+            getAnalogFactor(section, r, c1, c0);
+
+            double b0, b1, b2;
+            if(section.first_order)
+            {
+                b0 = k + c0;
+                b1 = c0 - k;
+                b2 = 0.;
+            }
+            else
+            {
+                b0 = k * k + c1 * k + c0;
+                b1 = 2. * (c0 - k * k);
+                b2 = k * k - c1 * k + c0;
+            }
+
+            numerators[(3 * index) * stride] = static_cast<float_t>(b0 * section.inverse_a0);
+            numerators[(3 * index + 1) * stride] = static_cast<float_t>(b1 * section.inverse_a0);
+            numerators[(3 * index + 2) * stride] = static_cast<float_t>(b2 * section.inverse_a0);
+        }
+    }
+
+    void NearFieldFilters::process(NearFieldBatch& batch, size_t frames) const
+    {
+        const size_t lanes = batch.getLanes();
+        auto inputs = batch.inputs();
+        auto numerators = batch.numerators();
+        auto states = batch.states();
+        auto outputs = batch.outputs();
+
+        const size_t output_stride = m_order * lanes;
+        const size_t coefficient_stride = lanes;
+
+        for(size_t m = 1; m <= m_order; ++m)
+        {
+            const size_t count = std::min(batch.order_lanes[m - 1], lanes);
+            if(count == 0)
+                break;
+
+            const size_t first_row = (m - 1) * lanes;
+            outputs.block(first_row, 0, count, frames) = inputs.topLeftCorner(count, frames);
+
+            // each section runs over the whole block in place, one frame of all the lanes at a time.
+            for(size_t index = m_order_sections[m]; index < m_order_sections[m + 1]; ++index)
+            {
+                auto const& section = m_sections[index];
+                const float_t a1 = section.a1;
+                const float_t a2 = section.a2;
+
+                float_t const* b0 = numerators.data() + (3 * index) * coefficient_stride;
+                float_t const* b1 = b0 + coefficient_stride;
+                float_t const* b2 = b1 + coefficient_stride;
+                float_t* s1 = states.data() + (2 * index) * coefficient_stride;
+                float_t* s2 = s1 + coefficient_stride;
+
+                for(size_t frame = 0; frame < frames; ++frame)
+                {
+                    float_t* x = outputs.data() + frame * output_stride + first_row;
+
+                    for(size_t lane = 0; lane < count; ++lane)
+                    {
+                        const float_t input = x[lane];
+                        const float_t output = b0[lane] * input + s1[lane];
+                        s1[lane] = b1[lane] * input - a1 * output + s2[lane];
+                        s2[lane] = b2[lane] * input - a2 * output;
+                        x[lane] = output;
+                    }
+                }
+            }
+        }
+    }
+
+    void NearFieldFilters::clearStates(NearFieldBatch& batch, size_t lane, size_t order) const
+    {
+        auto states = batch.states();
+        for(size_t index = m_order_sections[std::min(order, m_order) + 1]; index < m_sections.size(); ++index)
+        {
+            states(lane, 2 * index) = 0.f;
+            states(lane, 2 * index + 1) = 0.f;
+        }
+    }
+}
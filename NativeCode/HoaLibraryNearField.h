@@ -0,0 +1,184 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#pragma once
+
+#include <Eigen/Dense>
+
+#include <cstddef>
+#include <vector>
+
+namespace HoaLibraryUnity
+{
+    //! @brief Default reference radius of the near-field compensation in meters.
+    static constexpr float k_default_near_field_radius = 1.f;
+
+    //! @brief Default maximum low frequency boost of a near-field filter in dB.
+    static constexpr float k_default_near_field_max_boost = 24.f;
+
+    //! @brief Shortest distance of a source for the near-field filters in meters.
+    static constexpr float k_min_near_field_distance = 0.01f;
+
+    //! @brief Settings of the near-field compensation of an instance.
+    struct NearFieldSettings
+    {
+        //! Filters the harmonics of the sources with their distance.
+        bool enabled = false;
+
+        //! The radius the soundfield is reproduced at in meters, the distance of the speakers
+        //! or of the HRIR measurements (0 for the farthest speaker of the layout if it has
+        //! distances, k_default_near_field_radius otherwise).
+        float radius = 0.f;
+
+        //! The low frequency boost of the nearest sources is limited to this gain in dB.
+        float max_boost = k_default_near_field_max_boost;
+    };
+
+    // ==================================================================================== //
+    // NearFieldBatch
+    // ==================================================================================== //
+
+    //! @brief The signals and the filter states of lanes (sources) filtered together.
+    //! @details All the matrices hold one lane per row so that a column, a frame or a
+    //! coefficient of all the lanes, is contiguous and the lanes are processed as vectors.
+    //! The lanes are packed: the matrices are as high as the number of lanes of the block,
+    //! not as the maximum one, so that the columns of a block stay close in memory.
+    class NearFieldBatch
+    {
+    public:
+
+        using matrix_t = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic>;
+        using map_t = Eigen::Map<matrix_t>;
+        using const_map_t = Eigen::Map<const matrix_t>;
+
+        //! @brief Allocates the buffers of a number of lanes.
+        //! @param order The order of the filters.
+        //! @param sections The number of sections of the filters.
+        NearFieldBatch(size_t order, size_t sections, size_t max_lanes, size_t vectorsize);
+
+        //! @brief Sets the number of lanes of the next block (at most max_lanes).
+        //! @details The layout of the matrices changes with it, all the lanes are gathered again.
+        void setLanes(size_t lanes);
+
+        //! @brief Returns the number of lanes.
+        size_t getLanes() const noexcept { return m_lanes; }
+
+        //! @brief (lanes x frames) signals.
+        map_t inputs() { return map_t(m_inputs.data(), m_lanes, m_vectorsize); }
+
+        //! @brief (lanes x 3 * sections) b0, b1, b2 of each section.
+        map_t numerators() { return map_t(m_numerators.data(), m_lanes, 3 * m_sections); }
+
+        //! @brief (lanes x 2 * sections) transposed direct form II states.
+        map_t states() { return map_t(m_states.data(), m_lanes, 2 * m_sections); }
+        const_map_t states() const { return const_map_t(m_states.data(), m_lanes, 2 * m_sections); }
+
+        //! @brief (order * lanes x frames) filtered signals, the lanes of order m from row (m - 1) * lanes.
+        map_t outputs() { return map_t(m_outputs.data(), m_order * m_lanes, m_vectorsize); }
+        const_map_t outputs() const { return const_map_t(m_outputs.data(), m_order * m_lanes, m_vectorsize); }
+
+        //! @brief Per order m (index m - 1), the number of first lanes filtered.
+        std::vector<size_t> order_lanes;
+
+    private:
+
+        const size_t m_order;
+        const size_t m_sections;
+        const size_t m_max_lanes;
+        const size_t m_vectorsize;
+        size_t m_lanes;
+
+        std::vector<float> m_inputs {};
+        std::vector<float> m_numerators {};
+        std::vector<float> m_states {};
+        std::vector<float> m_outputs {};
+    };
+
+    // ==================================================================================== //
+    // NearFieldFilters
+    // ==================================================================================== //
+
+    //! @brief Near-field compensation (NFC-HOA) filters of the harmonics of a source.
+    //! @details The harmonics of order m of a point source at distance r, reproduced at the
+    //! radius R, are the plane wave harmonics filtered by H_m(s) = F_m(s r / c) / F_m(s R / c),
+    //! where F_m is the near field term, a polynomial in 1 / s whose roots are given by the
+    //! roots of the Bessel polynomial of degree m (Daniel 2003). H_m is stable for any r,
+    //! it boosts (r < R) or cuts (r > R) the low frequencies by (R / r)^m and is flat above.
+    //! It is discretized with the bilinear transform as a cascade of second order sections
+    //! (and a first order one for the odd orders). The poles only depend on R: they are
+    //! shared by all the sources, only the numerators are computed from the distances,
+    //! at block rate. The sources are filtered in batches of lanes, all the harmonics of
+    //! an order of a source share the same filter so that it runs on its mono input.
+    class NearFieldFilters
+    {
+    public:
+
+        using float_t = float;
+
+        //! @brief Constructor
+        //! @param order The highest order.
+        //! @param radius The reference radius in meters.
+        //! @param max_boost The maximum low frequency boost in dB.
+        //! @param sample_rate The sample rate.
+        NearFieldFilters(size_t order, double radius, double max_boost, double sample_rate);
+
+        ~NearFieldFilters() = default;
+
+        //! @brief Returns the highest order.
+        size_t getOrder() const noexcept { return m_order; }
+
+        //! @brief Returns the reference radius in meters.
+        double getRadius() const noexcept { return m_radius; }
+
+        //! @brief Returns the number of sections of the filters of all the orders.
+        size_t getNumberOfSections() const noexcept { return m_sections.size(); }
+
+        //! @brief Computes the numerators of the sections for a distance.
+        //! @param numerators 3 * sections coefficients.
+        //! @param stride Distance between two coefficients.
+        void computeNumerators(float_t distance, float_t* numerators, size_t stride) const;
+
+        //! @brief Filters the lanes of a batch.
+        //! @details The inputs of each lane are filtered by the filters of the orders 1 to
+        //! order_lanes, the outputs of the orders above are not written.
+        //! @param batch The batch, its order_lanes must be decreasing.
+        //! @param frames The number of frames.
+        void process(NearFieldBatch& batch, size_t frames) const;
+
+        //! @brief Clears the states of the orders above an order in a lane.
+        void clearStates(NearFieldBatch& batch, size_t lane, size_t order) const;
+
+    private:
+
+        //! @brief A second order section, or a first order one when the second root is not used.
+        struct Section
+        {
+            size_t order;                   // the order of the filter of the section.
+            double root_real, root_imag;    // a root of the Bessel polynomial (imag >= 0).
+            bool first_order;
+            double inverse_a0;              // normalization of the numerators.
+            float_t a1, a2;                 // the shared denominator.
+        };
+
+        //! @brief Returns the analog (s^2 + c1 s + c0) or (s + c0) factor of a root
+        //! at a distance, the zeros (source distance) or the poles (reference radius).
+        void getAnalogFactor(Section const& section, double distance, double& c1, double& c0) const;
+
+    private:
+
+        const size_t m_order;
+        const double m_radius;
+        const double m_sample_rate;
+        std::vector<double> m_min_distances {};   // per order, the distance of the maximum boost
+        std::vector<Section> m_sections {};
+        std::vector<size_t> m_order_sections {};  // per order, the index of its first section
+    };
+}
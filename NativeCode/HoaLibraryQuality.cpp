@@ -0,0 +1,127 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#include "HoaLibraryQuality.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace HoaLibraryUnity
+{
+    void QualityController::setSettings(QualitySettings const& settings)
+    {
+        m_settings = settings;
+        m_settings.pressure_blocks = std::max<size_t>(m_settings.pressure_blocks, 1);
+        m_settings.recovery_blocks = std::max<size_t>(m_settings.recovery_blocks, 1);
+
+        if(!m_settings.enabled && m_level != 0)
+        {
+            setLevel(0, 0.);
+        }
+
+        m_pressure = 0;
+        m_recovery = 0;
+    }
+
+    bool QualityController::update(double block_us, double period_us)
+    {
+        ++m_blocks;
+
+        if(!m_settings.enabled || period_us <= 0.)
+            return false;
+
+        const double load = block_us / period_us;
+
+        if(load > m_settings.high_load)
+        {
+            ++m_pressure;
+            m_recovery = 0;
+
+            // a single overrun (a page fault, a preemption) is not a reason to degrade,
+            // only a persistent load is.
+            if(m_pressure >= m_settings.pressure_blocks && m_level < k_max_quality_level)
+            {
+                setLevel(m_level + 1, load);
+                return true;
+            }
+        }
+        else if(load < m_settings.low_load)
+        {
+            ++m_recovery;
+            m_pressure = 0;
+
+            if(m_recovery >= m_settings.recovery_blocks && m_level > 0)
+            {
+                setLevel(m_level - 1, load);
+                return true;
+            }
+        }
+        else
+        {
+            m_pressure = 0;
+            m_recovery = 0;
+        }
+
+        return false;
+    }
+
+    void QualityController::setLevel(int level, double load)
+    {
+        m_level = level;
+        m_pressure = 0;
+        m_recovery = 0;
+
+        QualityEvent event;
+        event.block = m_blocks;
+        event.level = level;
+        event.load = static_cast<float>(load * 100.);
+
+        // the oldest decision is dropped once the log is full.
+        if(m_log.count >= k_quality_log_size)
+        {
+            std::rotate(m_log.events.begin(), m_log.events.begin() + 1, m_log.events.end());
+        }
+
+        m_log.events[std::min<size_t>(m_log.count, k_quality_log_size - 1)] = event;
+        ++m_log.count;
+
+        m_published_log.store(m_log);
+    }
+
+    QualityLog QualityController::getLog() const
+    {
+        // the audio thread is never blocked, the reader retries while it writes.
+        QualityLog log;
+        while(!m_published_log.load(log))
+        {
+            std::this_thread::yield();
+        }
+
+        return log;
+    }
+
+    void get_quality_log_buffer(QualityLog const& log, float* buffer, int numsamples)
+    {
+        if(buffer == nullptr || numsamples <= 0)
+            return;
+
+        std::fill(buffer, buffer + numsamples, 0.f);
+
+        const size_t events = std::min<size_t>(log.count, k_quality_log_size);
+        const size_t samples = static_cast<size_t>(numsamples);
+        for(size_t i = 0; i < events && (i + 1) * 3 <= samples; ++i)
+        {
+            buffer[i * 3] = static_cast<float>(log.events[i].block);
+            buffer[i * 3 + 1] = static_cast<float>(log.events[i].level);
+            buffer[i * 3 + 2] = log.events[i].load;
+        }
+    }
+}
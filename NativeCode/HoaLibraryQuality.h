@@ -0,0 +1,150 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#pragma once
+
+#include "HoaLibrarySeqLock.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace HoaLibraryUnity
+{
+    //! @brief Number of decisions kept by a QualityLog.
+    static constexpr size_t k_quality_log_size = 16;
+
+    // ==================================================================================== //
+    // QualityLevel
+    // ==================================================================================== //
+
+    //! @brief The steps of the adaptive quality, each one includes the previous ones.
+    enum class QualityLevel : int
+    {
+        Full = 0,               //!< nothing is degraded.
+        NoLowPriorityOptim = 1, //!< the low priority sources are encoded without optimization.
+        LowPriorityOrder = 2,   //!< the low priority sources are encoded one order lower.
+        DecoderOrder = 3,       //!< the binaural decoder skips the harmonics of the highest order.
+        Culling = 4,            //!< the encoding budget is cut, each further level cuts it again.
+    };
+
+    //! @brief The lowest quality level, the last culling step.
+    static constexpr int k_max_quality_level = static_cast<int>(QualityLevel::Culling) + 3;
+
+    //! @brief Fraction of the encoding time kept by each culling level.
+    static constexpr double k_quality_culling_ratio = 0.75;
+
+    //! @brief Settings of the adaptive quality.
+    struct QualitySettings
+    {
+        //! Steps the quality down and up with the DSP load.
+        bool enabled = false;
+
+        //! Load, in fraction of the block period, above which the quality steps down.
+        float high_load = 0.85f;
+
+        //! Load under which the quality steps back up.
+        float low_load = 0.5f;
+
+        //! Consecutive blocks above the high load before a step down (including the blocks
+        //! over their period, an isolated overrun does not step down).
+        size_t pressure_blocks = 4;
+
+        //! Consecutive blocks under the low load before a step up.
+        size_t recovery_blocks = 200;
+
+        //! The sources with a priority under this one are degraded first.
+        float low_priority = 0.5f;
+    };
+
+    // ==================================================================================== //
+    // QualityLog
+    // ==================================================================================== //
+
+    //! @brief A change of the quality level.
+    struct QualityEvent
+    {
+        uint32_t block = 0;     //!< block of the decision since the creation.
+        int32_t level = 0;      //!< the new level.
+        float load = 0.f;       //!< load of the block, in percent of its period.
+    };
+
+    //! @brief The last decisions of a QualityController, the oldest first.
+    struct QualityLog
+    {
+        std::array<QualityEvent, k_quality_log_size> events {};
+        uint32_t count = 0;     //!< decisions since the creation, the last ones are in events.
+    };
+
+    //! @brief Copies a quality log to a buffer, for the GetFloatBuffer callbacks of the plugins.
+    //! @details The events are written as { block, level, load } triplets, the oldest first,
+    //! the samples above the events are set to zero.
+    void get_quality_log_buffer(QualityLog const& log, float* buffer, int numsamples);
+
+    // ==================================================================================== //
+    // QualityController
+    // ==================================================================================== //
+
+    //! @brief Steps the quality of the rendering down when the blocks come close to their
+    //! deadline and back up once they are well under it.
+    //! @details The load of each block is its render time over its period. The level steps down
+    //! after a few consecutive blocks above the high load, an overrun alone does not, then the
+    //! counts restart so that the effect of a step is measured before the next one. It steps up
+    //! only after many blocks under the low load, the gap between the two loads and the two
+    //! durations keeps it from oscillating. The decisions are published through a SeqLock.
+    class QualityController
+    {
+    public:
+
+        QualityController() = default;
+
+        ~QualityController() = default;
+
+        //! @brief Sets the thresholds (audio thread), the level is reset when it is disabled.
+        void setSettings(QualitySettings const& settings);
+
+        //! @brief Returns the settings.
+        QualitySettings const& getSettings() const noexcept { return m_settings; }
+
+        //! @brief Updates the level with the timings of a block (audio thread).
+        //! @param block_us The render time of the block.
+        //! @param period_us The duration of the block.
+        //! @return true if the level changed.
+        bool update(double block_us, double period_us);
+
+        //! @brief Returns the current level (audio thread).
+        int getLevel() const noexcept { return m_level; }
+
+        //! @brief Returns true if the current level includes a step.
+        bool hasLevel(QualityLevel level) const noexcept { return m_level >= static_cast<int>(level); }
+
+        //! @brief Returns the number of level changes since the creation (audio thread).
+        uint32_t getChanges() const noexcept { return m_log.count; }
+
+        //! @brief Returns the last published decisions (any thread but the audio thread).
+        QualityLog getLog() const;
+
+    private:
+
+        void setLevel(int level, double load);
+
+    private:
+
+        QualitySettings m_settings {};
+        int m_level = 0;
+        size_t m_pressure = 0;
+        size_t m_recovery = 0;
+        uint32_t m_blocks = 0;
+
+        QualityLog m_log {};
+        SeqLock<QualityLog> m_published_log {};
+    };
+}
@@ -0,0 +1,364 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#pragma once
+
+#include <assert.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace HoaLibraryUnity
+{
+    // ==================================================================================== //
+    // CommandQueue
+    // ==================================================================================== //
+
+    //! @brief Bounded lock-free multi-producer queue.
+    //! @details Any thread can push, pop must only be called by one consumer at a time.
+    //! (bounded queue with per-cell sequence numbers, see D. Vyukov).
+    template<class T>
+    class CommandQueue
+    {
+    public:
+
+        //! @brief Constructor
+        //! @param capacity Maximum number of commands, rounded up to a power of two.
+        CommandQueue(size_t capacity)
+        {
+            size_t size = 2;
+            while(size < capacity)
+            {
+                size *= 2;
+            }
+
+            m_mask = size - 1;
+            m_cells = std::unique_ptr<cell_t[]>(new cell_t[size]);
+            for(size_t i = 0; i < size; ++i)
+            {
+                m_cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        //! @brief Pushes a command.
+        //! @return false if the queue is full.
+        bool push(T const& value)
+        {
+            size_t position = m_tail.load(std::memory_order_relaxed);
+            for(;;)
+            {
+                auto& cell = m_cells[position & m_mask];
+                const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                const auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+
+                if(diff == 0)
+                {
+                    if(m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        cell.value = value;
+                        cell.sequence.store(position + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if(diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    position = m_tail.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        //! @brief Pops the oldest command.
+        //! @return false if the queue is empty.
+        bool pop(T& value)
+        {
+            const size_t position = m_head.load(std::memory_order_relaxed);
+            auto& cell = m_cells[position & m_mask];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+
+            if(static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position + 1) < 0)
+            {
+                return false;
+            }
+
+            value = cell.value;
+            cell.sequence.store(position + m_mask + 1, std::memory_order_release);
+            m_head.store(position + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+    private:
+
+        struct cell_t
+        {
+            std::atomic<size_t> sequence {0};
+            T value {};
+        };
+
+        size_t m_mask = 0;
+        std::unique_ptr<cell_t[]> m_cells = nullptr;
+        std::atomic<size_t> m_tail {0};
+        std::atomic<size_t> m_head {0};
+    };
+
+    // ==================================================================================== //
+    // SlotRegistry
+    // ==================================================================================== //
+
+    //! @brief Fixed-capacity registry of objects addressed by generation-checked handles.
+    //! @details Objects are created and destroyed from any thread through a lock-free
+    //! command queue that the audio thread applies at the start of each block,
+    //! so that the list of active objects only changes on the audio thread.
+    //! A handle packs a slot index and the generation of the slot when the object was
+    //! created, it resolves in O(1) and becomes invalid as soon as the object is destroyed.
+    template<class T>
+    class SlotRegistry
+    {
+    public:
+
+        using handle_t = int;
+
+        //! @brief Invalid handle.
+        static const handle_t invalid_handle = -1;
+
+        //! @brief Number of bits of the handle used by the slot index.
+        static constexpr unsigned k_index_bits = 16;
+
+        //! @brief Constructor
+        //! @param capacity Maximum number of live objects (at most 2^k_index_bits).
+        SlotRegistry(size_t capacity)
+        : m_capacity(capacity)
+        , m_slots(new slot_t[capacity])
+        , m_commands(2 * capacity)
+        {
+            assert(capacity > 0 && capacity <= (size_t(1) << k_index_bits));
+
+            m_active_slots.reserve(capacity);
+            m_active.reserve(capacity);
+
+            // all slots are free
+            for(size_t i = 0; i < capacity; ++i)
+            {
+                m_slots[i].next.store(static_cast<uint32_t>(i + 1 < capacity ? i + 1 : k_none),
+                                      std::memory_order_relaxed);
+            }
+
+            m_free_head.store(pack(0, 0), std::memory_order_relaxed);
+        }
+
+        //! @brief Returns the maximum number of live objects.
+        size_t getCapacity() const noexcept { return m_capacity; }
+
+        //! @brief Creates an object (any thread).
+        //! @param make A functor returning a std::unique_ptr<T>.
+        //! @return The handle of the object or invalid_handle if the registry is full.
+        template<class Make>
+        handle_t create(Make&& make)
+        {
+            const uint32_t index = popFreeSlot();
+            if(index == k_none)
+                return invalid_handle;
+
+            auto& slot = m_slots[index];
+
+            // the audio thread does not reference free slots,
+            // the object of a previous generation can be replaced here.
+            slot.object = make();
+
+            const uint32_t generation = (slot.generation.load(std::memory_order_relaxed) + 1) & k_generation_mask;
+            slot.generation.store(generation, std::memory_order_release);
+
+            if(!m_commands.push({command_t::Type::Create, index}))
+            {
+                // can't happen: there are at most two pending commands per slot.
+                slot.generation.store((generation + 1) & k_generation_mask, std::memory_order_release);
+                pushFreeSlot(index);
+                return invalid_handle;
+            }
+
+            return static_cast<handle_t>((generation << k_index_bits) | index);
+        }
+
+        //! @brief Destroys an object (any thread).
+        //! @details The handle is invalidated immediately, the object stops being
+        //! active when the audio thread applies the command.
+        bool destroy(handle_t handle)
+        {
+            const uint32_t index = getIndex(handle);
+            if(index == k_none)
+                return false;
+
+            auto& slot = m_slots[index];
+            uint32_t generation = getGeneration(handle);
+
+            // only the first destroy succeeds
+            if(!slot.generation.compare_exchange_strong(generation, (generation + 1) & k_generation_mask,
+                                                        std::memory_order_acq_rel))
+            {
+                return false;
+            }
+
+            const bool pushed = m_commands.push({command_t::Type::Destroy, index});
+            assert(pushed && "there are at most two pending commands per slot");
+            return pushed;
+        }
+
+        //! @brief Resolves a handle (any thread).
+        //! @return The object or nullptr if the handle is not valid anymore.
+        T* get(handle_t handle) const
+        {
+            const uint32_t index = getIndex(handle);
+            if(index == k_none)
+                return nullptr;
+
+            auto const& slot = m_slots[index];
+            if(slot.generation.load(std::memory_order_acquire) != getGeneration(handle))
+                return nullptr;
+
+            return slot.object.get();
+        }
+
+        //! @brief Applies pending creations and destructions (audio thread).
+        //! @param activate Called with each object that becomes active.
+        template<class Activate>
+        void applyCommands(Activate&& activate)
+        {
+            command_t command;
+            while(m_commands.pop(command))
+            {
+                auto& slot = m_slots[command.index];
+
+                if(command.type == command_t::Type::Create)
+                {
+                    assert(slot.active_index == k_none);
+                    slot.active_index = static_cast<uint32_t>(m_active.size());
+                    m_active_slots.push_back(command.index);
+                    m_active.push_back(slot.object.get());
+                    activate(*slot.object);
+                }
+                else
+                {
+                    const uint32_t active_index = slot.active_index;
+                    if(active_index != k_none)
+                    {
+                        // swap with the last active object
+                        const uint32_t last = m_active_slots.back();
+                        m_active_slots[active_index] = last;
+                        m_active[active_index] = m_active.back();
+                        m_slots[last].active_index = active_index;
+                        m_active_slots.pop_back();
+                        m_active.pop_back();
+                        slot.active_index = k_none;
+                    }
+
+                    pushFreeSlot(command.index);
+                }
+            }
+        }
+
+        //! @brief Applies pending creations and destructions (audio thread).
+        void applyCommands()
+        {
+            applyCommands([](T&){});
+        }
+
+        //! @brief Returns the active objects (audio thread).
+        std::vector<T*> const& getActive() const noexcept { return m_active; }
+
+    private:
+
+        static constexpr uint32_t k_none = 0xffffffff;
+        static constexpr uint32_t k_index_mask = (1u << k_index_bits) - 1;
+        static constexpr uint32_t k_generation_mask = (1u << (31 - k_index_bits)) - 1;
+
+        struct slot_t
+        {
+            std::atomic<uint32_t> generation {0};
+            std::atomic<uint32_t> next {k_none};
+            std::unique_ptr<T> object = nullptr;
+            uint32_t active_index = k_none; // audio thread only
+        };
+
+        struct command_t
+        {
+            enum class Type : uint32_t { Create, Destroy };
+            Type type = Type::Create;
+            uint32_t index = 0;
+        };
+
+        uint32_t getIndex(handle_t handle) const
+        {
+            if(handle < 0)
+                return k_none;
+
+            const uint32_t index = static_cast<uint32_t>(handle) & k_index_mask;
+            return index < m_capacity ? index : k_none;
+        }
+
+        static uint32_t getGeneration(handle_t handle)
+        {
+            return (static_cast<uint32_t>(handle) >> k_index_bits) & k_generation_mask;
+        }
+
+        // free list head: ABA tag in the high bits, slot index in the low bits.
+        static uint64_t pack(uint32_t tag, uint32_t index)
+        {
+            return (static_cast<uint64_t>(tag) << 32) | index;
+        }
+
+        uint32_t popFreeSlot()
+        {
+            uint64_t head = m_free_head.load(std::memory_order_acquire);
+            for(;;)
+            {
+                const uint32_t index = static_cast<uint32_t>(head);
+                if(index == k_none)
+                    return k_none;
+
+                const uint32_t next = m_slots[index].next.load(std::memory_order_relaxed);
+                if(m_free_head.compare_exchange_weak(head, pack(static_cast<uint32_t>(head >> 32) + 1, next),
+                                                     std::memory_order_acq_rel, std::memory_order_acquire))
+                {
+                    return index;
+                }
+            }
+        }
+
+        void pushFreeSlot(uint32_t index)
+        {
+            uint64_t head = m_free_head.load(std::memory_order_relaxed);
+            for(;;)
+            {
+                m_slots[index].next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+                if(m_free_head.compare_exchange_weak(head, pack(static_cast<uint32_t>(head >> 32) + 1, index),
+                                                     std::memory_order_release, std::memory_order_relaxed))
+                {
+                    return;
+                }
+            }
+        }
+
+    private:
+
+        const size_t m_capacity;
+        std::unique_ptr<slot_t[]> m_slots;
+        CommandQueue<command_t> m_commands;
+        std::atomic<uint64_t> m_free_head {0};
+
+        // audio thread only
+        std::vector<uint32_t> m_active_slots {};
+        std::vector<T*> m_active {};
+    };
+}
@@ -0,0 +1,147 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#include "HoaLibraryResampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace HoaLibraryUnity
+{
+    namespace
+    {
+        // Kaiser window shape, about -90 dB of stopband attenuation.
+        static const double k_kaiser_beta = 8.6;
+
+        // modified Bessel function of the first kind of order 0
+        double bessel0(double x)
+        {
+            const double half = 0.5 * x;
+            double sum = 1., term = 1.;
+            for(int k = 1; k < 64 && term > 1e-12 * sum; ++k)
+            {
+                const double factor = half / k;
+                term *= factor * factor;
+                sum += term;
+            }
+
+            return sum;
+        }
+
+        uint64_t greatestCommonDivisor(uint64_t a, uint64_t b)
+        {
+            while(b != 0)
+            {
+                const uint64_t rest = a % b;
+                a = b;
+                b = rest;
+            }
+
+            return a;
+        }
+    }
+
+    PolyphaseResampler::PolyphaseResampler(double source_rate, double target_rate, size_t zero_crossings)
+    {
+        const auto source = static_cast<uint64_t>(std::max(std::llround(source_rate), 0ll));
+        const auto target = static_cast<uint64_t>(std::max(std::llround(target_rate), 0ll));
+
+        if(source == 0 || target == 0 || zero_crossings == 0)
+            return;
+
+        const auto divisor = greatestCommonDivisor(source, target);
+        const auto upsampling = static_cast<size_t>(target / divisor);
+        const auto downsampling = static_cast<size_t>(source / divisor);
+
+        if(upsampling > k_max_factor || downsampling > k_max_factor)
+            return;
+
+        // the cutoff is the lowest of the two Nyquist frequencies,
+        // the sinc crosses zero every factor upsampled samples.
+        const size_t factor = std::max(upsampling, downsampling);
+        const double gain = static_cast<double>(upsampling) / factor;
+        const double window_norm = 1. / bessel0(k_kaiser_beta);
+        const double pi = 3.14159265358979323846;
+
+        m_center = zero_crossings * factor;
+        m_num_taps = 2 * m_center / upsampling + 1;
+        m_phases.assign(upsampling * m_num_taps, 0.);
+
+        for(size_t phase = 0; phase < upsampling; ++phase)
+        {
+            for(size_t tap = 0; tap < m_num_taps; ++tap)
+            {
+                const double offset = static_cast<double>(tap * upsampling + phase) - static_cast<double>(m_center);
+                const double position = offset / m_center;
+                if(std::abs(position) > 1.)
+                    continue;
+
+                const double x = pi * offset / factor;
+                const double sinc = (x == 0.) ? 1. : std::sin(x) / x;
+                const double window = bessel0(k_kaiser_beta * std::sqrt(1. - position * position)) * window_norm;
+                m_phases[phase * m_num_taps + tap] = gain * sinc * window;
+            }
+        }
+
+        m_upsampling = upsampling;
+        m_downsampling = downsampling;
+    }
+
+    size_t PolyphaseResampler::getOutputLength(size_t input_length) const noexcept
+    {
+        if(!isValid())
+            return 0;
+
+        return (input_length * m_upsampling + m_downsampling - 1) / m_downsampling;
+    }
+
+    void PolyphaseResampler::process(float_t const* input, size_t input_length, size_t input_stride,
+                                     float_t* output, size_t output_stride) const
+    {
+        const size_t output_length = getOutputLength(input_length);
+
+        for(size_t n = 0; n < output_length; ++n)
+        {
+            // the tap t of the phase multiplies the input sample last - t.
+            const size_t position = n * m_downsampling + m_center;
+            const size_t last = position / m_upsampling;
+            const size_t phase = position - last * m_upsampling;
+            double const* taps = m_phases.data() + phase * m_num_taps;
+
+            const size_t first_tap = (last >= input_length) ? last - input_length + 1 : 0;
+            const size_t end_tap = std::min(m_num_taps, last + 1);
+
+            double sum = 0.;
+            for(size_t tap = first_tap; tap < end_tap; ++tap)
+            {
+                sum += taps[tap] * input[(last - tap) * input_stride];
+            }
+
+            output[n * output_stride] = static_cast<float_t>(sum);
+        }
+    }
+
+    auto PolyphaseResampler::processResponses(matrix_t const& responses) const -> matrix_t
+    {
+        const auto rows = static_cast<size_t>(responses.rows());
+        matrix_t outputs(rows, getOutputLength(responses.cols()));
+
+        for(size_t row = 0; row < rows; ++row)
+        {
+            process(responses.data() + row, responses.cols(), rows, outputs.data() + row, rows);
+        }
+
+        // a response is the sampled impulse response times the sample period.
+        outputs *= static_cast<float_t>(m_downsampling) / static_cast<float_t>(m_upsampling);
+        return outputs;
+    }
+}
@@ -0,0 +1,75 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#pragma once
+
+#include <Eigen/Dense>
+
+#include <cstddef>
+#include <vector>
+
+namespace HoaLibraryUnity
+{
+    // ==================================================================================== //
+    // PolyphaseResampler
+    // ==================================================================================== //
+
+    //! @brief Converts signals between two sample rates with a ratio of integers L/M.
+    //! @details The signal is conceptually upsampled by L, low-pass filtered by a
+    //! Kaiser-windowed sinc and downsampled by M. Only the L phases of the filter are stored
+    //! and each output sample is the dot product of one phase with the input, so that the
+    //! zeros of the upsampled signal and the dropped samples are never computed.
+    //! The filter is centered: the output has no delay. Meant to convert filters once
+    //! (at initialization), not to run on the audio thread.
+    class PolyphaseResampler
+    {
+    public:
+
+        using float_t = float;
+        using matrix_t = Eigen::Matrix<float_t, Eigen::Dynamic, Eigen::Dynamic>;
+
+        //! @brief Largest L or M supported, the rates are rounded to the hertz.
+        static constexpr size_t k_max_factor = 4096;
+
+        //! @brief Constructor
+        //! @param source_rate The sample rate of the inputs.
+        //! @param target_rate The sample rate of the outputs.
+        //! @param zero_crossings Number of zero crossings of the sinc on each side.
+        PolyphaseResampler(double source_rate, double target_rate, size_t zero_crossings = 32);
+
+        ~PolyphaseResampler() = default;
+
+        //! @brief Returns false if the ratio of the rates is not supported.
+        bool isValid() const noexcept { return m_upsampling > 0; }
+
+        //! @brief Returns the number of output samples of an input.
+        size_t getOutputLength(size_t input_length) const noexcept;
+
+        //! @brief Resamples a signal.
+        //! @param output getOutputLength(input_length) samples.
+        //! @param output_stride Distance between two output samples.
+        void process(float_t const* input, size_t input_length, size_t input_stride,
+                     float_t* output, size_t output_stride) const;
+
+        //! @brief Resamples the impulse responses of each row of a matrix.
+        //! @details The responses are scaled by source rate / target rate so that their
+        //! frequency responses are kept.
+        matrix_t processResponses(matrix_t const& responses) const;
+
+    private:
+
+        size_t m_upsampling = 0;
+        size_t m_downsampling = 0;
+        size_t m_center = 0;
+        size_t m_num_taps = 0;
+        std::vector<double> m_phases {};  // m_upsampling x m_num_taps
+    };
+}
@@ -0,0 +1,430 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#include "HoaLibraryRotation.h"
+#include "HoaLibraryHarmonics.h"
+
+#include <Hoa.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace HoaLibraryUnity
+{
+    Eigen::Matrix3d get_rotation_matrix(Quaternion const& quaternion)
+    {
+        double w = quaternion.w, x = quaternion.x, y = quaternion.y, z = quaternion.z;
+        const double norm = std::sqrt(w * w + x * x + y * y + z * z);
+        if(!(norm > 0.) || !std::isfinite(norm))
+            return Eigen::Matrix3d::Identity();
+
+        w /= norm; x /= norm; y /= norm; z /= norm;
+
+        Eigen::Matrix3d rotation;
+        rotation << 1. - 2. * (y * y + z * z), 2. * (x * y - w * z), 2. * (x * z + w * y),
+                    2. * (x * y + w * z), 1. - 2. * (x * x + z * z), 2. * (y * z - w * x),
+                    2. * (x * z - w * y), 2. * (y * z + w * x), 1. - 2. * (x * x + y * y);
+        return rotation;
+    }
+
+    Quaternion get_quaternion(Eigen::Matrix3d const& r)
+    {
+        // Shepperd's method: divide by the largest of the four diagonal combinations.
+        double w, x, y, z;
+        const double trace = r(0, 0) + r(1, 1) + r(2, 2);
+        if(trace > r(0, 0) && trace > r(1, 1) && trace > r(2, 2))
+        {
+            const double s = 2. * std::sqrt(std::max(1. + trace, 0.));
+            w = 0.25 * s;
+            x = (r(2, 1) - r(1, 2)) / s;
+            y = (r(0, 2) - r(2, 0)) / s;
+            z = (r(1, 0) - r(0, 1)) / s;
+        }
+        else if(r(0, 0) > r(1, 1) && r(0, 0) > r(2, 2))
+        {
+            const double s = 2. * std::sqrt(std::max(1. + r(0, 0) - r(1, 1) - r(2, 2), 0.));
+            w = (r(2, 1) - r(1, 2)) / s;
+            x = 0.25 * s;
+            y = (r(0, 1) + r(1, 0)) / s;
+            z = (r(0, 2) + r(2, 0)) / s;
+        }
+        else if(r(1, 1) > r(2, 2))
+        {
+            const double s = 2. * std::sqrt(std::max(1. + r(1, 1) - r(0, 0) - r(2, 2), 0.));
+            w = (r(0, 2) - r(2, 0)) / s;
+            x = (r(0, 1) + r(1, 0)) / s;
+            y = 0.25 * s;
+            z = (r(1, 2) + r(2, 1)) / s;
+        }
+        else
+        {
+            const double s = 2. * std::sqrt(std::max(1. + r(2, 2) - r(0, 0) - r(1, 1), 0.));
+            w = (r(1, 0) - r(0, 1)) / s;
+            x = (r(0, 2) + r(2, 0)) / s;
+            y = (r(1, 2) + r(2, 1)) / s;
+            z = 0.25 * s;
+        }
+
+        Quaternion quaternion;
+        quaternion.w = static_cast<float>(w);
+        quaternion.x = static_cast<float>(x);
+        quaternion.y = static_cast<float>(y);
+        quaternion.z = static_cast<float>(z);
+        return quaternion;
+    }
+
+    Eigen::Matrix3d get_hoa_rotation(Eigen::Matrix3d const& unity_rotation)
+    {
+        // hoa x is unity z, hoa y is unity -x and hoa z is unity y.
+        Eigen::Matrix3d axes;
+        axes << 0., 0., 1.,
+                -1., 0., 0.,
+                0., 1., 0.;
+        return axes * unity_rotation * axes.transpose();
+    }
+
+    // ==================================================================================== //
+    // SoundfieldRotation
+    // ==================================================================================== //
+
+    namespace
+    {
+        // Ivanic/Ruedenberg recurrence, as written by Politis (getSHrotMtx),
+        // with the rows and columns indexed from 0 (m + l).
+        double recurrence_p(int i, int l, int a, int b,
+                            Eigen::MatrixXd const& r1, Eigen::MatrixXd const& previous)
+        {
+            const double ri1 = r1(i + 1, 2);
+            const double rim1 = r1(i + 1, 0);
+            const double ri0 = r1(i + 1, 1);
+
+            if(b == -l)
+                return ri1 * previous(a + l - 1, 0) + rim1 * previous(a + l - 1, 2 * l - 2);
+
+            if(b == l)
+                return ri1 * previous(a + l - 1, 2 * l - 2) - rim1 * previous(a + l - 1, 0);
+
+            return ri0 * previous(a + l - 1, b + l - 1);
+        }
+
+        double recurrence_u(int l, int m, int n, Eigen::MatrixXd const& r1, Eigen::MatrixXd const& previous)
+        {
+            return recurrence_p(0, l, m, n, r1, previous);
+        }
+
+        double recurrence_v(int l, int m, int n, Eigen::MatrixXd const& r1, Eigen::MatrixXd const& previous)
+        {
+            if(m == 0)
+            {
+                return recurrence_p(1, l, 1, n, r1, previous)
+                + recurrence_p(-1, l, -1, n, r1, previous);
+            }
+
+            if(m > 0)
+            {
+                const double d = (m == 1) ? 1. : 0.;
+                return recurrence_p(1, l, m - 1, n, r1, previous) * std::sqrt(1. + d)
+                - recurrence_p(-1, l, -m + 1, n, r1, previous) * (1. - d);
+            }
+
+            const double d = (m == -1) ? 1. : 0.;
+            return recurrence_p(1, l, m + 1, n, r1, previous) * (1. - d)
+            + recurrence_p(-1, l, -m - 1, n, r1, previous) * std::sqrt(1. + d);
+        }
+
+        double recurrence_w(int l, int m, int n, Eigen::MatrixXd const& r1, Eigen::MatrixXd const& previous)
+        {
+            if(m > 0)
+            {
+                return recurrence_p(1, l, m + 1, n, r1, previous)
+                + recurrence_p(-1, l, -m - 1, n, r1, previous);
+            }
+
+            return recurrence_p(1, l, m - 1, n, r1, previous)
+            - recurrence_p(-1, l, -m + 1, n, r1, previous);
+        }
+    }
+
+    SoundfieldRotation::SoundfieldRotation(size_t order, size_t vectorsize, BatchedEncoder const& encoder)
+    : m_order(order)
+    {
+        const size_t num_harmonics = (order + 1) * (order + 1);
+        const size_t max_size = 2 * order + 1;
+
+        m_basis_offset.resize(num_harmonics);
+        m_scale.resize(num_harmonics);
+        m_basis_rotation.resize(order + 1);
+        m_current.resize(order + 1);
+        m_delta.resize(order + 1);
+
+        for(size_t l = 0; l <= order; ++l)
+        {
+            m_current[l] = matrix_t::Identity(2 * l + 1, 2 * l + 1);
+            m_delta[l] = matrix_t::Zero(2 * l + 1, 2 * l + 1);
+        }
+
+        m_rotated = matrix_t::Zero(max_size, vectorsize);
+        m_ramped = matrix_t::Zero(max_size, vectorsize);
+        m_ramp = Eigen::Matrix<float_t, 1, Eigen::Dynamic>::Zero(vectorsize);
+
+        if(!encoder.isValid() || encoder.getNumberOfHarmonics() != num_harmonics)
+            return;
+
+        // each harmonic of a degree must be a scaled basis function of the same degree,
+        // and the basis functions of the degree must all be used once.
+        for(size_t l = 0; l <= order; ++l)
+        {
+            std::vector<bool> used(2 * l + 1, false);
+            for(size_t h = l * l; h < (l + 1) * (l + 1); ++h)
+            {
+                const size_t index = encoder.getBasisIndex(h);
+                const double scale = encoder.getBasisScale(h);
+                if(index < l * l || index >= (l + 1) * (l + 1) || used[index - l * l] || scale == 0.)
+                    return;
+
+                used[index - l * l] = true;
+                m_basis_offset[h] = index - l * l;
+                m_scale[h] = scale;
+            }
+        }
+
+        m_valid = verify();
+    }
+
+    void SoundfieldRotation::computeBasisRotation(rotation_t const& rotation,
+                                                  std::vector<Eigen::MatrixXd>& degrees)
+    {
+        if(degrees.empty())
+            return;
+
+        degrees[0] = Eigen::MatrixXd::Identity(1, 1);
+        if(degrees.size() < 2)
+            return;
+
+        // the first degree is (y, z, x).
+        static const int axes[3] = {1, 2, 0};
+        auto& r1 = degrees[1];
+        r1.resize(3, 3);
+        for(int i = 0; i < 3; ++i)
+        {
+            for(int j = 0; j < 3; ++j)
+            {
+                r1(i, j) = rotation(axes[i], axes[j]);
+            }
+        }
+
+        for(int l = 2; l < static_cast<int>(degrees.size()); ++l)
+        {
+            auto const& previous = degrees[l - 1];
+            auto& current = degrees[l];
+            current.resize(2 * l + 1, 2 * l + 1);
+
+            for(int m = -l; m <= l; ++m)
+            {
+                const int abs_m = std::abs(m);
+                const double d = (m == 0) ? 1. : 0.;
+
+                for(int n = -l; n <= l; ++n)
+                {
+                    const double denom = (std::abs(n) == l)
+                    ? static_cast<double>((2 * l) * (2 * l - 1))
+                    : static_cast<double>(l * l - n * n);
+
+                    double u = std::sqrt((l * l - m * m) / denom);
+                    double v = std::sqrt((1. + d) * (l + abs_m - 1) * (l + abs_m) / denom) * (1. - 2. * d) * 0.5;
+                    double w = std::sqrt((l - abs_m - 1) * (l - abs_m) / denom) * (1. - d) * -0.5;
+
+                    if(u != 0.)
+                        u *= recurrence_u(l, m, n, r1, previous);
+                    if(v != 0.)
+                        v *= recurrence_v(l, m, n, r1, previous);
+                    if(w != 0.)
+                        w *= recurrence_w(l, m, n, r1, previous);
+
+                    current(m + l, n + l) = u + v + w;
+                }
+            }
+        }
+    }
+
+    void SoundfieldRotation::computeRotation(rotation_t const& rotation, std::vector<matrix_t>& degrees)
+    {
+        computeBasisRotation(rotation, m_basis_rotation);
+
+        // a harmonic h is s_h times the basis function b_h,
+        // so the rotation of the harmonics is S B S^-1.
+        for(size_t l = 0; l <= m_order; ++l)
+        {
+            const size_t first = l * l;
+            const size_t size = 2 * l + 1;
+            auto const& basis = m_basis_rotation[l];
+            auto& degree = degrees[l];
+
+            for(size_t i = 0; i < size; ++i)
+            {
+                for(size_t j = 0; j < size; ++j)
+                {
+                    const double value = m_scale[first + i]
+                    * basis(m_basis_offset[first + i], m_basis_offset[first + j])
+                    / m_scale[first + j];
+
+                    degree(i, j) = static_cast<float_t>(value);
+                }
+            }
+        }
+    }
+
+    void SoundfieldRotation::setRotation(rotation_t const& rotation)
+    {
+        if(!m_valid || rotation == m_rotation)
+            return;
+
+        // the target is stored in the delta, then the delta is taken from the current.
+        computeRotation(rotation, m_delta);
+        for(size_t l = 1; l <= m_order; ++l)
+        {
+            m_delta[l] -= m_current[l];
+        }
+
+        m_rotation = rotation;
+        m_interpolate = true;
+    }
+
+    void SoundfieldRotation::process(Eigen::Ref<matrix_t> soundfield)
+    {
+        if(!m_valid || (m_identity && !m_interpolate))
+            return;
+
+        const size_t frames = std::min(static_cast<size_t>(soundfield.cols()),
+                                       static_cast<size_t>(m_ramp.size()));
+        if(frames == 0)
+            return;
+
+        const size_t num_degrees = std::min(m_order + 1,
+                                            static_cast<size_t>(std::sqrt(static_cast<double>(soundfield.rows()))));
+
+        if(m_interpolate)
+        {
+            const float_t step = 1.f / static_cast<float_t>(frames);
+            for(size_t i = 0; i < frames; ++i)
+            {
+                m_ramp[i] = static_cast<float_t>(i + 1) * step;
+            }
+        }
+
+        // the degree 0 is invariant.
+        for(size_t l = 1; l < num_degrees; ++l)
+        {
+            const auto first = static_cast<Eigen::Index>(l * l);
+            const auto size = static_cast<Eigen::Index>(2 * l + 1);
+            const auto cols = static_cast<Eigen::Index>(frames);
+
+            auto block = soundfield.block(first, 0, size, cols);
+            auto rotated = m_rotated.topLeftCorner(size, cols);
+
+            rotated.noalias() = m_current[l] * block;
+
+            if(m_interpolate)
+            {
+                auto ramped = m_ramped.topLeftCorner(size, cols);
+                ramped = block.array().rowwise() * m_ramp.head(cols).array();
+                rotated.noalias() += m_delta[l] * ramped;
+            }
+
+            block = rotated;
+        }
+
+        if(m_interpolate)
+        {
+            for(size_t l = 1; l <= m_order; ++l)
+            {
+                m_current[l] += m_delta[l];
+            }
+
+            m_interpolate = false;
+            m_identity = m_rotation.isIdentity(0.);
+        }
+    }
+
+    bool SoundfieldRotation::verify()
+    {
+        using encoder_t = hoa::Encoder<hoa::Hoa3d, float_t>;
+
+        encoder_t encoder(m_order);
+        const size_t num_harmonics = (m_order + 1) * (m_order + 1);
+        std::vector<float_t> harmonics(num_harmonics), expected(num_harmonics);
+
+        uint32_t seed = 1;
+        auto random = [&seed]() {
+            seed = seed * 1664525u + 1013904223u;
+            return static_cast<double>(seed >> 8) / static_cast<double>(1u << 24) * 2. - 1.;
+        };
+
+        auto encode = [&encoder](Eigen::Vector3d const& direction, std::vector<float_t>& output) {
+            const float_t unit = 1.f;
+            encoder.setRadius(1.f);
+            encoder.setAzimuth(static_cast<float_t>(std::atan2(direction.y(), direction.x())));
+            encoder.setElevation(static_cast<float_t>(std::asin(std::max(-1., std::min(direction.z(), 1.)))));
+            encoder.process(&unit, output.data());
+        };
+
+        std::vector<matrix_t> degrees(m_order + 1);
+        for(size_t l = 0; l <= m_order; ++l)
+        {
+            degrees[l].resize(2 * l + 1, 2 * l + 1);
+        }
+
+        for(size_t test = 0; test < 4; ++test)
+        {
+            Quaternion quaternion;
+            quaternion.w = static_cast<float>(random());
+            quaternion.x = static_cast<float>(random());
+            quaternion.y = static_cast<float>(random());
+            quaternion.z = static_cast<float>(random());
+
+            const rotation_t rotation = get_rotation_matrix(quaternion);
+            computeRotation(rotation, degrees);
+
+            for(size_t n = 0; n < 8; ++n)
+            {
+                const Eigen::Vector3d direction = Eigen::Vector3d(random(), random(), random()).normalized();
+                encode(direction, harmonics);
+                encode(rotation * direction, expected);
+
+                float_t peak = 1.f;
+                for(auto value : expected)
+                {
+                    peak = std::max(peak, std::abs(value));
+                }
+
+                for(size_t l = 0; l <= m_order; ++l)
+                {
+                    const size_t first = l * l;
+                    const size_t size = 2 * l + 1;
+                    for(size_t i = 0; i < size; ++i)
+                    {
+                        float_t value = 0.f;
+                        for(size_t j = 0; j < size; ++j)
+                        {
+                            value += degrees[l](i, j) * harmonics[first + j];
+                        }
+
+                        if(std::abs(value - expected[first + i]) > 1e-3f * peak)
+                            return false;
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+}
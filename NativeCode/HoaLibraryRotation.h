@@ -0,0 +1,117 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#pragma once
+
+#include <Eigen/Dense>
+
+#include <vector>
+
+namespace HoaLibraryUnity
+{
+    class BatchedEncoder;
+    
+    //! @brief A rotation as a unit quaternion in unity coordinates (x right, y up, z forward).
+    struct Quaternion
+    {
+        float w = 1.f;
+        float x = 0.f;
+        float y = 0.f;
+        float z = 0.f;
+    };
+
+    //! @brief Returns the rotation matrix of a quaternion (normalized first).
+    Eigen::Matrix3d get_rotation_matrix(Quaternion const& quaternion);
+
+    //! @brief Returns the quaternion of a rotation matrix.
+    Quaternion get_quaternion(Eigen::Matrix3d const& rotation);
+
+    //! @brief Converts a rotation in unity coordinates to hoa coordinates (x front, y left, z up).
+    Eigen::Matrix3d get_hoa_rotation(Eigen::Matrix3d const& unity_rotation);
+
+    // ==================================================================================== //
+    // SoundfieldRotation
+    // ==================================================================================== //
+
+    //! @brief Rotates soundfields encoded with the harmonics of hoa::Encoder<Hoa3d>.
+    //! @details A rotation of the directions is a block-diagonal matrix on the harmonics,
+    //! one (2l+1) x (2l+1) block per degree l. The blocks are computed on the real
+    //! harmonics (ACN ordering) with the Ivanic/Ruedenberg recurrence from the rotation
+    //! of the first degree, then mapped to the library harmonics with the calibration
+    //! of the BatchedEncoder, so that the cost is O(order^3) per rotation change.
+    //! The matrix is linearly interpolated from the previous rotation over a processed block.
+    //! At construction the rotation is checked against hoa::Encoder, if it does not
+    //! match isValid() returns false and the rotation must not be used.
+    class SoundfieldRotation
+    {
+    public:
+
+        using float_t = float;
+        using matrix_t = Eigen::Matrix<float_t, Eigen::Dynamic, Eigen::Dynamic>;
+        using rotation_t = Eigen::Matrix3d;
+
+        //! @brief Constructor
+        //! @param order The ambisonic order.
+        //! @param vectorsize The maximum number of frames of a block.
+        //! @param encoder A calibrated BatchedEncoder of the order.
+        SoundfieldRotation(size_t order, size_t vectorsize, BatchedEncoder const& encoder);
+
+        ~SoundfieldRotation() = default;
+
+        //! @brief Returns true if the rotation matches the library encoder.
+        bool isValid() const noexcept { return m_valid; }
+
+        //! @brief Sets the rotation reached at the end of the next processed block.
+        //! @param rotation The rotation of the directions in hoa coordinates.
+        void setRotation(rotation_t const& rotation);
+
+        //! @brief Rotates a soundfield in place.
+        //! @details The rotation set before is reached at the last frame, the identity is skipped.
+        //! @param soundfield The harmonics in rows, at most the ones of the order,
+        //! and at most vectorsize frames in columns.
+        void process(Eigen::Ref<matrix_t> soundfield);
+
+        //! @brief Computes the rotation of the real harmonics of each degree (ACN ordering,
+        //! without Condon-Shortley phase, x front, y left, z up).
+        static void computeBasisRotation(rotation_t const& rotation,
+                                         std::vector<Eigen::MatrixXd>& degrees);
+
+    private:
+
+        //! @brief Maps the rotation of the basis to the library harmonics.
+        void computeRotation(rotation_t const& rotation, std::vector<matrix_t>& degrees);
+
+        //! @brief Checks the rotation against hoa::Encoder on random directions.
+        bool verify();
+
+    private:
+
+        const size_t m_order;
+        bool m_valid = false;
+
+        // per library harmonic, its basis function in the degree and the scale to it.
+        std::vector<size_t> m_basis_offset {};
+        std::vector<double> m_scale {};
+
+        // per degree
+        std::vector<Eigen::MatrixXd> m_basis_rotation {};
+        std::vector<matrix_t> m_current {};
+        std::vector<matrix_t> m_delta {};
+
+        rotation_t m_rotation = rotation_t::Identity();
+        bool m_interpolate = false;
+        bool m_identity = true;
+
+        matrix_t m_rotated {};
+        matrix_t m_ramped {};
+        Eigen::Matrix<float_t, 1, Eigen::Dynamic> m_ramp {};
+    };
+}
@@ -0,0 +1,126 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+namespace HoaLibraryUnity
+{
+    // ==================================================================================== //
+    // SeqLock
+    // ==================================================================================== //
+
+    //! @brief Publishes a small value from any number of threads to readers that never block.
+    //! @details The value is guarded by a sequence number that is odd while it is written.
+    //! Writers take turns by making the sequence odd with a compare-exchange, readers copy
+    //! the value and retry if the sequence changed meanwhile. A reader gives up after a few
+    //! attempts (a writer was preempted in the middle of a write) so that the audio thread
+    //! never waits, it then keeps the value it read before.
+    //! The value is stored in atomic words so that the concurrent copies are well defined.
+    template<class T>
+    class SeqLock
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "the value must be trivially copyable");
+
+    public:
+
+        //! @brief Constructor
+        SeqLock(T const& value = T())
+        {
+            writeWords(value);
+        }
+
+        //! @brief Publishes a value (any thread).
+        void store(T const& value) noexcept
+        {
+            uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+            for(;;)
+            {
+                if((sequence & 1) == 0
+                   && m_sequence.compare_exchange_weak(sequence, sequence + 1,
+                                                       std::memory_order_acquire,
+                                                       std::memory_order_relaxed))
+                {
+                    break;
+                }
+
+                if(sequence & 1)
+                {
+                    // another writer is in the middle of a write.
+                    std::this_thread::yield();
+                    sequence = m_sequence.load(std::memory_order_relaxed);
+                }
+            }
+
+            std::atomic_thread_fence(std::memory_order_release);
+            writeWords(value);
+            m_sequence.store(sequence + 2, std::memory_order_release);
+        }
+
+        //! @brief Reads the last published value (any thread, wait-free).
+        //! @return false if a write was in progress, value is then unchanged.
+        bool load(T& value) const noexcept
+        {
+            for(int attempt = 0; attempt < k_max_attempts; ++attempt)
+            {
+                const uint32_t sequence = m_sequence.load(std::memory_order_acquire);
+                if(sequence & 1)
+                    continue;
+
+                uint32_t words[k_num_words];
+                for(size_t i = 0; i < k_num_words; ++i)
+                {
+                    words[i] = m_words[i].load(std::memory_order_relaxed);
+                }
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if(m_sequence.load(std::memory_order_relaxed) == sequence)
+                {
+                    std::memcpy(&value, words, sizeof(T));
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        //! @brief Returns the number of values published since the construction.
+        uint32_t getVersion() const noexcept
+        {
+            return m_sequence.load(std::memory_order_acquire) / 2;
+        }
+
+    private:
+
+        static constexpr size_t k_num_words = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+        static constexpr int k_max_attempts = 4;
+
+        void writeWords(T const& value) noexcept
+        {
+            uint32_t words[k_num_words] = {};
+            std::memcpy(words, &value, sizeof(T));
+            for(size_t i = 0; i < k_num_words; ++i)
+            {
+                m_words[i].store(words[i], std::memory_order_relaxed);
+            }
+        }
+
+    private:
+
+        std::atomic<uint32_t> m_sequence {0};
+        std::atomic<uint32_t> m_words[k_num_words];
+    };
+}
@@ -0,0 +1,460 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#include "HoaLibrarySpeakers.h"
+
+#include <Eigen/SVD>
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+namespace HoaLibraryUnity
+{
+    namespace
+    {
+        constexpr double k_pi = 3.14159265358979323846;
+        constexpr double k_degrees = k_pi / 180.;
+
+        Speaker make_speaker(double azimuth, double elevation)
+        {
+            Speaker speaker;
+            speaker.azimuth = static_cast<float>(azimuth * k_degrees);
+            speaker.elevation = static_cast<float>(elevation * k_degrees);
+            return speaker;
+        }
+
+        Speaker make_lfe()
+        {
+            Speaker speaker;
+            speaker.lfe = true;
+            return speaker;
+        }
+
+        SpeakerLayout get_preset(std::string const& name)
+        {
+            if(name == "quad")
+                return { make_speaker(45., 0.), make_speaker(-45., 0.),
+                         make_speaker(135., 0.), make_speaker(-135., 0.) };
+
+            if(name == "5.1")
+                return { make_speaker(30., 0.), make_speaker(-30., 0.), make_speaker(0., 0.), make_lfe(),
+                         make_speaker(110., 0.), make_speaker(-110., 0.) };
+
+            if(name == "7.1" || name == "7.1.4")
+            {
+                SpeakerLayout layout {
+                    make_speaker(30., 0.), make_speaker(-30., 0.), make_speaker(0., 0.), make_lfe(),
+                    make_speaker(150., 0.), make_speaker(-150., 0.),
+                    make_speaker(90., 0.), make_speaker(-90., 0.)
+                };
+
+                if(name == "7.1.4")
+                {
+                    layout.push_back(make_speaker(45., 45.));
+                    layout.push_back(make_speaker(-45., 45.));
+                    layout.push_back(make_speaker(135., 45.));
+                    layout.push_back(make_speaker(-135., 45.));
+                }
+
+                return layout;
+            }
+
+            if(name == "dome24")
+            {
+                SpeakerLayout layout;
+                for(int i = 0; i < 12; ++i)
+                    layout.push_back(make_speaker(i * 30., 0.));
+                for(int i = 0; i < 8; ++i)
+                    layout.push_back(make_speaker(22.5 + i * 45., 30.));
+                for(int i = 0; i < 3; ++i)
+                    layout.push_back(make_speaker(i * 120., 60.));
+                layout.push_back(make_speaker(0., 90.));
+                return layout;
+            }
+
+            return {};
+        }
+
+        //! @brief Evaluates the real harmonics (ACN, N3D, without Condon-Shortley phase)
+        //! of a direction, up to an order.
+        void get_harmonics(size_t order, double azimuth, double elevation, Eigen::Ref<Eigen::VectorXd> harmonics)
+        {
+            const double x = std::sin(elevation);
+            const double c = std::cos(elevation);
+
+            for(size_t m = 0; m <= order; ++m)
+            {
+                // associated Legendre functions P_l^m(x), from P_m^m upward in l.
+                double p_mm = 1.;
+                for(size_t i = 1; i <= m; ++i)
+                    p_mm *= (2. * i - 1.) * c;
+
+                double previous = 0., current = p_mm;
+                for(size_t l = m; l <= order; ++l)
+                {
+                    if(l > m)
+                    {
+                        const double next = (l == m + 1)
+                        ? x * (2. * m + 1.) * p_mm
+                        : ((2. * l - 1.) * x * current - (l + m - 1.) * previous) / (l - m);
+                        previous = current;
+                        current = next;
+                    }
+
+                    // N3D: sqrt((2l+1)(2-δm)(l-m)!/(l+m)!)
+                    double ratio = 1.;
+                    for(size_t k = l - m + 1; k <= l + m; ++k)
+                        ratio /= static_cast<double>(k);
+                    const double norm = std::sqrt((2. * l + 1.) * (m == 0 ? 1. : 2.) * ratio);
+
+                    const size_t acn = l * l + l;
+                    if(m == 0)
+                    {
+                        harmonics[acn] = norm * current;
+                    }
+                    else
+                    {
+                        harmonics[acn + m] = norm * current * std::cos(m * azimuth);
+                        harmonics[acn - m] = norm * current * std::sin(m * azimuth);
+                    }
+                }
+            }
+        }
+
+        //! @brief Returns the max-rE weight of each degree, normalized to the energy of the basic weights.
+        std::vector<double> get_max_re_weights(size_t order)
+        {
+            std::vector<double> weights(order + 1, 1.);
+
+            const double x = std::cos(2.4068 / (order + 1.51));
+            double previous = 0., weight = 1.;
+            double energy = 0., weighted_energy = 0.;
+
+            for(size_t degree = 0; degree <= order; ++degree)
+            {
+                if(degree > 0)
+                {
+                    const double next = ((2. * degree - 1.) * x * weight - (degree - 1.) * previous) / degree;
+                    previous = weight;
+                    weight = next;
+                }
+
+                weights[degree] = weight;
+                energy += 2. * degree + 1.;
+                weighted_energy += (2. * degree + 1.) * weight * weight;
+            }
+
+            const double scale = std::sqrt(energy / weighted_energy);
+            for(auto& value : weights)
+                value *= scale;
+
+            return weights;
+        }
+
+        size_t get_degree(size_t harmonic)
+        {
+            return static_cast<size_t>(std::sqrt(static_cast<double>(harmonic)));
+        }
+    }
+
+    bool get_speaker_layout(std::string const& description, SpeakerLayout& layout)
+    {
+        auto preset = get_preset(description);
+        if(!preset.empty())
+        {
+            layout = std::move(preset);
+            return true;
+        }
+
+        std::string lines = description;
+        std::replace(lines.begin(), lines.end(), ';', '\n');
+
+        SpeakerLayout custom;
+        std::istringstream stream(lines);
+        std::string line;
+        while(std::getline(stream, line))
+        {
+            std::istringstream values(line);
+            std::string first;
+            if(!(values >> first))
+                continue;
+
+            if(first == "lfe" || first == "LFE")
+            {
+                custom.push_back(make_lfe());
+                continue;
+            }
+
+            double azimuth = 0., elevation = 0., distance = 0.;
+            try
+            {
+                azimuth = std::stod(first);
+            }
+            catch(...)
+            {
+                return false;
+            }
+
+            if(!(values >> elevation))
+                return false;
+
+            if(values >> distance)
+            {
+                if(distance < 0.)
+                    return false;
+            }
+
+            auto speaker = make_speaker(azimuth, elevation);
+            speaker.distance = static_cast<float>(distance);
+            custom.push_back(speaker);
+        }
+
+        const bool has_speaker = std::any_of(custom.begin(), custom.end(),
+                                             [](Speaker const& speaker) { return !speaker.lfe; });
+        if(!has_speaker)
+            return false;
+
+        layout = std::move(custom);
+        return true;
+    }
+
+    // ==================================================================================== //
+    // SpeakerDecoder
+    // ==================================================================================== //
+
+    SpeakerDecoder::SpeakerDecoder(size_t order, SpeakerLayout const& layout, SpeakerSettings const& settings,
+                                   std::vector<size_t> const& channels, std::vector<float_t> const& scales,
+                                   size_t vectorsize, double sample_rate)
+    : m_layout(layout)
+    , m_num_harmonics((order + 1) * (order + 1))
+    , m_sample_rate(sample_rate)
+    {
+        if(m_layout.empty() || channels.size() != m_num_harmonics || scales.size() != m_num_harmonics)
+            return;
+
+        Eigen::MatrixXd n3d;
+        if(!computeMatrix(order, settings.decoding, n3d))
+            return;
+
+        const auto weights = get_max_re_weights(order);
+        m_dual_band = settings.dual_band && settings.crossover > 0.f && settings.crossover < sample_rate * 0.5;
+
+        // maps the N3D columns to the harmonics of the library: a harmonic is its SN3D
+        // channel times its scale, and a SN3D channel is its N3D channel over sqrt(2l+1).
+        m_matrix = matrix_t::Zero(m_layout.size(), m_num_harmonics);
+        m_shelf_gains = Eigen::VectorXf::Zero(m_num_harmonics);
+        for(size_t h = 0; h < m_num_harmonics; ++h)
+        {
+            const size_t channel = channels[h];
+            if(channel >= m_num_harmonics || !(scales[h] != 0.f))
+                return;
+
+            const size_t degree = get_degree(channel);
+            const double scale = std::sqrt(2. * degree + 1.) / scales[h];
+            m_matrix.col(h) = (n3d.col(channel) * (scale * weights[degree])).cast<float_t>();
+            m_shelf_gains[h] = static_cast<float>(1. / weights[degree] - 1.);
+        }
+
+        if(!m_matrix.allFinite())
+            return;
+
+        if(m_dual_band)
+        {
+            computeCrossover(settings.crossover, sample_rate);
+            m_filter_state = matrix_t::Zero(m_num_harmonics, 2);
+            m_weighted = matrix_t::Zero(m_num_harmonics, vectorsize);
+        }
+
+        m_signals = matrix_t::Zero(m_layout.size(), vectorsize);
+        computeCompensation(sample_rate);
+
+        m_valid = true;
+    }
+
+    bool SpeakerDecoder::computeMatrix(size_t order, SpeakerDecoding decoding, Eigen::MatrixXd& matrix)
+    {
+        const size_t num_speakers = m_layout.size();
+
+        // the harmonics of the speakers in columns, the LFE channels are left out.
+        Eigen::MatrixXd harmonics = Eigen::MatrixXd::Zero(m_num_harmonics, num_speakers);
+        for(size_t s = 0; s < num_speakers; ++s)
+        {
+            auto const& speaker = m_layout[s];
+            if(!speaker.lfe)
+                get_harmonics(order, speaker.azimuth, speaker.elevation, harmonics.col(s));
+        }
+
+        Eigen::JacobiSVD<Eigen::MatrixXd> svd(harmonics, Eigen::ComputeThinU | Eigen::ComputeThinV);
+        auto const& singular_values = svd.singularValues();
+        if(singular_values.size() == 0 || !(singular_values[0] > 0.))
+            return false;
+
+        // the directions the layout cannot resolve are left out of both decoders.
+        const double threshold = singular_values[0] * 1e-3;
+        Eigen::Index rank = 0;
+        while(rank < singular_values.size() && singular_values[rank] > threshold)
+            ++rank;
+
+        if(decoding == SpeakerDecoding::Auto)
+        {
+            // the layout is regular enough for the pseudo-inverse when it resolves all
+            // the harmonics with a condition number under 2.
+            const bool regular = (static_cast<size_t>(rank) == m_num_harmonics
+                                  && singular_values[rank - 1] > singular_values[0] * 0.5);
+            decoding = regular ? SpeakerDecoding::ModeMatching : SpeakerDecoding::EnergyPreserving;
+        }
+
+        auto const u = svd.matrixU().leftCols(rank);
+        auto const v = svd.matrixV().leftCols(rank);
+
+        if(decoding == SpeakerDecoding::ModeMatching)
+        {
+            const Eigen::VectorXd inverse = singular_values.head(rank).cwiseInverse();
+            matrix = v * inverse.asDiagonal() * u.transpose();
+        }
+        else
+        {
+            // scaled to match the pseudo-inverse of a regular layout (singular values of sqrt(L)).
+            const auto num_active = std::count_if(m_layout.begin(), m_layout.end(),
+                                                  [](Speaker const& speaker) { return !speaker.lfe; });
+            matrix = v * u.transpose() / std::sqrt(static_cast<double>(num_active));
+        }
+
+        m_decoding = decoding;
+        return matrix.allFinite();
+    }
+
+    void SpeakerDecoder::computeCrossover(double frequency, double sample_rate)
+    {
+        // second order Butterworth low-pass (bilinear transform).
+        const double w0 = 2. * k_pi * frequency / sample_rate;
+        const double alpha = std::sin(w0) / std::sqrt(2.);
+        const double cosw = std::cos(w0);
+        const double a0 = 1. + alpha;
+
+        m_b0 = static_cast<float_t>((1. - cosw) * 0.5 / a0);
+        m_b1 = static_cast<float_t>((1. - cosw) / a0);
+        m_b2 = m_b0;
+        m_a1 = static_cast<float_t>(-2. * cosw / a0);
+        m_a2 = static_cast<float_t>((1. - alpha) / a0);
+    }
+
+    void SpeakerDecoder::setCrossover(double frequency)
+    {
+        if(m_dual_band && frequency > 0. && frequency < m_sample_rate * 0.5)
+        {
+            computeCrossover(frequency, m_sample_rate);
+        }
+    }
+
+    void SpeakerDecoder::computeCompensation(double sample_rate)
+    {
+        const size_t num_speakers = m_layout.size();
+        m_delays.assign(num_speakers, 0);
+        m_gains.assign(num_speakers, 1.f);
+
+        float max_distance = 0.f;
+        for(auto const& speaker : m_layout)
+            max_distance = std::max(max_distance, speaker.distance);
+
+        if(!(max_distance > 0.f))
+            return;
+
+        // the speakers without distance are considered at the farthest distance.
+        size_t max_delay = 0;
+        for(size_t s = 0; s < num_speakers; ++s)
+        {
+            const float distance = m_layout[s].distance > 0.f ? m_layout[s].distance : max_distance;
+            m_delays[s] = static_cast<size_t>(std::lround((max_distance - distance) / k_speed_of_sound * sample_rate));
+            m_gains[s] = distance / max_distance;
+            max_delay = std::max(max_delay, m_delays[s]);
+        }
+
+        if(max_delay > 0)
+        {
+            m_delay_size = max_delay + 1;
+            m_delay_lines = matrix_t::Zero(num_speakers, m_delay_size);
+        }
+    }
+
+    void SpeakerDecoder::process(Eigen::Ref<const matrix_t> soundfield, size_t frames, size_t channels,
+                                 float_t* outputs, float_t gain)
+    {
+        const size_t num_speakers = m_layout.size();
+        std::fill(outputs, outputs + frames * channels, 0.f);
+
+        if(!m_valid)
+            return;
+
+        const auto harmonics = soundfield.topLeftCorner(m_num_harmonics, frames);
+
+        if(m_dual_band)
+        {
+            // x + (low / high - 1) * lowpass(x), the filter in transposed direct form II.
+            auto weighted = m_weighted.leftCols(frames);
+            for(size_t h = 0; h < m_num_harmonics; ++h)
+            {
+                const float_t shelf = m_shelf_gains[h];
+                float_t s1 = m_filter_state(h, 0), s2 = m_filter_state(h, 1);
+                for(size_t frame = 0; frame < frames; ++frame)
+                {
+                    const float_t x = harmonics(h, frame);
+                    const float_t y = m_b0 * x + s1;
+                    s1 = m_b1 * x - m_a1 * y + s2;
+                    s2 = m_b2 * x - m_a2 * y;
+                    weighted(h, frame) = x + shelf * y;
+                }
+
+                m_filter_state(h, 0) = s1;
+                m_filter_state(h, 1) = s2;
+            }
+
+            m_signals.leftCols(frames).noalias() = m_matrix * weighted;
+        }
+        else
+        {
+            m_signals.leftCols(frames).noalias() = m_matrix * harmonics;
+        }
+
+        const size_t outputs_speakers = std::min(num_speakers, channels);
+
+        if(m_delay_size == 0)
+        {
+            for(size_t s = 0; s < outputs_speakers; ++s)
+            {
+                const float_t speaker_gain = m_gains[s] * gain;
+                for(size_t frame = 0; frame < frames; ++frame)
+                {
+                    outputs[frame * channels + s] = m_signals(s, frame) * speaker_gain;
+                }
+            }
+
+            return;
+        }
+
+        for(size_t frame = 0; frame < frames; ++frame)
+        {
+            const size_t position = (m_delay_position + frame) % m_delay_size;
+            for(size_t s = 0; s < num_speakers; ++s)
+            {
+                m_delay_lines(s, position) = m_signals(s, frame);
+                if(s < outputs_speakers)
+                {
+                    const size_t delayed = (position + m_delay_size - m_delays[s]) % m_delay_size;
+                    outputs[frame * channels + s] = m_delay_lines(s, delayed) * m_gains[s] * gain;
+                }
+            }
+        }
+
+        m_delay_position = (m_delay_position + frames) % m_delay_size;
+    }
+}
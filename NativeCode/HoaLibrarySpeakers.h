@@ -0,0 +1,182 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#pragma once
+
+#include <Eigen/Dense>
+
+#include <string>
+#include <vector>
+
+namespace HoaLibraryUnity
+{
+    //! @brief Default crossover frequency of the dual-band speaker decoding in Hz.
+    static constexpr float k_default_speaker_crossover = 400.f;
+
+    //! @brief Speed of sound used by the distance compensation in m/s.
+    static constexpr double k_speed_of_sound = 343.;
+
+    // ==================================================================================== //
+    // SpeakerLayout
+    // ==================================================================================== //
+
+    //! @brief A loudspeaker of a layout.
+    struct Speaker
+    {
+        float azimuth = 0.f;    //!< radians, counterclockwise from the front (hoa coordinates).
+        float elevation = 0.f;  //!< radians, upward.
+        float distance = 0.f;   //!< meters from the listening position (0 if unknown).
+        bool lfe = false;       //!< low frequency channel, not fed by the decoder.
+    };
+
+    //! @brief The loudspeakers of an output, one per channel in the order of the channels.
+    using SpeakerLayout = std::vector<Speaker>;
+
+    //! @brief Returns a loudspeaker layout from its description.
+    //! @details The description is either a preset, in the channel order of Unity where
+    //! it has a speaker mode:
+    //! - "quad": FL FR RL RR
+    //! - "5.1": FL FR C LFE RL RR (rears at 110 degrees)
+    //! - "7.1": FL FR C LFE RL RR SL SR
+    //! - "7.1.4": 7.1 followed by TFL TFR TRL TRR at 45 degrees of elevation
+    //! - "dome24": rings of 12, 8 and 3 speakers at 0, 30 and 60 degrees and a top speaker
+    //! or a list of speakers separated by ';' or new lines, each one "azimuth elevation [distance]"
+    //! in degrees and meters, or "lfe".
+    //! @return false if the description is not valid, the layout is then unchanged.
+    bool get_speaker_layout(std::string const& description, SpeakerLayout& layout);
+
+    // ==================================================================================== //
+    // SpeakerDecoder
+    // ==================================================================================== //
+
+    //! @brief Method of computation of a speaker decoding matrix.
+    enum class SpeakerDecoding
+    {
+        Auto = 0,               //!< mode matching for regular layouts, energy preserving otherwise.
+        ModeMatching = 1,       //!< pseudo-inverse of the harmonics of the speakers.
+        EnergyPreserving = 2,   //!< EPAD (Zotter, Pomberger & Noisternig).
+    };
+
+    //! @brief Settings of the speaker output of an instance.
+    struct SpeakerSettings
+    {
+        //! The layout description (see get_speaker_layout), empty for no speaker output.
+        std::string layout {};
+
+        //! The decoding method.
+        SpeakerDecoding decoding = SpeakerDecoding::Auto;
+
+        //! Decodes with the basic weights under the crossover and the max-rE weights above,
+        //! otherwise with the max-rE weights only.
+        bool dual_band = true;
+
+        //! The crossover frequency in Hz.
+        float crossover = k_default_speaker_crossover;
+    };
+
+    //! @brief Decodes a soundfield to a loudspeaker layout.
+    //! @details The (speakers x harmonics) matrix is computed once on the real harmonics
+    //! (ACN, N3D) of the speakers directions and mapped to the harmonics of the library
+    //! with the AmbiX conversion of the instance. It is applied as one matrix product
+    //! per block. The dual-band weighting is a shelf on the harmonics: each harmonic is
+    //! weighted with its max-rE weight plus the difference to its basic weight times its
+    //! low-passed signal, so that the two bands always sum back without phase errors,
+    //! and the matrix product stays the only per-speaker operation.
+    //! The speakers closer than the farthest one are delayed and attenuated so that
+    //! the wavefronts arrive aligned at the listening position.
+    class SpeakerDecoder
+    {
+    public:
+
+        using float_t = float;
+        using matrix_t = Eigen::Matrix<float_t, Eigen::Dynamic, Eigen::Dynamic>;
+
+        //! @brief Constructor
+        //! @param order The ambisonic order of the soundfield.
+        //! @param layout The speakers.
+        //! @param settings The decoding settings (the layout of the settings is not used).
+        //! @param channels Per harmonic of the library, its ACN channel.
+        //! @param scales Per harmonic of the library, its scale to its SN3D channel.
+        //! @param vectorsize The maximum number of frames of a block.
+        //! @param sample_rate The sample rate.
+        SpeakerDecoder(size_t order, SpeakerLayout const& layout, SpeakerSettings const& settings,
+                       std::vector<size_t> const& channels, std::vector<float_t> const& scales,
+                       size_t vectorsize, double sample_rate);
+
+        ~SpeakerDecoder() = default;
+
+        //! @brief Returns false if the matrix could not be computed.
+        bool isValid() const noexcept { return m_valid; }
+
+        //! @brief Returns the number of speakers.
+        size_t getNumberOfSpeakers() const noexcept { return m_layout.size(); }
+
+        //! @brief Returns the method actually used (never Auto).
+        SpeakerDecoding getDecoding() const noexcept { return m_decoding; }
+
+        //! @brief Returns the decoding matrix (speakers x harmonics of the library).
+        matrix_t const& getMatrix() const noexcept { return m_matrix; }
+
+        //! @brief Decodes a block.
+        //! @param soundfield The harmonics of the library in rows.
+        //! @param frames The number of frames, at most the vectorsize.
+        //! @param channels The number of interleaved output channels, the channels above
+        //! the speakers are silent.
+        //! @param outputs The interleaved outputs.
+        //! @param gain A gain applied to all speakers.
+        void process(Eigen::Ref<const matrix_t> soundfield, size_t frames, size_t channels,
+                     float_t* outputs, float_t gain);
+
+        //! @brief Moves the crossover of the dual-band decoding (audio thread, between two blocks).
+        //! @details Only the low-pass coefficients are computed again, the filter states
+        //! are kept. No effect if the decoder was not built with the dual band or if the
+        //! frequency is not under the Nyquist frequency.
+        void setCrossover(double frequency);
+
+    private:
+
+        //! @brief Computes the decoding matrix of the speakers on the ACN/N3D harmonics.
+        bool computeMatrix(size_t order, SpeakerDecoding decoding, Eigen::MatrixXd& matrix);
+
+        //! @brief Computes the low-pass filter of the crossover.
+        void computeCrossover(double frequency, double sample_rate);
+
+        //! @brief Computes the delays and gains of the distance compensation.
+        void computeCompensation(double sample_rate);
+
+    private:
+
+        const SpeakerLayout m_layout;
+        const size_t m_num_harmonics;
+        const double m_sample_rate;
+        bool m_valid = false;
+        SpeakerDecoding m_decoding = SpeakerDecoding::Auto;
+
+        matrix_t m_matrix {};                   // speakers x harmonics, high band weights
+
+        // dual-band shelf: the matrix holds the high weights, the harmonics are
+        // shelved with x + (low / high - 1) * lowpass(x).
+        bool m_dual_band = false;
+        Eigen::VectorXf m_shelf_gains {};       // per harmonic, low over high weight minus one
+        float_t m_b0 = 0.f, m_b1 = 0.f, m_b2 = 0.f, m_a1 = 0.f, m_a2 = 0.f;
+        matrix_t m_filter_state {};             // harmonics x 2
+        matrix_t m_weighted {};                 // harmonics x vectorsize
+
+        matrix_t m_signals {};                  // speakers x vectorsize
+
+        // distance compensation
+        std::vector<size_t> m_delays {};
+        std::vector<float_t> m_gains {};
+        matrix_t m_delay_lines {};              // speakers x delay line size
+        size_t m_delay_size = 0;
+        size_t m_delay_position = 0;
+    };
+}
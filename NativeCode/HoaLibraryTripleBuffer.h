@@ -0,0 +1,79 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace HoaLibraryUnity
+{
+    // ==================================================================================== //
+    // TripleBuffer
+    // ==================================================================================== //
+    
+    //! @brief Wait-free single-producer single-consumer triple buffer.
+    //! @details The producer fills the write buffer and publishes it, the consumer
+    //! picks up the last published buffer. Neither side ever waits or sees a buffer
+    //! that is being written, the consumer only misses intermediate buffers
+    //! if the producer publishes faster than it reads.
+    template<class T>
+    class TripleBuffer
+    {
+    public:
+        
+        //! @brief Constructor
+        //! @param value Initial value of the three buffers.
+        TripleBuffer(T const& value = T())
+        : m_buffers {{value, value, value}}
+        {}
+        
+        //! @brief Returns the buffer to fill (producer).
+        T& getWriteBuffer() noexcept
+        {
+            return m_buffers[m_write];
+        }
+        
+        //! @brief Publishes the write buffer (producer).
+        void publish() noexcept
+        {
+            m_write = m_middle.exchange(m_write | k_dirty, std::memory_order_acq_rel) & k_index_mask;
+        }
+        
+        //! @brief Picks up the last published buffer if any (consumer).
+        //! @return true if the read buffer changed.
+        bool update() noexcept
+        {
+            if(!(m_middle.load(std::memory_order_relaxed) & k_dirty))
+                return false;
+            
+            m_read = m_middle.exchange(m_read, std::memory_order_acq_rel) & k_index_mask;
+            return true;
+        }
+        
+        //! @brief Returns the last picked up buffer (consumer).
+        T const& getReadBuffer() const noexcept
+        {
+            return m_buffers[m_read];
+        }
+        
+    private:
+        
+        static constexpr uint8_t k_index_mask = 0x3;
+        static constexpr uint8_t k_dirty = 0x4;
+        
+        std::array<T, 3> m_buffers;
+        uint8_t m_write = 0;            // producer only
+        std::atomic<uint8_t> m_middle {1};
+        uint8_t m_read = 2;             // consumer only
+    };
+}
@@ -9,52 +9,512 @@
 // - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
 //==============================================================================
 
-#include "HoaLibraryApi.h"
+#include "HoaLibraryUnity.h"
 #include <memory> // unique_ptr...
 #include <algorithm> // std::fill...
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 namespace HoaLibraryUnity {
 
     namespace
     {
-        // Stores the necessary components for the HoaLibrary system. Methods called
+        // Stores the necessary components for an HoaLibrary instance. Methods called
         // from the native implementation below must check the validity of this
         // instance.
         struct HoaLibrarySystem
         {
-            HoaLibrarySystem(size_t sampleframes)
-            : api(CreateHoaLibraryApi(sampleframes))
-            {}
+            HoaLibrarySystem(ApiSettings const& settings_, uint64_t epoch_)
+            : api(CreateHoaLibraryApi(settings_))
+            , settings(settings_)
+            , epoch(epoch_)
+            , bound(new std::atomic<source_id_t>[k_max_bindings])
+            {
+                for (binding_id_t binding = 0; binding < k_max_bindings; ++binding)
+                {
+                    bound[binding].store(HoaLibraryApi::invalid_source_id, std::memory_order_relaxed);
+                }
+            }
 
             // HoaLibrary API instance to communicate with the internal system.
             std::unique_ptr<HoaLibraryApi> api = nullptr;
+
+            // The settings of the last request applied to the instance (lifecycle_mutex).
+            ApiSettings settings;
+
+            // Initialization the sources belong to.
+            const uint64_t epoch;
+
+            // Per binding, the source or the bed created for it in this initialization.
+            std::unique_ptr<std::atomic<source_id_t>[]> bound;
+        };
+
+        // An instance. Its system is replaced while other threads use it: each thread counts
+        // itself as a reader in the current phase, the phase is flipped once the system is
+        // replaced and the previous system is deleted when the readers of the previous phase
+        // are gone, so that it is never deleted by a reader.
+        struct alignas(64) InstanceSlot
+        {
+            std::atomic<HoaLibrarySystem*> system {nullptr};
+            std::atomic<unsigned> phase {0};
+            std::atomic<size_t> readers[2] {{0}, {0}};
+
+            // owned by a renderer, see Initialize.
+            std::atomic<bool> claimed {false};
+        };
+
+        static InstanceSlot instances[k_max_instances];
+
+        // Incremented at each initialization.
+        static std::atomic<uint64_t> next_epoch {1};
+
+        // Serializes the replacements of the systems.
+        static std::mutex lifecycle_mutex;
+
+        // HRIR set of each instance, loaded again at each initialization.
+        struct HrirRequest
+        {
+            std::string path;
+            std::string cache_directory;
+        };
+
+        static HrirRequest hrir_requests[k_max_instances];
+        static std::mutex hrir_requests_mutex;
+
+        // The settings an instance must be built with, the last request wins (requests_mutex).
+        struct BuildRequest
+        {
+            bool active = false;        // initialized, or shut down
+            bool keep = false;          // the current system may be kept (ReinitializeInBackground)
+            ApiSettings settings {};
+            uint64_t version = 0;       // incremented by each request
+            bool pending = false;       // waits for the builder thread
+        };
+
+        static BuildRequest requests[k_max_instances];
+        static std::mutex requests_mutex;
+        static std::condition_variable requests_condition;
+
+        // A source or a bed created again in each initialization of its instance (bindings_mutex).
+        struct Binding
+        {
+            bool used = false;
+            bool bed = false;
+            std::atomic<instance_id_t> instance {-1};   // also read by GetBoundSource
+        };
+
+        static Binding bindings[k_max_bindings];
+        static std::mutex bindings_mutex;
+
+        // Uses the system of an instance, it is not deleted before the reference is destroyed.
+        // Lock-free, a reader only counts itself again if the system is replaced at the same time.
+        class SystemRef
+        {
+        public:
+
+            explicit SystemRef(instance_id_t instance)
+            {
+                if (instance < 0 || instance >= k_max_instances)
+                    return;
+
+                // counted in a phase only if it is still the current one once counted.
+                auto& slot = instances[instance];
+                for (;;)
+                {
+                    const unsigned phase = slot.phase.load() & 1u;
+                    slot.readers[phase].fetch_add(1);
+                    if ((slot.phase.load() & 1u) == phase)
+                    {
+                        m_readers = &slot.readers[phase];
+                        break;
+                    }
+
+                    slot.readers[phase].fetch_sub(1);
+                }
+
+                m_system = slot.system.load();
+            }
+
+            // the system of the handle, nullptr if the instance was initialized again since.
+            explicit SystemRef(SourceHandle const& handle)
+            : SystemRef(handle.instance)
+            {
+                if (m_system != nullptr && m_system->epoch != handle.epoch)
+                {
+                    m_system = nullptr;
+                }
+            }
+
+            ~SystemRef()
+            {
+                if (m_readers != nullptr)
+                {
+                    m_readers->fetch_sub(1, std::memory_order_release);
+                }
+            }
+
+            SystemRef(SystemRef const&) = delete;
+            SystemRef& operator=(SystemRef const&) = delete;
+
+            explicit operator bool() const noexcept { return m_system != nullptr; }
+            HoaLibrarySystem* operator->() const noexcept { return m_system; }
+
+        private:
+
+            std::atomic<size_t>* m_readers = nullptr;
+            HoaLibrarySystem* m_system = nullptr;
+        };
+
+        // The speaker crossover and the near-field radius are changed in the current system.
+        bool needsRebuild(ApiSettings const& lhs, ApiSettings const& rhs)
+        {
+            return (lhs.vectorsize != rhs.vectorsize || lhs.sample_rate != rhs.sample_rate
+                    || lhs.order != rhs.order || lhs.world_frame != rhs.world_frame
+                    || lhs.max_sources != rhs.max_sources || lhs.max_beds != rhs.max_beds
+                    || lhs.partitioned_decoder != rhs.partitioned_decoder
+                    || lhs.decoder_partition_size != rhs.decoder_partition_size
+                    || lhs.near_field.enabled != rhs.near_field.enabled
+                    || lhs.near_field.max_boost != rhs.near_field.max_boost
+                    || lhs.speakers.layout != rhs.speakers.layout
+                    || lhs.speakers.decoding != rhs.speakers.decoding
+                    || lhs.speakers.dual_band != rhs.speakers.dual_band);
+        }
+
+        // Records the request of an instance, it replaces the previous one. Returns its version.
+        uint64_t post(instance_id_t instance, BuildRequest const& request);
+
+        // Returns true if no request was made for an instance since this version.
+        bool isCurrentRequest(instance_id_t instance, uint64_t version)
+        {
+            std::lock_guard<std::mutex> lock(requests_mutex);
+            return requests[instance].version == version;
+        }
+
+        // Creates the source or the bed of a binding in the current system of its instance (bindings_mutex held).
+        void createBound(binding_id_t binding)
+        {
+            SystemRef system(bindings[binding].instance.load());
+            if (system)
+            {
+                const auto id = bindings[binding].bed ? system->api->createBed() : system->api->createSource();
+                system->bound[binding].store(id, std::memory_order_release);
+            }
+        }
+
+        // Destroys the source or the bed of a binding in the current system of its instance (bindings_mutex held).
+        void destroyBound(binding_id_t binding)
+        {
+            SystemRef system(bindings[binding].instance.load());
+            if (system)
+            {
+                const auto id = system->bound[binding].exchange(HoaLibraryApi::invalid_source_id);
+                if (bindings[binding].bed)
+                {
+                    system->api->destroyBed(id);
+                }
+                else
+                {
+                    system->api->destroySource(id);
+                }
+            }
+        }
+
+        // Replaces the system of an instance, the sources and the beds bound to the instance are
+        // created in the new one first. Returns once the previous one is deleted (lifecycle_mutex held).
+        void publish(instance_id_t instance, std::unique_ptr<HoaLibrarySystem> system)
+        {
+            auto& slot = instances[instance];
+            std::unique_ptr<HoaLibrarySystem> previous;
+            unsigned phase = 0;
+            {
+                std::lock_guard<std::mutex> lock(bindings_mutex);
+                for (binding_id_t binding = 0; system != nullptr && binding < k_max_bindings; ++binding)
+                {
+                    auto const& bound = bindings[binding];
+                    if (bound.used && bound.instance.load() == instance)
+                    {
+                        const auto id = bound.bed ? system->api->createBed() : system->api->createSource();
+                        system->bound[binding].store(id, std::memory_order_relaxed);
+                    }
+                }
+
+                // the HRIR set requested last, LoadHrir uses the current system.
+                std::lock_guard<std::mutex> hrir_lock(hrir_requests_mutex);
+                auto const& hrir = hrir_requests[instance];
+                if (system != nullptr && !hrir.path.empty())
+                {
+                    system->api->loadHrir(hrir.path, hrir.cache_directory);
+                }
+
+                previous.reset(slot.system.exchange(system.release()));
+                phase = slot.phase.fetch_xor(1u) & 1u;
+            }
+
+            // the audio threads may still be processing a block with the previous system.
+            while (slot.readers[phase].load(std::memory_order_acquire) != 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        // Applies a request to an instance: builds the system, or only updates the current one
+        // if its settings allow it (control or builder thread).
+        void apply(instance_id_t instance, BuildRequest const& request)
+        {
+            {
+                std::lock_guard<std::mutex> lock(lifecycle_mutex);
+                auto* system = instances[instance].system.load();
+                if (request.keep && system != nullptr && !needsRebuild(system->settings, request.settings))
+                {
+                    if (!isCurrentRequest(instance, request.version))
+                        return;
+
+                    auto const& settings = request.settings;
+                    if (settings.speakers.crossover != system->settings.speakers.crossover)
+                    {
+                        system->api->setSpeakerCrossover(settings.speakers.crossover);
+                    }
+
+                    if (settings.near_field.radius != system->settings.near_field.radius)
+                    {
+                        system->api->setNearFieldRadius(settings.near_field.radius);
+                    }
+
+                    system->settings = settings;
+                    return;
+                }
+            }
+
+            std::unique_ptr<HoaLibrarySystem> system = nullptr;
+            if (request.active)
+            {
+                system = std::make_unique<HoaLibrarySystem>(request.settings, next_epoch.fetch_add(1));
+            }
+
+            // a newer request replaces this one.
+            std::lock_guard<std::mutex> lock(lifecycle_mutex);
+            if (isCurrentRequest(instance, request.version))
+            {
+                publish(instance, std::move(system));
+            }
+        }
+
+        // Applies the requests made with the background functions, one at a time.
+        class InstanceBuilder
+        {
+        public:
+
+            ~InstanceBuilder()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(requests_mutex);
+                    m_stopping = true;
+                }
+
+                requests_condition.notify_one();
+                if (m_thread.joinable())
+                {
+                    m_thread.join();
+                }
+
+                for (auto& slot : instances)
+                {
+                    delete slot.system.exchange(nullptr);
+                }
+            }
+
+            // Starts the thread, by the first request (requests_mutex held).
+            void start()
+            {
+                if (!m_thread.joinable() && !m_stopping)
+                {
+                    m_thread = std::thread([this]() { run(); });
+                }
+            }
+
+        private:
+
+            void run()
+            {
+                std::unique_lock<std::mutex> lock(requests_mutex);
+                while (!m_stopping)
+                {
+                    auto it = std::find_if(std::begin(requests), std::end(requests),
+                                           [](BuildRequest const& request) { return request.pending; });
+                    if (it == std::end(requests))
+                    {
+                        requests_condition.wait(lock);
+                        continue;
+                    }
+
+                    it->pending = false;
+                    const BuildRequest request = *it;
+                    const auto instance = static_cast<instance_id_t>(it - std::begin(requests));
+
+                    lock.unlock();
+                    apply(instance, request);
+                    lock.lock();
+                }
+            }
+
+            std::thread m_thread {};
+            bool m_stopping = false;
         };
 
-        // Singleton instance to communicate with the internal API.
-        static std::shared_ptr<HoaLibrarySystem> hoalib = nullptr;
+        // destroyed first, with the instances left.
+        static InstanceBuilder builder;
+
+        uint64_t post(instance_id_t instance, BuildRequest const& request)
+        {
+            uint64_t version = 0;
+            {
+                std::lock_guard<std::mutex> lock(requests_mutex);
+                auto& current = requests[instance];
+
+                // the system may belong to the request replaced, it is not kept then.
+                const bool keep = request.keep && !(current.pending && !current.keep);
+                version = current.version + 1;
+                current = request;
+                current.keep = keep;
+                current.version = version;
+                builder.start();
+            }
+
+            if (request.pending)
+            {
+                requests_condition.notify_one();
+            }
+
+            return version;
+        }
+
+        bool isValidInstance(instance_id_t instance)
+        {
+            return instance >= 0 && instance < k_max_instances;
+        }
+
+        // Claims an instance for the caller, false if it is already claimed.
+        bool claim(instance_id_t instance)
+        {
+            bool expected = false;
+            return isValidInstance(instance) && instances[instance].claimed.compare_exchange_strong(expected, true);
+        }
+
+        binding_id_t bind(instance_id_t instance, bool bed)
+        {
+            std::lock_guard<std::mutex> lock(bindings_mutex);
+            auto it = std::find_if(std::begin(bindings), std::end(bindings),
+                                   [](Binding const& binding) { return !binding.used; });
+            if (it == std::end(bindings))
+                return invalid_binding_id;
+
+            const auto binding = static_cast<binding_id_t>(it - std::begin(bindings));
+            it->used = true;
+            it->bed = bed;
+            it->instance.store(instance);
+            createBound(binding);
+            return binding;
+        }
+
+        SourceHandle getBound(binding_id_t binding)
+        {
+            SourceHandle handle;
+            if (binding < 0 || binding >= k_max_bindings)
+                return handle;
+
+            const auto instance = bindings[binding].instance.load(std::memory_order_acquire);
+            SystemRef system(instance);
+            if (system)
+            {
+                handle.instance = instance;
+                handle.epoch = system->epoch;
+                handle.id = system->bound[binding].load(std::memory_order_acquire);
+            }
+            return handle;
+        }
 
     }  // namespace
 
-    void Initialize(size_t vectorsize)
+    bool Initialize(instance_id_t instance, ApiSettings const& settings)
+    {
+        assert(settings.vectorsize != 0);
+
+        if (!claim(instance))
+            return false;
+
+        BuildRequest request;
+        request.active = true;
+        request.settings = settings;
+        request.version = post(instance, request);
+        apply(instance, request);
+        return true;
+    }
+
+    bool InitializeInBackground(instance_id_t instance, ApiSettings const& settings)
+    {
+        assert(settings.vectorsize != 0);
+
+        if (!claim(instance))
+            return false;
+
+        BuildRequest request;
+        request.active = true;
+        request.settings = settings;
+        request.pending = true;
+        post(instance, request);
+        return true;
+    }
+
+    void ReinitializeInBackground(instance_id_t instance, ApiSettings const& settings)
+    {
+        if (isValidInstance(instance) && instances[instance].claimed.load())
+        {
+            BuildRequest request;
+            request.active = true;
+            request.keep = true;
+            request.settings = settings;
+            request.pending = true;
+            post(instance, request);
+        }
+    }
+
+    void Shutdown(instance_id_t instance)
     {
-        assert(vectorsize != 0);
-        hoalib = std::make_shared<HoaLibrarySystem>(vectorsize);
+        if (isValidInstance(instance))
+        {
+            BuildRequest request;
+            request.version = post(instance, request);
+            apply(instance, request);
+            instances[instance].claimed.store(false);
+        }
     }
 
-    void Shutdown()
+    void ShutdownInBackground(instance_id_t instance)
     {
-        hoalib.reset();
+        if (isValidInstance(instance))
+        {
+            BuildRequest request;
+            request.pending = true;
+            post(instance, request);
+            instances[instance].claimed.store(false);
+        }
     }
 
-    void ProcessListener(size_t frames, float_t* output)
+    bool IsInitialized(instance_id_t instance)
+    {
+        return static_cast<bool>(SystemRef(instance));
+    }
+
+    void ProcessListener(instance_id_t instance, size_t frames, float_t* output, dsptick_t dsptick)
     {
         assert(output != nullptr);
 
         const size_t channels = 2;
-        auto hoalib_copy = hoalib;
+        SystemRef system(instance);
 
-        if (hoalib_copy == nullptr
-            || !hoalib_copy->api->fillInterleavedOutputBuffer(frames, output))
+        if (!system
+            || !system->api->fillInterleavedOutputBuffer(frames, output, dsptick))
         {
             // No valid output was rendered, fill the output buffer with zeros.
             const size_t buffer_size_samples = channels * frames;
@@ -62,79 +522,424 @@ namespace HoaLibraryUnity {
         }
     }
 
-    void SetMasterGain(float_t gain)
+    void ProcessListenerAmbisonic(instance_id_t instance, size_t frames, size_t channels,
+                                  float_t* output, dsptick_t dsptick)
+    {
+        assert(output != nullptr);
+
+        SystemRef system(instance);
+
+        if (!system
+            || !system->api->fillInterleavedAmbisonicBuffer(frames, channels, output, dsptick))
+        {
+            std::fill(output, output + channels * frames, 0.0f);
+        }
+    }
+
+    void ProcessListenerSpeakers(instance_id_t instance, size_t frames, size_t channels,
+                                 float_t* output, dsptick_t dsptick)
+    {
+        assert(output != nullptr);
+
+        SystemRef system(instance);
+
+        if (!system
+            || !system->api->fillInterleavedSpeakerBuffer(frames, channels, output, dsptick))
+        {
+            std::fill(output, output + channels * frames, 0.0f);
+        }
+    }
+
+    void SetMasterGain(instance_id_t instance, float_t gain)
+    {
+        SystemRef system(instance);
+        if (system)
+        {
+            system->api->setMasterGain(gain);
+        }
+    }
+
+    void SetEncodingMode(instance_id_t instance, EncodingMode mode)
+    {
+        SystemRef system(instance);
+        if (system)
+        {
+            system->api->setEncodingMode(mode);
+        }
+    }
+
+    void SetWorkerThreads(instance_id_t instance, size_t num_threads, bool pin_threads)
+    {
+        SystemRef system(instance);
+        if (system)
+        {
+            system->api->setWorkerThreads(num_threads, pin_threads);
+        }
+    }
+
+    void SetOrderLod(instance_id_t instance, OrderLodSettings const& settings)
+    {
+        SystemRef system(instance);
+        if (system)
+        {
+            system->api->setOrderLod(settings);
+        }
+    }
+
+    InputStatistics GetInputStatistics(instance_id_t instance)
+    {
+        SystemRef system(instance);
+        if (system)
+        {
+            return system->api->getInputStatistics();
+        }
+        return {};
+    }
+
+    void SetEncodingBudget(instance_id_t instance, float_t microseconds)
+    {
+        SystemRef system(instance);
+        if (system)
+        {
+            system->api->setEncodingBudget(microseconds);
+        }
+    }
+
+    VoiceStatistics GetVoiceStatistics(instance_id_t instance)
+    {
+        SystemRef system(instance);
+        if (system)
+        {
+            return system->api->getVoiceStatistics();
+        }
+        return {};
+    }
+
+    DspMetrics GetDspMetrics(instance_id_t instance)
+    {
+        SystemRef system(instance);
+        if (system)
+        {
+            return system->api->getDspMetrics();
+        }
+        return {};
+    }
+
+    void SetQualitySettings(instance_id_t instance, QualitySettings const& settings)
+    {
+        SystemRef system(instance);
+        if (system)
+        {
+            system->api->setQualitySettings(settings);
+        }
+    }
+
+    QualityLog GetQualityLog(instance_id_t instance)
+    {
+        SystemRef system(instance);
+        if (system)
+        {
+            return system->api->getQualityLog();
+        }
+        return {};
+    }
+
+    bool LoadHrir(instance_id_t instance, std::string const& path, std::string const& cache_directory)
+    {
+        if (instance < 0 || instance >= k_max_instances)
+            return false;
+
+        std::lock_guard<std::mutex> lock(hrir_requests_mutex);
+        hrir_requests[instance] = {path, cache_directory};
+
+        SystemRef system(instance);
+        if (system && !path.empty())
+        {
+            system->api->loadHrir(path, cache_directory);
+        }
+        return true;
+    }
+
+    HrirStatus GetHrirStatus(instance_id_t instance)
+    {
+        SystemRef system(instance);
+        if (system)
+        {
+            return system->api->getHrirStatus();
+        }
+        return HrirStatus::Default;
+    }
+
+    bool IsWorldFrame(instance_id_t instance)
+    {
+        SystemRef system(instance);
+        return system && system->api->isWorldFrame();
+    }
+
+    void SetListenerOrientation(instance_id_t instance, Quaternion const& orientation)
+    {
+        SystemRef system(instance);
+        if (system)
+        {
+            system->api->setListenerOrientation(orientation);
+        }
+    }
+
+    void PublishListenerOrientation(instance_id_t instance, float_t const* lm, Quaternion& published)
+    {
+        Eigen::Matrix3d listener_to_world;
+        for (int r = 0; r < 3; ++r)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                listener_to_world(r, c) = lm[r * 4 + c];
+            }
+        }
+
+        const auto orientation = get_quaternion(listener_to_world);
+        if (orientation.w != published.w || orientation.x != published.x
+            || orientation.y != published.y || orientation.z != published.z)
+        {
+            SetListenerOrientation(instance, orientation);
+            published = orientation;
+        }
+    }
+
+    void SetHeadOrientation(instance_id_t instance, Quaternion const& orientation)
     {
-        auto hoalib_copy = hoalib;
-        if (hoalib_copy != nullptr)
+        SystemRef system(instance);
+        if (system)
         {
-            hoalib_copy->api->setMasterGain(gain);
+            system->api->setHeadOrientation(orientation);
         }
     }
 
-    HoaLibraryApi::source_id_t CreateSource()
+    void SetHeadTrackingSubblockSize(instance_id_t instance, size_t subblock_size)
     {
-        auto id = HoaLibraryApi::invalid_source_id;
-        auto hoalib_copy = hoalib;
-        if (hoalib_copy != nullptr)
+        SystemRef system(instance);
+        if (system)
         {
-            id = hoalib_copy->api->createSource();
+            system->api->setHeadTrackingSubblockSize(subblock_size);
         }
-        return id;
     }
 
-    void DestroySource(HoaLibraryApi::source_id_t id)
+    SourceHandle CreateSource(instance_id_t instance)
+    {
+        SourceHandle source;
+        SystemRef system(instance);
+        if (system)
+        {
+            source.instance = instance;
+            source.epoch = system->epoch;
+            source.id = system->api->createSource();
+        }
+        return source;
+    }
+
+    bool IsSourceValid(SourceHandle const& source)
+    {
+        SystemRef system(source);
+        return (system && system->api->isSourceValid(source.id));
+    }
+
+    void DestroySource(SourceHandle const& source)
     {
-        auto hoalib_copy = hoalib;
-        if (hoalib_copy != nullptr)
+        SystemRef system(source);
+        if (system)
         {
-            hoalib_copy->api->destroySource(id);
+            system->api->destroySource(source.id);
         }
     }
 
-    void ProcessSource(HoaLibraryApi::source_id_t id, size_t num_frames, float_t* inputs)
+    void ProcessSource(SourceHandle const& source, size_t num_frames, float_t* inputs, dsptick_t dsptick)
     {
         assert(inputs != nullptr);
 
-        auto hoalib_copy = hoalib;
-        if (hoalib_copy != nullptr)
+        SystemRef system(source);
+        if (system)
+        {
+            system->api->setInterleavedSourceBuffer(source.id, inputs, num_frames, dsptick);
+        }
+    }
+
+    void SetSourcePan(SourceHandle const& source, float_t pan)
+    {
+        SystemRef system(source);
+        if (system)
+        {
+            system->api->setSourcePan(source.id, pan);
+        }
+    }
+
+    void SetSourceGain(SourceHandle const& source, float_t gain)
+    {
+        SystemRef system(source);
+        if (system)
+        {
+            system->api->setSourceGain(source.id, gain);
+        }
+    }
+
+    void SetSourcePosition(SourceHandle const& source, float_t px, float_t py, float_t pz)
+    {
+        SystemRef system(source);
+        if (system)
+        {
+            system->api->setSourcePosition(source.id, px, py, pz);
+        }
+    }
+
+    void SetSourceOptim(SourceHandle const& source, int optim)
+    {
+        SystemRef system(source);
+        if (system)
+        {
+            system->api->setSourceOptim(source.id, optim);
+        }
+    }
+
+    void SetSourcePriority(SourceHandle const& source, float_t priority)
+    {
+        SystemRef system(source);
+        if (system)
+        {
+            system->api->setSourcePriority(source.id, priority);
+        }
+    }
+
+    void SetSourceMinDistance(SourceHandle const& source, float_t distance)
+    {
+        SystemRef system(source);
+        if (system)
+        {
+            system->api->setSourceMinDistance(source.id, distance);
+        }
+    }
+
+    BedHandle CreateBed(instance_id_t instance)
+    {
+        BedHandle bed;
+        SystemRef system(instance);
+        if (system)
+        {
+            bed.instance = instance;
+            bed.epoch = system->epoch;
+            bed.id = system->api->createBed();
+        }
+        return bed;
+    }
+
+    bool IsBedValid(BedHandle const& bed)
+    {
+        SystemRef system(bed);
+        return (system && system->api->isBedValid(bed.id));
+    }
+
+    void DestroyBed(BedHandle const& bed)
+    {
+        SystemRef system(bed);
+        if (system)
         {
-            hoalib_copy->api->setInterleavedSourceBuffer(id, inputs, num_frames);
+            system->api->destroyBed(bed.id);
         }
     }
 
-    void SetSourcePan(HoaLibraryApi::source_id_t id, float_t pan)
+    void ProcessBed(BedHandle const& bed, size_t num_channels, size_t num_frames,
+                    float_t const* input, dsptick_t dsptick)
     {
-        auto hoalib_copy = hoalib;
-        if (hoalib_copy != nullptr)
+        assert(input != nullptr);
+
+        SystemRef system(bed);
+        if (system)
         {
-            hoalib_copy->api->setSourcePan(id, pan);
+            system->api->setInterleavedBedBuffer(bed.id, input, num_channels, num_frames, dsptick);
         }
     }
 
-    void SetSourceGain(HoaLibraryApi::source_id_t id, float_t gain)
+    void SetBedGain(BedHandle const& bed, float_t gain)
     {
-        auto hoalib_copy = hoalib;
-        if (hoalib_copy != nullptr)
+        SystemRef system(bed);
+        if (system)
         {
-            hoalib_copy->api->setSourceGain(id, gain);
+            system->api->setBedGain(bed.id, gain);
         }
     }
 
-    void SetSourcePosition(HoaLibraryApi::source_id_t id, float_t px, float_t py, float_t pz)
+    binding_id_t BindSource(instance_id_t instance)
     {
-        auto hoalib_copy = hoalib;
-        if (hoalib_copy != nullptr)
+        return bind(instance, false);
+    }
+
+    binding_id_t BindBed(instance_id_t instance)
+    {
+        return bind(instance, true);
+    }
+
+    void Rebind(binding_id_t binding, instance_id_t instance)
+    {
+        if (binding < 0 || binding >= k_max_bindings)
+            return;
+
+        std::lock_guard<std::mutex> lock(bindings_mutex);
+        if (bindings[binding].used && bindings[binding].instance.load() != instance)
         {
-            hoalib_copy->api->setSourcePosition(id, px, py, pz);
+            destroyBound(binding);
+            bindings[binding].instance.store(instance);
+            createBound(binding);
         }
     }
 
-    void SetSourceOptim(HoaLibraryApi::source_id_t id, int optim)
+    void Unbind(binding_id_t binding)
     {
-        auto hoalib_copy = hoalib;
-        if (hoalib_copy != nullptr)
+        if (binding < 0 || binding >= k_max_bindings)
+            return;
+
+        std::lock_guard<std::mutex> lock(bindings_mutex);
+        if (bindings[binding].used)
         {
-            hoalib_copy->api->setSourceOptim(id, optim);
+            destroyBound(binding);
+            bindings[binding].instance.store(-1);
+            bindings[binding].used = false;
         }
     }
+
+    SourceHandle GetBoundSource(binding_id_t binding)
+    {
+        return getBound(binding);
+    }
+
+    BedHandle GetBoundBed(binding_id_t binding)
+    {
+        return getBound(binding);
+    }
+
+    bool HoaLibraryLoadHrir(instance_id_t instance, char const* path, char const* cache_directory)
+    {
+        return LoadHrir(instance, path != nullptr ? path : "", cache_directory != nullptr ? cache_directory : "");
+    }
+
+    int HoaLibraryGetHrirStatus(instance_id_t instance)
+    {
+        return static_cast<int>(GetHrirStatus(instance));
+    }
+
+    void HoaLibrarySetListenerOrientation(instance_id_t instance, float w, float x, float y, float z)
+    {
+        Quaternion orientation;
+        orientation.w = w;
+        orientation.x = x;
+        orientation.y = y;
+        orientation.z = z;
+        SetListenerOrientation(instance, orientation);
+    }
+
+    void HoaLibrarySetHeadOrientation(instance_id_t instance, float w, float x, float y, float z)
+    {
+        Quaternion orientation;
+        orientation.w = w;
+        orientation.x = x;
+        orientation.y = y;
+        orientation.z = z;
+        SetHeadOrientation(instance, orientation);
+    }
 }
@@ -17,38 +17,238 @@ namespace HoaLibraryUnity
 {
     using source_id_t = HoaLibraryApi::source_id_t;
 
-    //! @brief Initializes the HoaLibrary system with Unity audio engine settings.
-    void Initialize(size_t vectorsize);
+    //! @brief Identifies an HoaLibrary instance, in the range [0, k_max_instances).
+    using instance_id_t = int;
 
-    //! @brief Shuts down the HoaLibrary system.
-    void Shutdown();
+    //! @brief Maximum number of HoaLibrary instances alive at the same time.
+    static constexpr instance_id_t k_max_instances = 16;
+
+    //! @brief A source of an instance.
+    //! @details The epoch identifies the initialization of the instance the source was
+    //! created by, the handle becomes invalid when the instance is shut down or re-initialized.
+    struct SourceHandle
+    {
+        instance_id_t instance = -1;
+        uint64_t epoch = 0;
+        source_id_t id = HoaLibraryApi::invalid_source_id;
+    };
+
+    //! @brief An ambisonic bed of an instance, invalidated like the sources.
+    using BedHandle = SourceHandle;
+
+    //! @brief Identifies a source or a bed bound to an instance (see BindSource).
+    using binding_id_t = int;
+
+    //! @brief Maximum number of sources and beds bound at the same time.
+    static constexpr binding_id_t k_max_bindings = 2048;
+
+    //! @brief A binding that does not exist.
+    static constexpr binding_id_t invalid_binding_id = -1;
+
+    //! @brief Initializes an HoaLibrary instance with Unity audio engine settings.
+    //! @details Each instance is independent, the functions of different instances can be called
+    //! concurrently, and the ones of an instance are as thread-safe as the HoaLibraryApi.
+    //! The caller owns the instance until it shuts it down. The instance is built on the calling
+    //! thread, this method must not be called from the audio thread.
+    //! @return false if the instance id is out of range or if the instance is already owned.
+    bool Initialize(instance_id_t instance, ApiSettings const& settings);
+
+    //! @brief Initializes an HoaLibrary instance on a background thread (any thread).
+    //! @details The caller owns the instance from now on, the instance renders silence until
+    //! it is built.
+    //! @return false if the instance id is out of range or if the instance is already owned.
+    bool InitializeInBackground(instance_id_t instance, ApiSettings const& settings);
+
+    //! @brief Initializes again an instance owned by the caller with new settings, on a
+    //! background thread (any thread).
+    //! @details The current instance renders until the new one replaces it, the last request
+    //! wins. Only the speaker crossover or the near-field radius changed: the current instance
+    //! is kept, only its speaker decoder crossover or its near-field filters are updated.
+    void ReinitializeInBackground(instance_id_t instance, ApiSettings const& settings);
+
+    //! @brief Shuts down an HoaLibrary instance.
+    //! @details Waits for the other threads to be done with the instance, it is destroyed
+    //! on the calling thread. This method must not be called from the audio thread.
+    void Shutdown(instance_id_t instance);
+
+    //! @brief Shuts down an HoaLibrary instance on a background thread (any thread).
+    //! @details The instance is not owned anymore, it can be initialized again right away.
+    void ShutdownInBackground(instance_id_t instance);
+
+    //! @brief Returns true if the instance is initialized.
+    bool IsInitialized(instance_id_t instance);
 
     //! @brief Processes the next output buffer and stores the processed buffer in |output|.
     //! This method must be called from the audio thread.
-    void ProcessListener(size_t num_frames, float_t* output);
+    void ProcessListener(instance_id_t instance, size_t num_frames, float_t* output, dsptick_t dsptick);
+
+    //! @brief Processes the next output buffer without decoding, in AmbiX format
+    //! (see HoaLibraryApi::fillInterleavedAmbisonicBuffer).
+    //! This method must be called from the audio thread.
+    void ProcessListenerAmbisonic(instance_id_t instance, size_t num_frames, size_t num_channels,
+                                  float_t* output, dsptick_t dsptick);
+
+    //! @brief Processes the next output buffer decoded to the loudspeaker layout of the instance
+    //! (see HoaLibraryApi::fillInterleavedSpeakerBuffer).
+    //! This method must be called from the audio thread.
+    void ProcessListenerSpeakers(instance_id_t instance, size_t num_frames, size_t num_channels,
+                                 float_t* output, dsptick_t dsptick);
 
     //! @brief Updates the listener's master gain.
-    void SetMasterGain(float_t gain);
+    void SetMasterGain(instance_id_t instance, float_t gain);
+
+    //! @brief Sets the way sources are encoded.
+    void SetEncodingMode(instance_id_t instance, EncodingMode mode);
+
+    //! @brief Sets the number of threads helping the audio thread to encode the sources.
+    //! This method must not be called from the audio thread.
+    void SetWorkerThreads(instance_id_t instance, size_t num_threads, bool pin_threads);
+
+    //! @brief Sets the level of detail of the order of the sources.
+    void SetOrderLod(instance_id_t instance, OrderLodSettings const& settings);
+
+    //! @brief Returns the counters of the source input blocks.
+    InputStatistics GetInputStatistics(instance_id_t instance);
+
+    //! @brief Sets the time budget of the encoding of the sources per block in microseconds.
+    void SetEncodingBudget(instance_id_t instance, float_t microseconds);
+
+    //! @brief Returns the counts of the voices scheduled in the last block.
+    VoiceStatistics GetVoiceStatistics(instance_id_t instance);
+
+    //! @brief Returns the DSP load metrics of the renderer of an instance (see HoaLibraryApi::getDspMetrics).
+    //! This method must not be called from the audio thread.
+    DspMetrics GetDspMetrics(instance_id_t instance);
+
+    //! @brief Sets the adaptive quality of an instance (see HoaLibraryApi::setQualitySettings).
+    void SetQualitySettings(instance_id_t instance, QualitySettings const& settings);
+
+    //! @brief Returns the last adaptive quality decisions of an instance.
+    //! This method must not be called from the audio thread.
+    QualityLog GetQualityLog(instance_id_t instance);
+
+    //! @brief Decodes the outputs of an instance with an HRIR set (see HoaLibraryApi::loadHrir).
+    //! @details The HRIR set is loaded again each time the instance is initialized.
+    //! This method must not be called from the audio thread.
+    //! @param path The HRIR set file (empty to keep the built-in set from the next initialization).
+    //! @param cache_directory The directory of the decoding filters cache (empty for no cache).
+    //! @return false if the instance id is out of range.
+    bool LoadHrir(instance_id_t instance, std::string const& path, std::string const& cache_directory);
 
-    //! @brief Creates an object audio source to be spatialized.
-    source_id_t CreateSource();
+    //! @brief Returns the state of the HRIR set of an instance.
+    HrirStatus GetHrirStatus(instance_id_t instance);
+
+    //! @brief Returns true if the sources positions of an instance are given in the world frame.
+    bool IsWorldFrame(instance_id_t instance);
+
+    //! @brief Sets the listener orientation of an instance in world frame (any thread).
+    void SetListenerOrientation(instance_id_t instance, Quaternion const& orientation);
+
+    //! @brief Sets the listener orientation of an instance from a Unity listener matrix,
+    //! if it differs from the last one published by the caller (any thread).
+    //! @details The listener matrix rotates from the world to the listener,
+    //! the orientation is its inverse.
+    //! @param listener_matrix The 4x4 column-major listener matrix.
+    //! @param published The last orientation published by the caller, updated.
+    void PublishListenerOrientation(instance_id_t instance, float_t const* listener_matrix,
+                                    Quaternion& published);
+
+    //! @brief Sets the head orientation of an instance, relative to the listener
+    //! (any thread, see HoaLibraryApi::setHeadOrientation).
+    void SetHeadOrientation(instance_id_t instance, Quaternion const& orientation);
+
+    //! @brief Sets the number of frames between two readings of the head orientation.
+    void SetHeadTrackingSubblockSize(instance_id_t instance, size_t subblock_size);
+
+    //! @brief Creates an object audio source to be spatialized by an instance.
+    //! @return The source, check it with IsSourceValid.
+    SourceHandle CreateSource(instance_id_t instance);
+
+    //! @brief Returns true if the source exists and its instance was not re-initialized.
+    bool IsSourceValid(SourceHandle const& source);
 
     //! @brief Removes source
-    void DestroySource(source_id_t id);
+    void DestroySource(SourceHandle const& source);
 
     //! @brief Passes the next input buffer of the source to the system.
-    void ProcessSource(source_id_t id, size_t num_frames, float_t* input);
+    void ProcessSource(SourceHandle const& source, size_t num_frames, float_t* input, dsptick_t dsptick);
 
     //! @brief Sets the stereo pan
-    void SetSourcePan(source_id_t id, float_t pan);
+    void SetSourcePan(SourceHandle const& source, float_t pan);
 
     //! @brief Sets the stereo pan
-    void SetSourceGain(source_id_t id, float_t gain);
+    void SetSourceGain(SourceHandle const& source, float_t gain);
 
     //! @brief Updates the position of the source.
-    void SetSourcePosition(HoaLibraryApi::source_id_t id,
+    void SetSourcePosition(SourceHandle const& source,
                            float_t px, float_t py, float_t pz);
 
     //! @brief Sets the source ambisonic optimization.
-    void SetSourceOptim(HoaLibraryApi::source_id_t id, int optim);
+    void SetSourceOptim(SourceHandle const& source, int optim);
+
+    //! @brief Sets the source priority when the harmonics budget is exceeded.
+    void SetSourcePriority(SourceHandle const& source, float_t priority);
+
+    //! @brief Sets the source minimum distance in meters.
+    void SetSourceMinDistance(SourceHandle const& source, float_t distance);
+
+    //! @brief Creates an ambisonic bed summed into the soundfield of an instance.
+    //! @return The bed, check it with IsBedValid.
+    BedHandle CreateBed(instance_id_t instance);
+
+    //! @brief Returns true if the bed exists and its instance was not re-initialized.
+    bool IsBedValid(BedHandle const& bed);
+
+    //! @brief Removes a bed.
+    void DestroyBed(BedHandle const& bed);
+
+    //! @brief Passes the next block of AmbiX channels of the bed to the system.
+    void ProcessBed(BedHandle const& bed, size_t num_channels, size_t num_frames,
+                    float_t const* input, dsptick_t dsptick);
+
+    //! @brief Sets the linear gain of a bed.
+    void SetBedGain(BedHandle const& bed, float_t gain);
+
+    //! @brief Binds a source to an instance.
+    //! @details The source is created in the instance now if it is initialized, then in each
+    //! initialization of the instance before its first block, so that the caller never has
+    //! to create it again. This method must not be called from the audio thread.
+    //! @return The binding, invalid_binding_id if there are too many bindings.
+    binding_id_t BindSource(instance_id_t instance);
+
+    //! @brief Binds a bed to an instance, like BindSource.
+    binding_id_t BindBed(instance_id_t instance);
+
+    //! @brief Moves a binding to another instance, its source or its bed is created again.
+    //! This method must not be called from the audio thread.
+    void Rebind(binding_id_t binding, instance_id_t instance);
+
+    //! @brief Destroys the source or the bed of a binding and frees the binding.
+    //! This method must not be called from the audio thread.
+    void Unbind(binding_id_t binding);
+
+    //! @brief Returns the source of a binding in the current initialization of its instance
+    //! (any thread, lock-free).
+    //! @return The source, with an invalid id while the instance is not initialized.
+    SourceHandle GetBoundSource(binding_id_t binding);
+
+    //! @brief Returns the bed of a binding, like GetBoundSource.
+    BedHandle GetBoundBed(binding_id_t binding);
+
+    extern "C"
+    {
+        //! @brief LoadHrir entry point for managed code.
+        HOA_EXPORT bool HoaLibraryLoadHrir(instance_id_t instance, char const* path, char const* cache_directory);
+
+        //! @brief GetHrirStatus entry point for managed code.
+        HOA_EXPORT int HoaLibraryGetHrirStatus(instance_id_t instance);
+
+        //! @brief SetListenerOrientation entry point for managed code (unity quaternion).
+        HOA_EXPORT void HoaLibrarySetListenerOrientation(instance_id_t instance,
+                                                         float w, float x, float y, float z);
+
+        //! @brief SetHeadOrientation entry point for trackers (unity quaternion, any thread).
+        HOA_EXPORT void HoaLibrarySetHeadOrientation(instance_id_t instance,
+                                                     float w, float x, float y, float z);
+    }
 }
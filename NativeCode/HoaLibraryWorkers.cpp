@@ -0,0 +1,240 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#include "HoaLibraryWorkers.h"
+
+#include <algorithm>
+
+#if defined(__linux__) && !defined(__ANDROID__)
+#   include <pthread.h>
+#   include <sched.h>
+#   define HOA_WORKERS_AFFINITY 1
+#endif
+
+#if defined(__APPLE__)
+#   include <dispatch/dispatch.h>
+#elif defined(_WIN32)
+#   define NOMINMAX
+#   include <windows.h>
+#endif
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#   include <immintrin.h>
+#endif
+
+namespace HoaLibraryUnity
+{
+    namespace
+    {
+        void pinThread(std::thread& thread, size_t core)
+        {
+#if HOA_WORKERS_AFFINITY
+            const auto num_cores = std::max(1u, std::thread::hardware_concurrency());
+            
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(static_cast<int>(core % num_cores), &cpuset);
+            pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &cpuset);
+#else
+            (void) thread;
+            (void) core;
+#endif
+        }
+        
+        //! @brief Hints the core that the thread is spinning.
+        inline void cpu_relax()
+        {
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+            _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+            __asm__ __volatile__("yield");
+#endif
+        }
+        
+        constexpr uint64_t make_state(uint32_t batch, size_t num_tasks, size_t next)
+        {
+            return (static_cast<uint64_t>(batch) << 32) | (static_cast<uint64_t>(num_tasks) << 16) | next;
+        }
+    }
+    
+    // ==================================================================================== //
+    // WorkerSemaphore
+    // ==================================================================================== //
+    
+#if defined(__linux__) || defined(__ANDROID__)
+    
+    WorkerSemaphore::WorkerSemaphore()
+    {
+        sem_init(&m_semaphore, 0, 0);
+    }
+    
+    WorkerSemaphore::~WorkerSemaphore()
+    {
+        sem_destroy(&m_semaphore);
+    }
+    
+    void WorkerSemaphore::post(size_t count)
+    {
+        for(size_t i = 0; i < count; ++i)
+        {
+            sem_post(&m_semaphore);
+        }
+    }
+    
+    void WorkerSemaphore::wait()
+    {
+        while(sem_wait(&m_semaphore) != 0)
+        {
+            // interrupted by a signal
+        }
+    }
+    
+#elif defined(__APPLE__)
+    
+    WorkerSemaphore::WorkerSemaphore()
+    : m_semaphore(dispatch_semaphore_create(0))
+    {}
+    
+    WorkerSemaphore::~WorkerSemaphore()
+    {
+        dispatch_release(static_cast<dispatch_semaphore_t>(m_semaphore));
+    }
+    
+    void WorkerSemaphore::post(size_t count)
+    {
+        for(size_t i = 0; i < count; ++i)
+        {
+            dispatch_semaphore_signal(static_cast<dispatch_semaphore_t>(m_semaphore));
+        }
+    }
+    
+    void WorkerSemaphore::wait()
+    {
+        dispatch_semaphore_wait(static_cast<dispatch_semaphore_t>(m_semaphore), DISPATCH_TIME_FOREVER);
+    }
+    
+#elif defined(_WIN32)
+    
+    WorkerSemaphore::WorkerSemaphore()
+    : m_semaphore(CreateSemaphoreW(nullptr, 0, LONG_MAX, nullptr))
+    {}
+    
+    WorkerSemaphore::~WorkerSemaphore()
+    {
+        CloseHandle(static_cast<HANDLE>(m_semaphore));
+    }
+    
+    void WorkerSemaphore::post(size_t count)
+    {
+        if(count > 0)
+        {
+            ReleaseSemaphore(static_cast<HANDLE>(m_semaphore), static_cast<LONG>(count), nullptr);
+        }
+    }
+    
+    void WorkerSemaphore::wait()
+    {
+        WaitForSingleObject(static_cast<HANDLE>(m_semaphore), INFINITE);
+    }
+    
+#endif
+    
+    // ==================================================================================== //
+    // WorkerPool
+    // ==================================================================================== //
+    
+    WorkerPool::WorkerPool(size_t num_threads, bool pin_threads)
+    : m_pinned(pin_threads)
+    {
+        m_threads.reserve(num_threads);
+        for(size_t i = 0; i < num_threads; ++i)
+        {
+            m_threads.emplace_back(&WorkerPool::workerLoop, this);
+            
+            if(pin_threads)
+            {
+                // leave the first core to the audio thread.
+                pinThread(m_threads.back(), i + 1);
+            }
+        }
+    }
+    
+    WorkerPool::~WorkerPool()
+    {
+        m_running.store(false, std::memory_order_release);
+        m_semaphore.post(m_threads.size());
+        
+        for(auto& thread : m_threads)
+        {
+            thread.join();
+        }
+    }
+    
+    void WorkerPool::runTasks(size_t num_tasks, task_function_t function, void* data)
+    {
+        if(num_tasks == 0)
+            return;
+        
+        num_tasks = std::min(num_tasks, k_max_tasks);
+        
+        // the tasks of the previous batch are all done, no worker reads these anymore.
+        m_function = function;
+        m_data = data;
+        m_remaining.store(num_tasks, std::memory_order_relaxed);
+        m_state.store(make_state(++m_batch, num_tasks, 0), std::memory_order_release);
+        
+        // the tokens left by the workers woken too late only cause a spurious wake-up.
+        m_semaphore.post(std::min(m_threads.size(), num_tasks - 1));
+        
+        participate();
+        
+        // wait for the tasks started by the workers.
+        while(m_remaining.load(std::memory_order_acquire) != 0)
+        {
+            cpu_relax();
+        }
+    }
+    
+    void WorkerPool::participate()
+    {
+        uint64_t state = m_state.load(std::memory_order_acquire);
+        
+        for(;;)
+        {
+            const size_t num_tasks = static_cast<size_t>((state >> 16) & 0xffff);
+            const size_t index = static_cast<size_t>(state & 0xffff);
+            if(index >= num_tasks)
+                return;
+            
+            // fails if another participant claimed the task or if another batch was published.
+            if(m_state.compare_exchange_weak(state, state + 1,
+                                             std::memory_order_acq_rel, std::memory_order_acquire))
+            {
+                m_function(m_data, index);
+                m_remaining.fetch_sub(1, std::memory_order_acq_rel);
+                state = m_state.load(std::memory_order_acquire);
+            }
+        }
+    }
+    
+    void WorkerPool::workerLoop()
+    {
+        for(;;)
+        {
+            m_semaphore.wait();
+            
+            if(!m_running.load(std::memory_order_acquire))
+                return;
+            
+            participate();
+        }
+    }
+}
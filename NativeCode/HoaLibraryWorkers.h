@@ -0,0 +1,128 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__) || defined(__ANDROID__)
+#   include <semaphore.h>
+#endif
+
+namespace HoaLibraryUnity
+{
+    // ==================================================================================== //
+    // WorkerSemaphore
+    // ==================================================================================== //
+    
+    //! @brief A counting semaphore on which the workers sleep.
+    //! @details post() never blocks nor takes a lock, it is a single system call that wakes
+    //! the waiting threads (a futex wake on linux), so that the audio thread can post.
+    class WorkerSemaphore
+    {
+    public:
+        
+        WorkerSemaphore();
+        ~WorkerSemaphore();
+        
+        WorkerSemaphore(WorkerSemaphore const&) = delete;
+        WorkerSemaphore& operator=(WorkerSemaphore const&) = delete;
+        
+        //! @brief Increments the count by count, waking as many waiting threads.
+        void post(size_t count);
+        
+        //! @brief Waits for the count to be positive and decrements it.
+        void wait();
+        
+    private:
+        
+#if defined(__linux__) || defined(__ANDROID__)
+        sem_t m_semaphore;
+#else
+        void* m_semaphore = nullptr;    // dispatch_semaphore_t or HANDLE
+#endif
+    };
+    
+    // ==================================================================================== //
+    // WorkerPool
+    // ==================================================================================== //
+    
+    //! @brief A fixed set of threads that help the audio thread to run a batch of tasks.
+    //! @details The calling thread takes part in the work, the tasks are claimed one at a
+    //! time from a single atomic word holding the batch number, the number of tasks and
+    //! the next task, so that a worker woken late can not claim a task of another batch.
+    //! The calling thread never takes a lock: it publishes the batch with a store, wakes
+    //! the workers with a semaphore post, runs the tasks left and only spins (without a
+    //! system call) on the tasks already started by the workers.
+    class WorkerPool
+    {
+    public:
+        
+        //! @brief Constructor
+        //! @param num_threads Number of worker threads (in addition to the calling thread).
+        //! @param pin_threads Pins each worker to its own core (linux only).
+        WorkerPool(size_t num_threads, bool pin_threads);
+        
+        //! @brief Destructor, joins the threads.
+        ~WorkerPool();
+        
+        //! @brief Returns the number of worker threads.
+        size_t getNumberOfThreads() const noexcept { return m_threads.size(); }
+        
+        //! @brief Returns true if the workers are pinned to their cores.
+        bool arePinned() const noexcept { return m_pinned; }
+        
+        //! @brief Runs task(index) for each index in [0, num_tasks) and returns when all are done.
+        //! @details Must be called by one thread at a time. Tasks may run on any thread.
+        //! At most k_max_tasks tasks.
+        template<class Task>
+        void run(size_t num_tasks, Task& task)
+        {
+            runTasks(num_tasks, [](void* data, size_t index) {
+                (*static_cast<Task*>(data))(index);
+            }, &task);
+        }
+        
+        //! @brief The maximum number of tasks of a batch.
+        static constexpr size_t k_max_tasks = 0xffff;
+        
+    private:
+        
+        using task_function_t = void(*)(void*, size_t);
+        
+        void runTasks(size_t num_tasks, task_function_t function, void* data);
+        
+        //! @brief Runs the tasks of the current batch until none is left.
+        void participate();
+        
+        void workerLoop();
+        
+    private:
+        
+        std::vector<std::thread> m_threads {};
+        const bool m_pinned;
+        WorkerSemaphore m_semaphore {};
+        
+        // batch (32 bits) | number of tasks (16 bits) | next task (16 bits)
+        alignas(64) std::atomic<uint64_t> m_state {0};
+        alignas(64) std::atomic<size_t> m_remaining {0};
+        
+        // written before the batch is published, read after a task of the batch is claimed.
+        task_function_t m_function = nullptr;
+        void* m_data = nullptr;
+        uint32_t m_batch = 0;
+        
+        std::atomic<bool> m_running {true};
+    };
+}
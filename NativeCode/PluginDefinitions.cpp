@@ -0,0 +1,48 @@
+//==============================================================================
+// From the Unity [nativeaudioplugins](https://bitbucket.org/Unity-Technologies/nativeaudioplugins) SDK.
+// The effects of PluginList.h, split from AudioPluginUtil.cpp so that the utilities
+// can be built without the plugin entry points.
+//==============================================================================
+
+#include "AudioPluginUtil.h"
+
+#define DECLARE_EFFECT(namestr, ns) \
+    namespace ns \
+    { \
+    UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK CreateCallback            (UnityAudioEffectState* state); \
+    UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK ReleaseCallback           (UnityAudioEffectState* state); \
+    UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK ProcessCallback           (UnityAudioEffectState* state, float* inbuffer, float* outbuffer, unsigned int length, int inchannels, int outchannels); \
+    UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK SetFloatParameterCallback (UnityAudioEffectState* state, int index, float value); \
+    UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK GetFloatParameterCallback (UnityAudioEffectState* state, int index, float* value, char *valuestr); \
+    UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK GetFloatBufferCallback    (UnityAudioEffectState* state, const char* name, float* buffer, int numsamples); \
+    int InternalRegisterEffectDefinition(UnityAudioEffectDefinition& definition); \
+    }
+#include "PluginList.h"
+#undef DECLARE_EFFECT
+
+#define DECLARE_EFFECT(namestr, ns) \
+DeclareEffect( \
+definition[numeffects++], \
+namestr, \
+ns::CreateCallback, \
+ns::ReleaseCallback, \
+ns::ProcessCallback, \
+ns::SetFloatParameterCallback, \
+ns::GetFloatParameterCallback, \
+ns::GetFloatBufferCallback, \
+ns::InternalRegisterEffectDefinition);
+
+extern "C" UNITY_AUDIODSP_EXPORT_API int AUDIO_CALLING_CONVENTION UnityGetAudioEffectDefinitions(UnityAudioEffectDefinition*** definitionptr)
+{
+    static UnityAudioEffectDefinition definition[256];
+    static UnityAudioEffectDefinition* definitionp[256];
+    static int numeffects = 0;
+    if (numeffects == 0)
+    {
+        #include "PluginList.h"
+    }
+    for (int n = 0; n < numeffects; n++)
+        definitionp[n] = &definition[n];
+    *definitionptr = definitionp;
+    return numeffects;
+}
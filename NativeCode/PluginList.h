@@ -11,3 +11,4 @@
 
 DECLARE_EFFECT("HoaLibrary Spatializer", HoaLibrary_Spatializer);
 DECLARE_EFFECT("HoaLibrary Renderer", HoaLibrary_Renderer);
+DECLARE_EFFECT("HoaLibrary Ambisonic Decoder", HoaLibrary_Ambisonic);
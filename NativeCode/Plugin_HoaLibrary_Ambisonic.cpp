@@ -0,0 +1,172 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+// Please note that this plugin will only work on Unity 2017.1 or higher.
+
+#include "HoaLibraryUnity.h"
+
+#include "AudioPluginInterface.h"
+#include "AudioPluginUtil.h"
+
+namespace HoaLibrary_Ambisonic
+{
+    using namespace HoaLibraryUnity;
+    using effect_definition_t = UnityAudioEffectDefinition;
+    using param_definition_t = UnityAudioParameterDefinition;
+    using effect_state_t = UnityAudioEffectState;
+
+    //==============================================================================
+    // Processor
+    //==============================================================================
+
+    //! @brief Sends the AmbiX channels of an ambisonic clip to the HoaLibrary System
+    //! @details The clip is summed into the soundfield of the instance and rendered
+    //! by its renderer, the outputs of this decoder are silent.
+    class HoaAudioProcessor
+    {
+    public:
+
+        // parameters
+        enum Param
+        {
+            Gain,
+            Instance,
+            Size
+        };
+
+        HoaAudioProcessor() = default;
+        ~HoaAudioProcessor() = default;
+
+        static int registerEffect(effect_definition_t& definition)
+        {
+            const int numparams = Param::Size;
+            definition.paramdefs = new param_definition_t[numparams];
+
+            RegisterParameter(definition, "Gain", "dB",
+                              -60.f, 20.f, 0.0f, 1.0f, 1.0f, Param::Gain,
+                              "Additional gain");
+
+            RegisterParameter(definition, "Instance", "",
+                              0.0f, k_max_instances - 1.f, 0.0f, 1.0f, 1.0f, Param::Instance,
+                              "Instance of the renderer the clips are summed into");
+
+            // required flag to be recognized as an ambisonic decoder plugin by unity
+            definition.flags |= UnityAudioEffectDefinitionFlags_IsAmbisonicDecoder;
+
+            return numparams;
+        }
+
+        //! @brief Called when the plugin is created
+        void create(effect_state_t* state)
+        {
+            state->effectdata = this;
+
+            InitParametersFromDefinitions(registerEffect, p.data());
+
+            m_binding = HoaLibraryUnity::BindBed(static_cast<instance_id_t>(p[Param::Instance]));
+        }
+
+        //! @brief Release ressources.
+        void release()
+        {
+            HoaLibraryUnity::Unbind(m_binding);
+        }
+
+        bool setFloatParameter(effect_state_t* state, int index, float_t value)
+        {
+            if (index >= Param::Size)
+                return false;
+
+            const bool changed = (p[index] != value);
+            p[index] = value;
+
+            if (changed && index == Param::Instance)
+            {
+                HoaLibraryUnity::Rebind(m_binding, static_cast<instance_id_t>(p[Param::Instance]));
+            }
+
+            return true;
+        }
+
+        bool getFloatParameter(effect_state_t* state, int index, float_t* value, char *valuestr)
+        {
+            if (index >= Param::Size)
+                return false;
+
+            if (value)
+                *value = p[index];
+
+            if (valuestr)
+                valuestr[0] = 0;
+
+            return true;
+        }
+
+        //! @brief No buffers, the beds are measured with the renderer.
+        bool getFloatBuffer(effect_state_t* state, const char* name, float_t* buffer, int numsamples)
+        {
+            return false;
+        }
+
+        //! @brief Check host compatibility.
+        //! @details the ambisonic data is only passed from SDK version 1.04 (i.e. Unity 2017.1).
+        bool isHostCompatible(effect_state_t* state) const
+        {
+            return (state->structsize >= sizeof(effect_state_t)
+                    && state->hostapiversion >= 0x010400);
+        }
+
+        void process(effect_state_t* state,
+                     float_t* inputs, float_t* outputs, unsigned int length,
+                     int numins, int numouts)
+        {
+            // the outputs are always silent, the clip is rendered by the renderer.
+            std::fill(outputs, outputs + length * numouts, 0.f);
+
+            // the bed is created in the instance when it is (re)initialized, before it is
+            // published, nothing is rendered until then.
+            const auto bed = HoaLibraryUnity::GetBoundBed(m_binding);
+
+            if (numins < 1
+                || !isHostCompatible(state) || !state->ambisonicdata
+                || bed.id == HoaLibraryApi::invalid_bed_id)
+            {
+                return;
+            }
+
+            auto const& ambisonic = *state->ambisonicdata;
+
+            // the volume of the source is applied after the decoder, so to its silent outputs.
+            const bool has_volume = (state->hostapiversion >= 0x010401);
+            const auto volume = has_volume ? ambisonic.volume : 1.f;
+            const auto gain = std::pow(10.f, p[Param::Gain] * 0.05f) * volume;
+
+            // the beds are rotated by the listener.
+            HoaLibraryUnity::PublishListenerOrientation(bed.instance, ambisonic.listenermatrix, m_orientation);
+
+            HoaLibraryUnity::SetBedGain(bed, gain);
+            HoaLibraryUnity::ProcessBed(bed, static_cast<size_t>(numins), length,
+                                        inputs, state->currdsptick);
+        }
+
+    private:
+
+        std::array<float_t, Param::Size> p;
+
+        // the bed of this decoder in the instance of the Instance parameter.
+        binding_id_t m_binding = invalid_binding_id;
+
+        // the last listener orientation published by this decoder.
+        HoaLibraryUnity::Quaternion m_orientation {};
+    };
+
+    #include "UnityCallbacks.hpp"
+}
@@ -16,9 +16,12 @@
 #include "AudioPluginInterface.h"
 #include "AudioPluginUtil.h"
 
+#include <cstring>
+
 namespace HoaLibrary_Renderer
 {
     using HoaLibraryUnity::float_t;
+    using HoaLibraryUnity::instance_id_t;
     using effect_definition_t = UnityAudioEffectDefinition;
     using param_definition_t = UnityAudioParameterDefinition;
     using effect_state_t = UnityAudioEffectState;
@@ -36,9 +39,35 @@ namespace HoaLibrary_Renderer
         enum Param
         {
             MasterGain,
+            Encoding,
+            WorkerThreads,
+            PinThreads,
+            LodDistance,
+            LodBudget,
+            EncodingBudget,
+            Instance,
+            Order,
+            WorldFrame,
+            TrackingBlock,
+            Output,
+            Layout,
+            Decoder,
+            DualBand,
+            Crossover,
+            AdaptiveQuality,
+            NearField,
+            NearFieldRadius,
             Size
         };
 
+        // output modes
+        enum Output
+        {
+            Binaural,
+            Ambisonic,
+            Speakers
+        };
+
         HoaAudioProcessor() = default;
         ~HoaAudioProcessor() = default;
 
@@ -51,6 +80,78 @@ namespace HoaLibrary_Renderer
                               -120.f, 50.f, 0.0f, 1.0f, 1.0f,
                               Param::MasterGain, "Master Gain");
 
+            RegisterParameter(definition, "Encoding", "",
+                              0.f, 3.f, 0.f, 1.0f, 1.0f,
+                              Param::Encoding, "Source encoding (Per sample | Block rate | Matrix | Spatializer)");
+
+            RegisterParameter(definition, "Threads", "",
+                              0.f, 16.f, 0.f, 1.0f, 1.0f,
+                              Param::WorkerThreads, "Worker threads helping to encode the sources (0 = none)");
+
+            RegisterParameter(definition, "Pin Threads", "",
+                              0.f, 1.f, 0.f, 1.0f, 1.0f,
+                              Param::PinThreads, "Pin each worker thread to its own core (linux only)");
+
+            RegisterParameter(definition, "LOD Distance", "m",
+                              0.f, 1000.f, 0.f, 1.0f, 1.0f,
+                              Param::LodDistance, "Distance from which sources lose an order each time their distance doubles (0 = off)");
+
+            RegisterParameter(definition, "LOD Budget", "",
+                              0.f, 65536.f, 0.f, 1.0f, 1.0f,
+                              Param::LodBudget, "Maximum number of harmonics encoded per block, low priority sources lose orders first (0 = no limit)");
+
+            RegisterParameter(definition, "Budget", "us",
+                              0.f, 100000.f, 0.f, 1.0f, 1.0f,
+                              Param::EncodingBudget, "Encoding time per block, the quietest and lowest priority sources are culled first (0 = no limit)");
+
+            RegisterParameter(definition, "Instance", "",
+                              0.f, HoaLibraryUnity::k_max_instances - 1.f, 0.f, 1.0f, 1.0f,
+                              Param::Instance, "Instance rendered by this renderer, the spatializers with the same instance are rendered here");
+
+            RegisterParameter(definition, "Order", "",
+                              0.f, static_cast<float_t>(HoaLibraryUnity::k_order), 0.f, 1.0f, 1.0f,
+                              Param::Order, "Ambisonic order of the instance (0 = order of the HRIR set)");
+
+            RegisterParameter(definition, "World Frame", "",
+                              0.f, 1.f, 0.f, 1.0f, 1.0f,
+                              Param::WorldFrame, "Encode the sources in the world frame and rotate the soundfield by the listener orientation once per block");
+
+            RegisterParameter(definition, "Tracking Block", "",
+                              0.f, 4096.f, static_cast<float_t>(HoaLibraryUnity::k_default_head_tracking_subblock_size), 1.0f, 1.0f,
+                              Param::TrackingBlock, "Frames between two readings of the head tracker orientation (0 = once per block)");
+
+            RegisterParameter(definition, "Output", "",
+                              0.f, 2.f, 0.f, 1.0f, 1.0f,
+                              Param::Output, "Output (Binaural | Ambisonic: the harmonics in ACN/SN3D order, as many as there are channels | Speakers: the speakers of the layout)");
+
+            RegisterParameter(definition, "Layout", "",
+                              0.f, 4.f, 0.f, 1.0f, 1.0f,
+                              Param::Layout, "Speaker layout, in the channel order of Unity (Quad | 5.1 | 7.1 | 7.1.4 | Dome 24)");
+
+            RegisterParameter(definition, "Decoder", "",
+                              0.f, 2.f, 0.f, 1.0f, 1.0f,
+                              Param::Decoder, "Speaker decoder (Auto | Mode matching | Energy preserving)");
+
+            RegisterParameter(definition, "Dual Band", "",
+                              0.f, 1.f, 1.f, 1.0f, 1.0f,
+                              Param::DualBand, "Decode the speakers with basic weights under the crossover and max-rE weights above (max-rE only otherwise)");
+
+            RegisterParameter(definition, "Crossover", "Hz",
+                              100.f, 2000.f, HoaLibraryUnity::k_default_speaker_crossover, 1.0f, 3.0f,
+                              Param::Crossover, "Crossover frequency of the dual-band speaker decoder");
+
+            RegisterParameter(definition, "Adaptive Quality", "",
+                              0.f, 1.f, 0.f, 1.0f, 1.0f,
+                              Param::AdaptiveQuality, "Lower the quality of the low priority sources, then the decoder order, then cull voices when the blocks come close to their deadline");
+
+            RegisterParameter(definition, "Near Field", "",
+                              0.f, 1.f, 0.f, 1.0f, 1.0f,
+                              Param::NearField, "Filter the harmonics of the sources by their distance, the sources inside the radius get their proximity bass boost");
+
+            RegisterParameter(definition, "NF Radius", "m",
+                              0.f, 10.f, 0.f, 1.0f, 1.0f,
+                              Param::NearFieldRadius, "Radius the soundfield is reproduced at (0 = farthest speaker of the layout, or 1 meter)");
+
             return numparams;
         }
 
@@ -60,14 +161,16 @@ namespace HoaLibrary_Renderer
             assert(state);
             state->effectdata = this;
             InitParametersFromDefinitions(registerEffect, p.data());
-            const size_t vectorsize = static_cast<size_t>(state->dspbuffersize);
-            HoaLibraryUnity::Initialize(vectorsize);
+
+            m_vectorsize = static_cast<size_t>(state->dspbuffersize);
+            m_sample_rate = static_cast<float_t>(state->samplerate);
+            initialize();
         }
 
         //! @brief Release ressources.
         void release()
         {
-            HoaLibraryUnity::Shutdown();
+            shutdown();
         }
 
         bool setFloatParameter(effect_state_t* state, int index, float_t value)
@@ -75,8 +178,53 @@ namespace HoaLibrary_Renderer
             if (index >= Param::Size)
                 return false;
 
+            const bool changed = (p[index] != value);
+            const bool had_speakers = hasSpeakerOutput();
             p[index] = value;
 
+            // this callback may run on the audio thread: the instance is built again with the
+            // new settings on a background thread, the crossover and the radius only update it.
+            if (changed && index == Param::Instance)
+            {
+                shutdownInBackground();
+                initializeInBackground();
+            }
+            else if ((had_speakers != hasSpeakerOutput())
+                     || (changed && (index == Param::Order || index == Param::WorldFrame
+                                     || index == Param::Layout || index == Param::Decoder
+                                     || index == Param::DualBand || index == Param::Crossover
+                                     || index == Param::NearField || index == Param::NearFieldRadius)))
+            {
+                const auto instance = m_instance.load();
+                if (instance >= 0)
+                {
+                    HoaLibraryUnity::ReinitializeInBackground(instance, getApiSettings());
+                }
+                else
+                {
+                    initializeInBackground();
+                }
+            }
+
+            const auto instance = m_instance.load();
+
+            if (changed && (index == Param::WorkerThreads || index == Param::PinThreads))
+            {
+                HoaLibraryUnity::SetWorkerThreads(instance,
+                                                  static_cast<size_t>(p[Param::WorkerThreads]),
+                                                  p[Param::PinThreads] >= 0.5f);
+            }
+
+            if (changed && (index == Param::LodDistance || index == Param::LodBudget))
+            {
+                HoaLibraryUnity::SetOrderLod(instance, getOrderLodSettings());
+            }
+
+            if (changed && index == Param::AdaptiveQuality)
+            {
+                HoaLibraryUnity::SetQualitySettings(instance, getQualitySettings());
+            }
+
             return true;
         }
 
@@ -94,6 +242,23 @@ namespace HoaLibrary_Renderer
             return true;
         }
 
+        //! @brief Returns the DSP load metrics and the counters of the instance (see get_metrics_buffer),
+        //! or its adaptive quality decisions for "QualityLog" (see get_quality_log_buffer).
+        bool getFloatBuffer(effect_state_t* state, const char* name, float_t* buffer, int numsamples)
+        {
+            const auto instance = m_instance.load();
+            if (instance < 0)
+                return false;
+
+            if (name != nullptr && std::strcmp(name, "QualityLog") == 0)
+            {
+                HoaLibraryUnity::get_quality_log_buffer(HoaLibraryUnity::GetQualityLog(instance), buffer, numsamples);
+                return true;
+            }
+
+            return HoaLibraryUnity::get_metrics_buffer(HoaLibraryUnity::GetDspMetrics(instance), name, buffer, numsamples);
+        }
+
         void process(effect_state_t* state,
                      float_t* inputs, float_t* outputs, unsigned int length,
                      int numins, int numouts)
@@ -104,9 +269,16 @@ namespace HoaLibrary_Renderer
 
             const int stereo = 2;
 
+            const auto instance = m_instance.load();
+            const auto output = static_cast<int>(p[Param::Output]);
+            const bool valid_format = (output != Output::Binaural)
+            ? (numouts > 0)
+            : (numins == stereo && numouts == stereo);
+
             // Check that I/O formats are right
-            if ((numins != stereo || numouts != stereo)
-                || (is_muted || is_paused || !is_playing))
+            if (!valid_format
+                || (is_muted || is_paused || !is_playing)
+                || instance < 0)
             {
                 // fill with zeros
                 std::fill(outputs, outputs + length * numouts, 0.f);
@@ -120,14 +292,149 @@ namespace HoaLibrary_Renderer
             }
 
             const auto gain = std::powf(10.f, p[Param::MasterGain] * 0.05f);
+            const auto encoding = static_cast<int>(p[Param::Encoding]);
+
+            HoaLibraryUnity::SetMasterGain(instance, gain);
+            HoaLibraryUnity::SetEncodingBudget(instance, p[Param::EncodingBudget]);
+            HoaLibraryUnity::SetHeadTrackingSubblockSize(instance, static_cast<size_t>(p[Param::TrackingBlock]));
+            HoaLibraryUnity::SetEncodingMode(instance, static_cast<HoaLibraryUnity::EncodingMode>(encoding));
 
-            HoaLibraryUnity::SetMasterGain(gain);
-            HoaLibraryUnity::ProcessListener(length, outputs);
+            if (output == Output::Ambisonic)
+            {
+                HoaLibraryUnity::ProcessListenerAmbisonic(instance, length, static_cast<size_t>(numouts),
+                                                          outputs, state->currdsptick);
+            }
+            else if (output == Output::Speakers)
+            {
+                HoaLibraryUnity::ProcessListenerSpeakers(instance, length, static_cast<size_t>(numouts),
+                                                         outputs, state->currdsptick);
+            }
+            else
+            {
+                HoaLibraryUnity::ProcessListener(instance, length, outputs, state->currdsptick);
+            }
+        }
+
+    private:
+
+        //! @brief Initializes the instance of the Instance parameter (control thread).
+        //! @details The renderer stays silent if another renderer already owns the instance.
+        void initialize()
+        {
+            const auto instance = static_cast<instance_id_t>(p[Param::Instance]);
+            if (HoaLibraryUnity::Initialize(instance, getApiSettings()))
+            {
+                m_instance = instance;
+            }
+            else
+            {
+                HOA_LOG("HoaLibrary Renderer: the instance is already rendered by another renderer\n");
+            }
+        }
+
+        //! @brief Initializes the instance of the Instance parameter on a background thread.
+        void initializeInBackground()
+        {
+            const auto instance = static_cast<instance_id_t>(p[Param::Instance]);
+            if (HoaLibraryUnity::InitializeInBackground(instance, getApiSettings()))
+            {
+                m_instance = instance;
+            }
+            else
+            {
+                HOA_LOG("HoaLibrary Renderer: the instance is already rendered by another renderer\n");
+            }
+        }
+
+        //! @brief Shuts down the instance owned by this renderer (control thread).
+        void shutdown()
+        {
+            const auto instance = m_instance.exchange(-1);
+            if (instance >= 0)
+            {
+                HoaLibraryUnity::Shutdown(instance);
+            }
+        }
+
+        //! @brief Shuts down the instance owned by this renderer on a background thread.
+        void shutdownInBackground()
+        {
+            const auto instance = m_instance.exchange(-1);
+            if (instance >= 0)
+            {
+                HoaLibraryUnity::ShutdownInBackground(instance);
+            }
+        }
+
+        //! @brief Returns the settings of the instance of the parameters.
+        HoaLibraryUnity::ApiSettings getApiSettings() const
+        {
+            HoaLibraryUnity::ApiSettings settings;
+            settings.vectorsize = m_vectorsize;
+            settings.sample_rate = m_sample_rate;
+            settings.order = static_cast<size_t>(p[Param::Order]);
+            settings.worker_threads = static_cast<size_t>(p[Param::WorkerThreads]);
+            settings.pin_worker_threads = (p[Param::PinThreads] >= 0.5f);
+            settings.order_lod = getOrderLodSettings();
+            settings.encoding_budget = p[Param::EncodingBudget];
+            settings.world_frame = (p[Param::WorldFrame] >= 0.5f);
+            settings.head_tracking_subblock_size = static_cast<size_t>(p[Param::TrackingBlock]);
+            if (hasSpeakerOutput())
+            {
+                settings.speakers = getSpeakerSettings();
+            }
+
+            settings.quality = getQualitySettings();
+            settings.near_field.enabled = (p[Param::NearField] >= 0.5f);
+            settings.near_field.radius = p[Param::NearFieldRadius];
+            return settings;
+        }
+
+        HoaLibraryUnity::OrderLodSettings getOrderLodSettings() const
+        {
+            HoaLibraryUnity::OrderLodSettings settings;
+            settings.distance = p[Param::LodDistance];
+            settings.harmonics_budget = static_cast<size_t>(p[Param::LodBudget]);
+            return settings;
+        }
+
+        //! @brief Returns true if the Output parameter is the speaker output.
+        bool hasSpeakerOutput() const
+        {
+            return static_cast<int>(p[Param::Output]) == Output::Speakers;
+        }
+
+        //! @brief Returns the speaker output settings of the parameters.
+        HoaLibraryUnity::SpeakerSettings getSpeakerSettings() const
+        {
+            static const char* const layouts[] = { "quad", "5.1", "7.1", "7.1.4", "dome24" };
+            const auto layout = std::min(std::max(static_cast<int>(p[Param::Layout]), 0), 4);
+
+            HoaLibraryUnity::SpeakerSettings settings;
+            settings.layout = layouts[layout];
+            settings.decoding = static_cast<HoaLibraryUnity::SpeakerDecoding>(static_cast<int>(p[Param::Decoder]));
+            settings.dual_band = (p[Param::DualBand] >= 0.5f);
+            settings.crossover = p[Param::Crossover];
+            return settings;
+        }
+
+        //! @brief Returns the adaptive quality settings of the parameters.
+        HoaLibraryUnity::QualitySettings getQualitySettings() const
+        {
+            HoaLibraryUnity::QualitySettings settings;
+            settings.enabled = (p[Param::AdaptiveQuality] >= 0.5f);
+            return settings;
         }
 
     private:
 
         std::array<float_t, Param::Size> p;
+
+        size_t m_vectorsize = 0;
+        float_t m_sample_rate = 0.f;
+
+        // the instance owned by this renderer (-1 if none).
+        std::atomic<instance_id_t> m_instance {-1};
     };
 
     #include "UnityCallbacks.hpp"
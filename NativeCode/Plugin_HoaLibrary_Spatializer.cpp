@@ -19,7 +19,6 @@
 namespace HoaLibrary_Spatializer
 {
     using namespace HoaLibraryUnity;
-    using source_id_t = HoaLibraryApi::source_id_t;
     using effect_definition_t = UnityAudioEffectDefinition;
     using param_definition_t = UnityAudioParameterDefinition;
     using effect_state_t = UnityAudioEffectState;
@@ -40,6 +39,8 @@ namespace HoaLibrary_Spatializer
             Gain,
             CustomFalloff,
             Optim,
+            Priority,
+            Instance,
             Size
         };
 
@@ -67,6 +68,14 @@ namespace HoaLibrary_Spatializer
                               0.0f, 2.0f, 0.0f, 1.0f, 1.0f, Param::Optim,
                               "Ambisonic optimization (Basic | MaxRe | inPhase)");
 
+            RegisterParameter(definition, "Priority", "",
+                              0.0f, 1.0f, 1.0f, 1.0f, 1.0f, Param::Priority,
+                              "Sources with a lower priority lose orders first when the renderer budget is exceeded");
+
+            RegisterParameter(definition, "Instance", "",
+                              0.0f, k_max_instances - 1.f, 0.0f, 1.0f, 1.0f, Param::Instance,
+                              "Instance of the renderer that spatializes this source");
+
             // required flag to be recognized as a spatialiser plugin by unity
             definition.flags |= UnityAudioEffectDefinitionFlags_IsSpatializer;
 
@@ -83,13 +92,13 @@ namespace HoaLibrary_Spatializer
 
             InitParametersFromDefinitions(registerEffect, p.data());
 
-            m_source_id = HoaLibraryUnity::CreateSource();
+            m_binding = HoaLibraryUnity::BindSource(static_cast<instance_id_t>(p[Param::Instance]));
         }
 
         //! @brief Release ressources.
         void release()
         {
-            HoaLibraryUnity::DestroySource(m_source_id);
+            HoaLibraryUnity::Unbind(m_binding);
         }
 
         bool setFloatParameter(effect_state_t* state, int index, float_t value)
@@ -97,7 +106,14 @@ namespace HoaLibrary_Spatializer
             if (index >= Param::Size)
                 return false;
 
+            const bool changed = (p[index] != value);
             p[index] = value;
+
+            if (changed && index == Param::Instance)
+            {
+                HoaLibraryUnity::Rebind(m_binding, static_cast<instance_id_t>(p[Param::Instance]));
+            }
+
             return true;
         }
 
@@ -115,12 +131,20 @@ namespace HoaLibrary_Spatializer
             return true;
         }
 
+        //! @brief Returns the DSP load metrics of this spatializer (see get_metrics_buffer).
+        //! @details The encode time is the time of the source processing, which includes
+        //! the encoding in the Spatializer encoding mode, the decode time is always zero.
+        bool getFloatBuffer(effect_state_t* state, const char* name, float_t* buffer, int numsamples)
+        {
+            return get_metrics_buffer(m_metrics.getMetrics(), name, buffer, numsamples);
+        }
+
         //! @brief Check host compatibility.
         //! @details because hostapiversion is only supported from SDK version 1.03
         //! (i.e. Unity 5.2) and onwards.
-        //! Since we are only checking for version 0x010300 here, we can't use
-        //! newer fields in the UnityAudioSpatializerData struct,
-        //! such as minDistance and maxDistance.
+        //! Since we are only checking for version 0x010300 here, the newer fields
+        //! in the UnityAudioSpatializerData struct, such as minDistance and maxDistance,
+        //! are read only after checking the version of the host.
         bool isHostCompatible(effect_state_t* state) const
         {
             return (state->structsize >= sizeof(effect_state_t)
@@ -137,15 +161,21 @@ namespace HoaLibrary_Spatializer
                      float_t* inputs, float_t* outputs, unsigned int length,
                      int numins, int numouts)
         {
+            // the source is created in the instance when it is (re)initialized, before it is
+            // published, the spatializer stays silent until then.
+            const auto source = HoaLibraryUnity::GetBoundSource(m_binding);
+
             // Check that I/O formats are right and that the host API supports this feature
             if ((numins != 2 || numouts != 2)
                 || (!isHostCompatible(state) || !state->spatializerdata)
-                || m_source_id == HoaLibraryApi::invalid_source_id)
+                || source.id == HoaLibraryApi::invalid_source_id)
             {
                 std::fill(outputs, outputs + length * numouts, 0.f);
                 return;
             }
 
+            const auto start = std::chrono::steady_clock::now();
+
             const auto& spatinfos = *state->spatializerdata;
             const auto pan = spatinfos.stereopan; // [-1 to 1]
             const int optimization = static_cast<int>(p[Param::Optim]);
@@ -163,14 +193,45 @@ namespace HoaLibrary_Spatializer
             const float_t dir_z = lm[2] * pos_x + lm[6] * pos_y + lm[10] * pos_z + lm[14];
 
             const auto gain = std::powf(10.f, p[Param::Gain] * 0.05f);
-            HoaLibraryUnity::SetSourceGain(m_source_id, gain);
-            HoaLibraryUnity::SetSourcePan(m_source_id, pan);
-            HoaLibraryUnity::SetSourcePosition(m_source_id, dir_x, dir_y, dir_z);
-            HoaLibraryUnity::SetSourceOptim(m_source_id, optimization);
-            HoaLibraryUnity::ProcessSource(m_source_id, length, inputs);
+            HoaLibraryUnity::SetSourceGain(source, gain);
+            HoaLibraryUnity::SetSourcePan(source, pan);
+
+            if (HoaLibraryUnity::IsWorldFrame(source.instance))
+            {
+                // the offset from the listener is kept in the world axes,
+                // the instance rotates the whole soundfield by the listener orientation.
+                const float_t offset_x = lm[0] * dir_x + lm[1] * dir_y + lm[ 2] * dir_z;
+                const float_t offset_y = lm[4] * dir_x + lm[5] * dir_y + lm[ 6] * dir_z;
+                const float_t offset_z = lm[8] * dir_x + lm[9] * dir_y + lm[10] * dir_z;
+                HoaLibraryUnity::SetSourcePosition(source, offset_x, offset_y, offset_z);
+                HoaLibraryUnity::PublishListenerOrientation(source.instance, lm, m_orientation);
+            }
+            else
+            {
+                HoaLibraryUnity::SetSourcePosition(source, dir_x, dir_y, dir_z);
+            }
+
+            HoaLibraryUnity::SetSourceOptim(source, optimization);
+            HoaLibraryUnity::SetSourcePriority(source, p[Param::Priority]);
+
+            // the minimum distance of the AudioSource (1 meter before it was given to the plugins).
+            if (state->hostapiversion >= 0x010401)
+            {
+                HoaLibraryUnity::SetSourceMinDistance(source, spatinfos.minDistance);
+            }
+
+            const auto process_start = std::chrono::steady_clock::now();
+            HoaLibraryUnity::ProcessSource(source, length, inputs, state->currdsptick);
 
             // Copy inputs to outputs to allow post processing/analysis features in Unity.
             std::memcpy(outputs, inputs, length * sizeof(float_t) * numouts);
+
+            BlockTimings timings;
+            timings.block_us = get_elapsed_us(start);
+            timings.encode_us = get_elapsed_us(process_start);
+            timings.sources = 1;
+            timings.period_us = (state->samplerate > 0) ? length * 1e6 / state->samplerate : 0.;
+            m_metrics.record(timings);
         }
 
     private:
@@ -188,7 +249,14 @@ namespace HoaLibrary_Spatializer
 
         std::array<float_t, Param::Size> p;
 
-        source_id_t m_source_id = HoaLibraryApi::invalid_source_id;
+        // the source of this spatializer in the instance of the Instance parameter.
+        binding_id_t m_binding = invalid_binding_id;
+
+        // the last listener orientation published by this spatializer.
+        HoaLibraryUnity::Quaternion m_orientation {};
+
+        // recorded on the audio thread, polled by getFloatBuffer.
+        MetricsRecorder m_metrics {};
     };
 
     #include "UnityCallbacks.hpp"
@@ -0,0 +1,200 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+// Checks the PartitionedConvolver against the library binaural decoder it replaces, per
+// order of the HRIR set and partition size, with and without the use of the left/right
+// symmetry of the filters: the error to energy ratio of the outputs must stay below 1e-7,
+// the threshold the renderer checks before it switches to the partitioned decoder.
+// Also checks that the filters files with invalid symmetry flags are rejected, and that the
+// inputs dropped by setActiveInputs are ignored once their fade out and their tails are done.
+// usage: TestDecoder
+
+#include "HoaLibraryApi.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace HoaLibraryUnity;
+using matrix_t = PartitionedConvolver::matrix_t;
+
+namespace
+{
+    const size_t k_vectorsize = 512;
+    const double k_max_error = 1e-7;
+    const size_t k_partition_sizes[] = { 64, 128, k_vectorsize };
+    
+    //! @brief Writes the filters of a symmetric convolver, then reads them back as they
+    //! are, then with another partition size or number of inputs, with a number of
+    //! partitions whose size overflows, and with a symmetry flag that is neither 0 nor 1,
+    //! which must all be rejected.
+    bool checkFiltersFile()
+    {
+        std::mt19937 generator(2);
+        std::uniform_real_distribution<float_t> distribution(-1.f, 1.f);
+        
+        matrix_t left = matrix_t::Zero(4, 300).unaryExpr([&](float_t) { return distribution(generator); });
+        matrix_t right = left;
+        right.row(1) *= -1.f;
+        
+        PartitionedConvolver convolver(64, left, right);
+        
+        std::FILE* file = std::tmpfile();
+        if(file == nullptr || !convolver.isSymmetric() || !convolver.writeFilters(file))
+            return false;
+        
+        std::vector<char> data(static_cast<size_t>(std::ftell(file)));
+        std::rewind(file);
+        const bool read = (std::fread(data.data(), 1, data.size(), file) == data.size());
+        std::fclose(file);
+        
+        auto read_filters = [&data]() { return PartitionedConvolver::readFilters(data.data(), data.size(), 64, 4); };
+        
+        if(!read || read_filters() == nullptr
+           || PartitionedConvolver::readFilters(data.data(), data.size(), 128, 4) != nullptr
+           || PartitionedConvolver::readFilters(data.data(), data.size(), 64, 9) != nullptr)
+            return false;
+        
+        uint64_t num_partitions = 0;
+        const uint64_t huge_partitions = uint64_t(1) << 60;
+        std::memcpy(&num_partitions, data.data() + 2 * sizeof(uint64_t), sizeof(uint64_t));
+        std::memcpy(data.data() + 2 * sizeof(uint64_t), &huge_partitions, sizeof(uint64_t));
+        if(read_filters() != nullptr)
+            return false;
+        
+        std::memcpy(data.data() + 2 * sizeof(uint64_t), &num_partitions, sizeof(uint64_t));
+        
+        const size_t flags_offset = 4 * sizeof(uint64_t);
+        data[flags_offset + 1] = 2;
+        return read_filters() == nullptr;
+    }
+    
+    //! @brief Drops inputs of a convolver, then compares it to a convolver that never had them
+    //! once the fade out and the filters length are over.
+    bool checkActiveInputs()
+    {
+        std::mt19937 generator(3);
+        std::uniform_real_distribution<float_t> distribution(-1.f, 1.f);
+        auto noise = [&](float_t) { return distribution(generator); };
+        
+        const size_t num_inputs = 9, num_active = 4, partition_size = 64;
+        matrix_t left = matrix_t::Zero(num_inputs, 300).unaryExpr(noise);
+        matrix_t right = matrix_t::Zero(num_inputs, 300).unaryExpr(noise);
+        
+        PartitionedConvolver dropped(partition_size, left, right, false);
+        PartitionedConvolver reference(partition_size, left, right, false);
+        reference.setActiveInputs(num_active);
+        reference.reset();
+        
+        matrix_t inputs = matrix_t::Zero(num_inputs, k_vectorsize);
+        stereo_matrix_t outputs = stereo_matrix_t::Zero(2, k_vectorsize);
+        stereo_matrix_t expected = stereo_matrix_t::Zero(2, k_vectorsize);
+        
+        // the dropped inputs must not stop at once.
+        inputs = inputs.unaryExpr(noise);
+        dropped.process(inputs, outputs);
+        dropped.setActiveInputs(num_active);
+        dropped.process(inputs, outputs);
+        if(dropped.getActiveInputs() == num_active)
+            return false;
+        
+        const size_t num_blocks = static_cast<size_t>(left.cols()) / k_vectorsize + 2;
+        double error = 0., energy = 0.;
+        for(size_t i = 0; i < num_blocks; ++i)
+        {
+            inputs = inputs.unaryExpr(noise);
+            dropped.setActiveInputs(num_active);
+            dropped.process(inputs, outputs);
+            reference.process(inputs, expected);
+            
+            // the partitions still hold the previous inputs of the reference.
+            if(i + 1 == num_blocks)
+            {
+                error = (expected - outputs).cwiseAbs2().sum();
+                energy = expected.cwiseAbs2().sum();
+            }
+        }
+        
+        return dropped.getActiveInputs() == num_active && error / energy < k_max_error;
+    }
+}
+
+int main()
+{
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float_t> distribution(-1.f, 1.f);
+    auto noise = [&](float_t) { return distribution(generator); };
+    
+    bool failed = false;
+    
+    for(size_t order = 1; order <= k_order; ++order)
+    {
+        const size_t num_harmonics = get_num_harmonics_for_order(order);
+        
+        matrix_t left, right;
+        decoder_t probed(order);
+        probed.prepare(k_vectorsize);
+        if(!probeDecoder(probed, num_harmonics, k_vectorsize, left, right))
+        {
+            std::printf("order %zu: the decoder responses are too long FAILED\n", order);
+            failed = true;
+            continue;
+        }
+        
+        const size_t num_blocks = static_cast<size_t>(left.cols()) / k_vectorsize + 2;
+        
+        for(size_t partition_size : k_partition_sizes)
+        {
+            for(bool detect_symmetry : { true, false })
+            {
+                decoder_t decoder(order);
+                decoder.prepare(k_vectorsize);
+                PartitionedConvolver convolver(partition_size, left, right, detect_symmetry);
+                
+                harmonics_matrix_t inputs = harmonics_matrix_t::Zero(num_harmonics, k_vectorsize);
+                stereo_matrix_t expected = stereo_matrix_t::Zero(2, k_vectorsize);
+                stereo_matrix_t outputs = stereo_matrix_t::Zero(2, k_vectorsize);
+                auto expected_map = stereo_matrix_t::Map(expected.data(), 2, k_vectorsize);
+                
+                double error = 0., energy = 0.;
+                for(size_t i = 0; i < num_blocks; ++i)
+                {
+                    inputs = inputs.unaryExpr(noise);
+                    decoder.processBlock(inputs, expected_map);
+                    convolver.process(inputs, outputs);
+                    error += (expected - outputs).cwiseAbs2().sum();
+                    energy += expected.cwiseAbs2().sum();
+                }
+                
+                const double ratio = error / energy;
+                const bool ok = ratio < k_max_error;
+                failed |= !ok;
+                
+                std::printf("order %zu, partition %4zu, %-10s %10.3g %s\n",
+                            order, partition_size,
+                            convolver.isSymmetric() ? "symmetric" : "asymmetric",
+                            ratio, ok ? "ok" : "FAILED");
+            }
+        }
+    }
+    
+    const bool file_ok = checkFiltersFile();
+    failed |= !file_ok;
+    std::printf("filters file %s\n", file_ok ? "ok" : "FAILED");
+    
+    const bool inputs_ok = checkActiveInputs();
+    failed |= !inputs_ok;
+    std::printf("active inputs %s\n", inputs_ok ? "ok" : "FAILED");
+    
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,142 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+// Checks the block rate encoding modes (BlockRate, Matrix and Spatializer) against the
+// per sample encoding, the reference, on a source moving around the listener: the
+// soundfields must stay within -70 dB of the reference, per order and optimization.
+// usage: TestEncoding
+
+#include "HoaLibraryApi.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace HoaLibraryUnity;
+
+namespace
+{
+    const float_t k_sample_rate = 48000.f;
+    const size_t k_vectorsize = 512;
+    const size_t k_num_blocks = 200;
+    const double k_max_error = -70.; // dB
+    
+    // the first blocks are not compared: the position smoothing starts from the listener,
+    // where the block rate coefficients start without interpolation.
+    const size_t k_compared_frames = k_vectorsize * (k_num_blocks - 4);
+    
+    std::vector<float_t> make_noise(size_t size)
+    {
+        std::mt19937 generator(1);
+        std::uniform_real_distribution<float_t> distribution(-1.f, 1.f);
+        
+        std::vector<float_t> noise(size);
+        for(auto& sample : noise)
+        {
+            sample = distribution(generator);
+        }
+        
+        return noise;
+    }
+    
+    //! @brief Encodes a source turning around the listener, one turn in two seconds while
+    //! going up and down, and returns the soundfield of all the blocks.
+    harmonics_matrix_t encode(size_t order, int optim, EncodingMode mode, std::vector<float_t> const& input)
+    {
+        const size_t subblock_size = k_default_encoding_subblock_size;
+        const bool spatializer = (mode == EncodingMode::Spatializer);
+        
+        Source source(order, k_vectorsize, k_sample_rate, nullptr, spatializer);
+        source.setOptim(optim);
+        
+        SourcesEncoder encoder(1, k_vectorsize, order, BatchedEncoder(order));
+        Source* sources[] = { &source };
+        
+        const size_t num_harmonics = get_num_harmonics_for_order(order);
+        harmonics_matrix_t soundfield = harmonics_matrix_t::Zero(num_harmonics, k_vectorsize * k_num_blocks);
+        harmonics_matrix_t block = harmonics_matrix_t::Zero(num_harmonics, k_vectorsize);
+        InputStatistics statistics;
+        
+        for(size_t i = 0; i < k_num_blocks; ++i)
+        {
+            const dsptick_t dsptick = i * k_vectorsize;
+            const double angle = hoa::math<double>::pi() * dsptick / k_sample_rate;
+            source.setPosition(static_cast<float_t>(2. * std::cos(angle)),
+                               static_cast<float_t>(std::sin(0.5 * angle)),
+                               static_cast<float_t>(2. * std::sin(angle)));
+            
+            // the spatializer publishes the block, then the renderer picks it up.
+            source.setInterleavedBuffer(input.data() + 2 * dsptick, k_vectorsize, dsptick,
+                                        spatializer ? subblock_size : 0);
+            source.setEncodingMode(mode, subblock_size);
+            source.acquireInput(dsptick, statistics);
+            
+            block.setZero();
+            encoder.process(sources, 1, mode, subblock_size, block);
+            soundfield.middleCols(i * k_vectorsize, k_vectorsize) = block;
+            
+            if(spatializer)
+            {
+                // the spatializer encodes the next blocks.
+                source.handOverEncodingState();
+            }
+        }
+        
+        return soundfield;
+    }
+    
+    const char* get_mode_name(EncodingMode mode)
+    {
+        switch(mode)
+        {
+            case EncodingMode::PerSample: return "per sample";
+            case EncodingMode::BlockRate: return "block rate";
+            case EncodingMode::Matrix: return "matrix";
+            case EncodingMode::Spatializer: return "spatializer";
+        }
+        
+        return "";
+    }
+}
+
+int main()
+{
+    const auto input = make_noise(2 * k_vectorsize * k_num_blocks);
+    const EncodingMode modes[] = { EncodingMode::BlockRate, EncodingMode::Matrix, EncodingMode::Spatializer };
+    const size_t orders[] = { 1, 3, k_order };
+    
+    int failures = 0;
+    for(const size_t order : orders)
+    {
+        for(int optim = 0; optim < 3; ++optim)
+        {
+            const harmonics_matrix_t reference = encode(order, optim, EncodingMode::PerSample, input).rightCols(k_compared_frames);
+            const double energy = reference.cwiseAbs2().cast<double>().sum();
+            
+            for(const auto mode : modes)
+            {
+                const harmonics_matrix_t soundfield = encode(order, optim, mode, input).rightCols(k_compared_frames);
+                const double error = (soundfield - reference).cwiseAbs2().cast<double>().sum();
+                const double error_db = 10. * std::log10(std::max(error / energy, 1e-30));
+                const bool passed = (energy > 0. && error_db < k_max_error);
+                
+                std::printf("order %zu, optim %d, %-12s %8.1f dB %s\n", order, optim, get_mode_name(mode),
+                            error_db, passed ? "ok" : "FAILED");
+                
+                failures += passed ? 0 : 1;
+            }
+        }
+    }
+    
+    return failures == 0 ? 0 : 1;
+}
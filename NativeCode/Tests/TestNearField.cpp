@@ -0,0 +1,192 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+// Checks the NearFieldFilters against the NFC-HOA model, per order and source distance:
+// the filter of order m of a source at the distance r, reproduced at the radius R, must
+// have a DC gain of (R / r)^m and be flat at the high frequencies, within k_max_error.
+// Then checks that a source switched to the filters of another radius while it plays, by
+// the audio thread or by the spatializer, ends up with the soundfield of a source that
+// used them from the start.
+// usage: TestNearField
+
+#include "HoaLibraryApi.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <vector>
+
+using namespace HoaLibraryUnity;
+
+namespace
+{
+    const double k_sample_rate = 48000.;
+    const size_t k_vectorsize = 512;
+    const size_t k_num_blocks = 188; // two seconds, the lowest poles are settled.
+    const double k_radius = 1.;
+    const double k_max_boost = 60.; // dB, above the boosts checked.
+    const double k_max_error = 0.1; // dB
+    const double k_high_frequency = 16000.;
+    const float k_distances[] = { 0.5f, 0.8f, 2.f };
+    const double k_switch_radius = 2.;
+    const size_t k_switch_blocks = 20;
+    const size_t k_settle_blocks = 80;
+    const double k_max_switch_error = -60.; // dB
+    
+    //! @brief Returns the gain of an impulse response at a frequency.
+    double getGain(std::vector<double> const& response, double frequency)
+    {
+        const double omega = 2. * hoa::math<double>::pi() * frequency / k_sample_rate;
+        std::complex<double> sum = 0.;
+        for(size_t i = 0; i < response.size(); ++i)
+        {
+            sum += response[i] * std::polar(1., -omega * static_cast<double>(i));
+        }
+        
+        return std::abs(sum);
+    }
+    
+    //! @brief Returns the impulse responses of the filters of all the orders of a distance.
+    std::vector<std::vector<double>> getResponses(NearFieldFilters const& filters, float distance)
+    {
+        const size_t order = filters.getOrder();
+        
+        NearFieldBatch batch(order, filters.getNumberOfSections(), 1, k_vectorsize);
+        batch.setLanes(1);
+        std::fill(batch.order_lanes.begin(), batch.order_lanes.end(), 1);
+        filters.computeNumerators(distance, batch.numerators().data(), 1);
+        
+        std::vector<std::vector<double>> responses(order);
+        for(size_t i = 0; i < k_num_blocks; ++i)
+        {
+            batch.inputs().setZero();
+            if(i == 0)
+            {
+                batch.inputs()(0, 0) = 1.f;
+            }
+            
+            filters.process(batch, k_vectorsize);
+            
+            for(size_t m = 1; m <= order; ++m)
+            {
+                auto const& outputs = batch.outputs();
+                for(size_t frame = 0; frame < k_vectorsize; ++frame)
+                {
+                    responses[m - 1].push_back(outputs(m - 1, frame));
+                }
+            }
+        }
+        
+        return responses;
+    }
+    
+    double toDecibels(double gain)
+    {
+        return 20. * std::log10(gain);
+    }
+    
+    //! @brief Encodes a static source with a constant input, switched from the filters first
+    //! to the filters second after k_switch_blocks blocks (never if second is nullptr).
+    //! @param switched Receives true if the source uses the filters it ends with.
+    //! @return The last block.
+    harmonics_matrix_t encodeSwitching(NearFieldFilters const& first, NearFieldFilters const* second,
+                                       EncodingMode mode, bool& switched)
+    {
+        const size_t subblock_size = k_default_encoding_subblock_size;
+        const bool spatializer = (mode == EncodingMode::Spatializer);
+        
+        Source source(k_order, k_vectorsize, static_cast<float_t>(k_sample_rate), &first, spatializer);
+        SourcesEncoder encoder(1, k_vectorsize, k_order, BatchedEncoder(k_order), &first);
+        Source* sources[] = { &source };
+        source.setPosition(0.f, 0.f, 0.5f);
+        
+        const std::vector<float_t> input(2 * k_vectorsize, 0.5f);
+        harmonics_matrix_t block = harmonics_matrix_t::Zero(get_num_harmonics_for_order(k_order), k_vectorsize);
+        InputStatistics statistics;
+        
+        for(size_t i = 0; i < k_switch_blocks + k_settle_blocks; ++i)
+        {
+            const dsptick_t dsptick = i * k_vectorsize;
+            source.setInterleavedBuffer(input.data(), k_vectorsize, dsptick, spatializer ? subblock_size : 0);
+            source.setEncodingMode(mode, subblock_size);
+            source.acquireInput(dsptick, statistics);
+            
+            // the spatializer switches at its next block.
+            if(second != nullptr && i == k_switch_blocks)
+            {
+                source.setNearFieldFilters(second);
+                encoder.setNearFieldFilters(second);
+            }
+            
+            block.setZero();
+            encoder.process(sources, 1, mode, subblock_size, block);
+            
+            if(spatializer)
+            {
+                source.handOverEncodingState();
+            }
+        }
+        
+        switched = source.usesNearFieldFilters(second != nullptr ? second : &first);
+        return block;
+    }
+    
+    //! @brief Returns the peak of the difference of two soundfields relative to the peak of the reference.
+    double getError(harmonics_matrix_t const& soundfield, harmonics_matrix_t const& reference)
+    {
+        return toDecibels((soundfield - reference).cwiseAbs().maxCoeff() / reference.cwiseAbs().maxCoeff());
+    }
+}
+
+int main()
+{
+    NearFieldFilters filters(k_order, k_radius, k_max_boost, k_sample_rate);
+    
+    bool failed = false;
+    
+    for(float distance : k_distances)
+    {
+        const auto responses = getResponses(filters, distance);
+        
+        for(size_t m = 1; m <= k_order; ++m)
+        {
+            const double expected = toDecibels(std::pow(k_radius / distance, static_cast<double>(m)));
+            const double dc_error = toDecibels(getGain(responses[m - 1], 0.)) - expected;
+            const double high_error = toDecibels(getGain(responses[m - 1], k_high_frequency));
+            
+            const bool ok = std::abs(dc_error) < k_max_error && std::abs(high_error) < k_max_error;
+            failed |= !ok;
+            
+            std::printf("distance %4.2f m, order %zu: DC %+8.3f dB (%+.4f), %5.0f Hz %+.4f dB %s\n",
+                        distance, m, expected, dc_error, k_high_frequency, high_error,
+                        ok ? "ok" : "FAILED");
+        }
+    }
+    
+    const NearFieldFilters switched_filters(k_order, k_switch_radius, k_max_boost, k_sample_rate);
+    for(const auto mode : { EncodingMode::BlockRate, EncodingMode::Spatializer })
+    {
+        bool unused = false, switched = false;
+        const auto reference = encodeSwitching(switched_filters, nullptr, mode, unused);
+        const auto previous = encodeSwitching(filters, nullptr, mode, unused);
+        const auto soundfield = encodeSwitching(filters, &switched_filters, mode, switched);
+        
+        const double error = getError(soundfield, reference);
+        const bool ok = switched && error < k_max_switch_error && getError(previous, reference) > k_max_switch_error;
+        failed |= !ok;
+        
+        std::printf("radius %4.2f m to %4.2f m, %s: %+.1f dB %s\n", k_radius, k_switch_radius,
+                    mode == EncodingMode::Spatializer ? "spatializer" : "block rate", error, ok ? "ok" : "FAILED");
+    }
+    
+    return failed ? 1 : 0;
+}
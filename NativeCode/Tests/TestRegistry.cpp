@@ -0,0 +1,156 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+// Checks the CommandQueue and the SlotRegistry the sources and the beds are stored in:
+// the order and the capacity of the queue, the handles invalidated by destroy, the reuse
+// of the slots with a new generation, a full registry, and the list of active objects
+// kept consistent by the swap-remove of applyCommands.
+// usage: TestRegistry
+
+#include "HoaLibraryRegistry.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+using namespace HoaLibraryUnity;
+
+namespace
+{
+    struct Object
+    {
+        Object(int v) : value(v) {}
+        int value;
+    };
+    
+    using registry_t = SlotRegistry<Object>;
+    using handle_t = registry_t::handle_t;
+    
+    bool failed = false;
+    
+    void check(bool ok, char const* name)
+    {
+        failed |= !ok;
+        std::printf("%-44s %s\n", name, ok ? "ok" : "FAILED");
+    }
+    
+    handle_t create(registry_t& registry, int value)
+    {
+        return registry.create([value]() { return std::unique_ptr<Object>(new Object(value)); });
+    }
+    
+    //! @brief Returns true if the active objects are exactly the ones of the live handles.
+    bool isActiveConsistent(registry_t const& registry, std::vector<handle_t> const& handles)
+    {
+        std::vector<Object*> live;
+        for(auto handle : handles)
+        {
+            live.push_back(registry.get(handle));
+        }
+        
+        std::vector<Object*> active = registry.getActive();
+        if(std::find(live.begin(), live.end(), nullptr) != live.end())
+            return false;
+        
+        std::sort(live.begin(), live.end());
+        std::sort(active.begin(), active.end());
+        return live == active;
+    }
+    
+    void checkQueue()
+    {
+        CommandQueue<int> queue(3);
+        
+        bool pushed = true;
+        for(int i = 0; i < 4; ++i)
+        {
+            pushed &= queue.push(i);
+        }
+        
+        check(pushed && !queue.push(4), "queue: capacity rounded up to 4");
+        
+        int value = -1;
+        bool ordered = true;
+        for(int i = 0; i < 4; ++i)
+        {
+            ordered &= queue.pop(value) && value == i;
+        }
+        
+        check(ordered && !queue.pop(value), "queue: first in, first out");
+        check(queue.push(5) && queue.pop(value) && value == 5, "queue: cells reused");
+    }
+    
+    void checkRegistry()
+    {
+        registry_t registry(4);
+        
+        const handle_t first = create(registry, 1);
+        check(first != registry_t::invalid_handle && registry.get(first) != nullptr
+              && registry.get(first)->value == 1, "registry: created handle resolves");
+        check(registry.getActive().empty(), "registry: active after applyCommands only");
+        
+        registry.applyCommands();
+        check(registry.getActive().size() == 1, "registry: created object active");
+        
+        check(registry.destroy(first) && registry.get(first) == nullptr, "registry: handle stale after destroy");
+        check(!registry.destroy(first), "registry: double destroy fails");
+        
+        registry.applyCommands();
+        check(registry.getActive().empty(), "registry: destroyed object inactive");
+        
+        // the freed slot is the head of the free list, it is reused with a new generation.
+        const handle_t second = create(registry, 2);
+        const handle_t index_mask = (1 << registry_t::k_index_bits) - 1;
+        check(second != first && (second & index_mask) == (first & index_mask)
+              && registry.get(first) == nullptr && registry.get(second)->value == 2,
+              "registry: slot reuse bumps the generation");
+        
+        std::vector<handle_t> handles { second };
+        for(int i = 3; i <= 5; ++i)
+        {
+            handles.push_back(create(registry, i));
+        }
+        
+        check(create(registry, 6) == registry_t::invalid_handle, "registry: full registry fails");
+        
+        registry.applyCommands();
+        check(isActiveConsistent(registry, handles), "registry: all objects active");
+        
+        // remove the first, a middle and the last active objects.
+        bool consistent = true;
+        for(size_t position : { size_t(0), size_t(1), size_t(1) })
+        {
+            registry.destroy(handles[position]);
+            handles.erase(handles.begin() + static_cast<std::ptrdiff_t>(position));
+            registry.applyCommands();
+            consistent &= isActiveConsistent(registry, handles);
+        }
+        
+        // create and destroy in the same block.
+        const handle_t transient = create(registry, 7);
+        registry.destroy(transient);
+        handles.push_back(create(registry, 8));
+        registry.applyCommands();
+        consistent &= isActiveConsistent(registry, handles);
+        
+        check(consistent, "registry: swap-remove keeps the active list");
+    }
+}
+
+int main()
+{
+    checkQueue();
+    checkRegistry();
+    
+    return failed ? 1 : 0;
+}
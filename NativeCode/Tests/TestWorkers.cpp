@@ -0,0 +1,138 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+// Checks that the ParallelEncoder renders the same soundfield, bit for bit, whatever the
+// number of worker threads of its WorkerPool: a scene of moving sources is encoded on the
+// calling thread only, then with 1 and 4 workers, per encoding mode, and the soundfields
+// must be identical (the chunks are fixed and reduced in a fixed order).
+// usage: TestWorkers
+
+#include "HoaLibraryApi.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace HoaLibraryUnity;
+
+namespace
+{
+    const float_t k_sample_rate = 48000.f;
+    const size_t k_vectorsize = 512;
+    const size_t k_num_blocks = 32;
+    const size_t k_num_sources = 48;
+    const size_t k_num_workers[] = { 1, 4 };
+    
+    std::vector<float_t> make_noise(size_t size)
+    {
+        std::mt19937 generator(1);
+        std::uniform_real_distribution<float_t> distribution(-1.f, 1.f);
+        
+        std::vector<float_t> noise(size);
+        for(auto& sample : noise)
+        {
+            sample = distribution(generator);
+        }
+        
+        return noise;
+    }
+    
+    //! @brief Encodes sources turning around the listener at different speeds and distances,
+    //! and returns the soundfield of all the blocks.
+    harmonics_matrix_t encode(EncodingMode mode, size_t num_workers, std::vector<float_t> const& input)
+    {
+        const size_t order = k_order;
+        const size_t subblock_size = k_default_encoding_subblock_size;
+        
+        std::vector<std::unique_ptr<Source>> sources;
+        std::vector<Source*> encoded;
+        for(size_t i = 0; i < k_num_sources; ++i)
+        {
+            sources.emplace_back(std::make_unique<Source>(order, k_vectorsize, k_sample_rate, nullptr, false));
+            sources.back()->setOptim(static_cast<int>(i % 3));
+            encoded.push_back(sources.back().get());
+        }
+        
+        ParallelEncoder encoder(k_num_sources, k_vectorsize, order, BatchedEncoder(order));
+        std::unique_ptr<WorkerPool> pool = num_workers > 0 ? std::make_unique<WorkerPool>(num_workers, false) : nullptr;
+        
+        const size_t num_harmonics = get_num_harmonics_for_order(order);
+        harmonics_matrix_t soundfield = harmonics_matrix_t::Zero(num_harmonics, k_vectorsize * k_num_blocks);
+        harmonics_matrix_t block = harmonics_matrix_t::Zero(num_harmonics, k_vectorsize);
+        InputStatistics statistics;
+        
+        for(size_t i = 0; i < k_num_blocks; ++i)
+        {
+            const dsptick_t dsptick = i * k_vectorsize;
+            
+            for(size_t j = 0; j < k_num_sources; ++j)
+            {
+                auto& source = *sources[j];
+                const double angle = hoa::math<double>::pi() * (1. + 0.1 * j) * dsptick / k_sample_rate + j;
+                const double distance = 0.5 + 0.1 * j;
+                source.setPosition(static_cast<float_t>(distance * std::cos(angle)),
+                                   static_cast<float_t>(std::sin(0.5 * angle)),
+                                   static_cast<float_t>(distance * std::sin(angle)));
+                
+                source.setInterleavedBuffer(input.data() + 2 * (dsptick + j * k_vectorsize), k_vectorsize, dsptick, 0);
+                source.setEncodingMode(mode, subblock_size);
+                source.acquireInput(dsptick, statistics);
+            }
+            
+            block.setZero();
+            encoder.process(encoded, mode, subblock_size, block, pool.get());
+            soundfield.middleCols(i * k_vectorsize, k_vectorsize) = block;
+        }
+        
+        return soundfield;
+    }
+    
+    const char* get_mode_name(EncodingMode mode)
+    {
+        switch(mode)
+        {
+            case EncodingMode::PerSample: return "per sample";
+            case EncodingMode::BlockRate: return "block rate";
+            case EncodingMode::Matrix: return "matrix";
+            case EncodingMode::Spatializer: return "spatializer";
+        }
+        
+        return "";
+    }
+}
+
+int main()
+{
+    const auto input = make_noise(2 * k_vectorsize * (k_num_blocks + k_num_sources));
+    const EncodingMode modes[] = { EncodingMode::PerSample, EncodingMode::BlockRate, EncodingMode::Matrix };
+    
+    int failures = 0;
+    for(const auto mode : modes)
+    {
+        const harmonics_matrix_t reference = encode(mode, 0, input);
+        const size_t size = static_cast<size_t>(reference.size()) * sizeof(float_t);
+        
+        for(const size_t num_workers : k_num_workers)
+        {
+            const harmonics_matrix_t soundfield = encode(mode, num_workers, input);
+            const bool passed = (reference.cwiseAbs().maxCoeff() > 0.f
+                                 && std::memcmp(soundfield.data(), reference.data(), size) == 0);
+            
+            std::printf("%-12s %zu worker(s) %s\n", get_mode_name(mode), num_workers, passed ? "ok" : "FAILED");
+            failures += passed ? 0 : 1;
+        }
+    }
+    
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,487 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+// Renders a scene offline with the HoaLibraryApi, as fast as the CPU allows.
+// usage: HoaRender scene.txt output.wav [float|pcm16|pcm24]
+//
+// The scene is a text file with one statement per line ('#' starts a comment):
+//
+//   samplerate 48000            rate of the rendering (default: the rate of the first source)
+//   blocksize 512               frames per block (default 512)
+//   order 3                     ambisonic order (default 0: the order of the HRIR set)
+//   output binaural             binaural (default), ambisonic (AmbiX) or speakers <layout>
+//   encoding blockrate          persample (default), blockrate or matrix
+//   workers 2                   threads helping to encode the sources (default 0)
+//   hrir path/to/set.hrir       HRIR set of the binaural output, a HOAHRIR file (default: built-in)
+//   tail 1.5                    seconds rendered after the end of the inputs (default 1)
+//   source car car.wav -6       a source, its WAV file and its gain in dB (default 0)
+//   key car 0.0 -5 0 10         a position keyframe of a source: time in seconds, then
+//                               x (right), y (up), z (front) in meters from the listener
+//
+// The relative paths are relative to the scene file. The inputs are resampled to the rate
+// of the rendering, mono inputs are played on both channels of their source. A source is
+// held at its first keyframe before it and at its last one after it, and its position is
+// linearly interpolated in between, once per block (the library smoothes it over the block).
+
+#include "HoaLibraryApi.h"
+#include "HoaLibraryResampler.h"
+#include "WavFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace HoaLibraryUnity;
+using namespace HoaLibraryTools;
+using clock_type = std::chrono::steady_clock;
+
+namespace
+{
+    struct Keyframe
+    {
+        double time = 0.;
+        float_t x = 0.f, y = 0.f, z = 0.f;
+    };
+
+    struct SceneSource
+    {
+        std::string name {};
+        std::string path {};
+        float_t gain = 1.f;
+        std::vector<Keyframe> keyframes {};
+        AudioBuffer input {};   // stereo, at the rate of the rendering
+    };
+
+    enum class OutputMode
+    {
+        Binaural,
+        Ambisonic,
+        Speakers
+    };
+
+    struct Scene
+    {
+        double sample_rate = 0.;
+        size_t blocksize = 512;
+        size_t order = 0;
+        OutputMode output = OutputMode::Binaural;
+        std::string layout {};
+        EncodingMode encoding = EncodingMode::PerSample;
+        size_t workers = 0;
+        std::string hrir {};
+        double tail = 1.;
+        std::vector<SceneSource> sources {};
+    };
+
+    std::string get_directory(std::string const& path)
+    {
+        const auto separator = path.find_last_of("/\\");
+        return separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+    }
+
+    std::string resolve(std::string const& directory, std::string const& path)
+    {
+        const bool absolute = !path.empty() && (path[0] == '/' || path[0] == '\\'
+                                                || (path.size() > 1 && path[1] == ':'));
+        return absolute ? path : directory + path;
+    }
+
+    bool fail(size_t line, std::string const& message)
+    {
+        std::fprintf(stderr, "scene line %zu: %s\n", line, message.c_str());
+        return false;
+    }
+
+    bool parse_scene(std::string const& path, Scene& scene)
+    {
+        std::ifstream file(path);
+        if(!file)
+        {
+            std::fprintf(stderr, "can't open %s\n", path.c_str());
+            return false;
+        }
+
+        const auto directory = get_directory(path);
+
+        std::string text;
+        size_t number = 0;
+        while(std::getline(file, text))
+        {
+            ++number;
+            text = text.substr(0, text.find('#'));
+
+            std::istringstream line(text);
+            std::string keyword;
+            if(!(line >> keyword))
+                continue;
+
+            if(keyword == "samplerate")
+            {
+                if(!(line >> scene.sample_rate) || scene.sample_rate <= 0.)
+                    return fail(number, "invalid sample rate");
+            }
+            else if(keyword == "blocksize")
+            {
+                if(!(line >> scene.blocksize) || scene.blocksize == 0)
+                    return fail(number, "invalid block size");
+            }
+            else if(keyword == "order")
+            {
+                if(!(line >> scene.order))
+                    return fail(number, "invalid order");
+            }
+            else if(keyword == "output")
+            {
+                std::string mode;
+                line >> mode;
+                if(mode == "binaural")
+                {
+                    scene.output = OutputMode::Binaural;
+                }
+                else if(mode == "ambisonic")
+                {
+                    scene.output = OutputMode::Ambisonic;
+                }
+                else if(mode == "speakers")
+                {
+                    // the rest of the line, a preset or a list of speakers (see get_speaker_layout).
+                    std::getline(line >> std::ws, scene.layout);
+                    scene.output = OutputMode::Speakers;
+                }
+                else
+                {
+                    return fail(number, "unknown output " + mode);
+                }
+            }
+            else if(keyword == "encoding")
+            {
+                std::string mode;
+                line >> mode;
+                if(mode == "persample")
+                    scene.encoding = EncodingMode::PerSample;
+                else if(mode == "blockrate")
+                    scene.encoding = EncodingMode::BlockRate;
+                else if(mode == "matrix")
+                    scene.encoding = EncodingMode::Matrix;
+                else
+                    return fail(number, "unknown encoding " + mode);
+            }
+            else if(keyword == "workers")
+            {
+                if(!(line >> scene.workers))
+                    return fail(number, "invalid number of workers");
+            }
+            else if(keyword == "hrir")
+            {
+                std::string hrir;
+                std::getline(line >> std::ws, hrir);
+                scene.hrir = resolve(directory, hrir);
+            }
+            else if(keyword == "tail")
+            {
+                if(!(line >> scene.tail) || scene.tail < 0.)
+                    return fail(number, "invalid tail");
+            }
+            else if(keyword == "source")
+            {
+                SceneSource source;
+                float_t gain_db = 0.f;
+                if(!(line >> source.name >> source.path))
+                    return fail(number, "a source needs a name and a file");
+
+                line >> gain_db;
+                source.path = resolve(directory, source.path);
+                source.gain = std::pow(10.f, gain_db * 0.05f);
+                scene.sources.push_back(std::move(source));
+            }
+            else if(keyword == "key")
+            {
+                std::string name;
+                Keyframe keyframe;
+                if(!(line >> name >> keyframe.time >> keyframe.x >> keyframe.y >> keyframe.z))
+                    return fail(number, "a keyframe needs a source, a time and a position");
+
+                auto it = std::find_if(scene.sources.begin(), scene.sources.end(),
+                                       [&](SceneSource const& source) { return source.name == name; });
+                if(it == scene.sources.end())
+                    return fail(number, "unknown source " + name);
+
+                it->keyframes.push_back(keyframe);
+            }
+            else
+            {
+                return fail(number, "unknown statement " + keyword);
+            }
+        }
+
+        for(auto& source : scene.sources)
+        {
+            std::stable_sort(source.keyframes.begin(), source.keyframes.end(),
+                             [](Keyframe const& lhs, Keyframe const& rhs) { return lhs.time < rhs.time; });
+        }
+
+        return true;
+    }
+
+    //! @brief Reads the input of a source as a stereo signal at the rate of the rendering.
+    bool load_input(SceneSource& source, double& sample_rate)
+    {
+        AudioBuffer file;
+        std::string error;
+        if(!read_wav(source.path, file, error))
+        {
+            std::fprintf(stderr, "source %s: %s\n", source.name.c_str(), error.c_str());
+            return false;
+        }
+
+        if(sample_rate <= 0.)
+        {
+            sample_rate = file.sample_rate;
+        }
+
+        const size_t frames = file.getNumberOfFrames();
+        auto& input = source.input;
+        input.channels = 2;
+        input.sample_rate = sample_rate;
+
+        if(file.sample_rate == sample_rate)
+        {
+            input.samples.resize(frames * 2);
+            for(size_t frame = 0; frame < frames; ++frame)
+            {
+                input.samples[frame * 2] = file.samples[frame * file.channels];
+                input.samples[frame * 2 + 1] = file.samples[frame * file.channels + (file.channels > 1 ? 1 : 0)];
+            }
+
+            return true;
+        }
+
+        PolyphaseResampler resampler(file.sample_rate, sample_rate);
+        if(!resampler.isValid())
+        {
+            std::fprintf(stderr, "source %s: can't resample from %g Hz to %g Hz\n",
+                         source.name.c_str(), file.sample_rate, sample_rate);
+            return false;
+        }
+
+        input.samples.resize(resampler.getOutputLength(frames) * 2);
+        for(size_t channel = 0; channel < 2; ++channel)
+        {
+            const size_t file_channel = std::min(channel, file.channels - 1);
+            resampler.process(file.samples.data() + file_channel, frames, file.channels,
+                              input.samples.data() + channel, 2);
+        }
+
+        return true;
+    }
+
+    Keyframe get_position(std::vector<Keyframe> const& keyframes, double time)
+    {
+        if(keyframes.empty())
+            return Keyframe();
+
+        auto next = std::upper_bound(keyframes.begin(), keyframes.end(), time,
+                                     [](double value, Keyframe const& keyframe) { return value < keyframe.time; });
+        if(next == keyframes.begin())
+            return keyframes.front();
+        if(next == keyframes.end())
+            return keyframes.back();
+
+        auto const& previous = *(next - 1);
+        const double span = next->time - previous.time;
+        const float_t ratio = static_cast<float_t>(span > 0. ? (time - previous.time) / span : 1.);
+
+        Keyframe position;
+        position.time = time;
+        position.x = previous.x + (next->x - previous.x) * ratio;
+        position.y = previous.y + (next->y - previous.y) * ratio;
+        position.z = previous.z + (next->z - previous.z) * ratio;
+        return position;
+    }
+
+    WavFormat get_format(std::string const& name, bool& valid)
+    {
+        valid = true;
+        if(name == "pcm16")
+            return WavFormat::Pcm16;
+        if(name == "pcm24")
+            return WavFormat::Pcm24;
+
+        valid = (name == "float");
+        return WavFormat::Float32;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 3)
+    {
+        std::fprintf(stderr, "usage: HoaRender scene.txt output.wav [float|pcm16|pcm24]\n");
+        return 1;
+    }
+
+    bool valid_format = true;
+    const auto format = get_format(argc > 3 ? argv[3] : "float", valid_format);
+    if(!valid_format)
+    {
+        std::fprintf(stderr, "unknown format %s\n", argv[3]);
+        return 1;
+    }
+
+    Scene scene;
+    if(!parse_scene(argv[1], scene))
+        return 1;
+
+    size_t input_frames = 0;
+    for(auto& source : scene.sources)
+    {
+        if(!load_input(source, scene.sample_rate))
+            return 1;
+
+        input_frames = std::max(input_frames, source.input.getNumberOfFrames());
+    }
+
+    if(scene.sample_rate <= 0.)
+    {
+        scene.sample_rate = 48000.;
+    }
+
+    ApiSettings settings;
+    settings.vectorsize = scene.blocksize;
+    settings.sample_rate = static_cast<float_t>(scene.sample_rate);
+    settings.order = scene.order;
+    settings.worker_threads = scene.workers;
+    settings.max_sources = std::max(settings.max_sources, scene.sources.size());
+    settings.speakers.layout = scene.layout;
+
+    std::unique_ptr<HoaLibraryApi> api(CreateHoaLibraryApi(settings));
+    api->setEncodingMode(scene.encoding);
+
+    size_t channels = 2;
+    if(scene.output == OutputMode::Ambisonic)
+    {
+        channels = get_num_harmonics_for_order(api->getOrder());
+    }
+    else if(scene.output == OutputMode::Speakers)
+    {
+        channels = api->getNumberOfSpeakers();
+        if(channels == 0)
+        {
+            std::fprintf(stderr, "invalid speaker layout \"%s\"\n", scene.layout.c_str());
+            return 1;
+        }
+    }
+
+    if(!scene.hrir.empty())
+    {
+        api->loadHrir(scene.hrir, std::string());
+        while(api->getHrirStatus() == HrirStatus::Loading)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        if(api->getHrirStatus() != HrirStatus::Loaded)
+        {
+            std::fprintf(stderr, "can't load the HRIR set %s\n", scene.hrir.c_str());
+            return 1;
+        }
+    }
+
+    std::vector<HoaLibraryApi::source_id_t> ids;
+    for(auto const& source : scene.sources)
+    {
+        ids.push_back(api->createSource());
+        api->setSourceGain(ids.back(), source.gain);
+    }
+
+    const size_t blocksize = scene.blocksize;
+    const size_t total_frames = input_frames + static_cast<size_t>(std::lround(scene.tail * scene.sample_rate));
+    const size_t num_blocks = (total_frames + blocksize - 1) / blocksize;
+
+    AudioBuffer output;
+    output.channels = channels;
+    output.sample_rate = scene.sample_rate;
+    output.samples.resize(num_blocks * blocksize * channels);
+
+    std::vector<float_t> block(blocksize * 2);
+
+    const auto start = clock_type::now();
+
+    for(size_t index = 0; index < num_blocks; ++index)
+    {
+        const size_t first_frame = index * blocksize;
+        const auto dsptick = static_cast<dsptick_t>(first_frame);
+        const double time = first_frame / scene.sample_rate;
+
+        for(size_t s = 0; s < scene.sources.size(); ++s)
+        {
+            auto const& source = scene.sources[s];
+            const auto position = get_position(source.keyframes, time);
+            api->setSourcePosition(ids[s], position.x, position.y, position.z);
+
+            // the inputs are zero-padded to the end of the rendering.
+            const size_t frames = source.input.getNumberOfFrames();
+            const size_t available = first_frame < frames ? std::min(blocksize, frames - first_frame) : 0;
+            std::fill(block.begin(), block.end(), 0.f);
+            if(available > 0)
+            {
+                std::copy_n(source.input.samples.begin() + first_frame * 2, available * 2, block.begin());
+            }
+
+            api->setInterleavedSourceBuffer(ids[s], block.data(), blocksize, dsptick);
+        }
+
+        float_t* outputs = output.samples.data() + first_frame * channels;
+        switch(scene.output)
+        {
+            case OutputMode::Binaural:
+                api->fillInterleavedOutputBuffer(blocksize, outputs, dsptick);
+                break;
+            case OutputMode::Ambisonic:
+                api->fillInterleavedAmbisonicBuffer(blocksize, channels, outputs, dsptick);
+                break;
+            case OutputMode::Speakers:
+                api->fillInterleavedSpeakerBuffer(blocksize, channels, outputs, dsptick);
+                break;
+        }
+    }
+
+    const double elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    output.samples.resize(total_frames * channels);
+    if(!write_wav(argv[2], output, format))
+    {
+        std::fprintf(stderr, "can't write %s\n", argv[2]);
+        return 1;
+    }
+
+    const double duration = total_frames / scene.sample_rate;
+    const auto statistics = api->getInputStatistics();
+
+    std::printf("rendered %.3f s of %zu sources to %zu channels at %g Hz in %.3f s "
+                "(real-time factor %.1f)\n",
+                duration, scene.sources.size(), channels, scene.sample_rate, elapsed,
+                elapsed > 0. ? duration / elapsed : 0.);
+    std::printf("blocks concealed %llu, duplicated %llu, dropped %llu\n",
+                static_cast<unsigned long long>(statistics.concealed_blocks),
+                static_cast<unsigned long long>(statistics.duplicated_blocks),
+                static_cast<unsigned long long>(statistics.dropped_blocks));
+
+    return 0;
+}
@@ -0,0 +1,244 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#include "WavFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace HoaLibraryTools
+{
+    namespace
+    {
+        const uint16_t k_format_pcm = 1;
+        const uint16_t k_format_float = 3;
+        const uint16_t k_format_extensible = 0xFFFE;
+
+        // the files are little-endian whatever the platform.
+        uint32_t get_u32(unsigned char const* data)
+        {
+            return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8)
+            | (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+        }
+
+        uint16_t get_u16(unsigned char const* data)
+        {
+            return static_cast<uint16_t>(data[0] | (data[1] << 8));
+        }
+
+        void put_u32(std::vector<unsigned char>& data, uint32_t value)
+        {
+            for(int i = 0; i < 4; ++i)
+                data.push_back(static_cast<unsigned char>((value >> (8 * i)) & 0xFF));
+        }
+
+        void put_u16(std::vector<unsigned char>& data, uint16_t value)
+        {
+            data.push_back(static_cast<unsigned char>(value & 0xFF));
+            data.push_back(static_cast<unsigned char>(value >> 8));
+        }
+
+        void put_tag(std::vector<unsigned char>& data, char const* tag)
+        {
+            data.insert(data.end(), tag, tag + 4);
+        }
+
+        float read_sample(unsigned char const* data, uint16_t format, uint16_t bits)
+        {
+            if(format == k_format_float)
+            {
+                if(bits == 32)
+                {
+                    uint32_t value = get_u32(data);
+                    float sample;
+                    std::memcpy(&sample, &value, sizeof(sample));
+                    return sample;
+                }
+
+                uint64_t value = static_cast<uint64_t>(get_u32(data)) | (static_cast<uint64_t>(get_u32(data + 4)) << 32);
+                double sample;
+                std::memcpy(&sample, &value, sizeof(sample));
+                return static_cast<float>(sample);
+            }
+
+            switch(bits)
+            {
+                case 8: return (static_cast<int>(data[0]) - 128) / 128.f;
+                case 16: return static_cast<int16_t>(get_u16(data)) / 32768.f;
+                case 24:
+                {
+                    const int32_t value = static_cast<int32_t>((data[0] << 8) | (data[1] << 16)
+                                                               | (static_cast<uint32_t>(data[2]) << 24)) >> 8;
+                    return value / 8388608.f;
+                }
+                default: return static_cast<float>(static_cast<int32_t>(get_u32(data)) / 2147483648.);
+            }
+        }
+    }
+
+    bool read_wav(std::string const& path, AudioBuffer& buffer, std::string& error)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if(!file)
+        {
+            error = "can't open " + path;
+            return false;
+        }
+
+        const std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)),
+                                              std::istreambuf_iterator<char>());
+
+        if(data.size() < 12 || std::memcmp(data.data(), "RIFF", 4) != 0
+           || std::memcmp(data.data() + 8, "WAVE", 4) != 0)
+        {
+            error = path + " is not a WAV file";
+            return false;
+        }
+
+        uint16_t format = 0, channels = 0, bits = 0;
+        uint32_t sample_rate = 0;
+        unsigned char const* samples = nullptr;
+        size_t samples_size = 0;
+
+        size_t position = 12;
+        while(position + 8 <= data.size())
+        {
+            unsigned char const* chunk = data.data() + position;
+            const size_t size = std::min<size_t>(get_u32(chunk + 4), data.size() - position - 8);
+
+            if(std::memcmp(chunk, "fmt ", 4) == 0 && size >= 16)
+            {
+                format = get_u16(chunk + 8);
+                channels = get_u16(chunk + 10);
+                sample_rate = get_u32(chunk + 12);
+                bits = get_u16(chunk + 22);
+
+                // the format of the extensible files is the first two bytes of the sub format.
+                if(format == k_format_extensible && size >= 40)
+                {
+                    format = get_u16(chunk + 32);
+                }
+            }
+            else if(std::memcmp(chunk, "data", 4) == 0)
+            {
+                samples = chunk + 8;
+                samples_size = size;
+            }
+
+            // the chunks are padded to an even size.
+            position += 8 + size + (size & 1);
+        }
+
+        const bool supported = (format == k_format_pcm && (bits == 8 || bits == 16 || bits == 24 || bits == 32))
+        || (format == k_format_float && (bits == 32 || bits == 64));
+
+        if(!supported || channels == 0 || sample_rate == 0 || samples == nullptr)
+        {
+            error = path + ": unsupported WAV format";
+            return false;
+        }
+
+        const size_t sample_size = bits / 8;
+        const size_t num_samples = samples_size / sample_size / channels * channels;
+
+        buffer.channels = channels;
+        buffer.sample_rate = sample_rate;
+        buffer.samples.resize(num_samples);
+        for(size_t i = 0; i < num_samples; ++i)
+        {
+            buffer.samples[i] = read_sample(samples + i * sample_size, format, bits);
+        }
+
+        return true;
+    }
+
+    bool write_wav(std::string const& path, AudioBuffer const& buffer, WavFormat format)
+    {
+        const uint16_t bits = (format == WavFormat::Pcm16) ? 16 : (format == WavFormat::Pcm24) ? 24 : 32;
+        const uint16_t tag = (format == WavFormat::Float32) ? k_format_float : k_format_pcm;
+        const bool extensible = buffer.channels > 2;
+        const uint16_t channels = static_cast<uint16_t>(buffer.channels);
+        const uint32_t sample_rate = static_cast<uint32_t>(std::lround(buffer.sample_rate));
+        const uint32_t block_align = channels * bits / 8u;
+        const uint32_t data_size = static_cast<uint32_t>(buffer.samples.size() * bits / 8);
+        const uint32_t fmt_size = extensible ? 40 : 16;
+
+        std::vector<unsigned char> data;
+        data.reserve(data_size + 68);
+
+        put_tag(data, "RIFF");
+        put_u32(data, 4 + (8 + fmt_size) + (8 + data_size + (data_size & 1)));
+        put_tag(data, "WAVE");
+
+        put_tag(data, "fmt ");
+        put_u32(data, fmt_size);
+        put_u16(data, extensible ? k_format_extensible : tag);
+        put_u16(data, channels);
+        put_u32(data, sample_rate);
+        put_u32(data, sample_rate * block_align);
+        put_u16(data, static_cast<uint16_t>(block_align));
+        put_u16(data, bits);
+
+        if(extensible)
+        {
+            static const unsigned char guid_tail[14] = {
+                0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71
+            };
+
+            put_u16(data, 22);
+            put_u16(data, bits);
+            put_u32(data, 0);
+            put_u16(data, tag);
+            data.insert(data.end(), guid_tail, guid_tail + sizeof(guid_tail));
+        }
+
+        put_tag(data, "data");
+        put_u32(data, data_size);
+
+        for(const float sample : buffer.samples)
+        {
+            if(format == WavFormat::Float32)
+            {
+                uint32_t value;
+                std::memcpy(&value, &sample, sizeof(value));
+                put_u32(data, value);
+                continue;
+            }
+
+            const float clipped = std::max(-1.f, std::min(1.f, sample));
+            if(format == WavFormat::Pcm16)
+            {
+                const auto value = static_cast<int16_t>(std::lround(clipped * 32767.f));
+                put_u16(data, static_cast<uint16_t>(value));
+            }
+            else
+            {
+                const auto value = static_cast<uint32_t>(static_cast<int32_t>(std::lround(clipped * 8388607.f)));
+                data.push_back(static_cast<unsigned char>(value & 0xFF));
+                data.push_back(static_cast<unsigned char>((value >> 8) & 0xFF));
+                data.push_back(static_cast<unsigned char>((value >> 16) & 0xFF));
+            }
+        }
+
+        if(data_size & 1)
+        {
+            data.push_back(0);
+        }
+
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<char const*>(data.data()), static_cast<std::streamsize>(data.size()));
+        return static_cast<bool>(file);
+    }
+}
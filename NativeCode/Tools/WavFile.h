@@ -0,0 +1,49 @@
+//==============================================================================
+// HoaLibrary for Unity - version 1.0.0
+// https://github.com/CICM/HoaLibrary-Unity
+// Copyright (c) 2019, Eliott Paris, CICM, ArTeC.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+// Thirdparty :
+// - HoaLibrary-Light: https://github.com/CICM/HoaLibrary-Light
+// - Unity nativeaudioplugins SDK: https://bitbucket.org/Unity-Technologies/nativeaudioplugins.
+//==============================================================================
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace HoaLibraryTools
+{
+    //! @brief Sample format of a written WAV file.
+    enum class WavFormat
+    {
+        Pcm16,
+        Pcm24,
+        Float32,
+    };
+
+    //! @brief An interleaved audio signal.
+    struct AudioBuffer
+    {
+        std::vector<float> samples {};
+        size_t channels = 0;
+        double sample_rate = 0.;
+
+        size_t getNumberOfFrames() const noexcept { return channels > 0 ? samples.size() / channels : 0; }
+    };
+
+    //! @brief Reads a WAV file: PCM 8, 16, 24 or 32 bits, or float 32 or 64 bits,
+    //! plain or WAVE_FORMAT_EXTENSIBLE.
+    //! @param error The reason of the failure.
+    //! @return false if the file can't be read.
+    bool read_wav(std::string const& path, AudioBuffer& buffer, std::string& error);
+
+    //! @brief Writes a WAV file, the PCM samples are clipped.
+    //! @details The files of more than two channels are written as WAVE_FORMAT_EXTENSIBLE
+    //! without channel mask.
+    //! @return false if the file can't be written.
+    bool write_wav(std::string const& path, AudioBuffer const& buffer, WavFormat format);
+}
@@ -64,7 +64,9 @@ int UNITY_AUDIODSP_CALLBACK
 GetFloatBufferCallback(effect_state_t* state,
                        const char* name, float* buffer, int numsamples)
 {
-    return UNITY_AUDIODSP_OK;
+    auto* processor = getProcessor(*state);
+    return (processor->getFloatBuffer(state, name, buffer, numsamples)
+            ? UNITY_AUDIODSP_OK : UNITY_AUDIODSP_ERR_UNSUPPORTED);
 }
 
 UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK